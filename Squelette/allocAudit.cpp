@@ -0,0 +1,105 @@
+#include "allocAudit.h"
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+
+#ifdef _MSC_VER
+#include <crtdbg.h>
+#define AUDIT_TLS __declspec(thread)
+#else
+#define AUDIT_TLS __thread
+#endif
+
+static std::atomic<bool> enabled(false);
+static std::atomic<int> alloc_ctr(0);
+static AUDIT_TLS bool audited = false; // le thread courant fait partie de la boucle
+
+static void countAlloc(){
+	if (audited && enabled)
+		alloc_ctr++;
+}
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+
+static int __cdecl allocHook(int type, void* data, size_t size, int block, long request, const unsigned char* file, int line){
+	if (type == _HOOK_ALLOC || type == _HOOK_REALLOC)
+		countAlloc();
+	return TRUE;
+}
+
+static void installHook(){
+	_CrtSetAllocHook(allocHook);
+}
+
+#elif defined(__GLIBC__)
+
+/* operator new de libstdc++ passe par malloc : il est compte ici aussi */
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t nb, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+extern "C" void* malloc(size_t size){
+	countAlloc();
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t nb, size_t size){
+	countAlloc();
+	return __libc_calloc(nb, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size){
+	countAlloc();
+	return __libc_realloc(ptr, size);
+}
+
+static void installHook(){
+}
+
+#else
+
+void* operator new(size_t size){
+	countAlloc();
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size){
+	return operator new(size);
+}
+
+void operator delete(void* p) throw(){
+	free(p);
+}
+
+void operator delete[](void* p) throw(){
+	free(p);
+}
+
+static void installHook(){
+}
+
+#endif
+
+void allocAuditStart(){
+	installHook();
+	alloc_ctr = 0;
+	allocAuditThread();
+	enabled = true;
+}
+
+/* a appeler depuis chaque thread de la boucle, y compris le thread GL */
+void allocAuditThread(){
+	audited = true;
+}
+
+/* allocations comptees depuis l'appel precedent */
+int allocAuditFrame(){
+	return alloc_ctr.exchange(0);
+}
+
+void allocAuditStop(){
+	enabled = false;
+}
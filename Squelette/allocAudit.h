@@ -0,0 +1,19 @@
+#ifndef ALLOCAUDIT_H
+#define ALLOCAUDIT_H
+
+/* Comptage des allocations du tas faites par les threads de la boucle (rendu, lecture,
+calcul), pour verifier qu'une fois le vetement charge une image n'alloue plus rien.
+Les threads de chargement ne sont pas comptes : ils allouent par construction.
+- MSVC en Debug : crochet _CrtSetAllocHook (malloc, new et tampons du CRT) ;
+- glibc : malloc, calloc et realloc redefinis au-dessus de __libc_malloc ;
+- ailleurs (dont MSVC en Release) : operator new seulement.
+Inactif tant que allocAuditStart n'a pas ete appele. */
+
+#define ALLOC_AUDIT_WARMUP 60 // images ignorees apres la fin des chargements
+
+void allocAuditStart();
+void allocAuditThread();
+int allocAuditFrame();
+void allocAuditStop();
+
+#endif
@@ -0,0 +1,72 @@
+#include "background.h"
+#include "frameRing.h"
+#include "shaderCache.h"
+#include "profiler.h"
+#include <stdio.h>
+
+#define STR2(x) #x
+#define STR(x) STR2(x)
+
+/* triangle couvrant l'ecran, sans attribut ; l'image est a la profondeur du plan lointain */
+static const GLchar* backgroundVertex =
+"#version 410 core\n"
+"out vec2 st;"
+"void main(){"
+"	vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);"
+"	st = vec2(" STR(BACKGROUND_MIRROR) " != 0 ? 1.0 - p.x : p.x, 1.0 - p.y);"
+"	gl_Position = vec4(2.0 * p - 1.0, 1.0, 1.0);"
+"}";
+
+static const GLchar* backgroundFragment =
+"#version 410 core\n"
+"in vec2 st;"
+"out vec4 outColor;"
+"uniform sampler2D frame;"
+"void main(){"
+"	outColor = vec4(texture(frame, st).rgb, 1.0);"
+"}";
+
+static FrameRing ring;
+static RingTexture stream;
+static GLuint program = 0;
+static GLuint vao = 0;
+
+bool backgroundOpen(const char* source){
+	if (!ringOpen(&ring, source, false)){
+		printf("fond : fond blanc\n");
+		return false;
+	}
+	program = createProgram(backgroundVertex, backgroundFragment);
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "frame"), 0);
+	glGenVertexArrays(1, &vao);
+	ringTextureCreate(&stream, &ring);
+	return true;
+}
+
+void backgroundClose(){
+	if (ring.header == NULL)
+		return;
+	ringClose(&ring);
+	ringTextureDestroy(&stream);
+	glDeleteProgram(program);
+	glDeleteVertexArrays(1, &vao);
+}
+
+void backgroundDraw(){
+	if (ring.header == NULL)
+		return;
+	profBeginCPU(STAGE_BACKGROUND);
+	ringTextureUpdate(&stream, &ring);
+	if (stream.shown != 0){
+		glDisable(GL_DEPTH_TEST);
+		glDepthMask(GL_FALSE);
+		glUseProgram(program);
+		glBindVertexArray(vao);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, stream.texture);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glDepthMask(GL_TRUE);
+	}
+	profEndCPU(STAGE_BACKGROUND);
+}
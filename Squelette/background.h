@@ -0,0 +1,27 @@
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+/* Fond du miroir : l'image de la camera couleur, sous le vetement (Squelette --background SOURCE).
+SOURCE est soit la memoire partagee ecrite par le producteur du flux couleur (objet nomme
+sous Windows, fichier projete sinon), soit pour les essais une suite d'images TGA ou BMP
+numerotees ("essai/image%04d.tga"), lue en boucle par un thread qui joue le role du
+producteur (voir frameRing.h). A chaque image affichee, la derniere image complete est
+envoyee dans la texture de streaming, puis dessinee en plein ecran juste avant le vetement,
+dans la meme passe. L'image du capteur est donc a l'ecran a l'echange qui suit sa
+publication, sans file d'attente. */
+
+#define BACKGROUND_MIRROR 1          // image retournee gauche-droite, comme dans un miroir
+
+/* contexte GL courant ; false si la source est absente ou invalide (fond blanc) */
+bool backgroundOpen(const char* source);
+void backgroundClose();
+
+/* envoie la derniere image si elle est nouvelle, puis la dessine ; thread de rendu */
+void backgroundDraw();
+
+#endif
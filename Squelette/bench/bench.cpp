@@ -0,0 +1,821 @@
+#include "../matrixCalc.h"
+#include "../importer.h"
+#include "../frameArena.h"
+#include "../profiler.h"
+#include "../cloth.h"
+#include "../bodyCollision.h"
+#include "../skinWeights.h"
+#include "../skinKernels.h"
+#include "../skeletonCodec.h"
+#include "../occlusion.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+/* Microbenchmarks des calculs de pose, de la lecture Kinect, du codage des positions,
+de l'import des vetements et de l'encodage PNG, sans fenetre ni contexte GL.
+	./bench [resultats.json] [repertoire des fichiers de test]
+Un cas prend ses tableaux par caseAlloc, les mesure par runCase puis les libere d'un
+coup par caseFree. Chaque mesure se fait par echantillons de 'batch' appels, batch etant
+choisi pour qu'un echantillon dure au moins BENCH_SAMPLE_US ; les resultats (moyenne, min,
+mediane, p95 par appel) sont ecrits en JSON pour comparer deux versions. Le code de
+retour vaut 1 si l'erreur du codage des positions depasse la borne de skeletonCodec.h
+ou si un point connu ne tombe pas sur le texel attendu de la carte de profondeur. */
+
+#define BENCH_SAMPLE_US 200.0  // duree minimale d'un echantillon
+#define BENCH_MAX_SAMPLES 200
+#define BENCH_TIME_S 1.0       // temps maximal par cas, hors calibration
+#define BENCH_MAX_RESULTS 64
+#define BENCH_INPUTS 1024      // jeux d'entrees parcourus par getRot et updateMatrix
+#define BENCH_CODEC_FRAMES 900 // 30 s de positions a 30 images/s
+#define BENCH_MAX_BUFFERS 16   // tableaux d'un meme cas
+
+int nb_bones = 8;
+
+unsigned char* stbi_write_png_to_mem(unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len);
+
+struct BenchResult{
+	char name[64];
+	int samples;
+	int batch;
+	double mean_us;
+	double min_us;
+	double median_us;
+	double p95_us;
+	double items;      // unites traitees par appel (os, sommets, octets...) ; 0 si sans objet
+};
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static int result_ctr = 0;
+static const char* data_dir = "..";
+static volatile float sink = 0.0f; // empeche l'elimination des appels mesures
+static int failure_ctr = 0;        // verifications en echec (bornes, texels attendus) et cas impossibles
+static void* case_buffers[BENCH_MAX_BUFFERS];
+static int case_buffer_ctr = 0;
+
+typedef void(*BenchFn)(void* ctx);
+
+/* false si le resultat ne peut pas etre garde */
+static bool runBench(const char* name, BenchFn fn, void* ctx, double items){
+	if (result_ctr == BENCH_MAX_RESULTS){
+		printf("plus de %i resultats, %s ignore\n", BENCH_MAX_RESULTS, name);
+		failure_ctr++;
+		return false;
+	}
+	/* calibration : on double le batch jusqu'a atteindre BENCH_SAMPLE_US */
+	int batch = 1;
+	for (;;){
+		double start = profNow();
+		for (int i = 0; i < batch; i++)
+			fn(ctx);
+		double us = (profNow() - start) * 1e6;
+		if (us >= BENCH_SAMPLE_US || batch >= (1 << 20))
+			break;
+		batch *= 2;
+	}
+
+	double samples[BENCH_MAX_SAMPLES];
+	int ctr = 0;
+	double bench_start = profNow();
+	while (ctr < BENCH_MAX_SAMPLES && (ctr < 5 || profNow() - bench_start < BENCH_TIME_S)){
+		double start = profNow();
+		for (int i = 0; i < batch; i++)
+			fn(ctx);
+		samples[ctr++] = (profNow() - start) * 1e6 / batch;
+	}
+	std::sort(samples, samples + ctr);
+
+	BenchResult* r = &results[result_ctr++];
+	memset(r, 0, sizeof(BenchResult));
+	strncpy(r->name, name, sizeof(r->name) - 1);
+	r->samples = ctr;
+	r->batch = batch;
+	for (int i = 0; i < ctr; i++)
+		r->mean_us += samples[i];
+	r->mean_us /= ctr;
+	r->min_us = samples[0];
+	r->median_us = samples[ctr / 2];
+	r->p95_us = samples[(ctr * 95) / 100 < ctr ? (ctr * 95) / 100 : ctr - 1];
+	r->items = items;
+	printf("%-32s %10.3f us  (min %.3f, p95 %.3f, %i x %i)\n", name, r->median_us, r->min_us, r->p95_us, ctr, batch);
+	return true;
+}
+
+/* runBench avec un nom forme a la printf */
+static bool runCase(BenchFn fn, void* ctx, double items, const char* format, ...){
+	char name[256];
+	va_list args;
+	va_start(args, format);
+	vsprintf(name, format, args);
+	va_end(args);
+	return runBench(name, fn, ctx, items);
+}
+
+/* tableau mis a zero, libere avec ceux du meme cas par caseFree (un cas a la fois) */
+static void* caseAlloc(size_t bytes){
+	if (case_buffer_ctr == BENCH_MAX_BUFFERS){
+		printf("plus de %i tableaux pour un cas\n", BENCH_MAX_BUFFERS);
+		exit(1);
+	}
+	void* p = calloc(1, bytes);
+	case_buffers[case_buffer_ctr++] = p;
+	return p;
+}
+
+static void caseFree(){
+	for (int i = 0; i < case_buffer_ctr; i++)
+		free(case_buffers[i]);
+	case_buffer_ctr = 0;
+}
+
+static bool writeResults(const char* path){
+	FILE* out = fopen(path, "w");
+	if (out == NULL)
+		return false;
+	fprintf(out, "{\n  \"suite\": \"squelette\",\n  \"unit\": \"us\",\n  \"benchmarks\": [\n");
+	for (int i = 0; i < result_ctr; i++){
+		const BenchResult* r = &results[i];
+		fprintf(out, "    {\"name\": \"%s\", \"samples\": %i, \"batch\": %i, \"mean\": %.4f, \"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"items\": %.0f}%s\n",
+			r->name, r->samples, r->batch, r->mean_us, r->min_us, r->median_us, r->p95_us, r->items,
+			i + 1 < result_ctr ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+	fclose(out);
+	return true;
+}
+
+static void dataPath(char* out, const char* file){
+	sprintf(out, "%.400s/%.100s", data_dir, file);
+}
+
+static float frand(){
+	return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+/* --- calculs de pose --- */
+
+struct PoseInputs{
+	glm::vec3 ref1[BENCH_INPUTS];
+	glm::vec3 ref2[BENCH_INPUTS];
+	glm::vec3 mov1[BENCH_INPUTS];
+	glm::vec3 mov2[BENCH_INPUTS];
+	int next;
+};
+
+static void benchGetRot(void* ctx){
+	PoseInputs* in = (PoseInputs*)ctx;
+	int i = in->next++ & (BENCH_INPUTS - 1);
+	sink += getRot(in->ref1[i], in->ref2[i], in->mov1[i], in->mov2[i]);
+}
+
+static void benchUpdateMatrix(void* ctx){
+	PoseInputs* in = (PoseInputs*)ctx;
+	int i = in->next++ & (BENCH_INPUTS - 1);
+	glm::mat4 m = updateMatrix(in->ref1[i], in->ref2[i], in->mov1[i], in->mov2[i]);
+	sink += m[3][0];
+}
+
+struct Skeleton{
+	glm::vec3** Bones;
+	glm::mat4* bone_matrices;
+	FrameArena arena;
+	char path[512];    // fichier de pose : celui du depot, ou synthetique
+	bool synthetic;
+	FILE* fichier;
+};
+
+static bool writeSyntheticPose(const char* path){
+	FILE* out = fopen(path, "w");
+	if (out == NULL){
+		printf("impossible d'ecrire %s, cas ignore\n", path);
+		failure_ctr++;
+		return false;
+	}
+	for (int b = 0; b < 2 * nb_bones; b++)
+		fprintf(out, "%f %f %f\n", frand(), frand(), frand());
+	fclose(out);
+	return true;
+}
+
+/* Squelette synthetique de 'bones' os, de longueur et d'orientation aleatoires, pose
+bruitee. Son fichier de pose est pose_file dans data_dir, ou a defaut un fichier ecrit
+pour le cas et supprime par closeSkeleton (false s'il ne peut pas etre ecrit). */
+static bool openSkeleton(Skeleton* sk, int bones, const char* pose_file){
+	nb_bones = bones;
+	memset(sk, 0, sizeof(Skeleton));
+	sk->Bones = (glm::vec3 **)caseAlloc(nb_bones * sizeof(glm::vec3 *));
+	sk->Bones[0] = (glm::vec3 *)caseAlloc(4 * nb_bones * sizeof(glm::vec3));
+	for (int b = 0; b < nb_bones; b++)
+		sk->Bones[b] = sk->Bones[0] + 4 * b;
+	sk->bone_matrices = (glm::mat4 *)caseAlloc(nb_bones * sizeof(glm::mat4));
+	arenaInit(&sk->arena, FRAME_ARENA_SIZE);
+	for (int b = 0; b < nb_bones; b++){
+		sk->Bones[b][0] = glm::vec3(frand(), frand(), frand());
+		sk->Bones[b][1] = sk->Bones[b][0] + glm::vec3(frand(), frand(), frand()) * 0.3f;
+		sk->Bones[b][2] = sk->Bones[b][0] + glm::vec3(frand(), frand(), frand()) * 0.05f;
+		sk->Bones[b][3] = sk->Bones[b][1] + glm::vec3(frand(), frand(), frand()) * 0.05f;
+	}
+	sk->synthetic = pose_file == NULL;
+	if (!sk->synthetic){
+		dataPath(sk->path, pose_file);
+		return true;
+	}
+	sprintf(sk->path, "bench_pose_%i.txt", bones);
+	return writeSyntheticPose(sk->path);
+}
+
+/* libere aussi les autres tableaux du cas */
+static void closeSkeleton(Skeleton* sk){
+	if (sk->synthetic)
+		remove(sk->path);
+	arenaFree(&sk->arena);
+	caseFree();
+}
+
+/* scaleData remet le repos a l'echelle de la pose en place : des le premier appel le
+facteur vaut 1, les appels suivants sont donc representatifs du regime permanent */
+static void benchUpdateData(void* ctx){
+	Skeleton* sk = (Skeleton*)ctx;
+	updateData(sk->Bones, sk->bone_matrices);
+	sink += sk->bone_matrices[0][3][0];
+}
+
+static void benchReadPose(void* ctx){
+	Skeleton* sk = (Skeleton*)ctx;
+	arenaReset(&sk->arena);
+	readPose(sk->Bones, sk->path, &sk->arena, NULL);
+	sink += sk->Bones[0][2].x;
+}
+
+static void benchInitData(void* ctx){
+	Skeleton* sk = (Skeleton*)ctx;
+	rewind(sk->fichier);
+	initData(sk->Bones, sk->fichier);
+	sink += sk->Bones[0][0].x;
+}
+
+static void benchSkeleton(int bones, const char* pose_file, const char* rest_file){
+	Skeleton sk;
+	if (!openSkeleton(&sk, bones, pose_file)){
+		closeSkeleton(&sk);
+		return;
+	}
+	runCase(benchUpdateData, &sk, bones, "updateData/%i", bones);
+	runCase(benchReadPose, &sk, bones, "readPose/%i", bones);
+
+	char rest_path[512];
+	if (rest_file == NULL)
+		strcpy(rest_path, sk.path);
+	else
+		dataPath(rest_path, rest_file);
+	sk.fichier = fopen(rest_path, "r");
+	if (sk.fichier != NULL){
+		runCase(benchInitData, &sk, bones, "initData/%i", bones);
+		fclose(sk.fichier);
+	}
+	closeSkeleton(&sk);
+}
+
+/* --- collisions avec le corps --- */
+
+struct BodyCase{
+	BodyProxy body;
+	float* p[3];
+	float* out[4];
+	int n;
+};
+
+static void benchBodyQuery(void* ctx){
+	BodyCase* c = (BodyCase*)ctx;
+	bodyQuery(&c->body, c->p[0], c->p[1], c->p[2], c->n, c->out[0], c->out[1], c->out[2], c->out[3]);
+	sink += c->out[0][0];
+}
+
+/* Points sur une marche aleatoire dans la boite du corps : comme les sommets d'un
+maillage, deux points consecutifs sont voisins */
+static void benchBody(int bones, const char* pose_file, int points){
+	Skeleton sk;
+	if (!openSkeleton(&sk, bones, pose_file)){
+		closeSkeleton(&sk);
+		return;
+	}
+	if (pose_file != NULL)
+		readPose(sk.Bones, sk.path, &sk.arena, NULL);
+	BodyCase* c = (BodyCase*)caseAlloc(sizeof(BodyCase));
+	bodyBuild(&c->body, sk.Bones, bones);
+	c->n = points;
+	for (int k = 0; k < 3; k++)
+		c->p[k] = (float*)caseAlloc(points * sizeof(float));
+	for (int k = 0; k < 4; k++)
+		c->out[k] = (float*)caseAlloc(points * sizeof(float));
+	float walk[3] = { 0.5f, 0.5f, 0.5f };
+	for (int i = 0; i < points; i++){
+		for (int k = 0; k < 3; k++){
+			walk[k] += frand() * 0.02f;
+			walk[k] -= floorf(walk[k]);
+			c->p[k][i] = c->body.origin[k] + walk[k] * BODY_GRID / c->body.inv_cell[k];
+		}
+	}
+	runCase(benchBodyQuery, c, points, "bodyQuery/%ix%i", bones, points);
+	closeSkeleton(&sk);
+}
+
+/* --- codage des positions --- */
+
+struct CodecCase{
+	SkeletonCodec encoder;
+	SkeletonCodec decoder;
+	int point_ctr;
+	float* frames;          // BENCH_CODEC_FRAMES images de 3 * point_ctr flottants
+	float* decoded;
+	unsigned char* coded;   // images codees bout a bout
+	size_t* offsets;        // debut de chaque image dans coded, plus la fin
+	unsigned char* scratch; // une image codee
+	int next;
+};
+
+static void benchEncode(void* ctx){
+	CodecCase* c = (CodecCase*)ctx;
+	int f = c->next++ % BENCH_CODEC_FRAMES;
+	sink += (float)skeletonEncode(&c->encoder, c->frames + (size_t)f * 3 * c->point_ctr, NULL, c->scratch);
+}
+
+/* le flux reprend a l'image 0, une image cle */
+static void benchDecode(void* ctx){
+	CodecCase* c = (CodecCase*)ctx;
+	int f = c->next++ % BENCH_CODEC_FRAMES;
+	skeletonDecode(&c->decoder, c->coded + c->offsets[f], c->offsets[f + 1] - c->offsets[f], c->decoded, NULL);
+	sink += c->decoded[0];
+}
+
+/* Joints en mouvement lisse (jusqu'a 1 m/s) plus 1 mm de bruit du capteur, dans une
+piece de 4 m : taille par image comparee au texte du fichier Kinect, erreur maximale
+comparee a la borne de skeletonCodec.h, puis temps de codage et de decodage */
+static void benchCodec(int bones, float step){
+	CodecCase* c = (CodecCase*)caseAlloc(sizeof(CodecCase));
+	int n = 3 * 2 * bones;
+	c->point_ctr = 2 * bones;
+	c->frames = (float*)caseAlloc((size_t)BENCH_CODEC_FRAMES * n * sizeof(float));
+	c->decoded = (float*)caseAlloc(n * sizeof(float));
+	c->coded = (unsigned char*)caseAlloc(sizeof(SkeletonHeader) + BENCH_CODEC_FRAMES * SKELETON_FRAME_MAX(c->point_ctr));
+	c->offsets = (size_t*)caseAlloc((BENCH_CODEC_FRAMES + 1) * sizeof(size_t));
+	c->scratch = (unsigned char*)caseAlloc(SKELETON_FRAME_MAX(c->point_ctr));
+	skeletonCodecInit(&c->encoder, c->point_ctr, step, SKELETON_KEYFRAME, caseAlloc(skeletonCodecBytes(c->point_ctr)));
+	skeletonCodecInit(&c->decoder, c->point_ctr, step, SKELETON_KEYFRAME, caseAlloc(skeletonCodecBytes(c->point_ctr)));
+	for (int i = 0; i < n; i++){
+		float phase = frand() * 3.14159f;
+		float speed = 0.5f + 0.5f * frand();
+		for (int f = 0; f < BENCH_CODEC_FRAMES; f++)
+			c->frames[(size_t)f * n + i] = 2.0f * sinf(phase + speed * f / 30.0f) + frand() * 0.001f;
+	}
+
+	size_t text = 0;
+	char line[64];
+	for (int i = 0; i < n; i += 3)
+		text += sprintf(line, "%f %f %f\n", c->frames[i], c->frames[i + 1], c->frames[i + 2]);
+	size_t at = skeletonWriteHeader(&c->encoder, c->coded);
+	for (int f = 0; f < BENCH_CODEC_FRAMES; f++){
+		c->offsets[f] = at;
+		at += skeletonEncode(&c->encoder, c->frames + (size_t)f * n, NULL, c->coded + at);
+	}
+	c->offsets[BENCH_CODEC_FRAMES] = at;
+	double max_error = 0.0;
+	double max_bound = 0.0;
+	bool ok = true;
+	for (int f = 0; f < BENCH_CODEC_FRAMES && ok; f++){
+		const float* in = c->frames + (size_t)f * n;
+		ok = skeletonDecode(&c->decoder, c->coded + c->offsets[f], c->offsets[f + 1] - c->offsets[f], c->decoded, NULL)
+			== c->offsets[f + 1] - c->offsets[f];
+		for (int i = 0; i < n && ok; i++){
+			double error = fabs((double)c->decoded[i] - in[i]);
+			double bound = c->encoder.step * 0.5 + fabs(in[i]) * ldexp(1.0, -22);
+			max_error = error > max_error ? error : max_error;
+			max_bound = bound > max_bound ? bound : max_bound;
+			ok = error <= bound;
+		}
+	}
+	if (!ok)
+		failure_ctr++;
+	printf("skeletonCodec/%i au pas de %.2f mm : %.1f octets par image (texte %u), erreur max %.4f mm (borne %.4f) %s\n",
+		bones, step * 1000.0f, (double)(at - sizeof(SkeletonHeader)) / BENCH_CODEC_FRAMES, (unsigned int)text,
+		max_error * 1000.0, max_bound * 1000.0, ok ? "ok" : "DEPASSEE");
+
+	c->next = 0;
+	c->encoder.since_key = -1;
+	runCase(benchEncode, c, bones, "skeletonEncode/%i/%gmm", bones, step * 1000.0f);
+	c->next = 0;
+	runCase(benchDecode, c, bones, "skeletonDecode/%i/%gmm", bones, step * 1000.0f);
+	caseFree();
+}
+
+/* --- occultation --- */
+
+struct ProjectCase{
+	float eye[3];
+	bool visible;
+	int column;
+	int row;
+	float depth;
+};
+
+/* Carte Kinect v2 (512 x 424), capteur calibre a cote de la camera du vetement, image
+retournee (OCCLUSION_MIRROR) ; texels attendus calcules a la main :
+translation (0.1, -0.2, 0.5) : (0.3, 0.4, -2.5) -> capteur (0.4, 0.2, -2), d = 2,
+	u = 257 + 365.5 * 0.2 = 330.1 -> 512 - 330.1 = 181.9, v = 208 - 365.5 * 0.1 = 171.45
+quart de tour autour de y, 3 m : (0.5, 0, 0.25) -> capteur (0.25, 0, -3.5), d = 3.5,
+	u = 257 + 365.5 * 0.25 / 3.5 = 283.1 -> 228.9, v = 208 ; (-4, 0, 0) est derriere le capteur */
+static void checkOcclusion(){
+	static const char* calibrations[2] = {
+		"1 0 0 0.1\n0 1 0 -0.2\n0 0 1 0.5\n0 0 0 1\n365.5 365.5 257 208\n",
+		"0 0 1 0\n0 1 0 0\n-1 0 0 -3\n0 0 0 1\n365.5 365.5 257 208\n"
+	};
+	static const ProjectCase cases[2][2] = {
+		{ { { 0.3f, 0.4f, -2.5f }, true, 181, 171, 2.0f }, { { 0.0f, 0.0f, 1.0f }, false, 0, 0, 0.0f } },
+		{ { { 0.5f, 0.0f, 0.25f }, true, 228, 208, 3.5f }, { { -4.0f, 0.0f, 0.0f }, false, 0, 0, 0.0f } }
+	};
+	for (int k = 0; k < 2; k++){
+		FILE* out = fopen("bench_calib.txt", "w");
+		fputs(calibrations[k], out);
+		fclose(out);
+		bool ok = occlusionCalibrate("bench_calib.txt");
+		remove("bench_calib.txt");
+		for (int i = 0; i < 2 && ok; i++){
+			const ProjectCase* c = &cases[k][i];
+			int column = -1;
+			int row = -1;
+			float depth = 0.0f;
+			bool visible = occlusionProject(occlusionCalibration(), c->eye, 512, 424, &column, &row, &depth);
+			ok = visible == c->visible && (!visible || (column == c->column && row == c->row && fabsf(depth - c->depth) < 1e-4f));
+			if (visible)
+				printf("occlusionProject/%i/%i : texel %i %i a %.3f m %s\n", k, i, column, row, depth, ok ? "ok" : "FAUX");
+			else
+				printf("occlusionProject/%i/%i : hors carte %s\n", k, i, ok ? "ok" : "FAUX");
+		}
+		if (!ok)
+			failure_ctr++;
+	}
+}
+
+/* --- import des vetements --- */
+
+struct ImportCase{
+	char file[512];
+	char cooked[512];
+	bool cold;         // supprime le fichier cuit : import assimp + partitionnement
+	int point_ctr;
+};
+
+static void benchImport(void* ctx){
+	ImportCase* c = (ImportCase*)ctx;
+	if (c->cold)
+		remove(c->cooked);
+	ModelData data;
+	if (importModel(c->file, &data)){
+		c->point_ctr = data.point_ctr;
+		freeModelData(&data);
+	}
+}
+
+/* copie du fichier de test : le fichier cuit est ecrit a cote, hors du depot */
+static bool copyFile(const char* from, const char* to){
+	FILE* in = fopen(from, "rb");
+	if (in == NULL)
+		return false;
+	FILE* out = fopen(to, "wb");
+	if (out == NULL){
+		fclose(in);
+		return false;
+	}
+	char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		fwrite(buffer, 1, n, out);
+	fclose(in);
+	fclose(out);
+	return true;
+}
+
+struct WeightsCase{
+	const ModelData* data;
+	glm::vec3 segments[2 * 8];
+	int* bone_ids;
+	float* weights;
+};
+
+static void benchWeights(void* ctx){
+	WeightsCase* c = (WeightsCase*)ctx;
+	solveSkinWeights(c->data->points, c->data->point_ctr, c->data->indices, c->data->index_ctr,
+		c->segments, 8, c->bone_ids, c->weights);
+	sink += c->weights[0];
+}
+
+/* poids automatiques sur le squelette de repos du depot (8 os Kinect) */
+static void benchAutoWeights(const char* label, const ModelData* data){
+	WeightsCase c;
+	c.data = data;
+	char path[512];
+	dataPath(path, "init_exploit-new.txt");
+	FILE* in = fopen(path, "r");
+	int lus = 0;
+	if (in != NULL){
+		for (int i = 0; i < 2 * 8; i++)
+			lus += fscanf(in, "%f %f %f", &c.segments[i].x, &c.segments[i].y, &c.segments[i].z);
+		fclose(in);
+	}
+	if (lus != 6 * 8){
+		printf("%s illisible, cas ignore\n", path);
+		return;
+	}
+	c.bone_ids = (int*)caseAlloc(4 * data->point_ctr * sizeof(int));
+	c.weights = (float*)caseAlloc(4 * data->point_ctr * sizeof(float));
+	runCase(benchWeights, &c, data->point_ctr, "solveSkinWeights/%s", label);
+	caseFree();
+}
+
+struct SkinCase{
+	int point_ctr;
+	float* rest[3];
+	int* bones;        // bones globaux
+	float* weights;
+	float* out[3];
+	glm::mat4* matrices;
+	int nb_matrices;
+	const int* bucket_start; // NULL : noyau generique
+};
+
+static void benchSkin(void* ctx){
+	SkinCase* c = (SkinCase*)ctx;
+	skinPositions(c->rest, c->bones, c->weights, c->bucket_start, 0, c->point_ctr, c->matrices, c->nb_matrices, c->out);
+	sink += c->out[0][0];
+}
+
+/* skinning CPU de tous les sommets, noyau generique puis noyaux par nombre d'influences
+sur les sommets ranges par l'import ; l'acceleration est affichee par vetement */
+static void benchSkinning(const char* label, const ModelData* data){
+	if (data->bone_ids == NULL)
+		return;
+	SkinCase c;
+	int n = data->point_ctr;
+	c.point_ctr = n;
+	for (int k = 0; k < 3; k++){
+		c.rest[k] = (float*)caseAlloc(n * sizeof(float));
+		c.out[k] = (float*)caseAlloc(n * sizeof(float));
+	}
+	c.bones = (int*)caseAlloc(MAX_INFLUENCES * n * sizeof(int));
+	c.weights = (float*)caseAlloc(MAX_INFLUENCES * n * sizeof(float));
+	for (int p = 0; p < data->partition_ctr; p++){
+		const ModelPartition* part = &data->partitions[p];
+		for (int i = part->index_start; i < part->index_start + part->index_ctr; i++){
+			int v = data->indices[i];
+			for (int k = 0; k < MAX_INFLUENCES; k++)
+				c.bones[MAX_INFLUENCES * v + k] = data->palette_bones[part->bone_start + data->bone_ids[MAX_INFLUENCES * v + k]];
+		}
+	}
+	for (int v = 0; v < n; v++){
+		for (int k = 0; k < 3; k++)
+			c.rest[k][v] = data->points[3 * v + k];
+	}
+	memcpy(c.weights, data->weights, MAX_INFLUENCES * n * sizeof(float));
+	c.nb_matrices = data->bone_ctr;
+	c.matrices = (glm::mat4*)caseAlloc(c.nb_matrices * sizeof(glm::mat4));
+	for (int b = 0; b < c.nb_matrices; b++){
+		c.matrices[b] = glm::rotate(glm::mat4(1.0f), frand(), glm::normalize(glm::vec3(frand(), frand(), 1.0f)));
+		c.matrices[b][3] = glm::vec4(frand(), frand(), frand(), 1.0f) * 0.1f;
+		c.matrices[b][3].w = 1.0f;
+	}
+
+	/* l'import range les sommets par nombre d'influences, a partir de 1 */
+	int bucket_start[MAX_INFLUENCES + 2];
+	bucket_start[0] = bucket_start[1] = 0;
+	for (int k = 1; k <= MAX_INFLUENCES; k++)
+		bucket_start[k + 1] = bucket_start[k] + data->influence_ctr[k - 1];
+
+	c.bucket_start = NULL;
+	bool measured = runCase(benchSkin, &c, n, "skinPositions/%s/generic", label);
+	double generic_us = results[result_ctr - 1].median_us;
+	c.bucket_start = bucket_start;
+	if (measured && runCase(benchSkin, &c, n, "skinPositions/%s/bucketed", label))
+		printf("%s : %i %i %i %i sommets a 1, 2, 3, 4 influences, skinning x%.2f\n", label,
+			data->influence_ctr[0], data->influence_ctr[1], data->influence_ctr[2], data->influence_ctr[3],
+			generic_us / results[result_ctr - 1].median_us);
+	caseFree();
+}
+
+/* budget nul : CLOTH_MIN_SUBSTEPS sous-pas, bones a l'identite */
+static void benchCloth(void* ctx){
+	clothStep((Cloth*)ctx, NULL, 0, NULL, 0.04, 0.0);
+}
+
+static void benchModel(const char* label, const char* file){
+	ImportCase c;
+	memset(&c, 0, sizeof(c));
+	strcpy(c.file, file);
+	sprintf(c.cooked, "%.500s.cooked", file);
+
+	c.cold = true;
+	benchImport(&c);
+	if (c.point_ctr == 0){
+		printf("%s : import impossible, cas ignore\n", file);
+		return;
+	}
+	runCase(benchImport, &c, c.point_ctr, "importModel/%s/assimp", label);
+	c.cold = false;
+	runCase(benchImport, &c, c.point_ctr, "importModel/%s/cooked", label);
+
+	ModelData data;
+	if (importModel(c.file, &data)){
+		Cloth* cloth = clothCreate(&data);
+		benchAutoWeights(label, &data);
+		benchSkinning(label, &data);
+		freeModelData(&data);
+		if (cloth != NULL){
+			runCase(benchCloth, cloth, cloth->particle_ctr, "clothStep/%s", label);
+			clothDestroy(cloth);
+		}
+	}
+	remove(c.cooked);
+}
+
+/* Maillage COLLADA synthetique : grille de side x side sommets sur une chaine de
+'bones' os, chaque sommet pese sur les deux os les plus proches de sa rangee.
+Au-dela de PALETTE_SIZE os, l'import passe par le partitionnement. */
+static bool writeSyntheticMesh(const char* path, int side, int bones){
+	FILE* out = fopen(path, "w");
+	if (out == NULL){
+		printf("impossible d'ecrire %s, cas ignore\n", path);
+		failure_ctr++;
+		return false;
+	}
+	int point_ctr = side * side;
+	int tri_ctr = 2 * (side - 1) * (side - 1);
+	fprintf(out, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+		"<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n"
+		"<asset><unit name=\"meter\" meter=\"1\"/><up_axis>Z_UP</up_axis></asset>\n"
+		"<library_geometries><geometry id=\"grid\" name=\"grid\"><mesh>\n");
+	fprintf(out, "<source id=\"grid-pos\"><float_array id=\"grid-pos-array\" count=\"%i\">", 3 * point_ctr);
+	for (int r = 0; r < side; r++)
+		for (int c = 0; c < side; c++)
+			fprintf(out, "%f 0 %f ", (float)c / (side - 1) - 0.5f, (float)r / (side - 1));
+	fprintf(out, "</float_array>\n<technique_common><accessor source=\"#grid-pos-array\" count=\"%i\" stride=\"3\">"
+		"<param name=\"X\" type=\"float\"/><param name=\"Y\" type=\"float\"/><param name=\"Z\" type=\"float\"/>"
+		"</accessor></technique_common></source>\n", point_ctr);
+	fprintf(out, "<vertices id=\"grid-verts\"><input semantic=\"POSITION\" source=\"#grid-pos\"/></vertices>\n");
+	fprintf(out, "<triangles count=\"%i\"><input semantic=\"VERTEX\" source=\"#grid-verts\" offset=\"0\"/><p>", tri_ctr);
+	for (int r = 0; r + 1 < side; r++){
+		for (int c = 0; c + 1 < side; c++){
+			int v = r * side + c;
+			fprintf(out, "%i %i %i %i %i %i ", v, v + 1, v + side, v + 1, v + side + 1, v + side);
+		}
+	}
+	fprintf(out, "</p></triangles>\n</mesh></geometry></library_geometries>\n");
+
+	fprintf(out, "<library_controllers><controller id=\"skin\"><skin source=\"#grid\">\n"
+		"<bind_shape_matrix>1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1</bind_shape_matrix>\n");
+	fprintf(out, "<source id=\"skin-joints\"><Name_array id=\"skin-joints-array\" count=\"%i\">", bones);
+	for (int b = 0; b < bones; b++)
+		fprintf(out, "bone%i ", b);
+	fprintf(out, "</Name_array><technique_common><accessor source=\"#skin-joints-array\" count=\"%i\" stride=\"1\">"
+		"<param name=\"JOINT\" type=\"name\"/></accessor></technique_common></source>\n", bones);
+	fprintf(out, "<source id=\"skin-bind\"><float_array id=\"skin-bind-array\" count=\"%i\">", 16 * bones);
+	for (int b = 0; b < bones; b++)
+		fprintf(out, "1 0 0 0 0 1 0 0 0 0 1 %f 0 0 0 1 ", -(float)b / bones);
+	fprintf(out, "</float_array><technique_common><accessor source=\"#skin-bind-array\" count=\"%i\" stride=\"16\">"
+		"<param name=\"TRANSFORM\" type=\"float4x4\"/></accessor></technique_common></source>\n", bones);
+	fprintf(out, "<source id=\"skin-weights\"><float_array id=\"skin-weights-array\" count=\"2\">0.75 0.25</float_array>"
+		"<technique_common><accessor source=\"#skin-weights-array\" count=\"2\" stride=\"1\">"
+		"<param name=\"WEIGHT\" type=\"float\"/></accessor></technique_common></source>\n");
+	fprintf(out, "<joints><input semantic=\"JOINT\" source=\"#skin-joints\"/>"
+		"<input semantic=\"INV_BIND_MATRIX\" source=\"#skin-bind\"/></joints>\n");
+	fprintf(out, "<vertex_weights count=\"%i\"><input semantic=\"JOINT\" source=\"#skin-joints\" offset=\"0\"/>"
+		"<input semantic=\"WEIGHT\" source=\"#skin-weights\" offset=\"1\"/><vcount>", point_ctr);
+	for (int v = 0; v < point_ctr; v++)
+		fprintf(out, "2 ");
+	fprintf(out, "</vcount><v>");
+	for (int v = 0; v < point_ctr; v++){
+		int b = (v / side) * bones / side;
+		int next = b + 1 < bones ? b + 1 : b - 1;
+		fprintf(out, "%i 0 %i 1 ", b, next);
+	}
+	fprintf(out, "</v></vertex_weights>\n</skin></controller></library_controllers>\n");
+
+	fprintf(out, "<library_visual_scenes><visual_scene id=\"scene\" name=\"scene\">\n");
+	for (int b = 0; b < bones; b++)
+		fprintf(out, "<node id=\"bone%i\" sid=\"bone%i\" name=\"bone%i\" type=\"JOINT\">"
+			"<matrix>1 0 0 0 0 1 0 0 0 0 1 %f 0 0 0 1</matrix>\n", b, b, b, b == 0 ? 0.0f : 1.0f / bones);
+	for (int b = 0; b < bones; b++)
+		fprintf(out, "</node>");
+	fprintf(out, "\n<node id=\"garment\" name=\"garment\"><instance_controller url=\"#skin\">"
+		"<skeleton>#bone0</skeleton></instance_controller></node>\n"
+		"</visual_scene></library_visual_scenes>\n"
+		"<scene><instance_visual_scene url=\"#scene\"/></scene>\n</COLLADA>\n");
+	fclose(out);
+	return true;
+}
+
+/* --- encodage PNG (captures d'ecran) --- */
+
+struct PngCase{
+	unsigned char* pixels;
+	int width;
+	int height;
+};
+
+static void benchPng(void* ctx){
+	PngCase* c = (PngCase*)ctx;
+	int len = 0;
+	unsigned char* png = stbi_write_png_to_mem(c->pixels, 4 * c->width, c->width, c->height, 4, &len);
+	sink += (float)len;
+	free(png);
+}
+
+/* degrade et bruit : ni trivialement compressible ni incompressible, comme un rendu */
+static void benchScreenshot(int width, int height){
+	PngCase c;
+	c.width = width;
+	c.height = height;
+	c.pixels = (unsigned char *)caseAlloc(4 * width * height);
+	for (int y = 0; y < height; y++){
+		for (int x = 0; x < width; x++){
+			unsigned char* p = c.pixels + 4 * (y * width + x);
+			p[0] = (unsigned char)(255 * x / width);
+			p[1] = (unsigned char)(255 * y / height);
+			p[2] = (unsigned char)(128 + (rand() & 15));
+			p[3] = 255;
+		}
+	}
+	runCase(benchPng, &c, 4.0 * width * height, "png/%ix%i", width, height);
+	caseFree();
+}
+
+int main(int argc, char** argv){
+	const char* output = argc > 1 ? argv[1] : "bench.json";
+	if (argc > 2)
+		data_dir = argv[2];
+	srand(1234);
+	clothStart(CLOTH_THREADS);
+
+	PoseInputs* in = (PoseInputs*)caseAlloc(sizeof(PoseInputs));
+	for (int i = 0; i < BENCH_INPUTS; i++){
+		in->ref1[i] = glm::vec3(frand(), frand(), frand());
+		in->ref2[i] = in->ref1[i] + glm::vec3(frand(), frand(), frand());
+		in->mov1[i] = in->ref1[i] + glm::vec3(frand(), frand(), frand()) * 0.1f;
+		in->mov2[i] = in->ref2[i] + glm::vec3(frand(), frand(), frand()) * 0.1f;
+	}
+	in->next = 0;
+	runBench("getRot", benchGetRot, in, 1);
+	runBench("updateMatrix", benchUpdateMatrix, in, 1);
+	caseFree();
+
+	/* squelette de la Kinect avec les fichiers du depot, puis squelettes synthetiques */
+	benchSkeleton(8, "bones-ordonnesTestJeu.txt", "init_exploit-new.txt");
+	benchSkeleton(64, NULL, NULL);
+	benchSkeleton(1024, NULL, NULL);
+	benchBody(8, "bones-ordonnesTestJeu.txt", 4096);
+	benchBody(64, NULL, 4096);
+	benchBody(64, NULL, 65536);
+	nb_bones = 8;
+
+	/* Kinect, 1 mm de pas, puis six personnes de 24 os */
+	benchCodec(8, SKELETON_PRECISION);
+	benchCodec(8, 0.001f);
+	benchCodec(144, SKELETON_PRECISION);
+	checkOcclusion();
+
+	char fixture[512];
+	const char* models[] = { "monkey_with_bones_y_up.dae", "Sweat8PaintedNormalizedTest5.dae" };
+	const char* labels[] = { "monkey", "sweat8" };
+	for (int m = 0; m < 2; m++){
+		char copy[512];
+		dataPath(fixture, models[m]);
+		sprintf(copy, "bench_%s.dae", labels[m]);
+		if (copyFile(fixture, copy)){
+			benchModel(labels[m], copy);
+			remove(copy);
+		}
+		else
+			printf("%s introuvable, cas ignore\n", fixture);
+	}
+	if (writeSyntheticMesh("bench_grid.dae", 128, 16))
+		benchModel("grid128x16", "bench_grid.dae");
+	if (writeSyntheticMesh("bench_grid.dae", 256, 96))
+		benchModel("grid256x96", "bench_grid.dae");
+	remove("bench_grid.dae");
+
+	benchScreenshot(640, 480);
+	benchScreenshot(1024, 768);
+	clothStop();
+
+	if (!writeResults(output)){
+		printf("impossible d'ecrire %s\n", output);
+		return 1;
+	}
+	printf("%i resultats ecrits dans %s\n", result_ctr, output);
+	if (failure_ctr > 0){
+		printf("%i verifications en echec\n", failure_ctr);
+		return 1;
+	}
+	return 0;
+}
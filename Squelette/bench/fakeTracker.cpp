@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "../matrixCalc.h"
+#include "../skeletonCodec.h"
+
+/* Traqueur de test : remplace le programme Kinect en ecrivant le meme fichier de
+positions, a la meme cadence, avec une pose fixe qui saute brusquement tous les
+'step' ms (translation de STEP_OFFSET en x). Chaque image est suivie de l'etiquette
+lue par readPose : "t <date> <echelon> <date de l'echelon>", dates prises avec
+l'horloge de profNow (QueryPerformanceCounter / CLOCK_MONOTONIC, communes aux processus).
+Avec --precision, chaque fichier est une image cle codee (skeletonCodec.h) au pas donne.
+	fakeTracker [--pose fichier] [--out fichier] [--period ms] [--step ms] [--frames N] [--precision mm]
+A lancer avant Squelette --latency N. */
+
+#define POSE_POINTS 16      // 2 positions par os, 8 os
+#define STEP_OFFSET 0.25f
+
+/* meme horloge que profNow */
+static double now(){
+#ifdef _WIN32
+	static LARGE_INTEGER freq = { 0 };
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#endif
+}
+
+static void sleepUntil(double t){
+	for (;;){
+		double left = t - now();
+		if (left <= 0.0)
+			return;
+#ifdef _WIN32
+		Sleep(left > 0.002 ? (DWORD)((left - 0.001) * 1000.0) : 0);
+#else
+		usleep(left > 0.002 ? (useconds_t)((left - 0.001) * 1e6) : 0);
+#endif
+	}
+}
+
+/* Le lecteur ne doit jamais voir un fichier a moitie ecrit : on ecrit a cote puis
+on remplace. Sous Windows le remplacement echoue tant que le rendu lit le fichier. */
+static bool publish(const char* tmp, const char* path){
+#ifdef _WIN32
+	for (int retry = 0; retry < 20; retry++){
+		if (MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING))
+			return true;
+		Sleep(0);
+	}
+	return false;
+#else
+	return rename(tmp, path) == 0;
+#endif
+}
+
+int main(int argc, char** argv){
+	const char* pose_file = "../bones-ordonnesTestJeu.txt";
+	const char* out_file = KINECT_FILE;
+	double period = 0.033;
+	double step = 0.5;
+	int frames = 0; // 0 : sans fin
+	float precision = 0.0f; // 0 : texte
+	for (int a = 1; a + 1 < argc; a += 2){
+		if (strcmp(argv[a], "--pose") == 0)
+			pose_file = argv[a + 1];
+		else if (strcmp(argv[a], "--out") == 0)
+			out_file = argv[a + 1];
+		else if (strcmp(argv[a], "--period") == 0)
+			period = atof(argv[a + 1]) / 1000.0;
+		else if (strcmp(argv[a], "--step") == 0)
+			step = atof(argv[a + 1]) / 1000.0;
+		else if (strcmp(argv[a], "--frames") == 0)
+			frames = atoi(argv[a + 1]);
+		else if (strcmp(argv[a], "--precision") == 0)
+			precision = (float)atof(argv[a + 1]) / 1000.0f;
+	}
+
+	float pose[POSE_POINTS][3];
+	FILE* in = fopen(pose_file, "r");
+	if (in == NULL){
+		printf("pose %s introuvable\n", pose_file);
+		return 1;
+	}
+	for (int i = 0; i < POSE_POINTS; i++){
+		if (fscanf(in, "%f %f %f", &pose[i][0], &pose[i][1], &pose[i][2]) != 3){
+			printf("pose %s incomplete\n", pose_file);
+			fclose(in);
+			return 1;
+		}
+	}
+	fclose(in);
+
+	/* une image cle par fichier : le lecteur n'en voit pas toutes les images */
+	SkeletonCodec codec;
+	int codec_memory[3 * POSE_POINTS];
+	unsigned char coded[sizeof(SkeletonHeader) + SKELETON_FRAME_MAX(POSE_POINTS)];
+	skeletonCodecInit(&codec, POSE_POINTS, precision, 1, codec_memory);
+	float points[POSE_POINTS][3];
+
+	char tmp[512];
+	sprintf(tmp, "%.500s.tmp", out_file);
+	printf("traqueur de test -> %s : une image toutes les %.1f ms, un echelon toutes les %.0f ms\n",
+		out_file, period * 1000.0, step * 1000.0);
+
+	double start = now();
+	double next = start;
+	int step_i = -1;
+	double step_time = 0.0;
+	int failed = 0;
+	for (int f = 0; frames == 0 || f < frames; f++){
+		sleepUntil(next);
+		double t = now();
+		int s = (int)((t - start) / step);
+		if (s != step_i){
+			step_i = s;
+			step_time = t;
+		}
+		float dx = (step_i & 1) ? STEP_OFFSET : 0.0f;
+
+		FILE* out = fopen(tmp, precision > 0.0f ? "wb" : "w");
+		if (out == NULL){
+			printf("impossible d'ecrire %s\n", tmp);
+			return 1;
+		}
+		if (precision > 0.0f){
+			PoseTag tag = { t, step_i, step_time };
+			for (int i = 0; i < POSE_POINTS; i++){
+				points[i][0] = pose[i][0] + dx;
+				points[i][1] = pose[i][1];
+				points[i][2] = pose[i][2];
+			}
+			size_t size = skeletonWriteHeader(&codec, coded);
+			size += skeletonEncode(&codec, &points[0][0], &tag, coded + size);
+			fwrite(coded, 1, size, out);
+		}
+		else{
+			for (int i = 0; i < POSE_POINTS; i++)
+				fprintf(out, "%f %f %f\n", pose[i][0] + dx, pose[i][1], pose[i][2]);
+			fprintf(out, "t %.6f %i %.6f\n", t, step_i, step_time);
+		}
+		fclose(out);
+		if (!publish(tmp, out_file))
+			failed++;
+		next += period;
+	}
+	if (failed > 0)
+		printf("%i images non publiees (fichier occupe)\n", failed);
+	return 0;
+}
@@ -0,0 +1,160 @@
+#include "bodyCollision.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define BODY_SSE
+#include <emmintrin.h>
+#endif
+
+void bodyBuild(BodyProxy* body, glm::vec3** Bones, int nb_bones){
+	int n = std::min(nb_bones, BODY_MAX_CAPSULES);
+	float lo[3] = { 1e30f, 1e30f, 1e30f };
+	float hi[3] = { -1e30f, -1e30f, -1e30f };
+	for (int k = 0; k < n; k++){
+		glm::vec3 a = Bones[k][2];
+		glm::vec3 ab = Bones[k][3] - Bones[k][2];
+		float len2 = ab.x * ab.x + ab.y * ab.y + ab.z * ab.z;
+		float r = std::max(BODY_MIN_RADIUS, std::min(BODY_MAX_RADIUS, BODY_RADIUS_RATIO * sqrtf(len2)));
+		for (int ax = 0; ax < 3; ax++){
+			body->a[ax][k] = a[ax];
+			body->ab[ax][k] = ab[ax];
+			float reach = r + BODY_REACH;
+			lo[ax] = std::min(lo[ax], std::min(a[ax], a[ax] + ab[ax]) - reach);
+			hi[ax] = std::max(hi[ax], std::max(a[ax], a[ax] + ab[ax]) + reach);
+		}
+		body->inv_len2[k] = len2 > 0.0f ? 1.0f / len2 : 0.0f; // os nul : sphere
+		body->radius[k] = r;
+	}
+	body->capsule_ctr = n;
+	memset(body->cells, 0, sizeof(body->cells));
+	if (n == 0)
+		return;
+	for (int ax = 0; ax < 3; ax++){
+		body->origin[ax] = lo[ax];
+		body->inv_cell[ax] = BODY_GRID / std::max(hi[ax] - lo[ax], 1e-6f);
+	}
+
+	/* chaque capsule marque les cellules de sa boite elargie de BODY_REACH */
+	for (int k = 0; k < n; k++){
+		int c0[3], c1[3];
+		for (int ax = 0; ax < 3; ax++){
+			float a = body->a[ax][k];
+			float b = a + body->ab[ax][k];
+			float reach = body->radius[k] + BODY_REACH;
+			c0[ax] = std::max(0, (int)((std::min(a, b) - reach - body->origin[ax]) * body->inv_cell[ax]));
+			c1[ax] = std::min(BODY_GRID - 1, (int)((std::max(a, b) + reach - body->origin[ax]) * body->inv_cell[ax]));
+		}
+		for (int i = c0[0]; i <= c1[0]; i++)
+			for (int j = c0[1]; j <= c1[1]; j++)
+				for (int l = c0[2]; l <= c1[2]; l++)
+					body->cells[(i * BODY_GRID + j) * BODY_GRID + l] |= 1ULL << k;
+	}
+}
+
+/* masque de la cellule du point, 0 hors de la grille */
+static unsigned long long cellMask(const BodyProxy* body, float x, float y, float z){
+	float p[3] = { x, y, z };
+	int c[3];
+	for (int ax = 0; ax < 3; ax++){
+		float f = (p[ax] - body->origin[ax]) * body->inv_cell[ax];
+		if (!(f >= 0.0f && f < (float)BODY_GRID))
+			return 0;
+		c[ax] = (int)f;
+	}
+	return body->cells[(c[0] * BODY_GRID + c[1]) * BODY_GRID + c[2]];
+}
+
+void bodyQuery(const BodyProxy* body, const float* x, const float* y, const float* z, int n,
+	float* dist, float* nx, float* ny, float* nz){
+	for (int i = 0; i < n; i += 4){
+		/* paquet de 4, le dernier complete en repetant son dernier point */
+		int lanes = std::min(4, n - i);
+		float px[4], py[4], pz[4];
+		unsigned long long mask = 0;
+		for (int l = 0; l < 4; l++){
+			int src = i + std::min(l, lanes - 1);
+			px[l] = x[src];
+			py[l] = y[src];
+			pz[l] = z[src];
+			mask |= cellMask(body, px[l], py[l], pz[l]);
+		}
+		float best[4], dx[4], dy[4], dz[4], len[4];
+#ifdef BODY_SSE
+		__m128 X = _mm_loadu_ps(px), Y = _mm_loadu_ps(py), Z = _mm_loadu_ps(pz);
+		__m128 vbest = _mm_set1_ps(BODY_FAR);
+		__m128 vdx = _mm_setzero_ps(), vdy = _mm_setzero_ps(), vdz = _mm_set1_ps(1.0f);
+		__m128 vlen = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		for (int k = 0; mask != 0; k++, mask >>= 1){
+			if (!(mask & 1))
+				continue;
+			__m128 apx = _mm_sub_ps(X, _mm_set1_ps(body->a[0][k]));
+			__m128 apy = _mm_sub_ps(Y, _mm_set1_ps(body->a[1][k]));
+			__m128 apz = _mm_sub_ps(Z, _mm_set1_ps(body->a[2][k]));
+			__m128 abx = _mm_set1_ps(body->ab[0][k]);
+			__m128 aby = _mm_set1_ps(body->ab[1][k]);
+			__m128 abz = _mm_set1_ps(body->ab[2][k]);
+			__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(apx, abx), _mm_mul_ps(apy, aby)), _mm_mul_ps(apz, abz)),
+				_mm_set1_ps(body->inv_len2[k]));
+			t = _mm_min_ps(one, _mm_max_ps(zero, t));
+			__m128 ex = _mm_sub_ps(apx, _mm_mul_ps(t, abx));
+			__m128 ey = _mm_sub_ps(apy, _mm_mul_ps(t, aby));
+			__m128 ez = _mm_sub_ps(apz, _mm_mul_ps(t, abz));
+			__m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez)));
+			__m128 d = _mm_sub_ps(l, _mm_set1_ps(body->radius[k]));
+			__m128 closer = _mm_cmplt_ps(d, vbest);
+			vbest = _mm_or_ps(_mm_and_ps(closer, d), _mm_andnot_ps(closer, vbest));
+			vdx = _mm_or_ps(_mm_and_ps(closer, ex), _mm_andnot_ps(closer, vdx));
+			vdy = _mm_or_ps(_mm_and_ps(closer, ey), _mm_andnot_ps(closer, vdy));
+			vdz = _mm_or_ps(_mm_and_ps(closer, ez), _mm_andnot_ps(closer, vdz));
+			vlen = _mm_or_ps(_mm_and_ps(closer, l), _mm_andnot_ps(closer, vlen));
+		}
+		_mm_storeu_ps(best, vbest);
+		_mm_storeu_ps(dx, vdx);
+		_mm_storeu_ps(dy, vdy);
+		_mm_storeu_ps(dz, vdz);
+		_mm_storeu_ps(len, vlen);
+#else
+		for (int l = 0; l < 4; l++){
+			best[l] = BODY_FAR;
+			dx[l] = dy[l] = 0.0f;
+			dz[l] = len[l] = 1.0f;
+		}
+		for (int k = 0; mask != 0; k++, mask >>= 1){
+			if (!(mask & 1))
+				continue;
+			for (int l = 0; l < 4; l++){
+				float apx = px[l] - body->a[0][k], apy = py[l] - body->a[1][k], apz = pz[l] - body->a[2][k];
+				float t = (apx * body->ab[0][k] + apy * body->ab[1][k] + apz * body->ab[2][k]) * body->inv_len2[k];
+				t = std::min(1.0f, std::max(0.0f, t));
+				float ex = apx - t * body->ab[0][k], ey = apy - t * body->ab[1][k], ez = apz - t * body->ab[2][k];
+				float e = sqrtf(ex * ex + ey * ey + ez * ez);
+				float d = e - body->radius[k];
+				if (d < best[l]){
+					best[l] = d;
+					dx[l] = ex;
+					dy[l] = ey;
+					dz[l] = ez;
+					len[l] = e;
+				}
+			}
+		}
+#endif
+		for (int l = 0; l < lanes; l++){
+			dist[i + l] = best[l];
+			if (len[l] > 1e-6f){
+				nx[i + l] = dx[l] / len[l];
+				ny[i + l] = dy[l] / len[l];
+				nz[i + l] = dz[l] / len[l];
+			}
+			else{
+				/* sur l'axe de la capsule : direction arbitraire */
+				nx[i + l] = 0.0f;
+				ny[i + l] = 0.0f;
+				nz[i + l] = 1.0f;
+			}
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef BODYCOLLISION_H
+#define BODYCOLLISION_H
+
+#ifndef GLM_H
+#define GLM_H
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#endif
+
+/* Corps approche par des capsules, une par os : le segment Kinect Bones[i][2]-Bones[i][3]
+et un rayon tire de sa longueur. Reconstruit a chaque image par le thread de calcul.
+Une grille uniforme sur la boite du corps donne pour chaque cellule le masque des
+capsules a moins de BODY_REACH de leur surface ; les requetes sont faites 4 points a la
+fois en SSE contre l'union des masques de leurs 4 cellules (des sommets consecutifs du
+maillage tombent dans des cellules voisines). */
+
+#define BODY_MAX_CAPSULES 64     // un bit par capsule dans les masques ; os suivants ignores
+#define BODY_GRID 8              // cellules par axe
+#define BODY_RADIUS_RATIO 0.25f  // rayon d'une capsule, en fraction de la longueur de l'os
+#define BODY_MIN_RADIUS 0.03f
+#define BODY_MAX_RADIUS 0.12f
+#define BODY_REACH 0.05f         // portee des masques : distances exactes en dessous
+#define BODY_FAR 1e30f           // distance rendue loin de toute capsule
+
+struct BodyProxy{
+	int capsule_ctr;
+	float a[3][BODY_MAX_CAPSULES];    // premiere extremite, en SoA
+	float ab[3][BODY_MAX_CAPSULES];   // de la premiere a la seconde extremite
+	float inv_len2[BODY_MAX_CAPSULES];
+	float radius[BODY_MAX_CAPSULES];
+	float origin[3];
+	float inv_cell[3];
+	unsigned long long cells[BODY_GRID * BODY_GRID * BODY_GRID];
+};
+
+void bodyBuild(BodyProxy* body, glm::vec3** Bones, int nb_bones);
+
+/* Distance signee de n points a la surface du corps (negative a l'interieur) et normale
+sortante. Exacte en dessous de BODY_REACH ; au-dela, BODY_FAR ou une distance plus grande
+que BODY_REACH. */
+void bodyQuery(const BodyProxy* body, const float* x, const float* y, const float* z, int n,
+	float* dist, float* nx, float* ny, float* nz);
+
+#endif
@@ -0,0 +1,677 @@
+#include "cloth.h"
+#include "profiler.h"
+#include "skinKernels.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define CLOTH_SSE
+#include <emmintrin.h>
+#endif
+
+/* arete d'un triangle, particules dans l'ordre croissant, avec le sommet oppose */
+struct ClothEdge{
+	int a;
+	int b;
+	int opp;
+};
+
+static bool edgeLess(const ClothEdge& e, const ClothEdge& f){
+	return e.a < f.a || (e.a == f.a && e.b < f.b);
+}
+
+static void addEdge(ClothEdge* edges, int* ctr, int a, int b, int opp){
+	ClothEdge* e = &edges[(*ctr)++];
+	e->a = a < b ? a : b;
+	e->b = a < b ? b : a;
+	e->opp = opp;
+}
+
+static char* carve(char** cursor, size_t bytes){
+	char* p = *cursor;
+	*cursor += (bytes + 15) & ~(size_t)15;
+	return p;
+}
+
+/* Distance geodesique de chaque particule au bord libre le plus proche, le long des
+aretes (Dijkstra a sources multiples), arretee a CLOTH_HEM_WIDTH : FLT_MAX au-dela */
+static void borderDistance(const ClothEdge* edges, int edge_ctr, const bool* border,
+	const float* points, const int* first_vertex, int particle_ctr, float* dist){
+	int* start = (int*)calloc(particle_ctr + 1, sizeof(int));
+	int* adj = (int*)malloc(2 * edge_ctr * sizeof(int));
+	for (int e = 0; e < edge_ctr; e++){
+		start[edges[e].a + 1]++;
+		start[edges[e].b + 1]++;
+	}
+	for (int p = 0; p < particle_ctr; p++)
+		start[p + 1] += start[p];
+	int* fill = (int*)malloc(particle_ctr * sizeof(int));
+	memcpy(fill, start, particle_ctr * sizeof(int));
+	for (int e = 0; e < edge_ctr; e++){
+		adj[fill[edges[e].a]++] = edges[e].b;
+		adj[fill[edges[e].b]++] = edges[e].a;
+	}
+	free(fill);
+
+	typedef std::pair<float, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+	for (int p = 0; p < particle_ctr; p++){
+		dist[p] = border[p] ? 0.0f : FLT_MAX;
+		if (border[p])
+			queue.push(Entry(0.0f, p));
+	}
+	while (!queue.empty()){
+		Entry top = queue.top();
+		queue.pop();
+		int p = top.second;
+		if (top.first > dist[p] || top.first > CLOTH_HEM_WIDTH)
+			continue;
+		const float* pp = &points[3 * first_vertex[p]];
+		for (int k = start[p]; k < start[p + 1]; k++){
+			int q = adj[k];
+			const float* pq = &points[3 * first_vertex[q]];
+			float dx = pq[0] - pp[0], dy = pq[1] - pp[1], dz = pq[2] - pp[2];
+			float d = top.first + sqrtf(dx * dx + dy * dy + dz * dz);
+			if (d < dist[q]){
+				dist[q] = d;
+				queue.push(Entry(d, q));
+			}
+		}
+	}
+	free(start);
+	free(adj);
+}
+
+Cloth* clothCreate(const ModelData* data){
+	if (data->bone_ids == NULL || data->weights == NULL || data->index_ctr < 3)
+		return NULL;
+	double begin = profNow();
+	int vertex_ctr = data->point_ctr;
+	const float* points = data->points;
+
+	/* soudure : les sommets dupliques (coutures d'UV, partitions) deviennent une seule particule */
+	int* order = (int*)malloc(vertex_ctr * sizeof(int));
+	for (int v = 0; v < vertex_ctr; v++)
+		order[v] = v;
+	std::sort(order, order + vertex_ctr, [points](int i, int j){
+		const float* a = &points[3 * i];
+		const float* b = &points[3 * j];
+		if (a[0] != b[0]) return a[0] < b[0];
+		if (a[1] != b[1]) return a[1] < b[1];
+		return a[2] < b[2];
+	});
+	int* vertex_particle = (int*)malloc(vertex_ctr * sizeof(int));
+	int* first_vertex = (int*)malloc(vertex_ctr * sizeof(int));
+	int particle_ctr = 0;
+	for (int k = 0; k < vertex_ctr; k++){
+		int v = order[k];
+		if (k == 0 || memcmp(&points[3 * v], &points[3 * order[k - 1]], 3 * sizeof(float)) != 0)
+			first_vertex[particle_ctr++] = v;
+		vertex_particle[v] = particle_ctr - 1;
+	}
+	free(order);
+
+	/* partition de chaque sommet, pour retrouver les bones globaux */
+	int* vertex_part = (int*)malloc(vertex_ctr * sizeof(int));
+	for (int v = 0; v < vertex_ctr; v++)
+		vertex_part[v] = -1;
+	for (int p = 0; p < data->partition_ctr; p++){
+		const ModelPartition* part = &data->partitions[p];
+		for (int i = part->index_start; i < part->index_start + part->index_ctr; i++)
+			vertex_part[data->indices[i]] = p;
+	}
+
+	/* particules renumerotees par nombre d'influences, pour les noyaux de skinning specialises */
+	int skin_start[MAX_INFLUENCES + 2] = { 0 };
+	int* particle_count = (int*)malloc(particle_ctr * sizeof(int));
+	for (int p = 0; p < particle_ctr; p++){
+		int v = first_vertex[p];
+		const ModelPartition* part = vertex_part[v] >= 0 ? &data->partitions[vertex_part[v]] : NULL;
+		int n = 0;
+		for (int k = 0; k < MAX_INFLUENCES; k++){
+			int local = data->bone_ids[MAX_INFLUENCES * v + k];
+			if (part != NULL && local >= 0 && local < part->bone_ctr && data->weights[MAX_INFLUENCES * v + k] > 0.0f)
+				n++;
+		}
+		particle_count[p] = n;
+		skin_start[n + 1]++;
+	}
+	for (int k = 0; k <= MAX_INFLUENCES; k++)
+		skin_start[k + 1] += skin_start[k];
+	int next[MAX_INFLUENCES + 1];
+	memcpy(next, skin_start, sizeof(next));
+	int* renumber = (int*)malloc(particle_ctr * sizeof(int));
+	int* sorted_first = (int*)malloc(particle_ctr * sizeof(int));
+	for (int p = 0; p < particle_ctr; p++){
+		renumber[p] = next[particle_count[p]]++;
+		sorted_first[renumber[p]] = first_vertex[p];
+	}
+	for (int v = 0; v < vertex_ctr; v++)
+		vertex_particle[v] = renumber[vertex_particle[v]];
+	free(first_vertex);
+	first_vertex = sorted_first;
+	free(renumber);
+	free(particle_count);
+
+	/* aretes des triangles ; une arete vue une seule fois est sur un bord libre */
+	int tri_ctr = data->index_ctr / 3;
+	ClothEdge* edges = (ClothEdge*)malloc(3 * tri_ctr * sizeof(ClothEdge));
+	int half_ctr = 0;
+	for (int t = 0; t < tri_ctr; t++){
+		int a = vertex_particle[data->indices[3 * t]];
+		int b = vertex_particle[data->indices[3 * t + 1]];
+		int c = vertex_particle[data->indices[3 * t + 2]];
+		if (a == b || b == c || c == a)
+			continue;
+		addEdge(edges, &half_ctr, a, b, c);
+		addEdge(edges, &half_ctr, b, c, a);
+		addEdge(edges, &half_ctr, c, a, b);
+	}
+	std::sort(edges, edges + half_ctr, edgeLess);
+
+	bool* border = (bool*)calloc(particle_ctr, sizeof(bool));
+	int* bend = (int*)malloc(half_ctr * sizeof(int)); // paires de sommets opposes
+	int bend_ctr = 0;
+	int edge_ctr = 0;
+	bool has_border = false;
+	for (int e = 0; e < half_ctr;){
+		int run = 1;
+		while (e + run < half_ctr && !edgeLess(edges[e], edges[e + run]))
+			run++;
+		if (run == 1){
+			border[edges[e].a] = border[edges[e].b] = true;
+			has_border = true;
+		}
+		else if (edges[e].opp != edges[e + 1].opp){
+			bend[2 * bend_ctr] = edges[e].opp;
+			bend[2 * bend_ctr + 1] = edges[e + 1].opp;
+			bend_ctr++;
+		}
+		edges[edge_ctr++] = edges[e];
+		e += run;
+	}
+	if (!has_border){
+		free(vertex_particle);
+		free(first_vertex);
+		free(edges);
+		free(border);
+		free(bend);
+		return NULL;
+	}
+	float* dist = (float*)malloc(particle_ctr * sizeof(float));
+	borderDistance(edges, edge_ctr, border, points, first_vertex, particle_ctr, dist);
+	free(border);
+
+	/* bloc unique : particules, contraintes (au plus une par arete et par paire opposee), sommets */
+	int max_constraints = edge_ctr + bend_ctr;
+	size_t total = 25 * (((size_t)particle_ctr * sizeof(float) + 15) & ~(size_t)15)
+		+ 2 * (((size_t)4 * particle_ctr * sizeof(float) + 15) & ~(size_t)15)
+		+ 4 * (((size_t)max_constraints * sizeof(float) + 15) & ~(size_t)15)
+		+ (((size_t)vertex_ctr * sizeof(int) + 15) & ~(size_t)15)
+		+ 2 * (((size_t)3 * vertex_ctr * sizeof(float) + 15) & ~(size_t)15);
+	Cloth* c = (Cloth*)calloc(1, sizeof(Cloth));
+	c->block = calloc(1, total);
+	char* cursor = (char*)c->block;
+	for (int k = 0; k < 3; k++){
+		c->x[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+		c->prev[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+		c->v[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+		c->target[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+		c->last[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+		c->bind[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+	}
+	c->inv_mass = (float*)carve(&cursor, particle_ctr * sizeof(float));
+	c->attach = (float*)carve(&cursor, particle_ctr * sizeof(float));
+	c->target_depth = (float*)carve(&cursor, particle_ctr * sizeof(float));
+	for (int k = 0; k < 4; k++)
+		c->contact[k] = (float*)carve(&cursor, particle_ctr * sizeof(float));
+	c->bones = (int*)carve(&cursor, 4 * particle_ctr * sizeof(int));
+	c->weights = (float*)carve(&cursor, 4 * particle_ctr * sizeof(float));
+	c->c0 = (int*)carve(&cursor, max_constraints * sizeof(int));
+	c->c1 = (int*)carve(&cursor, max_constraints * sizeof(int));
+	c->rest = (float*)carve(&cursor, max_constraints * sizeof(float));
+	c->compliance = (float*)carve(&cursor, max_constraints * sizeof(float));
+	c->vertex_particle = (int*)carve(&cursor, vertex_ctr * sizeof(int));
+	c->bind_points = (float*)carve(&cursor, 3 * vertex_ctr * sizeof(float));
+	c->out = (float*)carve(&cursor, 3 * vertex_ctr * sizeof(float));
+	c->particle_ctr = particle_ctr;
+	c->vertex_ctr = vertex_ctr;
+	memcpy(c->vertex_particle, vertex_particle, vertex_ctr * sizeof(int));
+	memcpy(c->bind_points, points, 3 * vertex_ctr * sizeof(float));
+	memcpy(c->out, points, 3 * vertex_ctr * sizeof(float));
+	free(vertex_particle);
+
+	/* bones globaux des particules, via la palette de la partition de leur premier sommet ;
+	les influences valides sont tassees en tete, dans l'ordre decroissant du fichier */
+	memcpy(c->skin_start, skin_start, sizeof(skin_start));
+	int free_ctr = 0;
+	for (int p = 0; p < particle_ctr; p++){
+		int v = first_vertex[p];
+		for (int k = 0; k < 3; k++)
+			c->bind[k][p] = points[3 * v + k];
+		const ModelPartition* part = vertex_part[v] >= 0 ? &data->partitions[vertex_part[v]] : NULL;
+		int n = 0;
+		for (int k = 0; k < MAX_INFLUENCES; k++){
+			int local = data->bone_ids[MAX_INFLUENCES * v + k];
+			float w = data->weights[MAX_INFLUENCES * v + k];
+			if (part == NULL || local < 0 || local >= part->bone_ctr || w <= 0.0f)
+				continue;
+			c->bones[MAX_INFLUENCES * p + n] = data->palette_bones[part->bone_start + local];
+			c->weights[MAX_INFLUENCES * p + n] = w;
+			n++;
+		}
+		for (; n < MAX_INFLUENCES; n++){
+			c->bones[MAX_INFLUENCES * p + n] = 0;
+			c->weights[MAX_INFLUENCES * p + n] = 0.0f;
+		}
+		/* mobilite : 1 au bord, 0 a CLOTH_HEM_WIDTH et au-dela */
+		float m = dist[p] < CLOTH_HEM_WIDTH ? 1.0f - dist[p] / CLOTH_HEM_WIDTH : 0.0f;
+		c->inv_mass[p] = m > 0.0f ? 1.0f : 0.0f;
+		c->attach[p] = CLOTH_ATTACH_COMPLIANCE * m * m;
+		if (m > 0.0f)
+			free_ctr++;
+	}
+	free(vertex_part);
+	free(first_vertex);
+	free(dist);
+
+	/* contraintes touchant au moins une particule libre, coloriees gloutonnement :
+	couleur la plus basse que n'utilise encore aucune de leurs deux particules */
+	int* c0 = (int*)malloc(max_constraints * sizeof(int));
+	int* c1 = (int*)malloc(max_constraints * sizeof(int));
+	float* comp = (float*)malloc(max_constraints * sizeof(float));
+	int* color = (int*)malloc(max_constraints * sizeof(int));
+	unsigned long long* used = (unsigned long long*)calloc(particle_ctr, sizeof(unsigned long long));
+	int count[CLOTH_MAX_COLORS] = { 0 };
+	int n = 0;
+	int dropped = 0;
+	for (int k = 0; k < edge_ctr + bend_ctr; k++){
+		int a = k < edge_ctr ? edges[k].a : bend[2 * (k - edge_ctr)];
+		int b = k < edge_ctr ? edges[k].b : bend[2 * (k - edge_ctr) + 1];
+		if (c->inv_mass[a] == 0.0f && c->inv_mass[b] == 0.0f)
+			continue;
+		unsigned long long taken = used[a] | used[b];
+		if (taken == ~0ULL){
+			dropped++;
+			continue;
+		}
+		int col = 0;
+		while (taken & (1ULL << col))
+			col++;
+		used[a] |= 1ULL << col;
+		used[b] |= 1ULL << col;
+		c0[n] = a;
+		c1[n] = b;
+		comp[n] = k < edge_ctr ? CLOTH_STRETCH_COMPLIANCE : CLOTH_BEND_COMPLIANCE;
+		color[n] = col;
+		count[col]++;
+		if (col + 1 > c->color_ctr)
+			c->color_ctr = col + 1;
+		n++;
+	}
+	c->color_start[0] = 0;
+	for (int col = 0; col < CLOTH_MAX_COLORS; col++)
+		c->color_start[col + 1] = c->color_start[col] + count[col];
+	int fill[CLOTH_MAX_COLORS];
+	memcpy(fill, c->color_start, sizeof(fill));
+	for (int k = 0; k < n; k++){
+		int i = fill[color[k]]++;
+		c->c0[i] = c0[k];
+		c->c1[i] = c1[k];
+		c->compliance[i] = comp[k];
+		float d2 = 0.0f;
+		for (int ax = 0; ax < 3; ax++){
+			float d = c->bind[ax][c1[k]] - c->bind[ax][c0[k]];
+			d2 += d * d;
+		}
+		c->rest[i] = sqrtf(d2);
+	}
+	c->constraint_ctr = n;
+	free(c0);
+	free(c1);
+	free(comp);
+	free(color);
+	free(used);
+	free(edges);
+	free(bend);
+
+	printf("tissu : %i particules dont %i libres, %i contraintes en %i couleurs (%.1f ms)\n",
+		particle_ctr, free_ctr, n, c->color_ctr, (profNow() - begin) * 1000.0);
+	if (dropped > 0)
+		printf("tissu : %i contraintes ignorees (plus de %i couleurs)\n", dropped, CLOTH_MAX_COLORS);
+	return c;
+}
+
+void clothDestroy(Cloth* cloth){
+	if (cloth == NULL)
+		return;
+	free(cloth->block);
+	free(cloth);
+}
+
+void clothReset(Cloth* cloth){
+	if (cloth != NULL)
+		cloth->primed = false;
+}
+
+/* pool du solveur : le thread de rendu fait office de thread 0 */
+static std::thread* threads = NULL;
+static int thread_ctr = 1;
+static std::mutex lock;
+static std::condition_variable wake;
+static int generation = 0;
+static bool stopping = false;
+static std::atomic<int> barrier_ctr(0);
+static std::atomic<int> barrier_phase(0);
+
+/* pas en cours, fixe avant de reveiller le pool */
+static Cloth* job = NULL;
+static const glm::mat4* job_matrices = NULL;
+static const BodyProxy* job_body = NULL;
+static int job_nb_matrices = 0;
+static int job_substeps = 0;
+static float job_h = 0.0f;
+
+/* attente active : une couleur ne dure que quelques microsecondes */
+static void barrierWait(){
+	if (thread_ctr == 1)
+		return;
+	int phase = barrier_phase.load();
+	if (barrier_ctr.fetch_add(1) + 1 == thread_ctr){
+		barrier_ctr.store(0);
+		barrier_phase.fetch_add(1);
+		return;
+	}
+	for (int spin = 0; barrier_phase.load() == phase; spin++){
+		if (spin > 1000)
+			std::this_thread::yield();
+	}
+}
+
+/* tranche [a, b) du thread t, de longueur multiple de align */
+static void split(int n, int t, int align, int* a, int* b){
+	int chunk = (n + thread_ctr - 1) / thread_ctr;
+	chunk = (chunk + align - 1) / align * align;
+	*a = std::min(n, t * chunk);
+	*b = std::min(n, *a + chunk);
+}
+
+/* cibles de l'image, avec la meme somme ponderee de matrices que le vertex shader */
+static void skinParticles(Cloth* c, int a, int b){
+	if (c->primed){
+		for (int k = 0; k < 3; k++)
+			memcpy(c->last[k] + a, c->target[k] + a, (b - a) * sizeof(float));
+	}
+	skinPositions(c->bind, c->bones, c->weights, c->skin_start, a, b, job_matrices, job_nb_matrices, c->target);
+	if (!c->primed){
+		for (int k = 0; k < 3; k++){
+			memcpy(c->last[k] + a, c->target[k] + a, (b - a) * sizeof(float));
+			memcpy(c->x[k] + a, c->target[k] + a, (b - a) * sizeof(float));
+			memset(c->v[k] + a, 0, (b - a) * sizeof(float));
+		}
+	}
+}
+
+/* prediction, puis rappel vers la cible interpolee a la fraction f de l'image */
+static void predict(Cloth* c, int a, int b, float h, float inv_h2, float f){
+	for (int p = a; p < b; p++){
+		float w = c->inv_mass[p];
+		float k = w / (w + c->attach[p] * inv_h2);
+		for (int ax = 0; ax < 3; ax++){
+			float t = c->last[ax][p] + (c->target[ax][p] - c->last[ax][p]) * f;
+			if (w == 0.0f){
+				c->x[ax][p] = t;
+				c->prev[ax][p] = t;
+				continue;
+			}
+			float vel = c->v[ax][p] - (ax == 2 ? CLOTH_GRAVITY * h : 0.0f);
+			float x = c->x[ax][p];
+			c->prev[ax][p] = x;
+			x += vel * h;
+			c->x[ax][p] = x + (t - x) * k;
+		}
+	}
+}
+
+/* hors du corps, a CLOTH_COLLISION_MARGIN de sa surface, ou pas plus enfonce que la cible */
+static void collide(Cloth* c, const BodyProxy* body, int a, int b){
+	float* d = c->contact[0];
+	bodyQuery(body, c->x[0] + a, c->x[1] + a, c->x[2] + a, b - a, d + a, c->contact[1] + a, c->contact[2] + a, c->contact[3] + a);
+	for (int p = a; p < b; p++){
+		float floor = std::min(CLOTH_COLLISION_MARGIN, c->target_depth[p]);
+		if (c->inv_mass[p] == 0.0f || d[p] >= floor)
+			continue;
+		for (int ax = 0; ax < 3; ax++)
+			c->x[ax][p] += c->contact[ax + 1][p] * (floor - d[p]);
+	}
+}
+
+static void velocities(Cloth* c, int a, int b, float inv_h, float damp){
+	for (int p = a; p < b; p++){
+		if (c->inv_mass[p] == 0.0f)
+			continue;
+		for (int ax = 0; ax < 3; ax++)
+			c->v[ax][p] = (c->x[ax][p] - c->prev[ax][p]) * inv_h * damp;
+	}
+}
+
+/* Contraintes de distance [a, b) d'une meme couleur. Une seule iteration par sous-pas :
+le multiplicateur XPBD part de 0, d'ou dl = -C / (w0 + w1 + compliance / h^2). */
+static void solveConstraints(Cloth* c, int a, int b, float inv_h2){
+	float* X = c->x[0];
+	float* Y = c->x[1];
+	float* Z = c->x[2];
+	const float* W = c->inv_mass;
+	int i = a;
+#ifdef CLOTH_SSE
+	/* 4 contraintes a la fois : dans une couleur, aucune particule n'est partagee,
+	les lectures et ecritures dispersees ne se recouvrent pas */
+	const __m128 tiny = _mm_set1_ps(1e-12f);
+	const __m128 h2 = _mm_set1_ps(inv_h2);
+	for (; i + 4 <= b; i += 4){
+		const int* p = &c->c0[i];
+		const int* q = &c->c1[i];
+		__m128 dx = _mm_sub_ps(_mm_setr_ps(X[q[0]], X[q[1]], X[q[2]], X[q[3]]), _mm_setr_ps(X[p[0]], X[p[1]], X[p[2]], X[p[3]]));
+		__m128 dy = _mm_sub_ps(_mm_setr_ps(Y[q[0]], Y[q[1]], Y[q[2]], Y[q[3]]), _mm_setr_ps(Y[p[0]], Y[p[1]], Y[p[2]], Y[p[3]]));
+		__m128 dz = _mm_sub_ps(_mm_setr_ps(Z[q[0]], Z[q[1]], Z[q[2]], Z[q[3]]), _mm_setr_ps(Z[p[0]], Z[p[1]], Z[p[2]], Z[p[3]]));
+		__m128 w0 = _mm_setr_ps(W[p[0]], W[p[1]], W[p[2]], W[p[3]]);
+		__m128 w1 = _mm_setr_ps(W[q[0]], W[q[1]], W[q[2]], W[q[3]]);
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 len = _mm_sqrt_ps(_mm_max_ps(len2, tiny));
+		__m128 cons = _mm_sub_ps(len, _mm_loadu_ps(&c->rest[i]));
+		__m128 denom = _mm_add_ps(_mm_add_ps(w0, w1), _mm_mul_ps(_mm_loadu_ps(&c->compliance[i]), h2));
+		__m128 s = _mm_div_ps(_mm_sub_ps(_mm_setzero_ps(), cons), _mm_mul_ps(denom, len));
+		dx = _mm_mul_ps(dx, s);
+		dy = _mm_mul_ps(dy, s);
+		dz = _mm_mul_ps(dz, s);
+		float out[6][4];
+		_mm_storeu_ps(out[0], _mm_mul_ps(dx, w0));
+		_mm_storeu_ps(out[1], _mm_mul_ps(dy, w0));
+		_mm_storeu_ps(out[2], _mm_mul_ps(dz, w0));
+		_mm_storeu_ps(out[3], _mm_mul_ps(dx, w1));
+		_mm_storeu_ps(out[4], _mm_mul_ps(dy, w1));
+		_mm_storeu_ps(out[5], _mm_mul_ps(dz, w1));
+		for (int l = 0; l < 4; l++){
+			X[p[l]] -= out[0][l];
+			Y[p[l]] -= out[1][l];
+			Z[p[l]] -= out[2][l];
+			X[q[l]] += out[3][l];
+			Y[q[l]] += out[4][l];
+			Z[q[l]] += out[5][l];
+		}
+	}
+#endif
+	for (; i < b; i++){
+		int p = c->c0[i];
+		int q = c->c1[i];
+		float dx = X[q] - X[p], dy = Y[q] - Y[p], dz = Z[q] - Z[p];
+		float len = sqrtf(std::max(dx * dx + dy * dy + dz * dz, 1e-12f));
+		float denom = W[p] + W[q] + c->compliance[i] * inv_h2;
+		float s = (0.0f - (len - c->rest[i])) / (denom * len);
+		dx *= s;
+		dy *= s;
+		dz *= s;
+		X[p] -= dx * W[p];
+		Y[p] -= dy * W[p];
+		Z[p] -= dz * W[p];
+		X[q] += dx * W[q];
+		Y[q] += dy * W[q];
+		Z[q] += dz * W[q];
+	}
+}
+
+/* corps du pas, execute par chacun des threads du pool */
+static void solve(int t){
+	Cloth* c = job;
+	int a, b;
+	split(c->particle_ctr, t, 1, &a, &b);
+	skinParticles(c, a, b);
+	const BodyProxy* body = job_body;
+	if (body != NULL)
+		bodyQuery(body, c->target[0] + a, c->target[1] + a, c->target[2] + a, b - a,
+			c->target_depth + a, c->contact[1] + a, c->contact[2] + a, c->contact[3] + a);
+	float h = job_h;
+	float inv_h2 = 1.0f / (h * h);
+	float damp = std::max(0.0f, 1.0f - CLOTH_DAMPING * h);
+	for (int s = 0; s < job_substeps; s++){
+		predict(c, a, b, h, inv_h2, (float)(s + 1) / (float)job_substeps);
+		barrierWait();
+		for (int col = 0; col < c->color_ctr; col++){
+			int ca, cb;
+			split(c->color_start[col + 1] - c->color_start[col], t, 4, &ca, &cb);
+			solveConstraints(c, c->color_start[col] + ca, c->color_start[col] + cb, inv_h2);
+			barrierWait();
+		}
+		if (body != NULL)
+			collide(c, body, a, b);
+		velocities(c, a, b, 1.0f / h, damp);
+	}
+	barrierWait();
+
+	/* recopie vers les sommets, doublons compris */
+	split(c->vertex_ctr, t, 1, &a, &b);
+	for (int v = a; v < b; v++){
+		int p = c->vertex_particle[v];
+		c->out[3 * v] = c->x[0][p];
+		c->out[3 * v + 1] = c->x[1][p];
+		c->out[3 * v + 2] = c->x[2][p];
+	}
+}
+
+static void workerMain(int t){
+	int seen = 0;
+	for (;;){
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			wake.wait(lk, [&seen]{ return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+		}
+		solve(t);
+		barrierWait();
+	}
+}
+
+void clothStart(int nb_threads){
+	if (threads != NULL || nb_threads <= 1)
+		return;
+	stopping = false;
+	thread_ctr = nb_threads;
+	threads = new std::thread[nb_threads - 1];
+	for (int t = 1; t < nb_threads; t++)
+		threads[t - 1] = std::thread(workerMain, t);
+}
+
+void clothStop(){
+	if (threads == NULL)
+		return;
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (int t = 1; t < thread_ctr; t++)
+		threads[t - 1].join();
+	delete[] threads;
+	threads = NULL;
+	thread_ctr = 1;
+}
+
+void clothStep(Cloth* cloth, const glm::mat4* bone_matrices, int nb_matrices, const BodyProxy* body,
+	double dt, double budget_ms){
+	double start = profNow();
+	if (dt > CLOTH_MAX_DT)
+		dt = CLOTH_MAX_DT;
+	if (dt < 0.001)
+		dt = 0.001;
+	if (cloth->substeps == 0)
+		cloth->substeps = CLOTH_MIN_SUBSTEPS;
+
+	job_matrices = bone_matrices;
+	job_nb_matrices = nb_matrices;
+	job_body = body != NULL && body->capsule_ctr > 0 ? body : NULL;
+	job_substeps = cloth->substeps;
+	job_h = (float)(dt / cloth->substeps);
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		job = cloth;
+		generation++;
+	}
+	wake.notify_all();
+	solve(0);
+	barrierWait();
+	cloth->primed = true;
+
+	/* sous-pas de l'image suivante : ce que le budget permet au cout moyen observe */
+	double per = (profNow() - start) * 1000.0 / cloth->substeps;
+	cloth->substep_ms = cloth->substep_ms == 0.0 ? per : 0.8 * cloth->substep_ms + 0.2 * per;
+	int n = (int)(budget_ms / cloth->substep_ms);
+	cloth->substeps = std::max(CLOTH_MIN_SUBSTEPS, std::min(CLOTH_MAX_SUBSTEPS, n));
+}
+
+void clothUpload(const Cloth* cloth, GLuint points_buffer){
+	glBindBuffer(GL_COPY_WRITE_BUFFER, points_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, 3 * cloth->vertex_ctr * sizeof(float), cloth->out);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void clothSetRest(Cloth* cloth, const int* vertices, int vertex_ctr, const float* points){
+	if (cloth == NULL)
+		return;
+	for (int i = 0; i < vertex_ctr; i++){
+		int v = vertices[i];
+		int p = cloth->vertex_particle[v];
+		for (int k = 0; k < 3; k++){
+			cloth->bind_points[3 * v + k] = points[3 * v + k];
+			cloth->bind[k][p] = points[3 * v + k];
+		}
+	}
+	for (int i = 0; i < cloth->constraint_ctr; i++){
+		float d2 = 0.0f;
+		for (int ax = 0; ax < 3; ax++){
+			float d = cloth->bind[ax][cloth->c1[i]] - cloth->bind[ax][cloth->c0[i]];
+			d2 += d * d;
+		}
+		cloth->rest[i] = sqrtf(d2);
+	}
+	cloth->primed = false;
+}
+
+/* le buffer retrouve les positions de repos, skinnees par le shader */
+void clothRestore(Cloth* cloth, GLuint points_buffer){
+	glBindBuffer(GL_COPY_WRITE_BUFFER, points_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, 3 * cloth->vertex_ctr * sizeof(float), cloth->bind_points);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	cloth->primed = false;
+}
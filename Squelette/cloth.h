@@ -0,0 +1,92 @@
+#ifndef CLOTH_H
+#define CLOTH_H
+
+#include "importer.h"
+#include "bodyCollision.h"
+
+/* Tissu simule par-dessus le skinning rigide (optionnel : Squelette --cloth MS, touche C).
+Les sommets sont soudes par position en particules. Les positions skinnees par la palette
+de bones, calculees ici sur CPU, servent de cibles d'attache : les particules a moins de
+CLOTH_HEM_WIDTH d'un bord libre du maillage (bas du vetement, poignets, encolure) sont
+libres et rappelees vers leur cible d'autant plus mollement qu'elles sont pres du bord,
+les autres suivent exactement le skinning.
+Les contraintes de distance (aretes) et de flexion (sommets opposes de deux triangles
+voisins) sont resolues par XPBD en petits pas, une iteration par sous-pas. Elles sont
+colorees pour que deux contraintes de meme couleur ne partagent aucune particule :
+chaque couleur est resolue en parallele sur CLOTH_THREADS threads, par paquets de 4
+en SSE. A chaque sous-pas, les particules libres sont repoussees hors des capsules du
+corps (bodyCollision.h), jamais plus loin que leur cible quand celle-ci y est deja
+enfoncee. Le nombre de sous-pas s'adapte pour tenir dans le budget de l'image.
+Les positions obtenues remplacent le flux des positions du vetement (buffers[0]) ; le
+vertex shader ne les skinne alors plus (uniform 'simulated'). */
+
+#define CLOTH_THREADS 3                // threads du solveur, thread de rendu compris
+#define CLOTH_BUDGET_MS 2.0            // budget par image quand le tissu est active a la touche C
+#define CLOTH_MIN_SUBSTEPS 2
+#define CLOTH_MAX_SUBSTEPS 32
+#define CLOTH_MAX_COLORS 64
+#define CLOTH_HEM_WIDTH 0.15f          // largeur de la bande libre le long des bords (m)
+#define CLOTH_STRETCH_COMPLIANCE 1e-7f // souplesse des aretes
+#define CLOTH_BEND_COMPLIANCE 1e-4f    // souplesse en flexion
+#define CLOTH_ATTACH_COMPLIANCE 1e-3f  // souplesse de l'attache, au bord meme
+#define CLOTH_DAMPING 2.0f             // amortissement des vitesses (1/s)
+#define CLOTH_GRAVITY 9.81f            // selon -z, axe vertical des vetements
+#define CLOTH_COLLISION_MARGIN 0.01f   // epaisseur gardee entre le tissu et le corps (m)
+#define CLOTH_MAX_DT 0.05              // pas tronque au-dela (pause, chargement)
+
+/* tableaux en SoA ; les contraintes sont triees par couleur */
+struct Cloth{
+	int particle_ctr;
+	int vertex_ctr;
+	int constraint_ctr;
+	int color_ctr;
+	int color_start[CLOTH_MAX_COLORS + 1]; // contraintes de la couleur c : [color_start[c], color_start[c + 1])
+
+	float* x[3];        // positions courantes
+	float* prev[3];     // positions au debut du sous-pas
+	float* v[3];
+	float* target[3];   // cible skinnee de l'image
+	float* last[3];     // cible de l'image precedente, interpolee pendant les sous-pas
+	float* bind[3];     // position de repos
+	float* inv_mass;    // 0 : la particule suit le skinning
+	float* attach;      // souplesse de l'attache a la cible
+	float* target_depth; // distance de la cible au corps, negative si elle y est enfoncee
+	float* contact[4];  // distance au corps et normale, a chaque sous-pas
+	int* bones;         // 4 par particule, bones globaux, influences valides en tete
+	float* weights;     // 4 par particule
+	int skin_start[MAX_INFLUENCES + 2]; // particules a k influences : [skin_start[k], skin_start[k + 1])
+
+	int* c0;
+	int* c1;
+	float* rest;
+	float* compliance;
+
+	int* vertex_particle;
+	float* bind_points; // 3 par sommet, pour rendre au buffer sa position de repos
+	float* out;         // 3 par sommet, envoye au buffer des positions
+
+	bool primed;        // false : les particules partent de leur cible au prochain pas
+	int substeps;
+	double substep_ms;  // cout moyen d'un sous-pas, skinning et recopie compris
+	void* block;
+};
+
+/* NULL si le vetement n'a pas de bones ou pas de bord libre */
+Cloth* clothCreate(const ModelData* data);
+void clothDestroy(Cloth* cloth);
+void clothReset(Cloth* cloth);
+
+/* thread de rendu ; budget_ms borne le temps du pas hors CLOTH_MIN_SUBSTEPS, body peut etre NULL */
+void clothStep(Cloth* cloth, const glm::mat4* bone_matrices, int nb_matrices, const BodyProxy* body,
+	double dt, double budget_ms);
+void clothUpload(const Cloth* cloth, GLuint points_buffer);
+void clothRestore(Cloth* cloth, GLuint points_buffer);
+
+/* nouvelles positions de repos des sommets listes (3 par sommet, indexees par sommet),
+deformees par les cibles de morph (morph.h) : attaches et longueurs de repos suivent */
+void clothSetRest(Cloth* cloth, const int* vertices, int vertex_ctr, const float* points);
+
+void clothStart(int nb_threads);
+void clothStop();
+
+#endif
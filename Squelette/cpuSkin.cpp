@@ -0,0 +1,139 @@
+#include "cpuSkin.h"
+#include "skinKernels.h"
+#include <string.h>
+
+static char* carve(char** cursor, size_t bytes){
+	char* p = *cursor;
+	*cursor += (bytes + 15) & ~(size_t)15;
+	return p;
+}
+
+CpuSkin* cpuSkinCreate(const ModelData* data){
+	if (data->bone_ids == NULL || data->weights == NULL || data->clusters == NULL)
+		return NULL;
+	int n = data->point_ctr;
+	size_t soa = ((size_t)n * sizeof(float) + 15) & ~(size_t)15;
+	size_t quad = ((size_t)MAX_INFLUENCES * n * sizeof(float) + 15) & ~(size_t)15;
+	size_t total = 6 * soa + 2 * quad + 2 * (((size_t)3 * n * sizeof(float) + 15) & ~(size_t)15)
+		+ (((size_t)data->cluster_ctr * sizeof(ModelCluster) + 15) & ~(size_t)15);
+	CpuSkin* skin = (CpuSkin*)calloc(1, sizeof(CpuSkin));
+	skin->block = calloc(1, total);
+	char* cursor = (char*)skin->block;
+	for (int k = 0; k < 3; k++){
+		skin->rest[k] = (float*)carve(&cursor, n * sizeof(float));
+		skin->skinned[k] = (float*)carve(&cursor, n * sizeof(float));
+	}
+	skin->bones = (int*)carve(&cursor, MAX_INFLUENCES * n * sizeof(int));
+	skin->weights = (float*)carve(&cursor, MAX_INFLUENCES * n * sizeof(float));
+	skin->out = (float*)carve(&cursor, 3 * n * sizeof(float));
+	skin->clusters = (ModelCluster*)carve(&cursor, data->cluster_ctr * sizeof(ModelCluster));
+	skin->vertex_ctr = n;
+	skin->cluster_ctr = data->cluster_ctr;
+	memcpy(skin->clusters, data->clusters, data->cluster_ctr * sizeof(ModelCluster));
+	memcpy(skin->out, data->points, 3 * n * sizeof(float));
+	memcpy(skin->weights, data->weights, MAX_INFLUENCES * n * sizeof(float));
+	for (int v = 0; v < n; v++){
+		for (int k = 0; k < 3; k++)
+			skin->rest[k][v] = data->points[3 * v + k];
+	}
+
+	/* bones globaux, via la palette de la partition de chaque sommet */
+	for (int p = 0; p < data->partition_ctr; p++){
+		const ModelPartition* part = &data->partitions[p];
+		for (int i = part->index_start; i < part->index_start + part->index_ctr; i++){
+			int v = data->indices[i];
+			for (int k = 0; k < MAX_INFLUENCES; k++){
+				int local = data->bone_ids[MAX_INFLUENCES * v + k];
+				skin->bones[MAX_INFLUENCES * v + k] = local >= 0 && local < part->bone_ctr ? data->palette_bones[part->bone_start + local] : 0;
+			}
+		}
+	}
+
+	/* l'import range les sommets par nombre d'influences, a partir de 1 */
+	skin->bucket_start[0] = skin->bucket_start[1] = 0;
+	for (int k = 1; k <= MAX_INFLUENCES; k++)
+		skin->bucket_start[k + 1] = skin->bucket_start[k] + data->influence_ctr[k - 1];
+	return skin;
+}
+
+void cpuSkinDestroy(CpuSkin* skin){
+	if (skin == NULL)
+		return;
+	free(skin->block);
+	free(skin);
+}
+
+void cpuSkinInvalidate(CpuSkin* skin){
+	if (skin != NULL)
+		skin->valid = false;
+}
+
+static bool clusterDirty(const ModelCluster* cluster, const unsigned char* bone_dirty, int nb_matrices){
+	for (int k = 0; k < MAX_INFLUENCES; k++){
+		int b = cluster->bones[k];
+		if (b >= 0 && b < nb_matrices && bone_dirty[b])
+			return true;
+	}
+	return false;
+}
+
+/* reskinne [a, b) et l'envoie au buffer lie a GL_COPY_WRITE_BUFFER */
+static void skinAndUpload(CpuSkin* skin, const glm::mat4* bone_matrices, int nb_matrices, int a, int b){
+	skinPositions(skin->rest, skin->bones, skin->weights, skin->bucket_start, a, b, bone_matrices, nb_matrices, skin->skinned);
+	for (int v = a; v < b; v++){
+		for (int k = 0; k < 3; k++)
+			skin->out[3 * v + k] = skin->skinned[k][v];
+	}
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)a * 3 * sizeof(float), (GLsizeiptr)(b - a) * 3 * sizeof(float), &skin->out[3 * a]);
+}
+
+float cpuSkinUpdate(CpuSkin* skin, const glm::mat4* bone_matrices, const unsigned char* bone_dirty,
+	int nb_matrices, GLuint points_buffer){
+	glBindBuffer(GL_COPY_WRITE_BUFFER, points_buffer);
+	int skinned = 0;
+	if (!skin->valid || bone_dirty == NULL){
+		skinAndUpload(skin, bone_matrices, nb_matrices, 0, skin->vertex_ctr);
+		skinned = skin->vertex_ctr;
+		skin->valid = true;
+	}
+	else{
+		/* groupes voisins a reskinner fusionnes en une seule plage */
+		int start = -1;
+		for (int c = 0; c <= skin->cluster_ctr; c++){
+			bool dirty = c < skin->cluster_ctr && clusterDirty(&skin->clusters[c], bone_dirty, nb_matrices);
+			if (dirty && start < 0)
+				start = skin->clusters[c].vertex_start;
+			if (!dirty && start >= 0){
+				int end = c < skin->cluster_ctr ? skin->clusters[c].vertex_start : skin->vertex_ctr;
+				skinAndUpload(skin, bone_matrices, nb_matrices, start, end);
+				skinned += end - start;
+				start = -1;
+			}
+		}
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	skin->skipped = skin->vertex_ctr > 0 ? 1.0f - (float)skinned / (float)skin->vertex_ctr : 0.0f;
+	return skin->skipped;
+}
+
+void cpuSkinSetRest(CpuSkin* skin, const int* vertices, int vertex_ctr, const float* points){
+	if (skin == NULL)
+		return;
+	for (int i = 0; i < vertex_ctr; i++){
+		int v = vertices[i];
+		for (int k = 0; k < 3; k++)
+			skin->rest[k][v] = points[3 * v + k];
+	}
+	skin->valid = false;
+}
+
+void cpuSkinRestore(CpuSkin* skin, GLuint points_buffer){
+	for (int v = 0; v < skin->vertex_ctr; v++){
+		for (int k = 0; k < 3; k++)
+			skin->out[3 * v + k] = skin->rest[k][v];
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, points_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)skin->vertex_ctr * 3 * sizeof(float), skin->out);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	skin->valid = false;
+}
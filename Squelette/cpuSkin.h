@@ -0,0 +1,44 @@
+#ifndef CPUSKIN_H
+#define CPUSKIN_H
+
+#include "importer.h"
+
+/* Skinning des positions du vetement sur CPU, a la place du vertex shader
+(Squelette --skin cpu, touche K). Les sommets sont groupes a l'import par ensemble de
+bones (ModelCluster) ; le thread de calcul signale les bones dont la matrice a bouge
+(FrameSlot::bone_dirty) et seuls les groupes touchant l'un d'eux sont reskinnes puis
+renvoyes au buffer des positions (buffers[0]), par plages contigues. Utilisateur
+immobile, presque rien n'est recalcule ni envoye. */
+
+struct CpuSkin{
+	int vertex_ctr;
+	int cluster_ctr;
+	ModelCluster* clusters;
+	float* rest[3];      // positions de repos, en SoA
+	float* skinned[3];
+	int* bones;          // 4 par sommet, bones globaux
+	float* weights;      // 4 par sommet
+	float* out;          // 3 par sommet, contenu du buffer des positions
+	int bucket_start[MAX_INFLUENCES + 2]; // sommets a k influences, pour skinPositions
+	bool valid;          // false : tout est reskinne au prochain appel
+	float skipped;       // fraction des sommets sautes a la derniere image
+	void* block;
+};
+
+/* NULL si le vetement n'a pas de bones */
+CpuSkin* cpuSkinCreate(const ModelData* data);
+void cpuSkinDestroy(CpuSkin* skin);
+void cpuSkinInvalidate(CpuSkin* skin);
+
+/* bone_dirty : un drapeau par matrice, NULL : tous ; renvoie la fraction de sommets sautes */
+float cpuSkinUpdate(CpuSkin* skin, const glm::mat4* bone_matrices, const unsigned char* bone_dirty,
+	int nb_matrices, GLuint points_buffer);
+
+/* nouvelles positions de repos des sommets listes (3 par sommet, indexees par sommet),
+par exemple deformees par les cibles de morph (morph.h) ; tout est reskinne ensuite */
+void cpuSkinSetRest(CpuSkin* skin, const int* vertices, int vertex_ctr, const float* points);
+
+/* remet le buffer des positions au repos, pour le skinning du vertex shader */
+void cpuSkinRestore(CpuSkin* skin, GLuint points_buffer);
+
+#endif
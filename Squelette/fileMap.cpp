@@ -0,0 +1,153 @@
+#include "fileMap.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void* mapFile(const char* path, size_t* size){
+	*size = 0;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length) || length.QuadPart == 0){
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return NULL;
+	/* la vue garde une reference sur l'objet de mapping */
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == NULL)
+		return NULL;
+	*size = (size_t)length.QuadPart;
+	return view;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0){
+		close(fd);
+		return NULL;
+	}
+	void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return NULL;
+	*size = (size_t)st.st_size;
+	return view;
+#endif
+}
+
+void unmapFile(void* view, size_t size){
+	if (view == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+#else
+	munmap(view, size);
+#endif
+}
+
+void* mapShared(const char* name, size_t* size){
+	*size = 0;
+#ifdef _WIN32
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if (mapping == NULL){
+		HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return NULL;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (mapping == NULL)
+			return NULL;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == NULL)
+		return NULL;
+	/* taille de la vue : celle de l'objet, arrondie aux pages */
+	MEMORY_BASIC_INFORMATION info;
+	if (VirtualQuery(view, &info, sizeof(info)) == 0){
+		UnmapViewOfFile(view);
+		return NULL;
+	}
+	*size = info.RegionSize;
+	return view;
+#else
+	int fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0){
+		close(fd);
+		return NULL;
+	}
+	void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return NULL;
+	*size = (size_t)st.st_size;
+	return view;
+#endif
+}
+
+long readFileInto(const char* path, char* buffer, size_t capacity){
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return -1;
+	DWORD lus = 0;
+	BOOL ok = ReadFile(file, buffer, (DWORD)capacity, &lus, NULL);
+	CloseHandle(file);
+	return ok ? (long)lus : -1;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	size_t total = 0;
+	while (total < capacity){
+		ssize_t n = read(fd, buffer + total, capacity - total);
+		if (n < 0){
+			close(fd);
+			return -1;
+		}
+		if (n == 0)
+			break;
+		total += (size_t)n;
+	}
+	close(fd);
+	return (long)total;
+#endif
+}
+
+bool hashFile(const char* path, unsigned long long* hash){
+	FILE* fichier = fopen(path, "rb");
+	if (fichier == NULL)
+		return false;
+	unsigned long long h = 14695981039346656037ULL;
+	unsigned char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fichier)) > 0){
+		for (size_t i = 0; i < n; i++){
+			h ^= buffer[i];
+			h *= 1099511628211ULL;
+		}
+	}
+	fclose(fichier);
+	*hash = h;
+	return true;
+}
@@ -0,0 +1,22 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stdlib.h>
+
+/* Projection d'un fichier en memoire en lecture seule (MapViewOfFile / mmap) */
+void* mapFile(const char* path, size_t* size);
+void unmapFile(void* view, size_t size);
+
+/* Vue en lecture d'une memoire partagee qu'un autre processus continue d'ecrire : objet
+nomme (Windows) ou fichier ouvert en ecriture par le producteur. Les ecritures du
+producteur y sont visibles sans reprojection ; a fermer par unmapFile */
+void* mapShared(const char* name, size_t* size);
+
+/* Lecture d'au plus 'capacity' octets sans passer par stdio (fopen alloue un tampon
+a chaque ouverture) : utilisable dans la boucle de rendu. -1 si illisible */
+long readFileInto(const char* path, char* buffer, size_t capacity);
+
+/* hash FNV-1a 64 bits du contenu d'un fichier, false si illisible */
+bool hashFile(const char* path, unsigned long long* hash);
+
+#endif
@@ -0,0 +1,280 @@
+#include "fileWatch.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+struct WatchEntry{
+	bool used;
+	char path[256];
+	char dir[256];
+	const char* name;   // pointe dans path, apres le dernier separateur
+	bool exists;
+	long long mtime;
+	long long size;
+	bool pending;       // modifie, en attente de stabilite
+	double last_change;
+	bool changed;       // stable, pas encore lu par watchChanged
+};
+
+/* partage avec le thread de surveillance, protege par 'lock' */
+static std::mutex lock;
+static std::thread* watcher = NULL;
+static bool stopping = false;
+static bool dirs_dirty = false;
+static WatchEntry entries[WATCH_MAX];
+
+/* etat propre au thread de surveillance */
+#ifdef _WIN32
+static HANDLE handles[WATCH_MAX];
+#elif defined(__linux__)
+static int inotify_fd = -1;
+#endif
+static int nb_dirs = 0;
+
+static void splitPath(WatchEntry* e, const char* path){
+	strncpy(e->path, path, sizeof(e->path) - 1);
+	e->path[sizeof(e->path) - 1] = '\0';
+	const char* slash = strrchr(e->path, '/');
+	const char* backslash = strrchr(e->path, '\\');
+	if (backslash != NULL && (slash == NULL || backslash > slash))
+		slash = backslash;
+	if (slash == NULL){
+		strcpy(e->dir, ".");
+		e->name = e->path;
+	}
+	else{
+		size_t len = slash - e->path;
+		memcpy(e->dir, e->path, len);
+		e->dir[len] = '\0';
+		e->name = slash + 1;
+	}
+}
+
+static void readStat(WatchEntry* e){
+	struct stat st;
+	e->exists = stat(e->path, &st) == 0;
+	e->mtime = e->exists ? (long long)st.st_mtime : 0;
+	e->size = e->exists ? (long long)st.st_size : 0;
+}
+
+/* reconstruit une notification par dossier distinct */
+static void rebuildWatches(){
+	char dirs[WATCH_MAX][256];
+	int n = 0;
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		for (int i = 0; i < WATCH_MAX; i++){
+			if (!entries[i].used)
+				continue;
+			bool seen = false;
+			for (int d = 0; d < n && !seen; d++)
+				seen = strcmp(dirs[d], entries[i].dir) == 0;
+			if (!seen)
+				strcpy(dirs[n++], entries[i].dir);
+		}
+		dirs_dirty = false;
+	}
+
+#ifdef _WIN32
+	for (int d = 0; d < nb_dirs; d++)
+		FindCloseChangeNotification(handles[d]);
+	nb_dirs = 0;
+	for (int d = 0; d < n; d++){
+		HANDLE h = FindFirstChangeNotificationA(dirs[d], FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+		if (h == INVALID_HANDLE_VALUE)
+			printf("surveillance impossible de %s\n", dirs[d]);
+		else
+			handles[nb_dirs++] = h;
+	}
+#elif defined(__linux__)
+	if (inotify_fd >= 0)
+		close(inotify_fd);
+	inotify_fd = inotify_init1(IN_NONBLOCK);
+	nb_dirs = 0;
+	for (int d = 0; d < n && inotify_fd >= 0; d++){
+		if (inotify_add_watch(inotify_fd, dirs[d], IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY) < 0)
+			printf("surveillance impossible de %s\n", dirs[d]);
+		else
+			nb_dirs++;
+	}
+#else
+	nb_dirs = n;
+#endif
+}
+
+static void markPending(const char* name, double now){
+	std::lock_guard<std::mutex> lk(lock);
+	for (int i = 0; i < WATCH_MAX; i++){
+		if (entries[i].used && strcmp(entries[i].name, name) == 0){
+			entries[i].pending = true;
+			entries[i].last_change = now;
+		}
+	}
+}
+
+/* attend une notification ou WATCH_TIMEOUT_MS ; la date et la taille sont de toute
+facon comparees ensuite, les notifications ne servent qu'a reagir plus tot */
+static void waitEvents(){
+#ifdef _WIN32
+	if (nb_dirs == 0){
+		Sleep(WATCH_TIMEOUT_MS);
+		return;
+	}
+	DWORD r = WaitForMultipleObjects(nb_dirs, handles, FALSE, WATCH_TIMEOUT_MS);
+	if (r >= WAIT_OBJECT_0 && r < WAIT_OBJECT_0 + (DWORD)nb_dirs)
+		FindNextChangeNotification(handles[r - WAIT_OBJECT_0]);
+#elif defined(__linux__)
+	if (inotify_fd < 0){
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_TIMEOUT_MS));
+		return;
+	}
+	struct pollfd pfd;
+	pfd.fd = inotify_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, WATCH_TIMEOUT_MS) <= 0)
+		return;
+	/* inotify donne le nom du fichier : une ecriture dans la meme seconde et de
+	meme taille, invisible pour stat, est quand meme detectee */
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(inotify_fd, buffer, sizeof(buffer))) > 0){
+		double now = profNow();
+		for (char* p = buffer; p < buffer + len;){
+			const struct inotify_event* ev = (const struct inotify_event*)p;
+			if (ev->len > 0)
+				markPending(ev->name, now);
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+#else
+	std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_TIMEOUT_MS));
+#endif
+}
+
+static void watcherMain(){
+	for (;;){
+		bool rebuild;
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			if (stopping)
+				break;
+			rebuild = dirs_dirty;
+		}
+		if (rebuild)
+			rebuildWatches();
+		waitEvents();
+
+		double now = profNow();
+		std::lock_guard<std::mutex> lk(lock);
+		for (int i = 0; i < WATCH_MAX; i++){
+			WatchEntry* e = &entries[i];
+			if (!e->used)
+				continue;
+			long long mtime = e->mtime;
+			long long size = e->size;
+			bool exists = e->exists;
+			readStat(e);
+			if (e->exists != exists || e->mtime != mtime || e->size != size){
+				e->pending = true;
+				e->last_change = now;
+			}
+			/* un fichier absent (sauvegarde par renommage en cours) n'est pas signale */
+			if (e->pending && e->exists && (now - e->last_change) * 1000.0 >= WATCH_DEBOUNCE_MS){
+				e->pending = false;
+				e->changed = true;
+			}
+		}
+	}
+
+#ifdef _WIN32
+	for (int d = 0; d < nb_dirs; d++)
+		FindCloseChangeNotification(handles[d]);
+#elif defined(__linux__)
+	if (inotify_fd >= 0)
+		close(inotify_fd);
+	inotify_fd = -1;
+#endif
+	nb_dirs = 0;
+}
+
+void watchStart(){
+	if (watcher != NULL)
+		return;
+	stopping = false;
+	dirs_dirty = true;
+	watcher = new std::thread(watcherMain);
+}
+
+/* surveille 'path' ; un fichier deja surveille garde son emplacement */
+int watchFile(const char* path){
+	std::lock_guard<std::mutex> lk(lock);
+	int id = -1;
+	for (int i = 0; i < WATCH_MAX; i++){
+		if (entries[i].used && strcmp(entries[i].path, path) == 0)
+			return i;
+		if (!entries[i].used && id < 0)
+			id = i;
+	}
+	if (id < 0){
+		printf("trop de fichiers surveilles, %s ignore\n", path);
+		return -1;
+	}
+	WatchEntry* e = &entries[id];
+	memset(e, 0, sizeof(WatchEntry));
+	splitPath(e, path);
+	readStat(e);
+	e->used = true;
+	dirs_dirty = true;
+	return id;
+}
+
+void watchRetarget(int id, const char* path){
+	if (id < 0)
+		return;
+	std::lock_guard<std::mutex> lk(lock);
+	WatchEntry* e = &entries[id];
+	if (strcmp(e->path, path) == 0)
+		return;
+	splitPath(e, path);
+	readStat(e);
+	e->pending = false;
+	e->changed = false;
+	dirs_dirty = true;
+}
+
+bool watchChanged(int id){
+	if (id < 0)
+		return false;
+	std::lock_guard<std::mutex> lk(lock);
+	bool changed = entries[id].changed;
+	entries[id].changed = false;
+	return changed;
+}
+
+void watchStop(){
+	if (watcher == NULL)
+		return;
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		stopping = true;
+	}
+	watcher->join();
+	delete watcher;
+	watcher = NULL;
+	memset(entries, 0, sizeof(entries));
+}
@@ -0,0 +1,20 @@
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+/* Surveillance de fichiers pour le rechargement a chaud.
+Un thread attend les notifications du systeme sur les dossiers des fichiers
+surveilles (inotify sous Linux, FindFirstChangeNotification sous Windows) et
+compare date et taille de chaque fichier. Un changement n'est signale qu'une fois
+le fichier stable depuis WATCH_DEBOUNCE_MS, pour ne pas relire un export en cours. */
+
+#define WATCH_MAX 8
+#define WATCH_DEBOUNCE_MS 300.0
+#define WATCH_TIMEOUT_MS 100 // attente maximale entre deux verifications
+
+void watchStart();
+int watchFile(const char* path);                // -1 si plus de place
+void watchRetarget(int id, const char* path);   // change le fichier surveille par 'id'
+bool watchChanged(int id);                      // vrai une seule fois par changement
+void watchStop();
+
+#endif
@@ -0,0 +1,72 @@
+#include "frameArena.h"
+#include "fileMap.h"
+#include <stdio.h>
+#include <string.h>
+
+void arenaInit(FrameArena* arena, size_t size){
+	memset(arena, 0, sizeof(FrameArena));
+	arena->base = (char *)malloc(size);
+	if (arena->base != NULL)
+		arena->size = size;
+}
+
+/* Renvoie NULL si l'arene est pleine : l'appelant garde alors ses donnees de l'image
+precedente plutot que de retomber sur malloc au milieu de la boucle */
+void* arenaAlloc(FrameArena* arena, size_t size){
+	size_t start = (arena->used + FRAME_ARENA_ALIGN - 1) & ~(size_t)(FRAME_ARENA_ALIGN - 1);
+	if (start + size > arena->size){
+		if (arena->overflow_ctr++ == 0)
+			printf("arene d'image pleine (%u octets demandes, %u libres)\n",
+				(unsigned int)size, (unsigned int)(arena->size - arena->used));
+		return NULL;
+	}
+	arena->used = start + size;
+	if (arena->used > arena->high_water)
+		arena->high_water = arena->used;
+	return arena->base + start;
+}
+
+/* Contenu d'un petit fichier texte (au plus max_size octets), termine par un zero, et sa
+taille dans *size si size n'est pas NULL (fichier binaire). La place non utilisee est
+rendue a l'arene. NULL si illisible ou arene pleine. */
+char* arenaReadText(FrameArena* arena, const char* path, size_t max_size, size_t* size){
+	char* text = (char *)arenaAlloc(arena, max_size + 1);
+	if (text == NULL)
+		return NULL;
+	long lus = readFileInto(path, text, max_size);
+	if (lus < 0){
+		arena->used = (size_t)(text - arena->base);
+		return NULL;
+	}
+	text[lus] = '\0';
+	if (size != NULL)
+		*size = (size_t)lus;
+	arena->used = (size_t)(text - arena->base) + lus + 1;
+	return text;
+}
+
+/* Lit jusqu'a 'count' flottants separes par des blancs et avance *text d'autant ;
+renvoie le nombre lu. Remplace fscanf("%f") sans FILE ni allocation. */
+int parseFloats(const char** text, float* out, int count){
+	int lus = 0;
+	const char* p = *text;
+	while (lus < count){
+		char* end;
+		float v = strtof(p, &end);
+		if (end == p)
+			break;
+		out[lus++] = v;
+		p = end;
+	}
+	*text = p;
+	return lus;
+}
+
+void arenaReset(FrameArena* arena){
+	arena->used = 0;
+}
+
+void arenaFree(FrameArena* arena){
+	free(arena->base);
+	memset(arena, 0, sizeof(FrameArena));
+}
@@ -0,0 +1,28 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <stdlib.h>
+
+/* Memoire temporaire d'une image : un bloc alloue une fois, decoupe par increments
+et rendu en entier par arenaReset au debut de l'image suivante. Une arene par thread
+de la boucle (rendu, lecture Kinect) ; rien n'y survit d'une image a l'autre. */
+
+#define FRAME_ARENA_SIZE (256 * 1024)
+#define FRAME_ARENA_ALIGN 16
+
+struct FrameArena{
+	char* base;
+	size_t size;
+	size_t used;
+	size_t high_water; // plus forte occupation depuis arenaInit
+	int overflow_ctr;  // demandes refusees faute de place
+};
+
+void arenaInit(FrameArena* arena, size_t size);
+void* arenaAlloc(FrameArena* arena, size_t size);
+char* arenaReadText(FrameArena* arena, const char* path, size_t max_size, size_t* size);
+int parseFloats(const char** text, float* out, int count);
+void arenaReset(FrameArena* arena);
+void arenaFree(FrameArena* arena);
+
+#endif
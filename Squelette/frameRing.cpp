@@ -0,0 +1,254 @@
+#include "frameRing.h"
+#include "fileMap.h"
+#include "texture.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+
+static size_t pixelBytes(unsigned int format){
+	return format == GL_R16 ? 2 : 4;
+}
+
+static bool fileExists(const char* path){
+	FILE* fichier = fopen(path, "rb");
+	if (fichier == NULL)
+		return false;
+	fclose(fichier);
+	return true;
+}
+
+/* PGM binaire ("P5"), 16 bits gros-boutiens si maxval > 255 ; profondeur en mm, ligne du haut en premier */
+static unsigned char* decodePGM(const char* path, int* width, int* height){
+	size_t size = 0;
+	const unsigned char* view = (const unsigned char*)mapFile(path, &size);
+	if (view == NULL)
+		return NULL;
+	int values[3];
+	size_t p = 2;
+	bool ok = size > 2 && view[0] == 'P' && view[1] == '5';
+	for (int k = 0; k < 3 && ok; k++){
+		while (p < size && (view[p] == ' ' || view[p] == '\n' || view[p] == '\r' || view[p] == '\t' || view[p] == '#')){
+			if (view[p] == '#'){
+				while (p < size && view[p] != '\n')
+					p++;
+			}
+			else
+				p++;
+		}
+		values[k] = 0;
+		ok = p < size && view[p] >= '0' && view[p] <= '9';
+		while (p < size && view[p] >= '0' && view[p] <= '9')
+			values[k] = 10 * values[k] + (view[p++] - '0');
+	}
+	p++; // un seul blanc avant les pixels
+	size_t bpp = ok && values[2] > 255 ? 2 : 1;
+	ok = ok && values[0] > 0 && values[1] > 0 && p + (size_t)values[0] * values[1] * bpp <= size;
+	unsigned short* depth = NULL;
+	if (ok){
+		*width = values[0];
+		*height = values[1];
+		size_t n = (size_t)values[0] * values[1];
+		depth = (unsigned short*)malloc(n * sizeof(unsigned short));
+		for (size_t i = 0; i < n; i++)
+			depth[i] = bpp == 2 ? (unsigned short)(view[p + 2 * i] << 8 | view[p + 2 * i + 1]) : view[p + i];
+	}
+	unmapFile((void*)view, size);
+	return (unsigned char*)depth;
+}
+
+/* une image de la suite, ligne du haut en premier ; a liberer par free */
+static unsigned char* readFrame(const char* path, bool depth, int* width, int* height){
+	if (depth)
+		return decodePGM(path, width, height);
+	unsigned char* rgba = readImage(path, width, height);
+	if (rgba == NULL)
+		return NULL;
+	/* readImage donne la ligne du bas en premier */
+	size_t row_bytes = 4 * (size_t)*width;
+	unsigned char* row = (unsigned char*)malloc(row_bytes);
+	for (int y = 0; y < *height / 2; y++){
+		unsigned char* a = rgba + y * row_bytes;
+		unsigned char* b = rgba + (*height - 1 - y) * row_bytes;
+		memcpy(row, a, row_bytes);
+		memcpy(a, b, row_bytes);
+		memcpy(b, row, row_bytes);
+	}
+	free(row);
+	return rgba;
+}
+
+/* producteur de test : publie l'image suivante de la suite a chaque periode */
+static void sequenceMain(FrameRing* ring){
+	profThread(ring->depth ? "depth" : "colour");
+	RingHeader* h = (RingHeader*)ring->local;
+	unsigned char* slots = ring->local + RING_HEADER_SIZE;
+	int index = ring->first_index + 1; // la premiere image est publiee par ringOpen
+	double next = profNow();
+	while (!ring->stopping){
+		char path[300];
+		sprintf(path, ring->pattern, index);
+		if (!fileExists(path)){
+			index = ring->first_index;
+			sprintf(path, ring->pattern, index);
+		}
+		int width = 0;
+		int height = 0;
+		unsigned char* frame = readFrame(path, ring->depth, &width, &height);
+		if (frame != NULL && width == (int)h->width && height == (int)h->height){
+			unsigned int n = h->latest + 1;
+			memcpy(slots + (size_t)(n % h->slot_ctr) * ring->frame_bytes, frame, ring->frame_bytes);
+			std::atomic_thread_fence(std::memory_order_release);
+			h->latest = n;
+		}
+		free(frame);
+		index++;
+
+		next += 1.0 / RING_SEQUENCE_FPS;
+		double wait = next - profNow();
+		if (wait > 0.0)
+			std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1e6)));
+		else
+			next = profNow();
+	}
+}
+
+/* suite de fichiers : la premiere image fixe la taille, les suivantes de taille differente sont sautees */
+static bool openSequence(FrameRing* ring, const char* source){
+	if (strlen(source) >= sizeof(ring->pattern))
+		return false;
+	strcpy(ring->pattern, source);
+	char path[300];
+	ring->first_index = 0;
+	sprintf(path, ring->pattern, ring->first_index);
+	if (!fileExists(path)){
+		ring->first_index = 1;
+		sprintf(path, ring->pattern, ring->first_index);
+	}
+	int width = 0;
+	int height = 0;
+	unsigned char* frame = readFrame(path, ring->depth, &width, &height);
+	if (frame == NULL)
+		return false;
+
+	unsigned int format = ring->depth ? GL_R16 : GL_RGBA;
+	ring->frame_bytes = pixelBytes(format) * width * height;
+	ring->local = (unsigned char*)calloc(1, RING_HEADER_SIZE + RING_SEQUENCE_SLOTS * ring->frame_bytes);
+	RingHeader* h = (RingHeader*)ring->local;
+	h->magic = RING_MAGIC;
+	h->width = width;
+	h->height = height;
+	h->format = format;
+	h->slot_ctr = RING_SEQUENCE_SLOTS;
+	memcpy(ring->local + RING_HEADER_SIZE + ring->frame_bytes, frame, ring->frame_bytes);
+	free(frame);
+	h->latest = 1;
+
+	ring->header = h;
+	ring->frames = ring->local + RING_HEADER_SIZE;
+	ring->stopping = false;
+	ring->reader = new std::thread(sequenceMain, ring);
+	printf("%s : suite de fichiers %s, %ix%i a %.0f images/s\n", ring->depth ? "profondeur" : "couleur",
+		source, width, height, RING_SEQUENCE_FPS);
+	return true;
+}
+
+static bool openShared(FrameRing* ring, const char* source){
+	ring->shared = mapShared(source, &ring->shared_size);
+	if (ring->shared == NULL)
+		return false;
+	const RingHeader* h = (const RingHeader*)ring->shared;
+	bool valid = ring->shared_size >= RING_HEADER_SIZE
+		&& h->magic == RING_MAGIC
+		&& (ring->depth ? h->format == GL_R16 : (h->format == GL_BGRA || h->format == GL_RGBA))
+		&& h->width > 0 && h->height > 0 && h->slot_ctr >= 2;
+	ring->frame_bytes = valid ? pixelBytes(h->format) * h->width * h->height : 0;
+	if (!valid || RING_HEADER_SIZE + h->slot_ctr * ring->frame_bytes > ring->shared_size){
+		printf("%s n'est pas un anneau d'images %s valide\n", source, ring->depth ? "de profondeur" : "couleur");
+		unmapFile(ring->shared, ring->shared_size);
+		ring->shared = NULL;
+		return false;
+	}
+	ring->header = h;
+	ring->frames = (const unsigned char*)ring->shared + RING_HEADER_SIZE;
+	printf("%s : memoire partagee %s, %ux%u, %u emplacements\n", ring->depth ? "profondeur" : "couleur",
+		source, h->width, h->height, h->slot_ctr);
+	return true;
+}
+
+bool ringOpen(FrameRing* ring, const char* source, bool depth){
+	memset(ring, 0, sizeof(FrameRing));
+	ring->depth = depth;
+	if (strchr(source, '%') != NULL ? openSequence(ring, source) : openShared(ring, source))
+		return true;
+	printf("source %s illisible\n", source);
+	return false;
+}
+
+void ringClose(FrameRing* ring){
+	if (ring->reader != NULL){
+		ring->stopping = true;
+		ring->reader->join();
+		delete ring->reader;
+	}
+	free(ring->local);
+	unmapFile(ring->shared, ring->shared_size);
+	memset(ring, 0, sizeof(FrameRing));
+}
+
+void ringTextureCreate(RingTexture* tex, const FrameRing* ring){
+	memset(tex, 0, sizeof(RingTexture));
+	bool depth = ring->header->format == GL_R16;
+	GLint filter = depth ? GL_NEAREST : GL_LINEAR;
+	glGenTextures(1, &tex->texture);
+	glBindTexture(GL_TEXTURE_2D, tex->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, depth ? GL_R16 : GL_RGBA8, ring->header->width, ring->header->height, 0,
+		depth ? GL_RED : GL_RGBA, depth ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenBuffers(RING_PBOS, tex->pbos);
+}
+
+void ringTextureDestroy(RingTexture* tex){
+	glDeleteTextures(1, &tex->texture);
+	glDeleteBuffers(RING_PBOS, tex->pbos);
+	memset(tex, 0, sizeof(RingTexture));
+}
+
+/* La seule copie CPU va de l'anneau au PBO projete, rendu orphelin pour ne jamais attendre
+la fin de la copie precedente ; le GPU copie ensuite le PBO dans la texture. */
+bool ringTextureUpdate(RingTexture* tex, const FrameRing* ring){
+	const RingHeader* h = ring->header;
+	unsigned int latest = h->latest;
+	if (latest == 0 || latest == tex->shown)
+		return false;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const unsigned char* src = ring->frames + (size_t)(latest % h->slot_ctr) * ring->frame_bytes;
+
+	bool updated = false;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex->pbos[tex->pbo_next]);
+	tex->pbo_next = (tex->pbo_next + 1) % RING_PBOS;
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, ring->frame_bytes, NULL, GL_STREAM_DRAW);
+	void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ring->frame_bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (dst != NULL){
+		memcpy(dst, src, ring->frame_bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		/* le producteur a fait le tour de l'anneau pendant la copie : image dechiree, on garde la precedente */
+		if (h->latest - latest < h->slot_ctr - 1){
+			bool depth = h->format == GL_R16;
+			glBindTexture(GL_TEXTURE_2D, tex->texture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, depth ? 2 : 4);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, h->width, h->height, depth ? GL_RED : h->format,
+				depth ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, NULL);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			tex->shown = latest;
+			updated = true;
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return updated;
+}
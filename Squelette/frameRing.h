@@ -0,0 +1,70 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#include <stdlib.h>
+#include <thread>
+
+/* Anneau d'images d'un capteur (couleur ou profondeur), partage avec son producteur.
+La source est soit la memoire partagee ecrite par le producteur du flux (objet nomme sous
+Windows, fichier projete sinon), soit pour les essais une suite de fichiers numerotes
+("rep/image%04d.tga") relue en boucle par un thread qui joue le role du producteur :
+TGA ou BMP pour la couleur, PGM 16 bits (profondeur en mm) pour la profondeur.
+RingTexture en tire une texture de streaming : la derniere image complete est recopiee
+une seule fois, de l'anneau vers le PBO suivant, puis copiee par le GPU dans la texture. */
+
+#define RING_MAGIC 0x47424847   // "GHBG"
+#define RING_HEADER_SIZE 64     // les images commencent a cet octet de la memoire partagee
+#define RING_SEQUENCE_FPS 30.0  // cadence du lecteur de suite de fichiers
+#define RING_SEQUENCE_SLOTS 3
+#define RING_PBOS 3
+
+/* En-tete de la memoire partagee. L'image n occupe l'emplacement n % slot_ctr, lignes du
+haut en premier ; latest ne passe a n qu'une fois l'image n ecrite. */
+struct RingHeader{
+	unsigned int magic;
+	unsigned int width;
+	unsigned int height;
+	unsigned int format;          // GL_BGRA (capteur) ou GL_RGBA : 4 octets ; GL_R16 : profondeur en mm
+	unsigned int slot_ctr;        // au moins 2
+	volatile unsigned int latest; // derniere image complete, 0 : aucune
+};
+
+struct FrameRing{
+	const RingHeader* header;     // NULL : anneau ferme
+	const unsigned char* frames;
+	size_t frame_bytes;
+	void* shared;                 // vue de la memoire partagee
+	size_t shared_size;
+	unsigned char* local;         // anneau du lecteur de suite de fichiers
+	std::thread* reader;
+	volatile bool stopping;
+	bool depth;
+	char pattern[256];
+	int first_index;
+};
+
+/* texture alimentee par un anneau, propre au thread de rendu */
+struct RingTexture{
+	GLuint texture;
+	GLuint pbos[RING_PBOS];
+	int pbo_next;
+	unsigned int shown;           // image dans la texture, 0 : aucune
+};
+
+/* depth : anneau de profondeur GL_R16, sinon de couleur */
+bool ringOpen(FrameRing* ring, const char* source, bool depth);
+void ringClose(FrameRing* ring);
+
+/* contexte GL courant ; texture a la taille de l'anneau, filtrage lineaire en couleur,
+au plus proche en profondeur */
+void ringTextureCreate(RingTexture* tex, const FrameRing* ring);
+void ringTextureDestroy(RingTexture* tex);
+/* envoie la derniere image si elle est nouvelle ; true si la texture a change */
+bool ringTextureUpdate(RingTexture* tex, const FrameRing* ring);
+
+#endif
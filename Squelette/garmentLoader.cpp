@@ -0,0 +1,308 @@
+#include "garmentLoader.h"
+#include "profiler.h"
+#include "cloth.h"
+#include "cpuSkin.h"
+#include "morph.h"
+#include "poseLibrary.h"
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct LoadJob{
+	char file_name[256];
+	int seq;
+};
+
+struct LoadResult{
+	ModelData data;
+	TextureData tex;    // vide si pas de texture ou si elle est deja en cache
+	Cloth* cloth;       // construit ici aussi : soudure, aretes et coloration hors du thread de rendu
+	CpuSkin* skin;
+	MorphSet* morph;
+	PoseLibrary* poses;
+	char file_name[256];
+	int seq;
+	bool ok;
+};
+
+/* partage entre les threads, protege par 'lock' */
+static std::mutex lock;
+static std::condition_variable wake;
+static std::thread* workers = NULL;
+static int nb_workers = 0;
+static bool stopping = false;
+static LoadJob jobs[LOADER_QUEUE];
+static int job_head = 0;
+static int job_ctr = 0;
+static LoadResult results[LOADER_QUEUE];
+static int result_ctr = 0;
+static int request_seq = 0;
+static int working = 0;
+
+/* envoi en cours, propre au thread de rendu */
+static bool uploading = false;
+static LoadResult pending;
+static Garment staged;
+static GarmentStream streams[NB_GARMENT_BUFFERS];
+static int nb_streams = 0;
+static int stream_i = 0;
+static size_t stream_offset = 0;
+static int upload_frames = 0;
+static double upload_ms = 0.0;
+static TextureUpload tex_upload;
+static int installed_seq = 0;      // demande du vetement a l'ecran
+
+/* fait monter en memoire les pages du fichier cuit avant l'envoi GPU,
+pour que les defauts de page aient lieu ici et pas dans le thread de rendu */
+static void touchPages(const ModelData* data){
+	if (data->mapping == NULL)
+		return;
+	volatile unsigned char sum = 0;
+	const unsigned char* bytes = (const unsigned char*)data->mapping;
+	for (size_t i = 0; i < data->mapping_size; i += 4096)
+		sum += bytes[i];
+}
+
+static void freeResult(LoadResult* result){
+	freeModelData(&result->data);
+	freeTextureData(&result->tex);
+	clothDestroy(result->cloth);
+	result->cloth = NULL;
+	cpuSkinDestroy(result->skin);
+	result->skin = NULL;
+	morphDestroy(result->morph);
+	result->morph = NULL;
+	poseLibraryDestroy(result->poses);
+	result->poses = NULL;
+}
+
+static void workerMain(){
+	for (;;){
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			wake.wait(lk, []{ return stopping || job_ctr > 0; });
+			if (stopping)
+				return;
+			job = jobs[job_head];
+			job_head = (job_head + 1) % LOADER_QUEUE;
+			job_ctr--;
+			working++;
+		}
+
+		LoadResult result;
+		memset(&result, 0, sizeof(result));
+		strcpy(result.file_name, job.file_name);
+		result.seq = job.seq;
+		result.ok = importModel(job.file_name, &result.data);
+		if (result.ok){
+			touchPages(&result.data);
+			/* texture deja en cache : pas relue ; si elle en sort avant loaderUpdate, celui-ci la relit */
+			const char* texture = result.data.texture_file;
+			if (texture[0] != '\0' && !textureResident(texture) && !readTexture(texture, &result.tex))
+				printf("texture %s ignoree\n", texture);
+			result.cloth = clothCreate(&result.data);
+			result.skin = cpuSkinCreate(&result.data);
+			result.morph = morphCreate(&result.data);
+			result.poses = poseLibraryLoad(job.file_name, &result.data);
+		}
+
+		std::lock_guard<std::mutex> lk(lock);
+		working--;
+		if (result_ctr < LOADER_QUEUE)
+			results[result_ctr++] = result;
+		else
+			freeResult(&result);
+	}
+}
+
+void loaderStart(int nb_threads){
+	if (workers != NULL)
+		return;
+	stopping = false;
+	nb_workers = nb_threads;
+	workers = new std::thread[nb_workers];
+	for (int t = 0; t < nb_workers; t++)
+		workers[t] = std::thread(workerMain);
+}
+
+/* demande le chargement d'un vetement ; la demande la plus recente l'emporte */
+void loaderRequest(const char* file_name){
+	std::lock_guard<std::mutex> lk(lock);
+	if (job_ctr == LOADER_QUEUE){
+		printf("file de chargement pleine, %s ignore\n", file_name);
+		return;
+	}
+	LoadJob* job = &jobs[(job_head + job_ctr) % LOADER_QUEUE];
+	strncpy(job->file_name, file_name, sizeof(job->file_name) - 1);
+	job->file_name[sizeof(job->file_name) - 1] = '\0';
+	job->seq = ++request_seq;
+	job_ctr++;
+	wake.notify_one();
+}
+
+/* retire le resultat le plus recent au-dela de min_seq et libere ceux qu'il rend obsoletes,
+dont tous ceux de seq <= min_seq */
+static bool takeNewest(int min_seq, LoadResult* out){
+	LoadResult stale[LOADER_QUEUE];
+	int nb_stale = 0;
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		int best = -1;
+		for (int r = 0; r < result_ctr; r++){
+			if (results[r].seq > min_seq && (best < 0 || results[r].seq > results[best].seq))
+				best = r;
+		}
+		if (best >= 0){
+			*out = results[best];
+			found = true;
+		}
+		int threshold = found ? out->seq : min_seq + 1;
+		int kept = 0;
+		for (int r = 0; r < result_ctr; r++){
+			if (r == best)
+				continue;
+			if (results[r].seq < threshold)
+				stale[nb_stale++] = results[r];
+			else
+				results[kept++] = results[r];
+		}
+		result_ctr = kept;
+	}
+	for (int s = 0; s < nb_stale; s++)
+		freeResult(&stale[s]);
+	return found;
+}
+
+static void abortUpload(){
+	glDeleteBuffers(nb_streams, staged.buffers);
+	textureUploadAbort(&tex_upload);
+	freeResult(&pending);
+	uploading = false;
+}
+
+/* A appeler une fois par image depuis le thread de rendu (contexte courant).
+Renvoie true quand un nouveau vetement vient de remplacer 'current'. */
+bool loaderUpdate(Garment* current, double budget_ms){
+	double start = profNow();
+	double deadline = start + budget_ms / 1000.0;
+
+	/* un resultat plus recent rend l'envoi en cours inutile ; un thread lent ne remplace
+	jamais le vetement a l'ecran par une demande plus ancienne */
+	LoadResult next;
+	int floor_seq = uploading && pending.seq > installed_seq ? pending.seq : installed_seq;
+	if (takeNewest(floor_seq, &next)){
+		if (!next.ok){
+			printf("echec du chargement de %s\n", next.file_name);
+		}
+		else{
+			if (uploading)
+				abortUpload();
+			pending = next;
+			nb_streams = garmentStreams(&pending.data, streams);
+			memset(&staged, 0, sizeof(staged));
+			glGenBuffers(nb_streams, staged.buffers);
+			for (int s = 0; s < nb_streams; s++){
+				glBindBuffer(GL_COPY_WRITE_BUFFER, staged.buffers[s]);
+				glBufferData(GL_COPY_WRITE_BUFFER, streams[s].size, NULL, GL_STATIC_DRAW);
+			}
+			/* la texture part avec les buffers ; l'envoi prend possession des donnees */
+			if (pending.tex.level_ctr > 0)
+				textureUploadBegin(&tex_upload, &pending.tex);
+			memset(&pending.tex, 0, sizeof(pending.tex));
+			stream_i = 0;
+			stream_offset = 0;
+			upload_frames = 0;
+			upload_ms = 0.0;
+			uploading = true;
+		}
+	}
+	if (!uploading)
+		return false;
+
+	/* une tranche d'envoi, bornee par budget_ms */
+	upload_frames++;
+	while (stream_i < nb_streams){
+		const GarmentStream* st = &streams[stream_i];
+		size_t chunk = st->size - stream_offset;
+		if (chunk > LOADER_SLICE)
+			chunk = LOADER_SLICE;
+		if (chunk > 0){
+			glBindBuffer(GL_COPY_WRITE_BUFFER, staged.buffers[stream_i]);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, stream_offset, chunk, (const char*)st->src + stream_offset);
+			stream_offset += chunk;
+		}
+		if (stream_offset >= st->size){
+			stream_i++;
+			stream_offset = 0;
+		}
+		if (profNow() >= deadline)
+			break;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	bool tex_pending = tex_upload.active;
+	if (stream_i == nb_streams && tex_pending && profNow() < deadline)
+		tex_pending = !textureUploadStep(&tex_upload, deadline);
+	upload_ms += (profNow() - start) * 1000.0;
+	if (stream_i < nb_streams || tex_pending)
+		return false;
+
+	/* tout est envoye : on construit le VAO et on echange */
+	finishGarment(&staged, &pending.data, streams, nb_streams);
+	if (tex_upload.active)
+		staged.texture = textureUploadFinish(&tex_upload);
+	else if (pending.data.texture_file[0] != '\0'){
+		staged.texture = textureAcquire(pending.data.texture_file);
+		/* retiree du cache depuis que le thread de chargement l'y a vue : relue ici, en une fois */
+		if (staged.texture == 0){
+			staged.texture = uploadTexture(pending.data.texture_file);
+			printf("texture %s %s\n", pending.data.texture_file, staged.texture != 0 ? "retiree du cache, relue" : "ignoree");
+		}
+	}
+	staged.cloth = pending.cloth;
+	pending.cloth = NULL;
+	staged.skin = pending.skin;
+	pending.skin = NULL;
+	staged.morph = pending.morph;
+	pending.morph = NULL;
+	staged.poses = pending.poses;
+	pending.poses = NULL;
+	Garment old = *current;
+	*current = staged;
+	freeGarment(&old);
+	installed_seq = pending.seq;
+
+	printf("Vetement %s : lecture %.1f ms (thread de chargement), envoi GPU %.1f ms sur %i images\n",
+		pending.file_name, pending.data.parse_ms, upload_ms, upload_frames);
+	freeModelData(&pending.data);
+	uploading = false;
+	return true;
+}
+
+bool loaderBusy(){
+	std::lock_guard<std::mutex> lk(lock);
+	return uploading || job_ctr > 0 || working > 0 || result_ctr > 0;
+}
+
+void loaderStop(){
+	if (workers == NULL)
+		return;
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (int t = 0; t < nb_workers; t++)
+		workers[t].join();
+	delete[] workers;
+	workers = NULL;
+
+	if (uploading)
+		abortUpload();
+	for (int r = 0; r < result_ctr; r++)
+		freeResult(&results[r]);
+	result_ctr = 0;
+	job_ctr = 0;
+}
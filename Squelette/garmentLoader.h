@@ -0,0 +1,22 @@
+#ifndef GARMENTLOADER_H
+#define GARMENTLOADER_H
+
+#include "importer.h"
+
+/* Chargement des vetements en arriere-plan.
+Des threads de chargement font l'import (assimp ou fichier cuit) hors du thread
+de rendu ; celui-ci ne fait que l'envoi GPU, par tranches bornees en temps a
+chaque image, puis echange le vetement courant une fois tous les buffers remplis. */
+
+#define LOADER_THREADS 2
+#define LOADER_QUEUE 16
+#define LOADER_SLICE (256 * 1024) // octets par glBufferSubData
+#define LOADER_BUDGET_MS 2.0      // temps d'envoi GPU maximal par image
+
+void loaderStart(int nb_threads);
+void loaderRequest(const char* file_name);
+bool loaderUpdate(Garment* current, double budget_ms);
+bool loaderBusy();
+void loaderStop();
+
+#endif
@@ -0,0 +1,480 @@
+#include "golden.h"
+#include "session.h"
+#include "importer.h"
+#include "matrixCalc.h"
+#include "shaderCache.h"
+#include "fileMap.h"
+#include "frameArena.h"
+#include "texture.h"
+#include "printScreen.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <atomic>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDir(path) mkdir(path, 0755)
+#endif
+
+extern int nb_bones;
+
+#define GOLDEN_MAX_SEQUENCES 32
+#define GOLDEN_MAX_JOBS 4096
+
+/* un enregistrement du manifeste */
+struct GoldenSequence{
+	char name[128];         // "<poses>_<vetement>", sans repertoires ni extensions
+	char poses_file[256];
+	char garment_file[256];
+	char rest_file[256];
+	int frame_ctr;
+	float* poses;           // 6 flottants par os et par image, dans l'ordre de readData
+	glm::vec3* rest;        // 2 par os
+	int garment_i;
+};
+
+/* un vetement, charge une fois dans le contexte principal ; ses buffers et sa texture
+sont partages, chaque thread cree son propre VAO */
+struct GoldenGarment{
+	char file[256];
+	ModelData data;
+	Garment garment;
+};
+
+enum GoldenStatus{ GOLDEN_PASS, GOLDEN_FAIL, GOLDEN_MISSING, GOLDEN_UPDATED };
+static const char* status_names[] = { "ok", "ECHEC", "reference absente", "reference ecrite" };
+
+struct GoldenJob{
+	int sequence;
+	int frame;
+	int status;
+	int bad;                // pixels hors tolerance
+	int max_dist;
+};
+
+struct GoldenWorker{
+	GLFWwindow* window;
+	GLuint program;
+	std::thread* thread;
+};
+
+static GoldenSequence sequences[GOLDEN_MAX_SEQUENCES];
+static int sequence_ctr = 0;
+static GoldenGarment garments[GOLDEN_MAX_SEQUENCES];
+static int garment_ctr = 0;
+static GoldenJob jobs[GOLDEN_MAX_JOBS];
+static int job_ctr = 0;
+static std::atomic<int> next_job(0);
+static const char* golden_dir = GOLDEN_DIR;
+static GoldenMode golden_mode = GOLDEN_COMPARE;
+
+static void baseName(const char* path, char* out, size_t out_size){
+	const char* start = path;
+	for (const char* c = path; *c != '\0'; c++){
+		if (*c == '/' || *c == '\\')
+			start = c + 1;
+	}
+	size_t n = strlen(start);
+	const char* dot = strrchr(start, '.');
+	if (dot != NULL)
+		n = dot - start;
+	if (n >= out_size)
+		n = out_size - 1;
+	memcpy(out, start, n);
+	out[n] = '\0';
+}
+
+/* une ligne par enregistrement : "<poses> <vetement.dae> <positions de repos>" */
+static bool readManifest(const char* dir){
+	char path[512];
+	sprintf(path, "%.480s/manifest.txt", dir);
+	FILE* manifest = fopen(path, "r");
+	if (manifest == NULL){
+		printf("%s introuvable\n", path);
+		return false;
+	}
+	FrameArena arena;
+	arenaInit(&arena, FRAME_ARENA_SIZE);
+	glm::vec3** Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
+	for (int b = 0; b < nb_bones; b++)
+		Bones[b] = (glm::vec3 *)calloc(4, sizeof(glm::vec3));
+
+	char line[1024];
+	bool ok = true;
+	while (fgets(line, sizeof(line), manifest) != NULL && sequence_ctr < GOLDEN_MAX_SEQUENCES){
+		GoldenSequence* seq = &sequences[sequence_ctr];
+		memset(seq, 0, sizeof(GoldenSequence));
+		if (line[0] == '#' || sscanf(line, "%255s %255s %255s", seq->poses_file, seq->garment_file, seq->rest_file) != 3)
+			continue;
+		char poses_name[64];
+		char garment_name[64];
+		baseName(seq->poses_file, poses_name, sizeof(poses_name));
+		baseName(seq->garment_file, garment_name, sizeof(garment_name));
+		sprintf(seq->name, "%s_%s", poses_name, garment_name);
+		seq->frame_ctr = readRecording(seq->poses_file, &seq->poses);
+		arenaReset(&arena);
+		if (seq->frame_ctr == 0 || !loadRestPose(Bones, seq->rest_file, &arena)){
+			printf("%s : enregistrement ou positions de repos illisibles\n", seq->name);
+			free(seq->poses);
+			ok = false;
+			continue;
+		}
+		seq->rest = (glm::vec3 *)malloc(2 * nb_bones * sizeof(glm::vec3));
+		for (int b = 0; b < nb_bones; b++){
+			seq->rest[2 * b] = Bones[b][0];
+			seq->rest[2 * b + 1] = Bones[b][1];
+		}
+
+		seq->garment_i = -1;
+		for (int g = 0; g < garment_ctr; g++){
+			if (strcmp(garments[g].file, seq->garment_file) == 0)
+				seq->garment_i = g;
+		}
+		if (seq->garment_i < 0){
+			seq->garment_i = garment_ctr++;
+			memset(&garments[seq->garment_i], 0, sizeof(GoldenGarment));
+			strcpy(garments[seq->garment_i].file, seq->garment_file);
+		}
+		for (int f = 0; f < seq->frame_ctr && job_ctr < GOLDEN_MAX_JOBS; f++){
+			GoldenJob* job = &jobs[job_ctr++];
+			memset(job, 0, sizeof(GoldenJob));
+			job->sequence = sequence_ctr;
+			job->frame = f;
+		}
+		sequence_ctr++;
+	}
+	fclose(manifest);
+	for (int b = 0; b < nb_bones; b++)
+		free(Bones[b]);
+	free(Bones);
+	arenaFree(&arena);
+	return ok;
+}
+
+static void imagePath(char* out, const char* sub, const GoldenJob* job, const char* suffix){
+	sprintf(out, "%.200s/%s/%.127s_%03i%s", golden_dir, sub, sequences[job->sequence].name, job->frame, suffix);
+}
+
+/* glReadPixels donne la ligne du bas en premier, les fichiers la ligne du haut */
+static void writeImage(const char* path, const unsigned char* rgba, unsigned char* scratch, bool png){
+	int row = 4 * GOLDEN_WIDTH;
+	for (int y = 0; y < GOLDEN_HEIGHT; y++)
+		memcpy(scratch + row * (GOLDEN_HEIGHT - 1 - y), rgba + row * y, row);
+	if (png)
+		stbi_write_png(path, GOLDEN_WIDTH, GOLDEN_HEIGHT, 4, scratch, row);
+	else
+		stbi_write_tga(path, GOLDEN_WIDTH, GOLDEN_HEIGHT, 4, scratch);
+}
+
+/* distance "redmean", approximation peu couteuse de l'ecart percu entre deux couleurs */
+static int colorDistance(const unsigned char* a, const unsigned char* b){
+	int r_mean = (a[0] + b[0]) / 2;
+	int dr = a[0] - b[0];
+	int dg = a[1] - b[1];
+	int db = a[2] - b[2];
+	return (int)sqrt((double)((((512 + r_mean) * dr * dr) >> 8) + 4 * dg * dg + (((767 - r_mean) * db * db) >> 8)));
+}
+
+/* Un pixel est en faute si aucun pixel de la reference dans son voisinage 3x3 n'est
+assez proche : les decalages d'un pixel du rasteriseur sur les bords ne comptent pas.
+'diff' recoit la reference attenuee, les pixels en faute en rouge. */
+static int compareImages(const unsigned char* out, const unsigned char* ref, unsigned char* diff, int* max_dist){
+	int bad = 0;
+	*max_dist = 0;
+	for (int y = 0; y < GOLDEN_HEIGHT; y++){
+		for (int x = 0; x < GOLDEN_WIDTH; x++){
+			const unsigned char* o = out + 4 * (y * GOLDEN_WIDTH + x);
+			int best = colorDistance(o, ref + 4 * (y * GOLDEN_WIDTH + x));
+			for (int dy = -1; dy <= 1 && best > GOLDEN_TOLERANCE; dy++){
+				for (int dx = -1; dx <= 1 && best > GOLDEN_TOLERANCE; dx++){
+					int nx = x + dx;
+					int ny = y + dy;
+					if (nx < 0 || ny < 0 || nx >= GOLDEN_WIDTH || ny >= GOLDEN_HEIGHT)
+						continue;
+					int d = colorDistance(o, ref + 4 * (ny * GOLDEN_WIDTH + nx));
+					if (d < best)
+						best = d;
+				}
+			}
+			if (best > *max_dist)
+				*max_dist = best;
+			unsigned char* d = diff + 4 * (y * GOLDEN_WIDTH + x);
+			const unsigned char* r = ref + 4 * (y * GOLDEN_WIDTH + x);
+			if (best > GOLDEN_TOLERANCE){
+				bad++;
+				d[0] = 255;
+				d[1] = 0;
+				d[2] = 0;
+			}
+			else{
+				unsigned char grey = (unsigned char)(192 + (r[0] + r[1] + r[2]) / 12);
+				d[0] = grey;
+				d[1] = grey;
+				d[2] = grey;
+			}
+			d[3] = 255;
+		}
+	}
+	return bad;
+}
+
+static void workerMain(GoldenWorker* w){
+	glfwMakeContextCurrent(w->window);
+
+	/* les VAO ne sont pas partages entre contextes */
+	Garment local[GOLDEN_MAX_SEQUENCES];
+	for (int g = 0; g < garment_ctr; g++){
+		GarmentStream streams[NB_GARMENT_BUFFERS];
+		int nb_streams = garmentStreams(&garments[g].data, streams);
+		local[g] = garments[g].garment;
+		finishGarment(&local[g], &garments[g].data, streams, nb_streams);
+	}
+
+	GLuint fbo, color, depth;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	glUseProgram(w->program);
+	GLint palette_loc = glGetUniformLocation(w->program, "bone_matrices[0]");
+	GLint uni_textured = glGetUniformLocation(w->program, "textured");
+	glm::mat4 view = defaultView();
+	glm::mat4 proj = glm::perspective(45.0f, (float)GOLDEN_WIDTH / (float)GOLDEN_HEIGHT, 0.1f, 100.0f);
+	glm::mat4 model = defaultModel();
+	glUniformMatrix4fv(glGetUniformLocation(w->program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(w->program, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+	glUniformMatrix4fv(glGetUniformLocation(w->program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniform1f(glGetUniformLocation(w->program, "scale"), 1.0f);
+	glUniform1i(glGetUniformLocation(w->program, "garment_tex"), 0);
+
+	glm::vec3** Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
+	for (int b = 0; b < nb_bones; b++)
+		Bones[b] = (glm::vec3 *)calloc(4, sizeof(glm::vec3));
+	glm::mat4* bone_matrices = (glm::mat4 *)malloc(nb_bones * sizeof(glm::mat4));
+	size_t image_size = 4 * GOLDEN_WIDTH * GOLDEN_HEIGHT;
+	unsigned char* pixels = (unsigned char *)malloc(image_size);
+	unsigned char* diff = (unsigned char *)malloc(image_size);
+	unsigned char* scratch = (unsigned char *)malloc(image_size);
+
+	for (;;){
+		int j = next_job++;
+		if (j >= job_ctr)
+			break;
+		GoldenJob* job = &jobs[j];
+		const GoldenSequence* seq = &sequences[job->sequence];
+
+		/* chaque image repart du repos initial : meme resultat qu'une lecture dans l'ordre */
+		const float* pose = seq->poses + job->frame * 6 * nb_bones;
+		for (int b = 0; b < nb_bones; b++){
+			Bones[b][0] = seq->rest[2 * b];
+			Bones[b][1] = seq->rest[2 * b + 1];
+			Bones[b][2] = glm::vec3(pose[6 * b], pose[6 * b + 1], pose[6 * b + 2]);
+			Bones[b][3] = glm::vec3(pose[6 * b + 3], pose[6 * b + 4], pose[6 * b + 5]);
+		}
+		updateData(Bones, bone_matrices);
+
+		glViewport(0, 0, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_DEPTH_TEST);
+		const Garment* garment = &local[seq->garment_i];
+		glUniform1i(uni_textured, garment->texture != 0);
+		drawGarment(garment, bone_matrices, nb_bones, &w->program, &palette_loc, 1, 1);
+		glReadPixels(0, 0, GOLDEN_WIDTH, GOLDEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+		char path[512];
+		imagePath(path, "ref", job, ".tga");
+		if (golden_mode == GOLDEN_UPDATE){
+			writeImage(path, pixels, scratch, false);
+			job->status = GOLDEN_UPDATED;
+			continue;
+		}
+		int width = 0;
+		int height = 0;
+		unsigned char* ref = readImage(path, &width, &height);
+		if (ref == NULL || width != GOLDEN_WIDTH || height != GOLDEN_HEIGHT){
+			free(ref);
+			if (golden_mode == GOLDEN_BOOTSTRAP){
+				imagePath(path, "ref", job, ".tga");
+				writeImage(path, pixels, scratch, false);
+				job->status = GOLDEN_UPDATED;
+				continue;
+			}
+			job->status = GOLDEN_MISSING;
+			imagePath(path, "report", job, "_out.png");
+			writeImage(path, pixels, scratch, true);
+			continue;
+		}
+		job->bad = compareImages(pixels, ref, diff, &job->max_dist);
+		job->status = job->bad > GOLDEN_MAX_BAD * GOLDEN_WIDTH * GOLDEN_HEIGHT ? GOLDEN_FAIL : GOLDEN_PASS;
+		if (job->status == GOLDEN_FAIL){
+			imagePath(path, "report", job, "_out.png");
+			writeImage(path, pixels, scratch, true);
+			imagePath(path, "report", job, "_ref.png");
+			writeImage(path, ref, scratch, true);
+			imagePath(path, "report", job, "_diff.png");
+			writeImage(path, diff, scratch, true);
+		}
+		free(ref);
+	}
+
+	for (int b = 0; b < nb_bones; b++)
+		free(Bones[b]);
+	free(Bones);
+	free(bone_matrices);
+	free(pixels);
+	free(diff);
+	free(scratch);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &color);
+	glDeleteRenderbuffers(1, &depth);
+	for (int g = 0; g < garment_ctr; g++){
+		glDeleteVertexArrays(1, &local[g].vao);
+		free(local[g].partitions);
+		free(local[g].palette_bones);
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+static void writeReport(const char* dir, double ms){
+	char path[512];
+	sprintf(path, "%.480s/report/index.html", dir);
+	FILE* out = fopen(path, "w");
+	if (out == NULL)
+		return;
+	int counts[4] = { 0, 0, 0, 0 };
+	for (int j = 0; j < job_ctr; j++)
+		counts[jobs[j].status]++;
+	fprintf(out, "<html><head><meta charset=\"utf-8\"><title>Images de reference</title></head><body>\n");
+	fprintf(out, "<h1>%i images : %i ok, %i en echec, %i sans reference</h1>\n<p>%.0f ms, tolerance %i, %.2f%% de pixels</p>\n",
+		job_ctr, counts[GOLDEN_PASS], counts[GOLDEN_FAIL], counts[GOLDEN_MISSING], ms, GOLDEN_TOLERANCE, GOLDEN_MAX_BAD * 100.0);
+	fprintf(out, "<table border=\"1\" cellpadding=\"4\">\n<tr><th>image</th><th>etat</th><th>pixels en faute</th><th>ecart max</th><th>rendu</th><th>reference</th><th>ecarts</th></tr>\n");
+	for (int j = 0; j < job_ctr; j++){
+		const GoldenJob* job = &jobs[j];
+		if (job->status == GOLDEN_PASS || job->status == GOLDEN_UPDATED)
+			continue;
+		const char* name = sequences[job->sequence].name;
+		fprintf(out, "<tr><td>%s %i</td><td>%s</td><td>%i</td><td>%i</td>", name, job->frame, status_names[job->status], job->bad, job->max_dist);
+		fprintf(out, "<td><img src=\"%s_%03i_out.png\"></td>", name, job->frame);
+		if (job->status == GOLDEN_FAIL)
+			fprintf(out, "<td><img src=\"%s_%03i_ref.png\"></td><td><img src=\"%s_%03i_diff.png\"></td>", name, job->frame, name, job->frame);
+		else
+			fprintf(out, "<td></td><td></td>");
+		fprintf(out, "</tr>\n");
+	}
+	fprintf(out, "</table>\n</body></html>\n");
+	fclose(out);
+}
+
+int goldenRun(const char* dir, GoldenMode mode, int nb_workers){
+	golden_dir = dir;
+	golden_mode = mode;
+	if (nb_workers < 1)
+		nb_workers = 1;
+	if (nb_workers > GOLDEN_MAX_WORKERS)
+		nb_workers = GOLDEN_MAX_WORKERS;
+	if (!readManifest(dir) || job_ctr == 0)
+		return 1;
+
+	char path[512];
+	sprintf(path, "%.480s/ref", dir);
+	makeDir(path);
+	sprintf(path, "%.480s/report", dir);
+	makeDir(path);
+
+	/* contexte principal cache : il charge les vetements, partages avec les contextes des threads */
+	glfwInit();
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = initGLFW(GOLDEN_WIDTH, GOLDEN_HEIGHT, "golden");
+	if (window == NULL){
+		printf("contexte GL indisponible\n");
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	initGLEW();
+	double start = profNow();
+
+	int failed = 0;
+	for (int g = 0; g < garment_ctr; g++){
+		GoldenGarment* gg = &garments[g];
+		if (!importModel(gg->file, &gg->data)){
+			failed++;
+			continue;
+		}
+		uploadModel(&gg->data, &gg->garment);
+		if (gg->data.texture_file[0] != '\0')
+			gg->garment.texture = uploadTexture(gg->data.texture_file);
+	}
+	if (failed > 0){
+		glfwTerminate();
+		return 1;
+	}
+
+	/* un programme par thread : les uniforms appartiennent au programme, partage entre contextes */
+	GoldenWorker workers[GOLDEN_MAX_WORKERS];
+	for (int w = 0; w < nb_workers; w++){
+		workers[w].program = createProgram(vertexSource, fragmentSource);
+		workers[w].window = glfwCreateWindow(16, 16, "golden", NULL, window);
+	}
+	glFinish();
+	glfwMakeContextCurrent(NULL);
+
+	next_job = 0;
+	for (int w = 0; w < nb_workers; w++)
+		workers[w].thread = new std::thread(workerMain, &workers[w]);
+	for (int w = 0; w < nb_workers; w++){
+		workers[w].thread->join();
+		delete workers[w].thread;
+	}
+	double ms = (profNow() - start) * 1000.0;
+
+	glfwMakeContextCurrent(window);
+	for (int w = 0; w < nb_workers; w++){
+		glDeleteProgram(workers[w].program);
+		glfwDestroyWindow(workers[w].window);
+	}
+	for (int g = 0; g < garment_ctr; g++){
+		freeGarment(&garments[g].garment);
+		freeModelData(&garments[g].data);
+	}
+	textureShutdown();
+	glfwTerminate();
+
+	int counts[4] = { 0, 0, 0, 0 };
+	for (int j = 0; j < job_ctr; j++){
+		const GoldenJob* job = &jobs[j];
+		counts[job->status]++;
+		if (job->status == GOLDEN_FAIL || job->status == GOLDEN_MISSING)
+			printf("%s image %i : %s (%i pixels, ecart max %i)\n", sequences[job->sequence].name, job->frame,
+				status_names[job->status], job->bad, job->max_dist);
+	}
+	for (int s = 0; s < sequence_ctr; s++){
+		free(sequences[s].poses);
+		free(sequences[s].rest);
+	}
+	if (mode == GOLDEN_UPDATE){
+		printf("%i references ecrites dans %s/ref en %.0f ms (%i threads)\n", counts[GOLDEN_UPDATED], dir, ms, nb_workers);
+		return 0;
+	}
+	writeReport(dir, ms);
+	printf("%i images en %.0f ms (%i threads) : %i ok, %i en echec, %i sans reference ; rapport dans %s/report\n",
+		job_ctr, ms, nb_workers, counts[GOLDEN_PASS], counts[GOLDEN_FAIL], counts[GOLDEN_MISSING], dir);
+	if (counts[GOLDEN_UPDATED] > 0)
+		printf("%i references absentes ecrites dans %s/ref\n", counts[GOLDEN_UPDATED], dir);
+	if (counts[GOLDEN_MISSING] > 0)
+		printf("references absentes : Squelette --golden-bootstrap %s les ecrit sur la machine de reference\n", dir);
+	return counts[GOLDEN_FAIL] + counts[GOLDEN_MISSING];
+}
@@ -0,0 +1,32 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+/* Non-regression par images de reference.
+GOLDEN_DIR/manifest.txt liste des enregistrements de poses Kinect (fichiers de positions
+mis bout a bout, 2 lignes par os et par image, comme skelcoordinates.txt ou un
+enregistrement fait avec Squelette --record), chacun avec son vetement et ses positions
+de repos. Chaque image est rendue hors ecran et comparee a
+GOLDEN_DIR/ref/<poses>_<vetement>_<image>.tga.
+Les images sont independantes (scaleData ne depend que de la pose courante et du
+repos initial) : elles sont reparties sur un pool de threads, un contexte GL partage
+par thread. Les ecarts sont decrits dans GOLDEN_DIR/report/index.html.
+Les references dependent du GPU et du pilote : elles ne sont pas dans le depot, qui ne
+porte que le manifeste et les poses. Sur la machine de reference, un premier passage
+Squelette --golden-bootstrap GOLDEN_DIR ecrit les references absentes et compare les
+autres ; --golden compte ensuite toute reference absente comme un echec. */
+
+#define GOLDEN_DIR "golden"
+#define GOLDEN_WIDTH 256
+#define GOLDEN_HEIGHT 192
+#define GOLDEN_WORKERS 4
+#define GOLDEN_MAX_WORKERS 8
+#define GOLDEN_TOLERANCE 24    // ecart de couleur tolere par pixel (distance "redmean", 0..765)
+#define GOLDEN_MAX_BAD 0.002   // fraction de pixels hors tolerance acceptee par image
+
+/* GOLDEN_UPDATE reecrit toutes les references, GOLDEN_BOOTSTRAP seulement les absentes */
+enum GoldenMode{ GOLDEN_COMPARE, GOLDEN_UPDATE, GOLDEN_BOOTSTRAP };
+
+/* renvoie le nombre d'images en echec (0 : tout passe) */
+int goldenRun(const char* dir, GoldenMode mode, int nb_workers);
+
+#endif
@@ -1,4 +1,75 @@
 #include "importer.h"
+#include "fileMap.h"
+#include "profiler.h"
+#include "cloth.h"
+#include "cpuSkin.h"
+#include "morph.h"
+#include "poseLibrary.h"
+#include "matrixCalc.h"
+#include "skinWeights.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+/* Format cuit : en-tete puis flux alignes sur 16 octets, dans l'ordre de l'enum.
+Toute modification de la disposition doit incrementer COOKED_VERSION (importer.h). */
+#define COOKED_MAGIC 0x4b434847 // "GHCK"
+
+enum {
+	STREAM_POINTS,
+	STREAM_NORMALS,
+	STREAM_TEXCOORDS,
+	STREAM_BONE_IDS,
+	STREAM_WEIGHTS,
+	STREAM_INDICES,
+	STREAM_BONE_NAMES,
+	STREAM_OFFSET_MATS,
+	STREAM_NODES,
+	STREAM_PARTITIONS,
+	STREAM_PALETTE,
+	STREAM_CLUSTERS,
+	STREAM_MORPHS,
+	STREAM_MORPH_DELTAS,
+	NB_STREAMS
+};
+
+#define HAS_NORMALS 1
+#define HAS_TEXCOORDS 2
+#define HAS_BONES 4
+#define HAS_AUTO_WEIGHTS 8    // poids calcules sur le squelette de repos
+#define HAS_FORCED_WEIGHTS 16 // ... a la place de poids peints (--weights auto)
+#define HAS_NO_WEIGHTS 32     // poids automatiques impossibles sur ce repos
+
+/* compteurs qui determinent la taille des flux */
+struct ModelCounts{
+	int point_ctr;
+	int index_ctr;
+	int bone_ctr;
+	int node_ctr;
+	int partition_ctr;
+	int palette_ctr;
+	int cluster_ctr;
+	int morph_ctr;
+	int delta_ctr;
+};
+
+struct CookedHeader{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long source_hash; // hash du .dae d'origine
+	unsigned long long weights_hash; // hash de REST_FILE si HAS_AUTO_WEIGHTS ou HAS_NO_WEIGHTS
+	ModelCounts counts;
+	int influence_ctr[MAX_INFLUENCES];
+	unsigned int flags;
+	char texture_file[256];
+	unsigned int offsets[NB_STREAMS]; // depuis le debut du fichier, 0 si absent
+	unsigned int sizes[NB_STREAMS];
+	unsigned int file_size;
+};
+
+extern int nb_bones;
+
+static bool force_auto_weights = false;
 
 glm::mat4 convertAIMatrix(const aiMatrix4x4 &matrix)
 {
@@ -11,11 +82,171 @@ glm::mat4 convertAIMatrix(const aiMatrix4x4 &matrix)
 	return result;
 }
 
-bool loadModel(const char* file_name, 
-	GLuint* vao, int* point_ctr, 
-	glm::mat4* bone_offset_mats, 
-	int* bone_ctr){
+static ModelCounts modelCounts(const ModelData* data){
+	ModelCounts counts;
+	counts.point_ctr = data->point_ctr;
+	counts.index_ctr = data->index_ctr;
+	counts.bone_ctr = data->bone_ctr;
+	counts.node_ctr = data->node_ctr;
+	counts.partition_ctr = data->partition_ctr;
+	counts.palette_ctr = data->palette_ctr;
+	counts.cluster_ctr = data->cluster_ctr;
+	counts.morph_ctr = data->morph_ctr;
+	counts.delta_ctr = data->delta_ctr;
+	return counts;
+}
+
+static void applyCounts(ModelData* data, const ModelCounts* counts){
+	data->point_ctr = counts->point_ctr;
+	data->index_ctr = counts->index_ctr;
+	data->bone_ctr = counts->bone_ctr;
+	data->node_ctr = counts->node_ctr;
+	data->partition_ctr = counts->partition_ctr;
+	data->palette_ctr = counts->palette_ctr;
+	data->cluster_ctr = counts->cluster_ctr;
+	data->morph_ctr = counts->morph_ctr;
+	data->delta_ctr = counts->delta_ctr;
+}
+
+/* calcule la taille et la position de chaque flux a partir de 'base' */
+static size_t layoutStreams(const ModelCounts* counts, unsigned int flags,
+	size_t base, unsigned int* offsets, unsigned int* sizes){
+	int point_ctr = counts->point_ctr;
+	sizes[STREAM_POINTS] = 3 * point_ctr * sizeof(GLfloat);
+	sizes[STREAM_NORMALS] = (flags & HAS_NORMALS) ? 3 * point_ctr * sizeof(GLfloat) : 0;
+	sizes[STREAM_TEXCOORDS] = (flags & HAS_TEXCOORDS) ? 2 * point_ctr * sizeof(GLfloat) : 0;
+	sizes[STREAM_BONE_IDS] = (flags & HAS_BONES) ? 4 * point_ctr * sizeof(GLint) : 0;
+	sizes[STREAM_WEIGHTS] = (flags & HAS_BONES) ? 4 * point_ctr * sizeof(GLfloat) : 0;
+	sizes[STREAM_INDICES] = counts->index_ctr * sizeof(GLuint);
+	sizes[STREAM_BONE_NAMES] = counts->bone_ctr * MAX_BONE_NAME;
+	sizes[STREAM_OFFSET_MATS] = counts->bone_ctr * sizeof(glm::mat4);
+	sizes[STREAM_NODES] = counts->node_ctr * sizeof(ModelNode);
+	sizes[STREAM_PARTITIONS] = counts->partition_ctr * sizeof(ModelPartition);
+	sizes[STREAM_PALETTE] = counts->palette_ctr * sizeof(GLint);
+	sizes[STREAM_CLUSTERS] = counts->cluster_ctr * sizeof(ModelCluster);
+	sizes[STREAM_MORPHS] = counts->morph_ctr * sizeof(ModelMorph);
+	sizes[STREAM_MORPH_DELTAS] = counts->delta_ctr * sizeof(MorphDelta);
+
+	size_t offset = base;
+	for (int s = 0; s < NB_STREAMS; s++){
+		offset = (offset + 15) & ~(size_t)15;
+		offsets[s] = sizes[s] ? (unsigned int)offset : 0;
+		offset += sizes[s];
+	}
+	return offset;
+}
+
+static void bindStreams(ModelData* data, char* base, const unsigned int* offsets){
+	data->points = offsets[STREAM_POINTS] ? (GLfloat*)(base + offsets[STREAM_POINTS]) : NULL;
+	data->normals = offsets[STREAM_NORMALS] ? (GLfloat*)(base + offsets[STREAM_NORMALS]) : NULL;
+	data->texcoords = offsets[STREAM_TEXCOORDS] ? (GLfloat*)(base + offsets[STREAM_TEXCOORDS]) : NULL;
+	data->bone_ids = offsets[STREAM_BONE_IDS] ? (GLint*)(base + offsets[STREAM_BONE_IDS]) : NULL;
+	data->weights = offsets[STREAM_WEIGHTS] ? (GLfloat*)(base + offsets[STREAM_WEIGHTS]) : NULL;
+	data->indices = offsets[STREAM_INDICES] ? (GLuint*)(base + offsets[STREAM_INDICES]) : NULL;
+	data->bone_names = offsets[STREAM_BONE_NAMES] ? (char(*)[MAX_BONE_NAME])(base + offsets[STREAM_BONE_NAMES]) : NULL;
+	data->bone_offset_mats = offsets[STREAM_OFFSET_MATS] ? (glm::mat4*)(base + offsets[STREAM_OFFSET_MATS]) : NULL;
+	data->nodes = offsets[STREAM_NODES] ? (ModelNode*)(base + offsets[STREAM_NODES]) : NULL;
+	data->partitions = offsets[STREAM_PARTITIONS] ? (ModelPartition*)(base + offsets[STREAM_PARTITIONS]) : NULL;
+	data->palette_bones = offsets[STREAM_PALETTE] ? (GLint*)(base + offsets[STREAM_PALETTE]) : NULL;
+	data->clusters = offsets[STREAM_CLUSTERS] ? (ModelCluster*)(base + offsets[STREAM_CLUSTERS]) : NULL;
+	data->morphs = offsets[STREAM_MORPHS] ? (ModelMorph*)(base + offsets[STREAM_MORPHS]) : NULL;
+	data->deltas = offsets[STREAM_MORPH_DELTAS] ? (MorphDelta*)(base + offsets[STREAM_MORPH_DELTAS]) : NULL;
+}
+
+static const void* streamData(const ModelData* data, int s){
+	switch (s){
+	case STREAM_POINTS: return data->points;
+	case STREAM_NORMALS: return data->normals;
+	case STREAM_TEXCOORDS: return data->texcoords;
+	case STREAM_BONE_IDS: return data->bone_ids;
+	case STREAM_WEIGHTS: return data->weights;
+	case STREAM_INDICES: return data->indices;
+	case STREAM_BONE_NAMES: return data->bone_names;
+	case STREAM_OFFSET_MATS: return data->bone_offset_mats;
+	case STREAM_NODES: return data->nodes;
+	case STREAM_PARTITIONS: return data->partitions;
+	case STREAM_PALETTE: return data->palette_bones;
+	case STREAM_CLUSTERS: return data->clusters;
+	case STREAM_MORPHS: return data->morphs;
+	case STREAM_MORPH_DELTAS: return data->deltas;
+	}
+	return NULL;
+}
+
+static unsigned int modelFlags(const ModelData* data){
+	unsigned int flags = 0;
+	if (data->normals != NULL)
+		flags |= HAS_NORMALS;
+	if (data->texcoords != NULL)
+		flags |= HAS_TEXCOORDS;
+	if (data->bone_ids != NULL)
+		flags |= HAS_BONES;
+	return flags;
+}
+
+static int countNodes(const aiNode* node){
+	int n = 1;
+	for (unsigned int c = 0; c < node->mNumChildren; c++)
+		n += countNodes(node->mChildren[c]);
+	return n;
+}
 
+/* aplatit la hierarchie en profondeur d'abord */
+static void flattenNodes(const aiNode* node, int parent, ModelNode* nodes, int* node_ctr){
+	int index = (*node_ctr)++;
+	strncpy(nodes[index].name, node->mName.data, MAX_BONE_NAME - 1);
+	nodes[index].name[MAX_BONE_NAME - 1] = '\0';
+	nodes[index].parent = parent;
+	nodes[index].transform = convertAIMatrix(node->mTransformation);
+	for (unsigned int c = 0; c < node->mNumChildren; c++)
+		flattenNodes(node->mChildren[c], index, nodes, node_ctr);
+}
+
+/* alloue un seul bloc pour tous les flux ; offsets[s] == 0 signifiant "absent",
+le premier flux commence a 16 */
+static void allocStreams(ModelData* data, const ModelCounts* counts, unsigned int flags){
+	unsigned int offsets[NB_STREAMS];
+	unsigned int sizes[NB_STREAMS];
+	size_t total = layoutStreams(counts, flags, 16, offsets, sizes);
+	data->block = malloc(total);
+	bindStreams(data, (char*)data->block, offsets);
+	applyCounts(data, counts);
+}
+
+/* chemin de la texture a cote du modele ; les textures integrees ("*0") ne sont pas gerees */
+static void resolveTexture(const char* model_file, const char* texture, char* out, size_t out_size){
+	out[0] = '\0';
+	if (strncmp(texture, "file://", 7) == 0)
+		texture += 7;
+	if (texture[0] == '\0' || texture[0] == '*')
+		return;
+	bool absolute = texture[0] == '/' || texture[0] == '\\' || (texture[0] != '\0' && texture[1] == ':');
+	const char* slash = strrchr(model_file, '/');
+	const char* backslash = strrchr(model_file, '\\');
+	if (backslash != NULL && (slash == NULL || backslash > slash))
+		slash = backslash;
+	size_t dir_len = (absolute || slash == NULL) ? 0 : (size_t)(slash - model_file + 1);
+	if (dir_len + strlen(texture) + 1 > out_size)
+		return;
+	memcpy(out, model_file, dir_len);
+	strcpy(out + dir_len, texture);
+}
+
+/* le sommet i de la cible s'ecarte-t-il du maillage de base ? */
+static bool morphTouches(const aiMesh* mesh, const aiAnimMesh* anim, int i){
+	const aiVector3D& a = anim->mVertices[i];
+	const aiVector3D& b = mesh->mVertices[i];
+	if (fabsf(a.x - b.x) > MORPH_EPSILON || fabsf(a.y - b.y) > MORPH_EPSILON || fabsf(a.z - b.z) > MORPH_EPSILON)
+		return true;
+	if (!mesh->HasNormals() || !anim->HasNormals())
+		return false;
+	const aiVector3D& n = anim->mNormals[i];
+	const aiVector3D& o = mesh->mNormals[i];
+	return fabsf(n.x - o.x) > MORPH_EPSILON || fabsf(n.y - o.y) > MORPH_EPSILON || fabsf(n.z - o.z) > MORPH_EPSILON;
+}
+
+/* import du .dae par assimp, tous les flux dans un seul bloc */
+static bool importAssimp(const char* file_name, ModelData* data){
 	const aiScene* scene = aiImportFile(file_name, aiProcess_Triangulate);
 	if (!scene){
 		fprintf(stderr, "ERROR reading the model %s\n", file_name);
@@ -32,149 +263,926 @@ bool loadModel(const char* file_name,
 	printf("  %i textures\n", scene->mNumTextures);
 
 	/* get first mesh in file only */
+	if (scene->mNumMeshes == 0 || !scene->mMeshes[0]->HasPositions()){
+		printf("%s : pas de maillage avec des positions, vetement ignore\n", file_name);
+		aiReleaseImport(scene);
+		return false;
+	}
 	const aiMesh* mesh = scene->mMeshes[0];
 	printf("  %i vertices in model[0]\n\n", mesh->mNumVertices);
 
-	/* pass back number of vertex points in mesh */
-	*point_ctr = mesh->mNumVertices;
+	int point_ctr = mesh->mNumVertices;
+	int index_ctr = 0;
+	for (unsigned int f = 0; f < mesh->mNumFaces; f++){
+		if (mesh->mFaces[f].mNumIndices == 3)
+			index_ctr += 3;
+	}
+	int bone_ctr = mesh->HasBones() ? (int)mesh->mNumBones : 0;
+	int node_ctr = scene->mRootNode ? countNodes(scene->mRootNode) : 0;
+	unsigned int flags = 0;
+	if (mesh->HasNormals())
+		flags |= HAS_NORMALS;
+	if (mesh->HasTextureCoords(0))
+		flags |= HAS_TEXCOORDS;
+	if (mesh->HasBones())
+		flags |= HAS_BONES;
 
-	/* generate a VAO, using the pass-by-reference parameter that we give to the
-	function */
-	glGenVertexArrays(1, vao);
-	glBindVertexArray(*vao);
+	/* cibles de morph : seuls les sommets qui s'ecartent du maillage de base sont gardes */
+	int morph_ctr = 0;
+	int delta_ctr = 0;
+	for (unsigned int m = 0; m < mesh->mNumAnimMeshes; m++){
+		const aiAnimMesh* anim = mesh->mAnimMeshes[m];
+		if (!anim->HasPositions() || (int)anim->mNumVertices != point_ctr)
+			continue;
+		morph_ctr++;
+		for (int i = 0; i < point_ctr; i++){
+			if (morphTouches(mesh, anim, i))
+				delta_ctr++;
+		}
+	}
 
-	GLfloat* points = NULL; // array of vertex points
-	GLfloat* normals = NULL; // array of vertex normals
-	GLfloat* texcoords = NULL; // array of texture coordinates
-	GLint* bone_ids = NULL; // array of bone ids
-	GLfloat* weights = NULL; // array of weights
+	ModelCounts counts;
+	memset(&counts, 0, sizeof(counts));
+	counts.point_ctr = point_ctr;
+	counts.index_ctr = index_ctr;
+	counts.bone_ctr = bone_ctr;
+	counts.node_ctr = node_ctr;
+	counts.morph_ctr = morph_ctr;
+	counts.delta_ctr = delta_ctr;
+	allocStreams(data, &counts, flags);
+	data->node_ctr = 0;
 
 	if (mesh->HasPositions()) {
-		points = (GLfloat*)malloc(*point_ctr * 3 * sizeof(GLfloat));
-		for (int i = 0; i < *point_ctr; i++) {
+		for (int i = 0; i < point_ctr; i++) {
 			const aiVector3D* vp = &(mesh->mVertices[i]);
-			points[i * 3] = (GLfloat)vp->x;
-			points[i * 3 + 1] = (GLfloat)vp->y;
-			points[i * 3 + 2] = (GLfloat)vp->z;
+			data->points[i * 3] = (GLfloat)vp->x;
+			data->points[i * 3 + 1] = (GLfloat)vp->y;
+			data->points[i * 3 + 2] = (GLfloat)vp->z;
 		}
 	}
 	if (mesh->HasNormals()) {
-		normals = (GLfloat*)malloc(*point_ctr * 3 * sizeof(GLfloat));
-		for (int i = 0; i < *point_ctr; i++) {
+		for (int i = 0; i < point_ctr; i++) {
 			const aiVector3D* vn = &(mesh->mNormals[i]);
-			normals[i * 3] = (GLfloat)vn->x;
-			normals[i * 3 + 1] = (GLfloat)vn->y;
-			normals[i * 3 + 2] = (GLfloat)vn->z;
+			data->normals[i * 3] = (GLfloat)vn->x;
+			data->normals[i * 3 + 1] = (GLfloat)vn->y;
+			data->normals[i * 3 + 2] = (GLfloat)vn->z;
 		}
 	}
 	if (mesh->HasTextureCoords(0)) {
-		texcoords = (GLfloat*)malloc(*point_ctr * 2 * sizeof(GLfloat));
-		for (int i = 0; i < *point_ctr; i++) {
+		for (int i = 0; i < point_ctr; i++) {
 			const aiVector3D* vt = &(mesh->mTextureCoords[0][i]);
-			texcoords[i * 2] = (GLfloat)vt->x;
-			texcoords[i * 2 + 1] = (GLfloat)vt->y;
+			data->texcoords[i * 2] = (GLfloat)vt->x;
+			data->texcoords[i * 2 + 1] = (GLfloat)vt->y;
 		}
 	}
 
-	/* Array qui va compter le nombre de bones li  chaque vertex */
-	int* vertexBoneCtr = (int*)malloc(*point_ctr * sizeof(int));
-	int vs;
-	for (vs = 0; vs < *point_ctr; vs++){
-		vertexBoneCtr[vs] = 0;
+	/* texture diffuse du materiau, chemin relatif au .dae */
+	aiString texture_path;
+	if (mesh->mMaterialIndex < scene->mNumMaterials
+		&& aiGetMaterialTexture(scene->mMaterials[mesh->mMaterialIndex], aiTextureType_DIFFUSE, 0, &texture_path) == aiReturn_SUCCESS)
+		resolveTexture(file_name, texture_path.data, data->texture_file, sizeof(data->texture_file));
+
+	int k = 0;
+	for (unsigned int f = 0; f < mesh->mNumFaces; f++){
+		const aiFace* face = &(mesh->mFaces[f]);
+		if (face->mNumIndices != 3)
+			continue;
+		data->indices[k++] = face->mIndices[0];
+		data->indices[k++] = face->mIndices[1];
+		data->indices[k++] = face->mIndices[2];
 	}
 
 	/* extract bone weights */
 	if (mesh->HasBones()){
-		*bone_ctr = (int)mesh->mNumBones;
-		bone_ids = (GLint*)malloc(4* (*point_ctr)  * sizeof(GLint*));
-		weights = (GLfloat*)malloc(4 * (*point_ctr) * sizeof(GLfloat));
+		GLint* bone_ids = data->bone_ids;
+		GLfloat* weights = data->weights;
+
+		/* Array qui va compter le nombre de bones li  chaque vertex */
+		int* vertexBoneCtr = (int*)calloc(point_ctr, sizeof(int));
 
-		/* an array of bones names, max 256 bones, max name length 64 */
-		char bone_names[256][64];
 		printf("Bone informations : \n");
-		for (int b_i = 0; b_i < *bone_ctr; b_i++){ //pour tous les bones
+		for (int b_i = 0; b_i < bone_ctr; b_i++){ //pour tous les bones
 			const aiBone* bone = mesh->mBones[b_i]; //rcupre un bone
-			strcpy(bone_names[b_i], bone->mName.data); //on copie son nom dans bone_names
-			printf("bone_names[%i] = %s\n", b_i, bone_names[b_i]); //affiche son nom
-			bone_offset_mats[b_i] = convertAIMatrix(bone->mOffsetMatrix); //rcupre la matrice de transformation initiale
+			strncpy(data->bone_names[b_i], bone->mName.data, MAX_BONE_NAME - 1); //on copie son nom dans bone_names
+			data->bone_names[b_i][MAX_BONE_NAME - 1] = '\0';
+			printf("bone_names[%i] = %s\n", b_i, data->bone_names[b_i]); //affiche son nom
+			data->bone_offset_mats[b_i] = convertAIMatrix(bone->mOffsetMatrix); //rcupre la matrice de transformation initiale
 
 			/* get weights */
 			int num_weights = (int)bone->mNumWeights; //nombre de poids du bone considr
 			for (int w_i = 0; w_i < num_weights; w_i++){ // pour chaque poids du bone
 				aiVertexWeight weight = bone->mWeights[w_i]; //rcupre le poids w_i
 				int vertex_id = (int)weight.mVertexId; // le poids weight est li  un vertex => vertex_id
-				bone_ids[4*vertex_id + vertexBoneCtr[vertex_id]] = (GLint)b_i; // le vertex vertex_id est influenc par le bone b_i
-				weights[4*vertex_id + vertexBoneCtr[vertex_id]] = (GLfloat)weight.mWeight;
+				/* au-dela de 4 influences, la plus faible des 4 places est remplacee */
+				int slot = vertexBoneCtr[vertex_id];
+				if (slot >= 4){
+					slot = 0;
+					for (int s = 1; s < 4; s++){
+						if (weights[4*vertex_id + s] < weights[4*vertex_id + slot])
+							slot = s;
+					}
+					if (weights[4*vertex_id + slot] >= (GLfloat)weight.mWeight)
+						slot = -1;
+				}
+				if (slot >= 0){
+					bone_ids[4*vertex_id + slot] = (GLint)b_i; // le vertex vertex_id est influenc par le bone b_i
+					weights[4*vertex_id + slot] = (GLfloat)weight.mWeight;
+				}
 				vertexBoneCtr[vertex_id]++;
 			}
 		}
-	}
 
-	int jk;
-	for (jk = 0; jk < *point_ctr; jk++){
-		if (vertexBoneCtr[jk] != 4){
+		int jk;
+		int overflow_ctr = 0;
+		for (jk = 0; jk < point_ctr; jk++){
 			int mq = vertexBoneCtr[jk];
 			while (mq < 4){
 				bone_ids[4*jk+mq] = (GLint)0;
 				weights[4*jk+mq] = (GLfloat)0.0;
 				mq++;
 			}
+			/* influences tronquees : les 4 gardees sont renormalisees */
+			if (vertexBoneCtr[jk] > 4){
+				float sum = weights[4*jk] + weights[4*jk+1] + weights[4*jk+2] + weights[4*jk+3];
+				for (mq = 0; mq < 4 && sum > 0.0f; mq++)
+					weights[4*jk+mq] /= sum;
+				overflow_ctr++;
+			}
 		}
-		int sum = bone_ids[4*jk+0] + bone_ids[4*jk+1] + bone_ids[4*jk+2] + bone_ids[4*jk+3];
-		float sumW = weights[4*jk+0] + weights[4*jk+1] + weights[4*jk+2] + weights[4*jk+3];
-		if ((sumW < 0.999f) || (sum < 0)){
-			//printf("erreur : %d\n\t sum : %d ; sumW : %f\n", jk, sum, sumW);
-		}	
+		if (overflow_ctr > 0)
+			printf("%i sommets avec plus de 4 influences : les 4 plus fortes sont gardees\n", overflow_ctr);
+		free(vertexBoneCtr);
 	}
 
-	/* copy mesh data into VBOs */
-	if (mesh->HasPositions()) {
-		GLuint vbo;
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, 3 * *point_ctr * sizeof(GLfloat), points, GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		glEnableVertexAttribArray(0);
-		free(points);
+	int d = 0;
+	int t = 0;
+	for (unsigned int m = 0; m < mesh->mNumAnimMeshes; m++){
+		const aiAnimMesh* anim = mesh->mAnimMeshes[m];
+		if (!anim->HasPositions() || (int)anim->mNumVertices != point_ctr)
+			continue;
+		ModelMorph* morph = &data->morphs[t++];
+		strncpy(morph->name, anim->mName.data, MAX_BONE_NAME - 1);
+		morph->name[MAX_BONE_NAME - 1] = '\0';
+		morph->delta_start = d;
+		for (int i = 0; i < point_ctr; i++){
+			if (!morphTouches(mesh, anim, i))
+				continue;
+			MorphDelta* delta = &data->deltas[d++];
+			memset(delta, 0, sizeof(MorphDelta));
+			delta->vertex = i;
+			delta->dp[0] = anim->mVertices[i].x - mesh->mVertices[i].x;
+			delta->dp[1] = anim->mVertices[i].y - mesh->mVertices[i].y;
+			delta->dp[2] = anim->mVertices[i].z - mesh->mVertices[i].z;
+			if (mesh->HasNormals() && anim->HasNormals()){
+				delta->dn[0] = anim->mNormals[i].x - mesh->mNormals[i].x;
+				delta->dn[1] = anim->mNormals[i].y - mesh->mNormals[i].y;
+				delta->dn[2] = anim->mNormals[i].z - mesh->mNormals[i].z;
+			}
+		}
+		morph->delta_ctr = d - morph->delta_start;
+		printf("cible de morph %s : %i sommets touches sur %i\n", morph->name, morph->delta_ctr, point_ctr);
 	}
-	if (mesh->HasNormals()) {
-		GLuint vbo;
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, 3 * *point_ctr * sizeof(GLfloat), normals, GL_STATIC_DRAW);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		glEnableVertexAttribArray(1);
-		free(normals);
+
+	if (scene->mRootNode)
+		flattenNodes(scene->mRootNode, -1, data->nodes, &data->node_ctr);
+
+	aiReleaseImport(scene);
+	return true;
+}
+
+/* Poids automatiques sur le squelette de repos (REST_FILE) : un os par segment, les bones
+globaux etant les os Kinect. Les flux sont realloues avec des bones s'il n'y en avait pas ;
+des poids peints sont remplaces. */
+static bool autoWeights(ModelData* data){
+	glm::vec3* segments = (glm::vec3*)malloc(2 * nb_bones * sizeof(glm::vec3));
+	FILE* fichier = fopen(REST_FILE, "r");
+	int lus = 0;
+	if (fichier != NULL){
+		for (int i = 0; i < 2 * nb_bones; i++)
+			lus += fscanf(fichier, "%f %f %f", &segments[i].x, &segments[i].y, &segments[i].z);
+		fclose(fichier);
 	}
-	if (mesh->HasTextureCoords(0)) {
-		GLuint vbo;
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, 2 * *point_ctr * sizeof(GLfloat), texcoords, GL_STATIC_DRAW);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-		glEnableVertexAttribArray(2);
-		free(texcoords);
+	if (lus != 6 * nb_bones){
+		printf("%s illisible : pas de poids automatiques\n", REST_FILE);
+		free(segments);
+		return false;
+	}
+
+	ModelData old = *data;
+	ModelCounts counts = modelCounts(&old);
+	counts.bone_ctr = nb_bones;
+	allocStreams(data, &counts, modelFlags(&old) | HAS_BONES);
+	memcpy(data->points, old.points, 3 * old.point_ctr * sizeof(GLfloat));
+	if (old.normals != NULL)
+		memcpy(data->normals, old.normals, 3 * old.point_ctr * sizeof(GLfloat));
+	if (old.texcoords != NULL)
+		memcpy(data->texcoords, old.texcoords, 2 * old.point_ctr * sizeof(GLfloat));
+	memcpy(data->indices, old.indices, old.index_ctr * sizeof(GLuint));
+	memcpy(data->nodes, old.nodes, old.node_ctr * sizeof(ModelNode));
+	memcpy(data->morphs, old.morphs, old.morph_ctr * sizeof(ModelMorph));
+	memcpy(data->deltas, old.deltas, old.delta_ctr * sizeof(MorphDelta));
+	for (int b = 0; b < nb_bones; b++){
+		if (b < old.bone_ctr){
+			strcpy(data->bone_names[b], old.bone_names[b]);
+			data->bone_offset_mats[b] = old.bone_offset_mats[b];
+		}
+		else{
+			sprintf(data->bone_names[b], "kinect%i", b);
+			data->bone_offset_mats[b] = glm::mat4(1.0f);
+		}
+	}
+	free(old.block);
+
+	bool ok = solveSkinWeights(data->points, data->point_ctr, data->indices, data->index_ctr,
+		segments, nb_bones, data->bone_ids, data->weights);
+	free(segments);
+	return ok;
+}
+
+/* Les sommets viennent d'etre dupliques ou permutes : le nouveau sommet n est une copie
+de l'ancien origin[n]. Les deltas des cibles de morph suivent leurs sommets, un par
+copie, et restent ranges par sommet dans chaque cible. */
+static void followMorphs(ModelData* data, const int* origin, int old_point_ctr){
+	if (data->delta_ctr == 0)
+		return;
+	int point_ctr = data->point_ctr;
+	int* first = (int*)calloc(old_point_ctr + 1, sizeof(int)); // copies de v : copies[first[v] .. first[v + 1])
+	int* copies = (int*)malloc(point_ctr * sizeof(int));
+	int* next = (int*)malloc(old_point_ctr * sizeof(int));
+	for (int n = 0; n < point_ctr; n++)
+		first[origin[n] + 1]++;
+	for (int v = 0; v < old_point_ctr; v++)
+		first[v + 1] += first[v];
+	memcpy(next, first, old_point_ctr * sizeof(int));
+	for (int n = 0; n < point_ctr; n++)
+		copies[next[origin[n]]++] = n;
+
+	int delta_ctr = 0;
+	for (int d = 0; d < data->delta_ctr; d++)
+		delta_ctr += first[data->deltas[d].vertex + 1] - first[data->deltas[d].vertex];
+	MorphDelta* deltas = (MorphDelta*)malloc((delta_ctr > 0 ? delta_ctr : 1) * sizeof(MorphDelta));
+	int k = 0;
+	for (int m = 0; m < data->morph_ctr; m++){
+		ModelMorph* morph = &data->morphs[m];
+		int start = k;
+		for (int d = morph->delta_start; d < morph->delta_start + morph->delta_ctr; d++){
+			int v = data->deltas[d].vertex;
+			for (int j = first[v]; j < first[v + 1]; j++){
+				deltas[k] = data->deltas[d];
+				deltas[k].vertex = copies[j];
+				k++;
+			}
+		}
+		std::sort(deltas + start, deltas + k, [](const MorphDelta& a, const MorphDelta& b){
+			return a.vertex < b.vertex;
+		});
+		morph->delta_start = start;
+		morph->delta_ctr = k - start;
+	}
+
+	/* sommets dupliques ou ecartes : le flux des deltas change de taille */
+	if (delta_ctr != data->delta_ctr){
+		ModelData old = *data;
+		ModelCounts counts = modelCounts(&old);
+		counts.delta_ctr = delta_ctr;
+		unsigned int offsets[NB_STREAMS];
+		unsigned int sizes[NB_STREAMS];
+		layoutStreams(&counts, modelFlags(&old), 16, offsets, sizes);
+		allocStreams(data, &counts, modelFlags(&old));
+		for (int s = 0; s < NB_STREAMS; s++){
+			if (sizes[s] > 0 && s != STREAM_MORPH_DELTAS)
+				memcpy((void*)streamData(data, s), streamData(&old, s), sizes[s]);
+		}
+		free(old.block);
+	}
+	memcpy(data->deltas, deltas, delta_ctr * sizeof(MorphDelta));
+	free(deltas);
+	free(first);
+	free(copies);
+	free(next);
+}
+
+/* Decoupe le maillage en partitions referencant chacune au plus palette_size bones.
+Les triangles sont pris dans l'ordre (voisins dans le fichier, donc souvent dans
+l'espace) et une partition est fermee des qu'un triangle ferait deborder sa palette.
+Les sommets partages par plusieurs partitions sont dupliques, et leurs bone_ids
+reecrits en indices locaux. */
+static void partitionModel(ModelData* data, int palette_size){
+	int tri_ctr = data->index_ctr / 3;
+	int bone_ctr = data->bone_ctr;
+
+	/* cas courant : tout tient dans une palette, rien a reecrire */
+	if (data->bone_ids == NULL || bone_ctr <= palette_size){
+		ModelData old = *data;
+		ModelCounts counts = modelCounts(&old);
+		counts.partition_ctr = 1;
+		counts.palette_ctr = bone_ctr;
+		unsigned int offsets[NB_STREAMS];
+		unsigned int sizes[NB_STREAMS];
+		layoutStreams(&counts, modelFlags(&old), 16, offsets, sizes);
+		allocStreams(data, &counts, modelFlags(&old));
+		for (int s = 0; s < NB_STREAMS; s++){
+			if (sizes[s] > 0 && s != STREAM_PARTITIONS && s != STREAM_PALETTE)
+				memcpy((void*)streamData(data, s), streamData(&old, s), sizes[s]);
+		}
+		data->partitions[0].index_start = 0;
+		data->partitions[0].index_ctr = data->index_ctr;
+		data->partitions[0].bone_start = 0;
+		data->partitions[0].bone_ctr = bone_ctr;
+		for (int b = 0; b < bone_ctr; b++)
+			data->palette_bones[b] = b;
+		free(old.block);
+		return;
+	}
+
+	/* 1) affectation gloutonne des triangles */
+	int* tri_part = (int*)malloc(tri_ctr * sizeof(int));
+	int* local_of = (int*)malloc(bone_ctr * sizeof(int)); // indice local du bone dans la partition courante
+	int* palette = (int*)malloc((tri_ctr + 1) * palette_size * sizeof(int));
+	int* part_bone_start = (int*)malloc((tri_ctr + 1) * sizeof(int));
+	for (int b = 0; b < bone_ctr; b++)
+		local_of[b] = -1;
+	int part_ctr = 0;
+	int palette_ctr = 0;
+	int set_ctr = 0;
+	part_bone_start[0] = 0;
+	for (int t = 0; t < tri_ctr; t++){
+		int tri_bones[12];
+		int new_ctr = 0;
+		for (int c = 0; c < 3; c++){
+			int v = data->indices[3 * t + c];
+			for (int k = 0; k < 4; k++){
+				if (data->weights[4 * v + k] <= 0.0f)
+					continue;
+				int b = data->bone_ids[4 * v + k];
+				bool seen = local_of[b] >= 0;
+				for (int n = 0; n < new_ctr && !seen; n++)
+					seen = tri_bones[n] == b;
+				if (!seen)
+					tri_bones[new_ctr++] = b;
+			}
+		}
+		if (set_ctr + new_ctr > palette_size){
+			/* on ferme la partition courante */
+			for (int j = 0; j < set_ctr; j++)
+				local_of[palette[part_bone_start[part_ctr] + j]] = -1;
+			palette_ctr += set_ctr;
+			part_ctr++;
+			part_bone_start[part_ctr] = palette_ctr;
+			set_ctr = 0;
+			/* les bones du triangle sont tous nouveaux dans la partition suivante */
+			new_ctr = 0;
+			for (int c = 0; c < 3; c++){
+				int v = data->indices[3 * t + c];
+				for (int k = 0; k < 4; k++){
+					int b = data->bone_ids[4 * v + k];
+					if (data->weights[4 * v + k] <= 0.0f || local_of[b] >= 0)
+						continue;
+					local_of[b] = set_ctr;
+					palette[palette_ctr + set_ctr++] = b;
+				}
+			}
+		}
+		else{
+			for (int n = 0; n < new_ctr; n++){
+				local_of[tri_bones[n]] = set_ctr;
+				palette[palette_ctr + set_ctr++] = tri_bones[n];
+			}
+		}
+		tri_part[t] = part_ctr;
+	}
+	palette_ctr += set_ctr;
+	part_ctr++;
+
+	/* 2) nombre de sommets apres duplication */
+	int* stamp = (int*)malloc(data->point_ctr * sizeof(int));
+	int* remap = (int*)malloc(data->point_ctr * sizeof(int));
+	for (int v = 0; v < data->point_ctr; v++)
+		stamp[v] = -1;
+	int new_point_ctr = 0;
+	for (int t = 0; t < tri_ctr; t++){
+		for (int c = 0; c < 3; c++){
+			int v = data->indices[3 * t + c];
+			if (stamp[v] != tri_part[t]){
+				stamp[v] = tri_part[t];
+				new_point_ctr++;
+			}
+		}
+	}
+
+	/* 3) reconstruction des flux */
+	ModelData old = *data;
+	ModelCounts counts = modelCounts(&old);
+	counts.point_ctr = new_point_ctr;
+	counts.partition_ctr = part_ctr;
+	counts.palette_ctr = palette_ctr;
+	allocStreams(data, &counts, modelFlags(&old));
+	memcpy(data->bone_names, old.bone_names, old.bone_ctr * MAX_BONE_NAME);
+	memcpy(data->bone_offset_mats, old.bone_offset_mats, old.bone_ctr * sizeof(glm::mat4));
+	memcpy(data->nodes, old.nodes, old.node_ctr * sizeof(ModelNode));
+	memcpy(data->palette_bones, palette, palette_ctr * sizeof(GLint));
+	memcpy(data->morphs, old.morphs, old.morph_ctr * sizeof(ModelMorph));
+	memcpy(data->deltas, old.deltas, old.delta_ctr * sizeof(MorphDelta));
+	int* origin = (int*)malloc(new_point_ctr * sizeof(int));
+
+	for (int v = 0; v < old.point_ctr; v++)
+		stamp[v] = -1;
+	int next_point = 0;
+	for (int p = 0; p < part_ctr; p++){
+		ModelPartition* part = &data->partitions[p];
+		part->bone_start = part_bone_start[p];
+		part->bone_ctr = (p + 1 < part_ctr ? part_bone_start[p + 1] : palette_ctr) - part->bone_start;
+		part->index_start = -1;
+		for (int j = 0; j < part->bone_ctr; j++)
+			local_of[palette[part->bone_start + j]] = j;
+
+		for (int t = 0; t < tri_ctr; t++){
+			if (tri_part[t] != p)
+				continue;
+			if (part->index_start < 0)
+				part->index_start = 3 * t;
+			for (int c = 0; c < 3; c++){
+				int v = old.indices[3 * t + c];
+				if (stamp[v] != p){
+					int n = next_point++;
+					stamp[v] = p;
+					remap[v] = n;
+					origin[n] = v;
+					memcpy(&data->points[3 * n], &old.points[3 * v], 3 * sizeof(GLfloat));
+					if (old.normals != NULL)
+						memcpy(&data->normals[3 * n], &old.normals[3 * v], 3 * sizeof(GLfloat));
+					if (old.texcoords != NULL)
+						memcpy(&data->texcoords[2 * n], &old.texcoords[2 * v], 2 * sizeof(GLfloat));
+					for (int k = 0; k < 4; k++){
+						float w = old.weights[4 * v + k];
+						data->weights[4 * n + k] = w;
+						data->bone_ids[4 * n + k] = w > 0.0f ? local_of[old.bone_ids[4 * v + k]] : 0;
+					}
+				}
+				data->indices[3 * t + c] = remap[v];
+			}
+		}
+		if (part->index_start < 0)
+			part->index_start = 0;
+		part->index_ctr = 3 * tri_ctr - part->index_start;
+		for (int j = 0; j < part->bone_ctr; j++)
+			local_of[palette[part->bone_start + j]] = -1;
+	}
+	/* les partitions sont des plages contigues de triangles */
+	for (int p = 0; p + 1 < part_ctr; p++)
+		data->partitions[p].index_ctr = data->partitions[p + 1].index_start - data->partitions[p].index_start;
+
+	printf("%i bones repartis en %i partitions de %i bones au plus (%i -> %i sommets)\n",
+		bone_ctr, part_ctr, palette_size, old.point_ctr, new_point_ctr);
+
+	free(old.block);
+	followMorphs(data, origin, old.point_ctr);
+	free(origin);
+	free(tri_part);
+	free(local_of);
+	free(palette);
+	free(part_bone_start);
+	free(stamp);
+	free(remap);
+}
+
+/* Range les influences de chaque sommet par poids decroissant, puis les sommets par
+nombre d'influences et, a nombre egal, par ensemble de bones globaux : les sommets
+partageant le meme ensemble forment un groupe contigu (ModelCluster), qui n'est a
+reskinner sur CPU que si l'un de ses bones a bouge (cpuSkin.h). Dans chaque partition,
+les triangles sont ensuite ranges par nombre d'influences de leur sommet le plus
+influence. Les tris sont stables : l'ordre d'origine est garde dans chaque groupe.
+Chaque groupe de triangles est dessine avec la variante du vertex shader qui ne lit
+que ses influences, et chaque groupe de sommets skinne sur CPU par le noyau
+correspondant (skinKernels.h). Un sommet sans poids compte pour une influence. */
+static void bucketInfluences(ModelData* data){
+	memset(data->influence_ctr, 0, sizeof(data->influence_ctr));
+	for (int p = 0; p < data->partition_ctr; p++)
+		memset(data->partitions[p].bucket_ctr, 0, sizeof(data->partitions[p].bucket_ctr));
+	if (data->bone_ids == NULL){
+		data->influence_ctr[MAX_INFLUENCES - 1] = data->point_ctr;
+		for (int p = 0; p < data->partition_ctr; p++)
+			data->partitions[p].bucket_ctr[MAX_INFLUENCES - 1] = data->partitions[p].index_ctr;
+		return;
+	}
+
+	/* cle de chaque sommet : nombre d'influences, puis bones globaux croissants (-1 au-dela) */
+	int point_ctr = data->point_ctr;
+	int* count = (int*)malloc(point_ctr * sizeof(int));
+	int* key = (int*)malloc(MAX_INFLUENCES * point_ctr * sizeof(int));
+	for (int v = 0; v < MAX_INFLUENCES * point_ctr; v++)
+		key[v] = -1;
+	for (int p = 0; p < data->partition_ctr; p++){
+		const ModelPartition* part = &data->partitions[p];
+		for (int i = part->index_start; i < part->index_start + part->index_ctr; i++){
+			int v = data->indices[i];
+			for (int k = 0; k < MAX_INFLUENCES; k++){
+				int local = data->bone_ids[MAX_INFLUENCES * v + k];
+				if (data->weights[MAX_INFLUENCES * v + k] > 0.0f && local < part->bone_ctr)
+					key[MAX_INFLUENCES * v + k] = data->palette_bones[part->bone_start + local];
+			}
+		}
+	}
+	for (int v = 0; v < point_ctr; v++){
+		GLint* ids = &data->bone_ids[MAX_INFLUENCES * v];
+		GLfloat* w = &data->weights[MAX_INFLUENCES * v];
+		int* kv = &key[MAX_INFLUENCES * v];
+		for (int k = 1; k < MAX_INFLUENCES; k++){
+			for (int j = k; j > 0 && w[j] > w[j - 1]; j--){
+				std::swap(w[j], w[j - 1]);
+				std::swap(ids[j], ids[j - 1]);
+				std::swap(kv[j], kv[j - 1]);
+			}
+		}
+		int c = 1;
+		while (c < MAX_INFLUENCES && w[c] > 0.0f)
+			c++;
+		count[v] = c;
+		data->influence_ctr[c - 1]++;
+		std::sort(kv, kv + c);
+	}
+
+	/* 1) sommets : tous les flux par sommet sont permutes, les indices renumerotes */
+	int* order = (int*)malloc(point_ctr * sizeof(int));
+	for (int v = 0; v < point_ctr; v++)
+		order[v] = v;
+	std::stable_sort(order, order + point_ctr, [count, key](int a, int b){
+		if (count[a] != count[b])
+			return count[a] < count[b];
+		for (int k = 0; k < MAX_INFLUENCES; k++){
+			if (key[MAX_INFLUENCES * a + k] != key[MAX_INFLUENCES * b + k])
+				return key[MAX_INFLUENCES * a + k] < key[MAX_INFLUENCES * b + k];
+		}
+		return false;
+	});
+	int* remap = (int*)malloc(point_ctr * sizeof(int));
+	int cluster_ctr = 0;
+	for (int n = 0; n < point_ctr; n++){
+		remap[order[n]] = n;
+		if (n == 0 || memcmp(&key[MAX_INFLUENCES * order[n]], &key[MAX_INFLUENCES * order[n - 1]], MAX_INFLUENCES * sizeof(int)) != 0)
+			cluster_ctr++;
+	}
+
+	ModelData old = *data;
+	ModelCounts counts = modelCounts(&old);
+	counts.cluster_ctr = cluster_ctr;
+	unsigned int offsets[NB_STREAMS];
+	unsigned int sizes[NB_STREAMS];
+	layoutStreams(&counts, modelFlags(&old), 16, offsets, sizes);
+	allocStreams(data, &counts, modelFlags(&old));
+	for (int s = 0; s < NB_STREAMS; s++){
+		if (sizes[s] == 0 || s == STREAM_CLUSTERS)
+			continue;
+		char* dst = (char*)streamData(data, s);
+		const char* src = (const char*)streamData(&old, s);
+		if (s >= STREAM_INDICES){
+			memcpy(dst, src, sizes[s]);
+			continue;
+		}
+		size_t elem = sizes[s] / point_ctr;
+		for (int v = 0; v < point_ctr; v++)
+			memcpy(dst + remap[v] * elem, src + v * elem, elem);
+	}
+	free(old.block);
+	followMorphs(data, order, point_ctr);
+	for (int i = 0; i < data->index_ctr; i++)
+		data->indices[i] = remap[data->indices[i]];
+	int* vertex_count = (int*)malloc(point_ctr * sizeof(int));
+	for (int v = 0; v < point_ctr; v++)
+		vertex_count[remap[v]] = count[v];
+	ModelCluster* cluster = NULL;
+	for (int n = 0; n < point_ctr; n++){
+		const int* kv = &key[MAX_INFLUENCES * order[n]];
+		if (cluster == NULL || memcmp(kv, cluster->bones, sizeof(cluster->bones)) != 0){
+			cluster = cluster == NULL ? data->clusters : cluster + 1;
+			cluster->vertex_start = n;
+			cluster->vertex_ctr = 0;
+			memcpy(cluster->bones, kv, sizeof(cluster->bones));
+		}
+		cluster->vertex_ctr++;
+	}
+	free(order);
+	free(remap);
+	free(count);
+	free(key);
+
+	/* 2) triangles de chaque partition, par le plus grand nombre d'influences de leurs sommets */
+	int tri_ctr = data->index_ctr / 3;
+	GLuint* tris = (GLuint*)malloc(3 * tri_ctr * sizeof(GLuint));
+	int* tri_count = (int*)malloc(tri_ctr * sizeof(int));
+	for (int p = 0; p < data->partition_ctr; p++){
+		ModelPartition* part = &data->partitions[p];
+		GLuint* indices = &data->indices[part->index_start];
+		int part_tris = part->index_ctr / 3;
+		for (int t = 0; t < part_tris; t++){
+			int c = 1;
+			for (int j = 0; j < 3; j++)
+				c = std::max(c, vertex_count[indices[3 * t + j]]);
+			tri_count[t] = c;
+			part->bucket_ctr[c - 1] += 3;
+		}
+		int fill[MAX_INFLUENCES];
+		fill[0] = 0;
+		for (int k = 1; k < MAX_INFLUENCES; k++)
+			fill[k] = fill[k - 1] + part->bucket_ctr[k - 1] / 3;
+		for (int t = 0; t < part_tris; t++)
+			memcpy(&tris[3 * fill[tri_count[t] - 1]++], &indices[3 * t], 3 * sizeof(GLuint));
+		memcpy(indices, tris, 3 * part_tris * sizeof(GLuint));
+	}
+	free(tris);
+	free(tri_count);
+	free(vertex_count);
+
+	printf("sommets a 1, 2, 3, 4 influences : %i %i %i %i, %i groupes de bones\n", data->influence_ctr[0],
+		data->influence_ctr[1], data->influence_ctr[2], data->influence_ctr[3], data->cluster_ctr);
+}
+
+/* ouvre le fichier cuit par projection memoire, false s'il est absent ou perime */
+static bool loadCooked(const char* path, unsigned long long source_hash, unsigned long long rest_hash, ModelData* data){
+	size_t size = 0;
+	void* view = mapFile(path, &size);
+	if (view == NULL)
+		return false;
+
+	const CookedHeader* header = (const CookedHeader*)view;
+	bool valid = size >= sizeof(CookedHeader)
+		&& header->magic == COOKED_MAGIC
+		&& header->version == COOKED_VERSION
+		&& header->source_hash == source_hash
+		&& header->file_size == size;
+	/* poids automatiques, ou leur echec, a refaire si le squelette de repos ou le mode ont change :
+	un essai qui a echoue n'est pas retente tant que le repos qui l'a fait echouer est le meme */
+	if (valid && (header->flags & (HAS_AUTO_WEIGHTS | HAS_NO_WEIGHTS)))
+		valid = header->weights_hash == rest_hash && (force_auto_weights || !(header->flags & HAS_FORCED_WEIGHTS));
+	else if (valid)
+		valid = (header->flags & HAS_BONES) && !force_auto_weights;
+	if (valid){
+		unsigned int offsets[NB_STREAMS];
+		unsigned int sizes[NB_STREAMS];
+		size_t total = layoutStreams(&header->counts, header->flags, sizeof(CookedHeader), offsets, sizes);
+		valid = total <= size && memcmp(offsets, header->offsets, sizeof(offsets)) == 0;
+	}
+	if (!valid){
+		unmapFile(view, size);
+		return false;
+	}
+
+	applyCounts(data, &header->counts);
+	bindStreams(data, (char*)view, header->offsets);
+	memcpy(data->influence_ctr, header->influence_ctr, sizeof(data->influence_ctr));
+	memcpy(data->texture_file, header->texture_file, sizeof(data->texture_file));
+	data->texture_file[sizeof(data->texture_file) - 1] = '\0';
+	data->auto_weights = (header->flags & HAS_AUTO_WEIGHTS) != 0;
+	data->mapping = view;
+	data->mapping_size = size;
+	return true;
+}
+
+static bool writeCooked(const char* path, unsigned long long source_hash, unsigned long long weights_hash,
+	unsigned int weight_flags, const ModelData* data){
+	CookedHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = COOKED_MAGIC;
+	header.version = COOKED_VERSION;
+	header.source_hash = source_hash;
+	header.weights_hash = weights_hash;
+	header.counts = modelCounts(data);
+	memcpy(header.influence_ctr, data->influence_ctr, sizeof(header.influence_ctr));
+	header.flags = modelFlags(data) | weight_flags;
+	memcpy(header.texture_file, data->texture_file, sizeof(header.texture_file));
+	header.file_size = (unsigned int)layoutStreams(&header.counts, header.flags, sizeof(CookedHeader), header.offsets, header.sizes);
+
+	/* ecrit a cote puis renomme, pour qu'un autre chargement ne voie jamais un fichier partiel */
+	char tmp_path[520];
+	sprintf(tmp_path, "%.500s.tmp", path);
+	FILE* fichier = fopen(tmp_path, "wb");
+	if (fichier == NULL){
+		printf("error writing the cooked model %s\n", path);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, fichier);
+	static const char padding[16] = { 0 };
+	size_t offset = sizeof(header);
+	for (int s = 0; s < NB_STREAMS; s++){
+		if (header.sizes[s] == 0)
+			continue;
+		fwrite(padding, 1, header.offsets[s] - offset, fichier);
+		fwrite(streamData(data, s), 1, header.sizes[s], fichier);
+		offset = header.offsets[s] + header.sizes[s];
+	}
+	fwrite(padding, 1, header.file_size - offset, fichier);
+	fclose(fichier);
+	remove(path);
+	return rename(tmp_path, path) == 0;
+}
+
+/* Charge un vetement : depuis <file_name>.cooked si le hash du .dae correspond,
+sinon par assimp, puis ecrit le fichier cuit pour les lancements suivants */
+bool importModel(const char* file_name, ModelData* data){
+	memset(data, 0, sizeof(ModelData));
+
+	unsigned long long source_hash = 0;
+	if (!hashFile(file_name, &source_hash)){
+		fprintf(stderr, "ERROR reading the model %s\n", file_name);
+		return false;
+	}
+	char cooked[512];
+	sprintf(cooked, "%.500s.cooked", file_name);
+
+	unsigned long long rest_hash = 0;
+	hashFile(REST_FILE, &rest_hash);
+
+	double start = profNow();
+	if (loadCooked(cooked, source_hash, rest_hash, data)){
+		data->parse_ms = (profNow() - start) * 1000.0;
+		printf("Model %s : %i vertices, %i bones (fichier cuit)\n", file_name, data->point_ctr, data->bone_ctr);
+		return true;
 	}
-	if (mesh->HasBones()){
-		GLuint vbo2; // mme dmarche pour faire le lien avec les weights
-		glGenBuffers(1, &vbo2);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo2);
-		glBufferData(GL_ARRAY_BUFFER, 4* *point_ctr * sizeof(GLfloat), weights, GL_STATIC_DRAW);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 0, NULL);
-		glEnableVertexAttribArray(4);
-		free(weights);
-		GLuint vbo; // liaison des bone_ids
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, 4* *point_ctr * sizeof(GLint), bone_ids, GL_STATIC_DRAW);
-		glVertexAttribIPointer(3, 4, GL_INT, 0, NULL);
-		glEnableVertexAttribArray(3);
-		free(bone_ids);
-	}
-
-	free(vertexBoneCtr);
-	aiReleaseImport(scene);
-	printf("\nmodel loaded\n");
 
+	if (!importAssimp(file_name, data))
+		return false;
+	unsigned int weight_flags = 0;
+	bool painted = data->bone_ids != NULL;
+	if (force_auto_weights || !painted)
+		weight_flags = (autoWeights(data) ? HAS_AUTO_WEIGHTS : HAS_NO_WEIGHTS) | (painted ? HAS_FORCED_WEIGHTS : 0);
+	data->auto_weights = (weight_flags & HAS_AUTO_WEIGHTS) != 0;
+	partitionModel(data, PALETTE_SIZE);
+	bucketInfluences(data);
+	data->parse_ms = (profNow() - start) * 1000.0;
+	if (writeCooked(cooked, source_hash, weight_flags != 0 ? rest_hash : 0, weight_flags, data))
+		printf("fichier cuit ecrit : %s\n", cooked);
 	return true;
-}
\ No newline at end of file
+}
+
+void setAutoWeights(bool force){
+	force_auto_weights = force;
+}
+
+void freeModelData(ModelData* data){
+	free(data->block);
+	unmapFile(data->mapping, data->mapping_size);
+	memset(data, 0, sizeof(ModelData));
+}
+
+/* description des buffers d'un vetement, dans l'ordre de Garment::buffers */
+int garmentStreams(const ModelData* data, GarmentStream* streams){
+	int n = 0;
+	GarmentStream* st;
+
+	st = &streams[n++];
+	st->target = GL_ARRAY_BUFFER; st->attrib = 0; st->comps = 3; st->type = GL_FLOAT;
+	st->src = data->points; st->size = 3 * data->point_ctr * sizeof(GLfloat);
+	if (data->normals != NULL){
+		st = &streams[n++];
+		st->target = GL_ARRAY_BUFFER; st->attrib = 1; st->comps = 3; st->type = GL_FLOAT;
+		st->src = data->normals; st->size = 3 * data->point_ctr * sizeof(GLfloat);
+	}
+	if (data->texcoords != NULL){
+		st = &streams[n++];
+		st->target = GL_ARRAY_BUFFER; st->attrib = 2; st->comps = 2; st->type = GL_FLOAT;
+		st->src = data->texcoords; st->size = 2 * data->point_ctr * sizeof(GLfloat);
+	}
+	if (data->bone_ids != NULL){
+		st = &streams[n++];
+		st->target = GL_ARRAY_BUFFER; st->attrib = 4; st->comps = 4; st->type = GL_FLOAT;
+		st->src = data->weights; st->size = 4 * data->point_ctr * sizeof(GLfloat);
+		st = &streams[n++];
+		st->target = GL_ARRAY_BUFFER; st->attrib = 3; st->comps = 4; st->type = GL_INT;
+		st->src = data->bone_ids; st->size = 4 * data->point_ctr * sizeof(GLint);
+	}
+	st = &streams[n++];
+	st->target = GL_ELEMENT_ARRAY_BUFFER; st->attrib = 0; st->comps = 1; st->type = GL_UNSIGNED_INT;
+	st->src = data->indices; st->size = data->index_ctr * sizeof(GLuint);
+	return n;
+}
+
+/* cree le VAO une fois les buffers remplis et garde la table des partitions */
+void finishGarment(Garment* garment, const ModelData* data, const GarmentStream* streams, int nb_streams){
+	glGenVertexArrays(1, &garment->vao);
+	glBindVertexArray(garment->vao);
+	for (int s = 0; s < nb_streams; s++){
+		const GarmentStream* st = &streams[s];
+		glBindBuffer(st->target, garment->buffers[s]);
+		if (st->target != GL_ARRAY_BUFFER)
+			continue;
+		if (st->type == GL_INT)
+			glVertexAttribIPointer(st->attrib, st->comps, st->type, 0, NULL);
+		else
+			glVertexAttribPointer(st->attrib, st->comps, st->type, GL_FALSE, 0, NULL);
+		glEnableVertexAttribArray(st->attrib);
+	}
+	glBindVertexArray(0);
+
+	garment->index_ctr = data->index_ctr;
+	garment->bone_ctr = data->bone_ctr;
+	garment->partition_ctr = data->partition_ctr;
+	garment->partitions = (ModelPartition*)malloc(data->partition_ctr * sizeof(ModelPartition));
+	memcpy(garment->partitions, data->partitions, data->partition_ctr * sizeof(ModelPartition));
+	garment->palette_bones = (GLint*)malloc(data->palette_ctr * sizeof(GLint));
+	memcpy(garment->palette_bones, data->palette_bones, data->palette_ctr * sizeof(GLint));
+}
+
+/* copie les flux dans des VBOs ; les sources peuvent etre la projection du fichier cuit */
+bool uploadModel(const ModelData* data, Garment* garment){
+	GarmentStream streams[NB_GARMENT_BUFFERS];
+	int nb_streams = garmentStreams(data, streams);
+
+	memset(garment, 0, sizeof(Garment));
+	glGenBuffers(nb_streams, garment->buffers);
+	for (int s = 0; s < nb_streams; s++){
+		/* GL_COPY_WRITE_BUFFER ne touche ni au VAO courant ni au GL_ARRAY_BUFFER lie */
+		glBindBuffer(GL_COPY_WRITE_BUFFER, garment->buffers[s]);
+		glBufferData(GL_COPY_WRITE_BUFFER, streams[s].size, streams[s].src, GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	finishGarment(garment, data, streams, nb_streams);
+	return true;
+}
+
+void freeGarment(Garment* garment){
+	if (garment->vao != 0)
+		glDeleteVertexArrays(1, &garment->vao);
+	glDeleteBuffers(NB_GARMENT_BUFFERS, garment->buffers);
+	free(garment->partitions);
+	free(garment->palette_bones);
+	textureRelease(garment->texture);
+	clothDestroy(garment->cloth);
+	cpuSkinDestroy(garment->skin);
+	morphDestroy(garment->morph);
+	poseLibraryDestroy(garment->poses);
+	memset(garment, 0, sizeof(Garment));
+}
+
+/* Dessine chaque partition avec sa palette : bone_matrices est indexe par bone global,
+les bones au-dela de nb_matrices restent a l'identite.
+Avec un seul programme, les partitions sont dessinees d'un bloc ; avec MAX_INFLUENCES
+programmes (programs[k] ne lit que k + 1 influences), chaque groupe de triangles l'est
+avec le sien, programme par programme. */
+void drawGarment(const Garment* garment, const glm::mat4* bone_matrices, int nb_matrices,
+	const GLuint* programs, const GLint* palette_locs, int nb_programs, int instances){
+	glm::mat4 palette[PALETTE_SIZE];
+	glBindVertexArray(garment->vao);
+	if (garment->texture != 0){
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, garment->texture);
+	}
+	bool bucketed = nb_programs == MAX_INFLUENCES;
+	for (int k = 0; k < nb_programs; k++){
+		glUseProgram(programs[k]);
+		for (int p = 0; p < garment->partition_ctr; p++){
+			const ModelPartition* part = &garment->partitions[p];
+			int first = part->index_start;
+			int ctr = part->index_ctr;
+			if (bucketed){
+				for (int j = 0; j < k; j++)
+					first += part->bucket_ctr[j];
+				ctr = part->bucket_ctr[k];
+			}
+			if (ctr == 0)
+				continue;
+			for (int j = 0; j < part->bone_ctr; j++){
+				int b = garment->palette_bones[part->bone_start + j];
+				palette[j] = b < nb_matrices ? bone_matrices[b] : glm::mat4(1.0f);
+			}
+			if (part->bone_ctr > 0)
+				glUniformMatrix4fv(palette_locs[k], part->bone_ctr, GL_FALSE, glm::value_ptr(palette[0]));
+			glDrawElementsInstanced(GL_TRIANGLES, ctr, GL_UNSIGNED_INT, (const void*)(first * sizeof(GLuint)), instances);
+		}
+	}
+}
+
+/* texture du cache, ou lue et envoyee en une fois ; 0 si illisible */
+GLuint uploadTexture(const char* file_name){
+	GLuint texture = textureAcquire(file_name);
+	TextureUpload up;
+	memset(&up, 0, sizeof(up));
+	TextureData tex;
+	if (texture == 0 && readTexture(file_name, &tex)){
+		textureUploadBegin(&up, &tex);
+		textureUploadStep(&up, profNow() + 3600.0); // sans limite : tout en un appel
+		texture = textureUploadFinish(&up);
+	}
+	return texture;
+}
+
+/* chargement synchrone : import (ou fichier cuit) puis envoi immediat au GPU */
+bool loadModel(const char* file_name, Garment* garment){
+	ModelData data;
+	if (!importModel(file_name, &data))
+		return false;
+
+	double start = profNow();
+	uploadModel(&data, garment);
+	if (data.texture_file[0] != '\0')
+		garment->texture = uploadTexture(data.texture_file);
+	garment->cloth = clothCreate(&data);
+	garment->skin = cpuSkinCreate(&data);
+	garment->morph = morphCreate(&data);
+	garment->poses = poseLibraryLoad(file_name, &data);
+	glFinish(); // pour mesurer le transfert complet
+	double upload_ms = (profNow() - start) * 1000.0;
+
+	printf("\nmodel loaded (lecture %.1f ms, envoi GPU %.1f ms)\n", data.parse_ms, upload_ms);
+	freeModelData(&data);
+	return true;
+}
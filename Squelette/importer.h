@@ -1,3 +1,6 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
 #ifndef GLEW_H
 #define GLEW_H
 #include <glew.h>
@@ -17,11 +20,151 @@
 #include <assimp/postprocess.h>
 #endif
 
+#include "texture.h"
 #include <stdlib.h>
 
+#define MAX_BONE_NAME 64
+
+/* nombre maximal de bones references par une partition : taille du tableau
+bone_matrices du vertex shader */
+#define PALETTE_SIZE 32
+
+/* influences lues par sommet : taille des attributs bone_ids et weights */
+#define MAX_INFLUENCES 4
+
+/* une plage d'indices dessinee avec sa propre palette de bones ;
+palette_bones[bone_start + j] est le bone global du bone local j.
+Les triangles y sont ranges par nombre d'influences de leur sommet le plus influence :
+bucket_ctr[k] indices a k + 1 influences, dans cet ordre. */
+struct ModelPartition{
+	int index_start;
+	int index_ctr;
+	int bone_start;
+	int bone_ctr;
+	int bucket_ctr[MAX_INFLUENCES];
+};
+
+/* sommets contigus influences par le meme ensemble de bones globaux, croissants
+(-1 au-dela) : a reskinner seulement si l'un d'eux a bouge */
+struct ModelCluster{
+	int vertex_start;
+	int vertex_ctr;
+	int bones[MAX_INFLUENCES];
+};
+
+/* cible de morph (blendshape) : seuls les sommets qu'elle deplace ont un delta,
+deltas[delta_start .. delta_start + delta_ctr) ranges par sommet (morph.h) */
+struct ModelMorph{
+	char name[MAX_BONE_NAME];
+	int delta_start;
+	int delta_ctr;
+};
+
+/* ecart d'un sommet de la cible au maillage de base */
+struct MorphDelta{
+	int vertex;
+	float dp[3];
+	float dn[3]; // nul si le vetement n'a pas de normales
+};
+
+/* un noeud de la hierarchie, a plat : le parent precede toujours ses enfants */
+struct ModelNode{
+	char name[MAX_BONE_NAME];
+	int parent; // -1 pour la racine
+	glm::mat4 transform;
+};
+
+/* Donnees d'un vetement pretes a etre envoyees au GPU.
+Les flux pointent soit dans un bloc alloue a l'import, soit directement dans
+la projection memoire du fichier cuit (<modele>.cooked). */
+struct ModelData{
+	int point_ctr;  // nombre de sommets
+	int index_ctr;  // nombre d'indices (3 par triangle)
+	int bone_ctr;
+	int node_ctr;
+	int partition_ctr;
+	int palette_ctr;
+	int cluster_ctr;
+	int morph_ctr;
+	int delta_ctr;
+	GLfloat* points;    // 3 par sommet
+	GLfloat* normals;   // 3 par sommet, NULL si absent
+	GLfloat* texcoords; // 2 par sommet, NULL si absent
+	GLint* bone_ids;    // 4 par sommet, indices locaux a la partition du sommet
+	GLfloat* weights;   // 4 par sommet par poids decroissant, NULL si pas de bones
+	GLuint* indices;
+	char (*bone_names)[MAX_BONE_NAME];
+	glm::mat4* bone_offset_mats;
+	ModelNode* nodes;
+	ModelPartition* partitions;
+	GLint* palette_bones;
+	ModelCluster* clusters; // NULL si pas de bones
+	ModelMorph* morphs;     // NULL sans cible de morph
+	MorphDelta* deltas;
+	char texture_file[256]; // texture diffuse du materiau, vide si aucune
+	int influence_ctr[MAX_INFLUENCES]; // sommets a k + 1 influences, ranges dans cet ordre
+	bool auto_weights;  // poids calcules sur le squelette de repos (skinWeights.h), pas peints
+
+	void* block;        // bloc de l'import assimp
+	void* mapping;      // vue du fichier cuit
+	size_t mapping_size;
+	double parse_ms;    // temps passe dans assimp ou dans la lecture du fichier cuit
+};
+
+#define NB_GARMENT_BUFFERS 6
+
+struct Cloth;
+struct CpuSkin;
+struct MorphSet;
+struct PoseLibrary;
+
+/* objets GL d'un vetement charge, dessine partition par partition */
+struct Garment{
+	GLuint vao;
+	GLuint buffers[NB_GARMENT_BUFFERS];
+	int index_ctr;
+	int bone_ctr;
+	int partition_ctr;
+	ModelPartition* partitions;
+	GLint* palette_bones;
+	GLuint texture;     // reference dans le cache de textures, 0 si aucune
+	Cloth* cloth;       // tissu simule (cloth.h), NULL si le vetement n'a pas de bord libre
+	CpuSkin* skin;      // skinning CPU par groupes de bones (cpuSkin.h), NULL sans bones
+	MorphSet* morph;    // cibles de morph pilotees par les mesures du corps (morph.h), NULL sans cible
+	PoseLibrary* poses; // instantanes precalcules (poseLibrary.h), NULL sans <vetement>.poses a jour
+};
+
+/* un buffer a remplir : source, taille et attribut du VAO */
+struct GarmentStream{
+	GLenum target;
+	GLuint attrib;
+	GLint comps;
+	GLenum type;
+	const void* src;
+	size_t size;
+};
+
 glm::mat4 convertAIMatrix(const aiMatrix4x4 &matrix);
 
-bool loadModel(const char* file_name,
-	GLuint* vao, int* point_ctr,
-	glm::mat4* bone_offset_mats,
-	int* bone_ctr);
\ No newline at end of file
+/* version du fichier cuit (<vetement>.cooked) ; les fichiers derives du vetement cuit,
+comme la bibliotheque de poses, la gardent pour etre refaits avec lui */
+#define COOKED_VERSION 7
+
+/* force : poids automatiques (skinWeights.h) meme pour les vetements peints ; sinon
+seuls les vetements sans poids en recoivent */
+void setAutoWeights(bool force);
+bool importModel(const char* file_name, ModelData* data);
+void freeModelData(ModelData* data);
+
+int garmentStreams(const ModelData* data, GarmentStream* streams);
+void finishGarment(Garment* garment, const ModelData* data, const GarmentStream* streams, int nb_streams);
+bool uploadModel(const ModelData* data, Garment* garment);
+GLuint uploadTexture(const char* file_name);
+void freeGarment(Garment* garment);
+/* instances : chaque triangle est dessine instances fois, une par vue du miroir (session.h) */
+void drawGarment(const Garment* garment, const glm::mat4* bone_matrices, int nb_matrices,
+	const GLuint* programs, const GLint* palette_locs, int nb_programs, int instances);
+
+bool loadModel(const char* file_name, Garment* garment);
+
+#endif
@@ -0,0 +1,145 @@
+#include "latencyProbe.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+static unsigned int* depths = NULL; // profondeur de la zone de rendu, produite par le seul vetement
+static int width = 0;
+static int height = 0;
+static int wanted = 0;
+static bool coded = false;          // derniere pose lue codee (skeletonCodec.h) plutot qu'en texte
+
+static unsigned long long last_hash = 0;
+static bool has_hash = false;
+static bool changed = false;        // le vetement dessine differe de celui de l'image precedente
+static int shown_step = -1;         // echelon de la pose de l'image capturee
+static int seen_step = -1;          // dernier echelon porte par une etiquette
+static int pending_step = -1;       // echelon recu mais pas encore visible
+static double pending_time = 0.0;
+static int skipped = 0;
+static double last_progress = 0.0;  // dernier echelon mesure, ou debut de la mesure
+
+static double latencies[LATENCY_MAX_STEPS];
+static int latency_ctr = 0;
+static int untagged_ctr = 0;        // changements du vetement sans l'echelon attendu
+static int missed_ctr = 0;          // echelons remplaces avant d'etre visibles
+
+void latencyStart(int w, int h, int nb_steps){
+	width = w;
+	height = h;
+	wanted = nb_steps < LATENCY_MAX_STEPS ? nb_steps : LATENCY_MAX_STEPS;
+	depths = (unsigned int *)malloc(width * height * sizeof(unsigned int));
+	coded = false;
+	has_hash = false;
+	changed = false;
+	shown_step = -1;
+	seen_step = -1;
+	pending_step = -1;
+	skipped = 0;
+	last_progress = profNow();
+	latency_ctr = 0;
+	untagged_ctr = 0;
+	missed_ctr = 0;
+}
+
+/* a appeler juste apres le dessin du vetement, la cible du rendu encore liee */
+void latencyCapture(const PoseTag* tag, int render_width, int render_height){
+	if (depths == NULL)
+		return;
+	coded = tag->coded;
+	/* la premiere etiquette ne suit aucun saut : rien a voir a l'ecran */
+	if (tag->step >= 0 && tag->step != seen_step){
+		if (pending_step >= 0)
+			missed_ctr++;
+		if (seen_step >= 0){
+			pending_step = tag->step;
+			pending_time = tag->step_time;
+		}
+		seen_step = tag->step;
+	}
+	shown_step = tag->step;
+
+	/* ni le fond, ni les os, ni la texture n'ecrivent la profondeur : elle ne change
+	que si les sommets skinnes du vetement ont bouge */
+	int w = render_width < width ? render_width : width;
+	int h = render_height < height ? render_height : height;
+	glReadPixels(0, 0, w, h, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, depths);
+	unsigned long long hash = 14695981039346656037ULL;
+	int n = w * h;
+	for (int i = 0; i < n; i++){
+		hash ^= depths[i];
+		hash *= 1099511628211ULL;
+	}
+	changed = has_hash && hash != last_hash;
+	last_hash = hash;
+	has_hash = true;
+}
+
+/* a appeler juste apres l'echange */
+void latencyPresented(double present_time){
+	if (depths == NULL || !changed)
+		return;
+	changed = false;
+	if (pending_step < 0 || shown_step != pending_step){
+		untagged_ctr++;
+		return;
+	}
+	if (skipped < LATENCY_WARMUP_STEPS)
+		skipped++;
+	else if (latency_ctr < wanted)
+		latencies[latency_ctr++] = (present_time - pending_time) * 1000.0;
+	last_progress = present_time;
+	pending_step = -1;
+}
+
+bool latencyDone(){
+	return depths != NULL && latency_ctr >= wanted;
+}
+
+const char* latencyIngest(){
+	return coded ? "file/skc" : "file/text";
+}
+
+bool latencyTimedOut(){
+	return depths != NULL && profNow() - last_progress > LATENCY_TIMEOUT;
+}
+
+static double percentile(const double* sorted, int n, int p){
+	int i = (n * p) / 100;
+	return sorted[i < n ? i : n - 1];
+}
+
+/* resultats sur la sortie standard, et ajoutes en une ligne JSON a json_path */
+void latencyReport(const char* mode, const char* json_path){
+	if (latencyTimedOut())
+		printf("latence %s : aucun echelon affiche depuis %.0f s, mesure interrompue\n", mode, LATENCY_TIMEOUT);
+	if (latency_ctr == 0){
+		printf("latence %s : aucun echelon mesure (bench/fakeTracker lance ?)\n", mode);
+		return;
+	}
+	double sorted[LATENCY_MAX_STEPS];
+	memcpy(sorted, latencies, latency_ctr * sizeof(double));
+	std::sort(sorted, sorted + latency_ctr);
+	double sum = 0.0;
+	for (int i = 0; i < latency_ctr; i++)
+		sum += sorted[i];
+	double p50 = percentile(sorted, latency_ctr, 50);
+	double p90 = percentile(sorted, latency_ctr, 90);
+	double p99 = percentile(sorted, latency_ctr, 99);
+	printf("latence %s : %i echelons, moy=%.1f p50=%.1f p90=%.1f p99=%.1f max=%.1f ms (%i manques, %i changements sans l'echelon attendu)\n",
+		mode, latency_ctr, sum / latency_ctr, p50, p90, p99, sorted[latency_ctr - 1], missed_ctr, untagged_ctr);
+
+	FILE* out = fopen(json_path, "a");
+	if (out == NULL)
+		return;
+	fprintf(out, "{\"mode\": \"%s\", \"steps\": %i, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"missed\": %i, \"untagged\": %i}\n",
+		mode, latency_ctr, sum / latency_ctr, p50, p90, p99, sorted[latency_ctr - 1], missed_ctr, untagged_ctr);
+	fclose(out);
+}
+
+void latencyStop(){
+	free(depths);
+	depths = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#include "matrixCalc.h"
+
+/* Mesure de la latence mouvement -> affichage avec bench/fakeTracker.
+Le traqueur de test ecrit dans le fichier Kinect des poses fixes entrecoupees de
+changements brusques (echelons), dates avec la meme horloge que profNow.
+A chaque image, latencyCapture relit la profondeur de la zone de rendu juste apres le
+dessin du vetement et en calcule une empreinte : seul le vetement ecrit la profondeur,
+qui ne change donc que si ses sommets skinnes ont bouge. La premiere image dont le
+vetement change apres un echelon, et qui porte l'etiquette de cet echelon, donne une
+fois l'echange fait (latencyPresented) la latence de l'echelon. Le tissu et l'occultation,
+qui deplacent ou coupent le vetement sans changement de pose, sont coupes pendant la mesure.
+La relecture synchrone empeche le GPU de prendre de l'avance : elle fait partie
+de la mesure, au meme titre que l'attente de l'echange. */
+
+#define LATENCY_MAX_STEPS 1024
+#define LATENCY_WARMUP_STEPS 2 // premiers echelons ignores (chargements, caches)
+#define LATENCY_TIMEOUT 5.0    // secondes sans echelon mesure avant abandon
+
+/* width, height : taille maximale de la zone de rendu */
+void latencyStart(int width, int height, int nb_steps);
+void latencyCapture(const PoseTag* tag, int render_width, int render_height);
+void latencyPresented(double present_time);
+bool latencyDone();
+/* aucun echelon mesure depuis LATENCY_TIMEOUT secondes (traqueur arrete, echelon jamais affiche) */
+bool latencyTimedOut();
+/* lecture de la derniere pose capturee : "file/text" ou "file/skc" */
+const char* latencyIngest();
+void latencyReport(const char* mode, const char* json_path);
+void latencyStop();
+
+#endif
@@ -4,680 +4,217 @@
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 #include <stdlib.h>
+#include <string.h>
 
 #include "importer.h"
 #include "matrixCalc.h"
 #include "printScreen.h"
+#include "texture.h"
+#include "session.h"
+#include "pipeline.h"
+#include "allocAudit.h"
+#include "garmentLoader.h"
+#include "latencyProbe.h"
+#include "golden.h"
+#include "resolution.h"
+#include "occlusion.h"
+#include "poseLibrary.h"
+#include "skeletonCodec.h"
 
-#define MAX_BONES 32
 int nb_bones = 8;
-#define MODEL_FILE "Sweat8AutoW2.dae" // "Sweat8PaintedNormalizedTest5Retry7.dae" et 9 corrects
 
-/* Shaders */
-
-/* Shader pour les points de la Kinect destination */
-const GLchar* fragmentSourceB2 =
-"#version 410 core\n"
-"out vec4 frag_colour;"
-"void main() {"
-"	frag_colour = vec4(1.0, 0.0, 0.0, 1.0);"
-"}";
-
-const GLchar* vertexSourceB2 =
-"#version 410 core\n"
-"layout(location = 0) in vec3 vp;"
-"uniform mat4 proj, view, model;"
-"void main() {"
-"	gl_PointSize = 7.0;"
-"	gl_Position = proj * view * model * vec4(vp, 1.0);"
-"}";
-
-/* Shaders pour le vetement */
-const GLchar* vertexSource =
-"#version 410 core\n"
-"layout(location = 0) in vec3 vpos;"
-"layout(location = 1) in vec3 vnormal;"
-"layout(location = 2) in vec2 vtexcoord;"
-"layout(location = 3) in ivec4 bone_ids;"
-"layout(location = 4) in vec4 weights;"
-
-"out vec3 normal;"
-"out vec2 st;"
-
-"uniform mat4 model;"
-"uniform mat4 view;"
-"uniform mat4 proj;"
-"uniform mat4 bone_matrices[32];"
-"uniform float scale;"
-
-"void main(){"
-"float a = scale;"
-"mat3 window_scale = mat3("
-"vec3(a, 0.0, 0.0),"
-"vec3(0.0, a, 0.0),"
-"vec3(0.0, 0.0, a)"
-");"
-"	mat4 boneTrans;"
-"	boneTrans = bone_matrices[bone_ids[0]] * weights[0];"
-"	boneTrans += bone_matrices[bone_ids[1]] * weights[1];"
-"	boneTrans += bone_matrices[bone_ids[2]] * weights[2];"
-"	boneTrans += bone_matrices[bone_ids[3]] * weights[3];"
-"	st = vtexcoord;"
-"	normal = vnormal;"
-"	gl_Position = proj * view * model * boneTrans * vec4(vpos.x, vpos.y, vpos.z, 1.0);"
-"}";
-
-const GLchar* fragmentSource =
-"#version 410 core\n"
-"in vec3 normal;"
-"in vec2 st;"
-"out vec4 outColor;"
-
-"void main(){"
-"	outColor = vec4(0.5-normal-0.5, 1.0);"
-"}";
-
-GLFWwindow* initGLFW(int width, int weight, char* title);
-void initGLEW();
-GLuint createShader(GLenum type, const GLchar* src);
-void updateTab(glm::vec3 ** Tab, float * maj);
-void main2();
-
-int main(){
-
-	/* Le tableau de bones : contiendra les positions des os */
-	glm::vec3 ** Bones;
-	glm::mat4 * bone_matrices = (glm::mat4 *)malloc(nb_bones * sizeof(glm::mat4));
-	Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
-	int b1;
-	for (b1 = 0; b1 < nb_bones; b1++){
-		Bones[b1] = (glm::vec3 *)malloc(4 * sizeof(glm::vec3));
+int cookTextures(int nb_files, char** files);
+int auditFrames(Session* session, int nb_frames);
+int measureLatency(Session* session, int nb_steps);
+
+int main(int argc, char** argv){
+
+	/* Squelette --cook image... : conversion hors ligne des textures en .ctex */
+	if (argc > 2 && strcmp(argv[1], "--cook") == 0)
+		return cookTextures(argc - 2, argv + 2);
+
+	/* Squelette --pose-library vetement.dae enregistrement : instantanes skinnes dans vetement.dae.poses */
+	if (argc > 3 && strcmp(argv[1], "--pose-library") == 0)
+		return poseLibraryBuild(argv[2], argv[3]);
+
+	/* Squelette --depth N : images en vol dans le pipeline (1 = latence minimale)
+	   Squelette --pace MS : duree minimale d'une image (0 : rendu au plus vite)
+	   Squelette --audit N : N images comptees, code 1 si l'une d'elles a alloue
+	   Squelette --latency N : latence de N echelons de bench/fakeTracker
+	   Squelette --cloth MS : tissu simule des le depart, MS par image (touche C)
+	   Squelette --weights auto : poids automatiques pour tous les vetements, peints ou non
+	   Squelette --skin cpu : skinning sur CPU des seuls sommets dont les bones ont bouge (touche K)
+	   Squelette --skin library : instantanes de la bibliotheque de poses, sans skinning (touche L)
+	   Squelette --background source : image couleur en fond, memoire partagee ou suite "rep/image%04d.tga"
+	   Squelette --occlusion source : vetement cache par l'utilisateur, profondeur en memoire partagee ou suite "rep/prof%04d.pgm" (touche O)
+	   Squelette --occlusion-calib fichier : position et parametres internes du capteur de profondeur (occlusion.h)
+	   Squelette --views N : N vues cote a cote (face, cote, dos, autre cote) en une passe, skinning CPU
+	   Squelette --budget MS [--scale MIN:MAX] : resolution de rendu adaptee pour tenir MS de GPU par image
+	   Squelette --record fichier : poses lues enregistrees pour les images de reference, codees si fichier.skc
+	   Squelette --precision MM : pas de quantification des enregistrements .skc (0.1 par defaut)
+	   Squelette --golden rep [--workers N] : comparaison aux images de reference, code 1 si ecart
+	   Squelette --golden-update rep : reecriture des images de reference
+	   Squelette --golden-bootstrap rep : ecriture des seules references absentes, comparaison des autres */
+	int depth = PIPELINE_DEPTH;
+	double frame_interval = FRAME_INTERVAL;
+	int audit = 0;
+	int latency = 0;
+	const char* golden = NULL;
+	GoldenMode golden_mode = GOLDEN_COMPARE;
+	int workers = GOLDEN_WORKERS;
+	double cloth = 0.0;
+	bool cpu_skin = false;
+	bool pose_library = false;
+	const char* background = NULL;
+	const char* occlusion = NULL;
+	int views = 1;
+	double budget = 0.0;
+	float min_scale = RESOLUTION_MIN_SCALE;
+	float max_scale = RESOLUTION_MAX_SCALE;
+	const char* record = NULL;
+	float precision = SKELETON_PRECISION;
+	for (int a = 1; a + 1 < argc; a += 2){
+		if (strcmp(argv[a], "--depth") == 0)
+			depth = atoi(argv[a + 1]);
+		else if (strcmp(argv[a], "--pace") == 0)
+			frame_interval = atof(argv[a + 1]) / 1000.0;
+		else if (strcmp(argv[a], "--audit") == 0)
+			audit = atoi(argv[a + 1]);
+		else if (strcmp(argv[a], "--latency") == 0)
+			latency = atoi(argv[a + 1]);
+		else if (strcmp(argv[a], "--golden") == 0 || strcmp(argv[a], "--golden-update") == 0 || strcmp(argv[a], "--golden-bootstrap") == 0){
+			golden = argv[a + 1];
+			golden_mode = strcmp(argv[a], "--golden-update") == 0 ? GOLDEN_UPDATE
+				: (strcmp(argv[a], "--golden-bootstrap") == 0 ? GOLDEN_BOOTSTRAP : GOLDEN_COMPARE);
+		}
+		else if (strcmp(argv[a], "--cloth") == 0)
+			cloth = atof(argv[a + 1]);
+		else if (strcmp(argv[a], "--skin") == 0){
+			cpu_skin = strcmp(argv[a + 1], "cpu") == 0;
+			pose_library = strcmp(argv[a + 1], "library") == 0;
+		}
+		else if (strcmp(argv[a], "--background") == 0)
+			background = argv[a + 1];
+		else if (strcmp(argv[a], "--occlusion") == 0)
+			occlusion = argv[a + 1];
+		else if (strcmp(argv[a], "--occlusion-calib") == 0)
+			occlusionCalibrate(argv[a + 1]);
+		else if (strcmp(argv[a], "--views") == 0)
+			views = atoi(argv[a + 1]);
+		else if (strcmp(argv[a], "--budget") == 0)
+			budget = atof(argv[a + 1]);
+		else if (strcmp(argv[a], "--scale") == 0 && sscanf(argv[a + 1], "%f:%f", &min_scale, &max_scale) != 2)
+			printf("--scale attend MIN:MAX, par exemple 0.5:1\n");
+		else if (strcmp(argv[a], "--weights") == 0)
+			setAutoWeights(strcmp(argv[a + 1], "auto") == 0);
+		else if (strcmp(argv[a], "--workers") == 0)
+			workers = atoi(argv[a + 1]);
+		else if (strcmp(argv[a], "--record") == 0)
+			record = argv[a + 1];
+		else if (strcmp(argv[a], "--precision") == 0)
+			precision = (float)atof(argv[a + 1]) / 1000.0f;
 	}
-
-	/* positions initiales des os du modele dans un txt pour traitement */
-	FILE* fichier2 = fopen("init_exploit-new.txt", "r");
-	if (fichier2 == NULL){
-		printf("Error loading the init file\n");
+	if (record != NULL && !pipelineRecord(record, precision))
+		printf("impossible d'enregistrer dans %s\n", record);
+	if (golden != NULL)
+		return goldenRun(golden, golden_mode, workers) == 0 ? 0 : 1;
+
+	/* fenetre, programmes et vetement sont crees une fois ; R ne remet a zero que la pose */
+	Session session;
+	resolutionConfigure(budget, min_scale, max_scale);
+	if (!sessionInit(&session, depth, frame_interval, cloth, cpu_skin, background, occlusion, views, pose_library))
 		exit(1);
+	if (latency > 0){
+		int result = measureLatency(&session, latency);
+		sessionDestroy(&session);
+		return result;
 	}
-	/* charge les donnes prcdentes */
-	initData(Bones, fichier2);
-	fclose(fichier2);
-	
-	/* variables */
-	float rot1 = 0.0f;
-	float rot2 = 0.0f;
-	int screen_width = 1024;
-	int screen_height = 768;
-	int width = 640;
-	int height = 480;
-
-	/* Initilisation GLFW, GLEW */
-	GLFWwindow* window = initGLFW(width, height, "PACT");
-	glfwMakeContextCurrent(window);
-	initGLEW();
-
-	/* le vao du vetement */
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	/* Appel du loader */
-	int point_ctr = 0;
-	int bone_ctr = 0;
-	glm::mat4 bone_offset_matrices[MAX_BONES];
-	loadModel(MODEL_FILE, &vao, &point_ctr, bone_offset_matrices, &bone_ctr);
-	printf("\nNombre de bones : %i\n", bone_ctr);
-
-	/* Les positions des os du modele de vetement et des donnes Kinect pour representation */
-	float * bone_positions3 = (float *)malloc(27 * sizeof(float));
-	float bone_positions4[] = {
-		0.031702, -0.305855, 0.561678,
-		-0.053113, -0.306185, 0.490401,
-		-0.136382, -0.286400, 0.348958,
-		-0.212196, -0.227865, 0.227038,
-		0.032215, -0.317140, 0.336961,
-		0.033871, -0.300125, 0.293703,
-		0.110854, -0.314255, 0.495051,
-		0.269807, -0.312715, 0.207836,
-		0.192558, -0.337995, 0.328809,
-	};
-	int h;
-	for (h = 0; h < 27; h++){
-		bone_positions3[h] = bone_positions4[h];
+	if (audit > 0){
+		int result = auditFrames(&session, audit);
+		sessionDestroy(&session);
+		return result;
 	}
+	while (sessionFrame(&session));
+	sessionDestroy(&session);
 
-	/* de mme pour les os Kinect */
-	GLuint bones_vao2;
-	glGenVertexArrays(1, &bones_vao2);
-	glBindVertexArray(bones_vao2);
-	GLuint bones_vbo2;
-	glGenBuffers(1, &bones_vbo2);
-	glBindBuffer(GL_ARRAY_BUFFER, bones_vbo2);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		3 * (bone_ctr + 2) * sizeof(float),
-		bone_positions3,
-		GL_STATIC_DRAW
-		);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
-	GLuint vertexShaderB2 = createShader(GL_VERTEX_SHADER, vertexSourceB2);
-	GLuint fragmentShaderB2 = createShader(GL_FRAGMENT_SHADER, fragmentSourceB2);
-
-	GLuint shaderProgramB2 = glCreateProgram();
-	glAttachShader(shaderProgramB2, vertexShaderB2);
-	glAttachShader(shaderProgramB2, fragmentShaderB2);
-	glBindFragDataLocation(shaderProgramB2, 0, "outColor");
-	glLinkProgram(shaderProgramB2);
-
-	/* Gestion des shaders du modele de vetement */
-	GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexSource);
-	GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-	GLuint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glBindFragDataLocation(shaderProgram, 0, "outColor");
-	glLinkProgram(shaderProgram);
-	glUseProgram(shaderProgram);
+	return 0;
+}
 
-	/* Initialisation des matrices de bones */
-	glm::mat4 identity = glm::mat4(1.0f);
-	int bone_matrices_loc[MAX_BONES];
-	char name[64];
-	for (int i = 0; i < MAX_BONES; i++){
-		sprintf(name, "bone_matrices[%i]", i);
-		bone_matrices_loc[i] = glGetUniformLocation(shaderProgram, name); // bone_matrices_loc : matrices de bones dans le programme C
-		glUniformMatrix4fv(bone_matrices_loc[i], 1, GL_FALSE, glm::value_ptr(identity));
+/* Boucle en regime permanent : on attend la fin des chargements et ALLOC_AUDIT_WARMUP
+images (pilote, caches), puis toute allocation des threads de la boucle est une erreur */
+int auditFrames(Session* session, int nb_frames){
+	allocAuditStart();
+	int warm = 0;
+	while (warm < ALLOC_AUDIT_WARMUP){
+		if (!sessionFrame(session))
+			return 1;
+		warm = loaderBusy() ? 0 : warm + 1;
 	}
-
-	/* Les matrices model, view, projection sont initialises */
-	glm::mat4 model = glm::mat4(1.0f);
-
-	glm::mat4 view = glm::lookAt(
-		glm::vec3(0.0f, 2.5f, 0.5f),
-		glm::vec3(0.0f, 0.0f, 0.0f),
-		glm::vec3(0.0f, 0.0f, 1.0f));
-	glm::mat4 proj = glm::perspective(45.0f, 1024.0f / 768.0f, 0.1f, 100.0f);
-
-	GLint uniModel = glGetUniformLocation(shaderProgram, "model");
-	model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-
-	GLint uniView = glGetUniformLocation(shaderProgram, "view");
-	glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
-
-	GLint uniProj = glGetUniformLocation(shaderProgram, "proj");
-	glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
-
-	/* gere le scaling du modele */
-	float scaleValue = 1.0f;
-	GLint uniScale = glGetUniformLocation(shaderProgram, "scale");
-	glUniform1f(uniScale, scaleValue);
-
-	/* lien avec les uniform mat des 2 shaders des os */
-	glUseProgram(shaderProgramB2);
-	GLint bones_view_mat_location2 = glGetUniformLocation(shaderProgramB2, "view");
-	glUniformMatrix4fv(bones_view_mat_location2, 1, GL_FALSE, glm::value_ptr(view));
-	GLint bones_proj_mat_location2 = glGetUniformLocation(shaderProgramB2, "proj");
-	glUniformMatrix4fv(bones_proj_mat_location2, 1, GL_FALSE, glm::value_ptr(proj));
-	GLint bones_model_mat_location2 = glGetUniformLocation(shaderProgramB2, "model");
-	glUniformMatrix4fv(bones_model_mat_location2, 1, GL_FALSE, glm::value_ptr(model));
-
-	FILE* commande;
-	char ordre = '0';
-	char ordrePrecedent = '1';
-	double newTime = 0.0f;
-	double elapsedTime = 0.0f;
-	
-	while (!glfwWindowShouldClose(window)){
-		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-			glfwSetWindowShouldClose(window, GL_TRUE);
-
-		if(glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS){
-			main2();
+	allocAuditFrame();
+
+	int failed = 0;
+	int total = 0;
+	for (int f = 0; f < nb_frames; f++){
+		if (!sessionFrame(session))
+			break;
+		int n = allocAuditFrame();
+		if (n > 0){
+			if (failed < 10)
+				printf("image %i : %i allocations\n", f, n);
+			failed++;
+			total += n;
 		}
-		
-		static double time = glfwGetTime();
-
-		do{
-			commande = fopen("commandeOuverture.txt", "r");
-			if (commande == NULL){
-				printf("error reading commande java\n");
-				exit(1);
-			}
-			ordrePrecedent = ordre;
-			fscanf(commande, "%c", &ordre);
-			fclose(commande);
-
-			if (ordrePrecedent == '1' && ordre == '0'){
-				glfwHideWindow(window);
-			}
-
-		} while (ordre == '0');
-			glfwShowWindow(window);
-
-		/* Taille de la fenetre */
-		glfwGetWindowSize(window, &width, &height);
-		glfwSetWindowPos(window, (int)(screen_width - width) / 4.0, (int)(screen_height - height)/2.0);
-		
-		glm::mat4 proj = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 100.0f);
-		glUseProgram(shaderProgram);
-		glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
-		glViewport(0, 0, width, height);
-		
-		/* Initialisation */
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		/* Rotation du modle */
-		rot1 = 0.0f;
-		rot2 = 0.0f;
-		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-			rot1 += 0.07f;
-
-		if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-			rot1 -= 0.07f;
-
-		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-			rot2 += 0.07f;
-
-		if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-			rot2 -= 0.07f;
-
-		glUseProgram(shaderProgram);
-		model = glm::rotate(model, glm::radians(rot2), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::rotate(model, glm::radians(rot1), glm::vec3(0.0f, 0.0f, 1.0f));
-		glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-		
-		glUseProgram(shaderProgramB2);
-		glUniformMatrix4fv(bones_model_mat_location2, 1, GL_FALSE, glm::value_ptr(model));
-
-		/* on dessine le vetement */
-		glEnable(GL_DEPTH_TEST);
-		glUseProgram(shaderProgram);
-		glBindVertexArray(vao);
-		glDrawArrays(GL_TRIANGLES, 0,point_ctr);
-
-		/* puis les positions des os */
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_PROGRAM_POINT_SIZE);
-		glUseProgram(shaderProgramB2);
-		glBindVertexArray(bones_vao2);
-		glDrawArrays(GL_POINTS, 0, bone_ctr + 2);
-		glDisable(GL_PROGRAM_POINT_SIZE);
-
-		newTime = glfwGetTime();
-		elapsedTime = newTime - time;
-
-				/* readKinectData */
-				readData(Bones);
-				updateTab(Bones, bone_positions3);
-
-				glUseProgram(shaderProgramB2);
-				glBufferData(
-					GL_ARRAY_BUFFER,
-					3 * (bone_ctr + 2) * sizeof(float),
-					bone_positions3,
-					GL_STATIC_DRAW
-					);
-
-				glUseProgram(shaderProgram);
-				glUniform1f(uniScale, scaleValue);
-
-				/* update les matrices */
-				updateData(Bones, bone_matrices);
-				int l;
-				for (l = 0; l < nb_bones; l++){
-					glUseProgram(shaderProgram);
-					glUniformMatrix4fv(bone_matrices_loc[l], 1, GL_FALSE, glm::value_ptr(bone_matrices[l]));
-				}
-
-					newTime = glfwGetTime();
-					elapsedTime = newTime - time;
-					while (elapsedTime < 0.04){
-						newTime = glfwGetTime();
-						elapsedTime = newTime - time;
-					}
-					time = newTime;
-
-			glfwSwapBuffers(window);
-			glfwPollEvents();
 	}
-	glDeleteProgram(shaderProgram);
-	glDeleteProgram(shaderProgramB2);
-	glDeleteShader(fragmentShader);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShaderB2);
-	glDeleteShader(vertexShaderB2);
-	glDeleteVertexArrays(1, &vao);
-	glDeleteVertexArrays(1, &bones_vao2);
-
-	glfwTerminate();
-
-	for (h = 0; h+2 < 27; h=h+3){
-		printf("%f, %f, %f\n", bone_positions3[h], bone_positions3[h+1], bone_positions3[h+2]);
-	}
-
-	return 0;
+	allocAuditStop();
+	printf("audit des allocations : %i images sur %i ont alloue (%i allocations), arene %u / %u octets\n",
+		failed, nb_frames, total, (unsigned int)session->arena.high_water, (unsigned int)session->arena.size);
+	return failed == 0 ? 0 : 1;
 }
 
-GLFWwindow* initGLFW(int width, int height, char* title){
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_DECORATED, GL_FALSE); // enleve decoration fenetre
-
-	return glfwCreateWindow(width, height, title, NULL, NULL);
-}
-
-void initGLEW(){
-	glewExperimental = GL_TRUE;
-	glewInit();
-}
-
-GLuint createShader(GLenum type, const GLchar* src){
-	GLuint shader = glCreateShader(type);
-	glShaderSource(shader, 1, &src, NULL);
-	glCompileShader(shader);
-
-	return shader;
-}
-
-void updateTab(glm::vec3 ** Tab, float * maj){
-	int i, k;
-	k = 0;
-	for (i = 0; i < nb_bones; i++){
-			maj[k] = Tab[i][3].x;
-			k++;
-			maj[k] = Tab[i][3].y;
-			k++;
-			maj[k] = Tab[i][3].z;
-			k++;
+/* Latence mouvement -> affichage pour la lecture, la profondeur et la cadence courantes,
+mesuree une fois le vetement charge, sans tissu ni occultation (latencyProbe.h). Chaque
+mesure est ajoutee a latency.json pour comparer les modes. */
+int measureLatency(Session* session, int nb_steps){
+	while (loaderBusy()){
+		if (!sessionFrame(session))
+			return 1;
 	}
-	maj[k] = Tab[0][3].x;
-	maj[k + 1] = Tab[0][3].y;
-	maj[k + 2] = Tab[0][3].z;
-}
-
-
-void main2(){
-		/* Le tableau de bones : contiendra les positions des os */
-	glm::vec3 ** Bones;
-	glm::mat4 * bone_matrices = (glm::mat4 *)malloc(nb_bones * sizeof(glm::mat4));
-	Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
-	int b1;
-	for (b1 = 0; b1 < nb_bones; b1++){
-		Bones[b1] = (glm::vec3 *)malloc(4 * sizeof(glm::vec3));
+	if (session->cloth_on || session->occlusion_on)
+		printf("latence : tissu et occultation coupes pendant la mesure\n");
+	session->cloth_on = false;
+	session->occlusion_on = false;
+	latencyStart(session->width, session->height, nb_steps);
+	while (!latencyDone() && !latencyTimedOut()){
+		if (!sessionFrame(session))
+			break;
 	}
+	bool done = latencyDone();
+	char mode[128];
+	sprintf(mode, "ingest=%s depth=%i pace=%.0fms", latencyIngest(), session->pipeline_depth, session->frame_interval * 1000.0);
+	latencyReport(mode, "latency.json");
+	latencyStop();
+	return done ? 0 : 1;
+}
 
-	/* positions initiales des os du modele dans un txt pour traitement */
-	FILE* fichier2 = fopen("init_exploit-new.txt", "r");
-	if (fichier2 == NULL){
-		printf("Error loading the init file\n");
-		exit(1);
+/* ouvre un contexte GL cache pour que le pilote compresse les textures */
+int cookTextures(int nb_files, char** files){
+	glfwInit();
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = initGLFW(64, 64, "cook");
+	if (window == NULL){
+		printf("contexte GL indisponible\n");
+		return 1;
 	}
-	/* charge les donnes prcdentes */
-	initData(Bones, fichier2);
-	fclose(fichier2);
-	
-	/* variables */
-	float rot1 = 0.0f;
-	float rot2 = 0.0f;
-	int screen_width = 1024;
-	int screen_height = 768;
-	int width = 640;
-	int height = 480;
-	GLFWwindow* window = initGLFW(width, height, "PACT");
 	glfwMakeContextCurrent(window);
 	initGLEW();
 
-	/* le vao du vetement */
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	/* Appel du loader */
-	int point_ctr = 0;
-	int bone_ctr = 0;
-	glm::mat4 bone_offset_matrices[MAX_BONES];
-	loadModel(MODEL_FILE, &vao, &point_ctr, bone_offset_matrices, &bone_ctr);
-	printf("\nNombre de bones : %i\n", bone_ctr);
-
-	/* Les positions des os du modele de vetement et des donnes Kinect pour representation */
-
-	float * bone_positions3 = (float *)malloc(27 * sizeof(float));
-	float bone_positions4[] = {
-		0.031702, -0.305855, 0.561678,
-		-0.053113, -0.306185, 0.490401,
-		-0.136382, -0.286400, 0.348958,
-		-0.212196, -0.227865, 0.227038,
-		0.032215, -0.317140, 0.336961,
-		0.033871, -0.300125, 0.293703,
-		0.110854, -0.314255, 0.495051,
-		0.269807, -0.312715, 0.207836,
-		0.192558, -0.337995, 0.328809,
-	};
-
-	int h;
-	for (h = 0; h < 27; h++){
-		bone_positions3[h] = bone_positions4[h];
-	}
-
-	/* de mme pour les os Kinect */
-	GLuint bones_vao2;
-	glGenVertexArrays(1, &bones_vao2);
-	glBindVertexArray(bones_vao2);
-	GLuint bones_vbo2;
-	glGenBuffers(1, &bones_vbo2);
-	glBindBuffer(GL_ARRAY_BUFFER, bones_vbo2);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		3 * (bone_ctr + 2) * sizeof(float),
-		bone_positions3,
-		GL_STATIC_DRAW
-		);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
-	GLuint vertexShaderB2 = createShader(GL_VERTEX_SHADER, vertexSourceB2);
-	GLuint fragmentShaderB2 = createShader(GL_FRAGMENT_SHADER, fragmentSourceB2);
-
-	GLuint shaderProgramB2 = glCreateProgram();
-	glAttachShader(shaderProgramB2, vertexShaderB2);
-	glAttachShader(shaderProgramB2, fragmentShaderB2);
-	glBindFragDataLocation(shaderProgramB2, 0, "outColor");
-	glLinkProgram(shaderProgramB2);
-
-	/* Gestion des shaders du modele de vetement */
-	GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexSource);
-	GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-	GLuint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glBindFragDataLocation(shaderProgram, 0, "outColor");
-	glLinkProgram(shaderProgram);
-	glUseProgram(shaderProgram);
-
-	/* Initialisation des matrices de bones */
-	glm::mat4 identity = glm::mat4(1.0f);
-	int bone_matrices_loc[MAX_BONES];
-	char name[64];
-	for (int i = 0; i < MAX_BONES; i++){
-		sprintf(name, "bone_matrices[%i]", i);
-		bone_matrices_loc[i] = glGetUniformLocation(shaderProgram, name); // bone_matrices_loc : matrices de bones dans le programme C
-		glUniformMatrix4fv(bone_matrices_loc[i], 1, GL_FALSE, glm::value_ptr(identity));
-	}
-
-	/* Les matrices model, view, projection sont initialises */
-	glm::mat4 model = glm::mat4(1.0f);
-
-	glm::mat4 view = glm::lookAt(
-		glm::vec3(0.0f, 2.5f, 0.5f),
-		glm::vec3(0.0f, 0.0f, 0.0f),
-		glm::vec3(0.0f, 0.0f, 1.0f));
-	glm::mat4 proj = glm::perspective(45.0f, 1024.0f / 768.0f, 0.1f, 100.0f);
-
-	GLint uniModel = glGetUniformLocation(shaderProgram, "model");
-	model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-
-	GLint uniView = glGetUniformLocation(shaderProgram, "view");
-	glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
-
-	GLint uniProj = glGetUniformLocation(shaderProgram, "proj");
-	glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
-
-	/* gere le scaling du modele */
-	float scaleValue = 1.0f;
-	GLint uniScale = glGetUniformLocation(shaderProgram, "scale");
-	glUniform1f(uniScale, scaleValue);
-
-	/* lien avec les uniform mat des 2 shaders des os */
-	glUseProgram(shaderProgramB2);
-	GLint bones_view_mat_location2 = glGetUniformLocation(shaderProgramB2, "view");
-	glUniformMatrix4fv(bones_view_mat_location2, 1, GL_FALSE, glm::value_ptr(view));
-	GLint bones_proj_mat_location2 = glGetUniformLocation(shaderProgramB2, "proj");
-	glUniformMatrix4fv(bones_proj_mat_location2, 1, GL_FALSE, glm::value_ptr(proj));
-	GLint bones_model_mat_location2 = glGetUniformLocation(shaderProgramB2, "model");
-	glUniformMatrix4fv(bones_model_mat_location2, 1, GL_FALSE, glm::value_ptr(model));
-
-	FILE* commande;
-	char ordre = '0';
-	char ordrePrecedent = '1';
-	double newTime = 0.0f;
-	double elapsedTime = 0.0f;
-	
-	while (!glfwWindowShouldClose(window)){
-		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-			glfwSetWindowShouldClose(window, GL_TRUE);
-		
-		static double time = glfwGetTime();
-
-		do{
-			commande = fopen("commandeOuverture.txt", "r");
-			if (commande == NULL){
-				printf("error reading commande java\n");
-				exit(1);
-			}
-			ordrePrecedent = ordre;
-			fscanf(commande, "%c", &ordre);
-			fclose(commande);
-
-			if (ordrePrecedent == '1' && ordre == '0'){
-				glfwHideWindow(window);
-			}
-
-		} while (ordre == '0');
-			glfwShowWindow(window);
-
-		if(glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS){
-			return;
+	int failed = 0;
+	for (int f = 0; f < nb_files; f++){
+		if (!cookTexture(files[f])){
+			printf("echec de la conversion de %s\n", files[f]);
+			failed++;
 		}
-
-		/* Taille de la fenetre */
-		glfwGetWindowSize(window, &width, &height);
-		glfwSetWindowPos(window, (int)(screen_width - width) / 4.0, (int)(screen_height - height)/2.0);
-		
-		glm::mat4 proj = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 100.0f);
-		glUseProgram(shaderProgram);
-		glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
-		glViewport(0, 0, width, height);
-		
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		/* Rotation du modle */
-		rot1 = 0.0f;
-		rot2 = 0.0f;
-		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-			rot1 += 0.07f;
-
-		if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-			rot1 -= 0.07f;
-
-		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-			rot2 += 0.07f;
-
-		if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-			rot2 -= 0.07f;
-
-		glUseProgram(shaderProgram);
-		model = glm::rotate(model, glm::radians(rot2), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::rotate(model, glm::radians(rot1), glm::vec3(0.0f, 0.0f, 1.0f));
-		glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-		
-		glUseProgram(shaderProgramB2);
-		glUniformMatrix4fv(bones_model_mat_location2, 1, GL_FALSE, glm::value_ptr(model));
-
-		/* on dessine le vetement */
-		glEnable(GL_DEPTH_TEST);
-		glUseProgram(shaderProgram);
-		glBindVertexArray(vao);
-		glDrawArrays(GL_TRIANGLES, 0,point_ctr);
-
-		/* puis les positions des os */
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_PROGRAM_POINT_SIZE);
-		glUseProgram(shaderProgramB2);
-		glBindVertexArray(bones_vao2);
-		glDrawArrays(GL_POINTS, 0, bone_ctr + 2);
-		glDisable(GL_PROGRAM_POINT_SIZE);
-
-		newTime = glfwGetTime();
-		elapsedTime = newTime - time;
-
-				/* readKinectData */
-				readData(Bones);
-				updateTab(Bones, bone_positions3);
-
-				glUseProgram(shaderProgramB2);
-				glBufferData(
-					GL_ARRAY_BUFFER,
-					3 * (bone_ctr + 2) * sizeof(float),
-					bone_positions3,
-					GL_STATIC_DRAW
-					);
-
-				glUseProgram(shaderProgram);
-				glUniform1f(uniScale, scaleValue);
-
-				/* update les matrices */
-				updateData(Bones, bone_matrices);
-				int l;
-				for (l = 0; l < nb_bones; l++){
-					glUseProgram(shaderProgram);
-					glUniformMatrix4fv(bone_matrices_loc[l], 1, GL_FALSE, glm::value_ptr(bone_matrices[l]));
-				}
-
-					newTime = glfwGetTime();
-					elapsedTime = newTime - time;
-					while (elapsedTime < 0.04){
-						newTime = glfwGetTime();
-						elapsedTime = newTime - time;
-					}
-					time = newTime;
-
-			glfwSwapBuffers(window);
-			glfwPollEvents();
 	}
-	glDeleteProgram(shaderProgram);
-	glDeleteProgram(shaderProgramB2);
-	glDeleteShader(fragmentShader);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShaderB2);
-	glDeleteShader(vertexShaderB2);
-	glDeleteVertexArrays(1, &vao);
-	glDeleteVertexArrays(1, &bones_vao2);
-
 	glfwTerminate();
-
-	for (h = 0; h+2 < 27; h=h+3){
-		printf("%f, %f, %f\n", bone_positions3[h], bone_positions3[h+1], bone_positions3[h+2]);
-	}
-
-	return;
-}
\ No newline at end of file
+	return failed == 0 ? 0 : 1;
+}
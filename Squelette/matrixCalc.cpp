@@ -1,6 +1,13 @@
 #include "matrixCalc.h"
+#include "fileMap.h"
+#include "skeletonCodec.h"
+#include <stdlib.h>
+#include <string.h>
 extern int nb_bones;
 
+/* fichiers de positions : 2 lignes "x y z" par os, plus une marge pour les commentaires */
+#define KINECT_FILE_MAX (2 * 48 * nb_bones + 1024)
+
 /* Kinect :
 ofstream myfile;
 myfile.open ("skelcoordinates.txt", ios_base::out);
@@ -136,20 +143,95 @@ void initData(glm::vec3 ** Bones, FILE* fichier){
 	//	printf("Bone %d, frame 1. \n\told1 = (%f, %f, %f)\n\told2 = (%f, %f, %f)\n\n", i, Bones[i][0].x, Bones[i][0].y, Bones[i][0].z, Bones[i][1].x, Bones[i][1].y, Bones[i][1].z);
 }
 
-/* Lit les donnes Kinect et les range dans le tableau de Bones(lui mme tableau de vec3 */
-void readData(glm::vec3 ** Bones){
-	FILE* fichier = fopen("\\Users\\Utilisateur\\Documents\\Kinect Studio\\Samples\\ColorBasics-D2D - fonctionnel\\skelcoordinates.txt", "r"); //"bones-ordonnesTestJeu.txt"
-	if (fichier == NULL){
-		printf("error loading the file skelcoordinates.txt\n");
-		//exit(1);
+/* Relit les positions de repos depuis 'path' sans toucher a Bones si le fichier
+est incomplet (export en cours d'ecriture) : renvoie false dans ce cas.
+Le texte et les valeurs lues sont places dans 'scratch', sans allocation. */
+bool loadRestPose(glm::vec3 ** Bones, const char* path, FrameArena* scratch){
+	const char* text = arenaReadText(scratch, path, KINECT_FILE_MAX, NULL);
+	glm::vec3* rest = (glm::vec3 *)arenaAlloc(scratch, 2 * nb_bones * sizeof(glm::vec3));
+	if (text == NULL || rest == NULL)
+		return false;
+	int lus = 0;
+	for (int i = 0; i < 2 * nb_bones; i++)
+		lus += parseFloats(&text, &rest[i].x, 3);
+	if (lus != 6 * nb_bones)
+		return false;
+	for (int i = 0; i < nb_bones; i++){
+		Bones[i][0] = rest[2 * i];
+		Bones[i][1] = rest[2 * i + 1];
 	}
-	int i;
-	for (i = 0; i < nb_bones; i++){
-		fscanf(fichier, "%f %f %f", &Bones[i][2].x, &Bones[i][2].y, &Bones[i][2].z);
-		fscanf(fichier, "%f %f %f", &Bones[i][3].x, &Bones[i][3].y, &Bones[i][3].z);
+	return true;
+}
+
+/* Pose d'un fichier Kinect code (skeletonCodec.h) : en-tete et une image cle, decodee
+dans 'scratch' */
+static bool decodePose(glm::vec3 ** Bones, const unsigned char* data, size_t size, FrameArena* scratch, PoseTag* tag){
+	SkeletonHeader header;
+	if (!skeletonReadHeader(data, size, &header) || header.point_ctr != 2 * nb_bones)
+		return false;
+	SkeletonCodec codec;
+	float* points = (float *)arenaAlloc(scratch, 3 * header.point_ctr * sizeof(float));
+	void* memory = arenaAlloc(scratch, skeletonCodecBytes(header.point_ctr));
+	if (points == NULL || memory == NULL)
+		return false;
+	skeletonCodecInit(&codec, header.point_ctr, header.step, 1, memory);
+	if (skeletonDecode(&codec, data + sizeof(SkeletonHeader), size - sizeof(SkeletonHeader), points, tag) == 0)
+		return false;
+	for (int i = 0; i < nb_bones; i++){
+		Bones[i][2] = glm::vec3(points[6 * i], points[6 * i + 1], points[6 * i + 2]);
+		Bones[i][3] = glm::vec3(points[6 * i + 3], points[6 * i + 4], points[6 * i + 5]);
+	}
+	return true;
+}
+
+/* Lit une pose Kinect (positions [2] et [3] de chaque os) depuis 'path', texte ou image
+codee placee dans 'scratch', et son etiquette si 'tag' n'est pas NULL. false si le
+fichier est illisible ou incomplet. */
+bool readPose(glm::vec3 ** Bones, const char* path, FrameArena* scratch, PoseTag* tag){
+	if (tag != NULL){
+		tag->time = 0.0;
+		tag->step = -1;
+		tag->step_time = 0.0;
+		tag->coded = false;
+	}
+	size_t size = 0;
+	const char* text = arenaReadText(scratch, path, KINECT_FILE_MAX, &size);
+	if (text == NULL)
+		return false;
+	if (size >= sizeof(unsigned int) && *(const unsigned int *)text == SKELETON_MAGIC){
+		bool ok = decodePose(Bones, (const unsigned char *)text, size, scratch, tag);
+		if (tag != NULL)
+			tag->coded = true;
+		return ok;
+	}
+	int lus = 0;
+	for (int i = 0; i < nb_bones; i++){
+		lus += parseFloats(&text, &Bones[i][2].x, 3);
+		lus += parseFloats(&text, &Bones[i][3].x, 3);
 		//printf("Bone %d : (%f, %f, %f) -> (%f, %f, %f)\n", i, Bones[i][2].x, Bones[i][2].y, Bones[i][2].z, Bones[i][3].x, Bones[i][3].y, Bones[i][3].z);
 	}
-	fclose(fichier);
+	if (lus != 6 * nb_bones)
+		return false;
+
+	/* etiquette du traqueur de test, apres la derniere position */
+	if (tag != NULL){
+		while (*text == ' ' || *text == '\r' || *text == '\n' || *text == '\t')
+			text++;
+		if (*text == 't'){
+			char* end;
+			tag->time = strtod(text + 1, &end);
+			tag->step = (int)strtol(end, &end, 10);
+			tag->step_time = strtod(end, &end);
+		}
+	}
+	return true;
+}
+
+/* Lit les donnes Kinect et les range dans le tableau de Bones(lui mme tableau de vec3.
+Appele a chaque image : le fichier est lu dans 'scratch' plutot qu'avec fopen, qui alloue */
+void readData(glm::vec3 ** Bones, FrameArena* scratch, PoseTag* tag){
+	if (!readPose(Bones, KINECT_FILE, scratch, tag)) //"bones-ordonnesTestJeu.txt"
+		printf("error loading the file skelcoordinates.txt\n");
 }
 
 void resetData(glm::vec3 ** Bones){
@@ -165,4 +247,86 @@ void resetData(glm::vec3 ** Bones){
 		//printf("Bone %d : (%f, %f, %f) -> (%f, %f, %f)\n", i, Bones[i][2].x, Bones[i][2].y, Bones[i][2].z, Bones[i][3].x, Bones[i][3].y, Bones[i][3].z);
 	}
 	fclose(fichier);
-}
\ No newline at end of file
+}
+
+/* enregistrement code (skeletonCodec.h) : images decodees jusqu'a la premiere tronquee */
+static int decodeRecording(const unsigned char* data, size_t size, float** poses){
+	SkeletonHeader header;
+	if (!skeletonReadHeader(data, size, &header) || header.point_ctr != 2 * nb_bones){
+		printf("enregistrement code illisible ou pour un autre nombre d'os que %i\n", nb_bones);
+		*poses = NULL;
+		return 0;
+	}
+	SkeletonCodec codec;
+	void* memory = malloc(skeletonCodecBytes(header.point_ctr));
+	skeletonCodecInit(&codec, header.point_ctr, header.step, SKELETON_KEYFRAME, memory);
+	int per_frame = 6 * nb_bones;
+	int capacity = 16;
+	float* out = (float *)malloc(capacity * per_frame * sizeof(float));
+	int frames = 0;
+	size_t at = sizeof(SkeletonHeader);
+	for (;;){
+		if (frames == capacity){
+			capacity *= 2;
+			out = (float *)realloc(out, capacity * per_frame * sizeof(float));
+		}
+		size_t lus = skeletonDecode(&codec, data + at, size - at, out + frames * per_frame, NULL);
+		if (lus == 0)
+			break;
+		at += lus;
+		frames++;
+	}
+	free(memory);
+	*poses = out;
+	return frames;
+}
+
+/* Images de pose mises bout a bout ; les lignes qui ne sont pas des positions
+(etiquettes du traqueur de test, commentaires) sont ignorees. Les enregistrements
+codes sont reconnus a leur en-tete. */
+int readRecording(const char* path, float** poses){
+	size_t size = 0;
+	void* view = mapFile(path, &size);
+	if (view == NULL)
+		return 0;
+	if (size >= sizeof(unsigned int) && *(const unsigned int *)view == SKELETON_MAGIC){
+		int frames = decodeRecording((const unsigned char *)view, size, poses);
+		unmapFile(view, size);
+		return frames;
+	}
+	char* text = (char *)malloc(size + 1);
+	memcpy(text, view, size);
+	text[size] = '\0';
+	unmapFile(view, size);
+
+	int per_frame = 6 * nb_bones;
+	int capacity = 16;
+	float* out = (float *)malloc(capacity * per_frame * sizeof(float));
+	int frames = 0;
+	const char* p = text;
+	for (;;){
+		if (frames == capacity){
+			capacity *= 2;
+			out = (float *)realloc(out, capacity * per_frame * sizeof(float));
+		}
+		float* dst = out + frames * per_frame;
+		int lus = 0;
+		while (lus < per_frame){
+			lus += parseFloats(&p, dst + lus, per_frame - lus);
+			if (lus == per_frame)
+				break;
+			while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+				p++;
+			if (*p == '\0')
+				break;
+			while (*p != '\0' && *p != '\n')
+				p++;
+		}
+		if (lus < per_frame)
+			break;
+		frames++;
+	}
+	free(text);
+	*poses = out;
+	return frames;
+}
@@ -1,3 +1,6 @@
+#ifndef MATRIXCALC_H
+#define MATRIXCALC_H
+
 #ifndef GLM_H
 #define GLM_H
 #include <glm.hpp>
@@ -5,6 +8,21 @@
 #include <gtc/type_ptr.hpp>
 #endif
 #include <stdio.h>
+#include "frameArena.h"
+
+/* fichier ecrit par le programme Kinect a chaque image (ou par bench/fakeTracker) */
+#define REST_FILE "init_exploit-new.txt" // positions de repos des os, relues a chaud
+#define KINECT_FILE "\\Users\\Utilisateur\\Documents\\Kinect Studio\\Samples\\ColorBasics-D2D - fonctionnel\\skelcoordinates.txt"
+
+/* Etiquette facultative qui suit les positions : "t <date de l'image> <echelon> <date de l'echelon>".
+Le traqueur de test y indique le dernier changement brusque de pose, date avec la
+meme horloge que profNow, pour mesurer la latence jusqu'a l'affichage. step vaut -1 sans etiquette. */
+struct PoseTag{
+	double time;
+	int step;
+	double step_time;
+	bool coded;        // pose lue en image codee (skeletonCodec.h), pas en texte
+};
 
 
 float getRot(glm::vec3 ref1, glm::vec3 ref2, glm::vec3 mov1, glm::vec3 mov2);
@@ -12,7 +30,13 @@ glm::vec3 getTrans(glm::vec3 ref, glm::vec3 mov);
 glm::vec3 getNormal(glm::vec3 ref1, glm::vec3 ref2, glm::vec3 mov1, glm::vec3 mov2);
 glm::mat4 updateMatrix(glm::vec3 ref1, glm::vec3 ref2, glm::vec3 mov1, glm::vec3 mov2);
 void updateData(glm::vec3 ** Bones, glm::mat4 * bone_matrices); 
-void readData(glm::vec3 ** Bones);
+void readData(glm::vec3 ** Bones, FrameArena* scratch, PoseTag* tag);
+bool readPose(glm::vec3 ** Bones, const char* path, FrameArena* scratch, PoseTag* tag);
 void initData(glm::vec3 ** Bones, FILE* fichier);
+bool loadRestPose(glm::vec3 ** Bones, const char* path, FrameArena* scratch);
+/* enregistrement de poses (Squelette --record) : 6 * nb_bones valeurs par image, a liberer par free */
+int readRecording(const char* path, float** poses);
 float getScale(glm::vec3 ref1, glm::vec3 ref2, glm::vec3 mov1, glm::vec3 mov2);
-void resetData(glm::vec3 ** Bones);
\ No newline at end of file
+void resetData(glm::vec3 ** Bones);
+
+#endif
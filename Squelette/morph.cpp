@@ -0,0 +1,259 @@
+#include "morph.h"
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MORPH_SSE
+#include <emmintrin.h>
+#endif
+
+extern int nb_bones;
+
+static char* carve(char** cursor, size_t bytes){
+	char* p = *cursor;
+	*cursor += (bytes + 15) & ~(size_t)15;
+	return p;
+}
+
+static size_t aligned(size_t bytes){
+	return (bytes + 15) & ~(size_t)15;
+}
+
+/* mesure pilotant la cible d'apres son nom, false si le nom n'en decrit aucune */
+static bool parseTarget(const char* name, MorphTarget* target){
+	int a = -1;
+	int b = -1;
+	float pct = 0.0f;
+	if (sscanf(name, "kinect%d-%d_%f", &a, &b, &pct) != 3){
+		b = -1;
+		if (sscanf(name, "kinect%d_%f", &a, &pct) != 2)
+			return false;
+	}
+	if (a < 0 || a >= nb_bones || b >= nb_bones || pct == 0.0f)
+		return false;
+	target->bone_a = a;
+	target->bone_b = b;
+	target->amplitude = pct / 100.0f;
+	return true;
+}
+
+MorphSet* morphCreate(const ModelData* data){
+	if (data->morph_ctr == 0)
+		return NULL;
+	int n = data->point_ctr;
+
+	/* cibles pilotables et sommets qu'elles touchent */
+	MorphTarget* targets = (MorphTarget*)calloc(data->morph_ctr, sizeof(MorphTarget));
+	unsigned char* touched = (unsigned char*)calloc(n, 1);
+	int target_ctr = 0;
+	int delta_ctr = 0;
+	for (int m = 0; m < data->morph_ctr; m++){
+		const ModelMorph* morph = &data->morphs[m];
+		MorphTarget* target = &targets[target_ctr];
+		if (!parseTarget(morph->name, target)){
+			printf("cible de morph %s ignoree : nom sans mesure (kinect<os>_<pct> ou kinect<a>-<b>_<pct>)\n", morph->name);
+			continue;
+		}
+		target->delta_start = morph->delta_start;
+		target->delta_ctr = morph->delta_ctr;
+		for (int d = morph->delta_start; d < morph->delta_start + morph->delta_ctr; d++)
+			touched[data->deltas[d].vertex] = 1;
+		delta_ctr += morph->delta_ctr;
+		target_ctr++;
+	}
+	int affected_ctr = 0;
+	for (int v = 0; v < n; v++)
+		affected_ctr += touched[v];
+	if (target_ctr == 0 || affected_ctr == 0){
+		free(targets);
+		free(touched);
+		return NULL;
+	}
+
+	size_t total = aligned(target_ctr * sizeof(MorphTarget)) + aligned(affected_ctr * sizeof(int))
+		+ aligned(delta_ctr * sizeof(int)) + aligned(8 * delta_ctr * sizeof(float))
+		+ 2 * aligned(8 * affected_ctr * sizeof(float)) + aligned(target_ctr * sizeof(float))
+		+ 2 * aligned(3 * n * sizeof(float));
+	MorphSet* morph = (MorphSet*)calloc(1, sizeof(MorphSet));
+	morph->block = calloc(1, total);
+	char* cursor = (char*)morph->block;
+	morph->targets = (MorphTarget*)carve(&cursor, target_ctr * sizeof(MorphTarget));
+	morph->affected = (int*)carve(&cursor, affected_ctr * sizeof(int));
+	morph->delta_slot = (int*)carve(&cursor, delta_ctr * sizeof(int));
+	morph->deltas = (float*)carve(&cursor, 8 * delta_ctr * sizeof(float));
+	morph->base = (float*)carve(&cursor, 8 * affected_ctr * sizeof(float));
+	morph->morphed = (float*)carve(&cursor, 8 * affected_ctr * sizeof(float));
+	morph->weights = (float*)carve(&cursor, target_ctr * sizeof(float));
+	morph->points = (float*)carve(&cursor, 3 * n * sizeof(float));
+	if (data->normals != NULL)
+		morph->normals = (float*)carve(&cursor, 3 * n * sizeof(float));
+	morph->vertex_ctr = n;
+	morph->target_ctr = target_ctr;
+	morph->affected_ctr = affected_ctr;
+	memcpy(morph->points, data->points, 3 * n * sizeof(float));
+	if (morph->normals != NULL)
+		memcpy(morph->normals, data->normals, 3 * n * sizeof(float));
+
+	/* rang de chaque sommet touche, et sa position et sa normale de base */
+	int* slot_of = (int*)malloc(n * sizeof(int));
+	int a = 0;
+	for (int v = 0; v < n; v++){
+		if (!touched[v])
+			continue;
+		slot_of[v] = a;
+		morph->affected[a] = v;
+		float* b = &morph->base[8 * a];
+		for (int k = 0; k < 3; k++){
+			b[k] = data->points[3 * v + k];
+			b[4 + k] = data->normals != NULL ? data->normals[3 * v + k] : 0.0f;
+		}
+		a++;
+	}
+
+	/* deltas recopies cible par cible, a la suite */
+	int d = 0;
+	for (int t = 0; t < target_ctr; t++){
+		MorphTarget* target = &targets[t];
+		int start = d;
+		for (int i = target->delta_start; i < target->delta_start + target->delta_ctr; i++){
+			const MorphDelta* delta = &data->deltas[i];
+			morph->delta_slot[d] = slot_of[delta->vertex];
+			float* o = &morph->deltas[8 * d];
+			for (int k = 0; k < 3; k++){
+				o[k] = delta->dp[k];
+				o[4 + k] = delta->dn[k];
+			}
+			d++;
+		}
+		target->delta_start = start;
+	}
+	memcpy(morph->targets, targets, target_ctr * sizeof(MorphTarget));
+	free(slot_of);
+	free(targets);
+	free(touched);
+
+	printf("%i cibles de morph, %i sommets touches sur %i\n", target_ctr, affected_ctr, n);
+	return morph;
+}
+
+void morphDestroy(MorphSet* morph){
+	if (morph == NULL)
+		return;
+	free(morph->block);
+	free(morph);
+}
+
+void morphRecalibrate(MorphSet* morph){
+	if (morph == NULL)
+		return;
+	morph->frames = 0;
+	for (int t = 0; t < morph->target_ctr; t++){
+		morph->targets[t].sum = 0.0;
+		morph->targets[t].measured = 0;
+	}
+}
+
+bool morphMeasure(MorphSet* morph, glm::vec3** Bones, int nb_bones){
+	if (morph->frames >= MORPH_CALIBRATION_FRAMES)
+		return false;
+	for (int t = 0; t < morph->target_ctr; t++){
+		MorphTarget* target = &morph->targets[t];
+		if (target->bone_a >= nb_bones || target->bone_b >= nb_bones)
+			continue;
+		float rest;
+		float kinect;
+		if (target->bone_b < 0){
+			rest = glm::length(Bones[target->bone_a][1] - Bones[target->bone_a][0]);
+			kinect = glm::length(Bones[target->bone_a][3] - Bones[target->bone_a][2]);
+		}
+		else{
+			rest = glm::length(Bones[target->bone_b][0] - Bones[target->bone_a][0]);
+			kinect = glm::length(Bones[target->bone_b][2] - Bones[target->bone_a][2]);
+		}
+		/* os non suivi dans l'image : pas de mesure */
+		if (rest <= 1e-6f || kinect <= 1e-6f)
+			continue;
+		target->sum += kinect / rest;
+		target->measured++;
+	}
+	if (++morph->frames < MORPH_CALIBRATION_FRAMES)
+		return false;
+
+	/* poids : ecart relatif moyen a la mesure de repos, rapporte a celui de la cible */
+	for (int t = 0; t < morph->target_ctr; t++){
+		const MorphTarget* target = &morph->targets[t];
+		float ratio = target->measured > 0 ? (float)(target->sum / target->measured) : 1.0f;
+		float w = (ratio - 1.0f) / target->amplitude;
+		morph->weights[t] = w < 0.0f ? 0.0f : (w > MORPH_MAX_WEIGHT ? MORPH_MAX_WEIGHT : w);
+	}
+	return true;
+}
+
+/* morphed = base + somme des poids * deltas, sur les seuls sommets touches */
+static void evaluate(MorphSet* morph){
+	memcpy(morph->morphed, morph->base, 8 * morph->affected_ctr * sizeof(float));
+	for (int t = 0; t < morph->target_ctr; t++){
+		const MorphTarget* target = &morph->targets[t];
+		float w = morph->weights[t];
+		if (w == 0.0f)
+			continue;
+		const float* deltas = &morph->deltas[8 * target->delta_start];
+		const int* slots = &morph->delta_slot[target->delta_start];
+#ifdef MORPH_SSE
+		/* le bloc vient de calloc, aligne sur 8 octets seulement sous Win32 : acces non alignes */
+		__m128 wv = _mm_set1_ps(w);
+		for (int d = 0; d < target->delta_ctr; d++){
+			float* o = &morph->morphed[8 * slots[d]];
+			_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_mul_ps(wv, _mm_loadu_ps(&deltas[8 * d]))));
+			_mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_mul_ps(wv, _mm_loadu_ps(&deltas[8 * d + 4]))));
+		}
+#else
+		for (int d = 0; d < target->delta_ctr; d++){
+			float* o = &morph->morphed[8 * slots[d]];
+			for (int k = 0; k < 8; k++)
+				o[k] += w * deltas[8 * d + k];
+		}
+#endif
+	}
+
+	for (int a = 0; a < morph->affected_ctr; a++){
+		const float* m = &morph->morphed[8 * a];
+		int v = morph->affected[a];
+		for (int k = 0; k < 3; k++)
+			morph->points[3 * v + k] = m[k];
+		if (morph->normals == NULL)
+			continue;
+		float len = sqrtf(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]);
+		float inv = len > 0.0f ? 1.0f / len : 0.0f;
+		for (int k = 0; k < 3; k++)
+			morph->normals[3 * v + k] = m[4 + k] * inv;
+	}
+}
+
+/* envoie les sommets touches de src, les plages voisines fusionnees */
+static void uploadAffected(const MorphSet* morph, GLuint buffer, const float* src){
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	int start = morph->affected[0];
+	int end = start + 1;
+	for (int a = 1; a <= morph->affected_ctr; a++){
+		if (a < morph->affected_ctr && morph->affected[a] - end <= MORPH_UPLOAD_GAP){
+			end = morph->affected[a] + 1;
+			continue;
+		}
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)start * 3 * sizeof(float),
+			(GLsizeiptr)(end - start) * 3 * sizeof(float), &src[3 * start]);
+		if (a < morph->affected_ctr){
+			start = morph->affected[a];
+			end = start + 1;
+		}
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void morphApply(MorphSet* morph, GLuint points_buffer, GLuint normals_buffer){
+	evaluate(morph);
+	uploadAffected(morph, points_buffer, morph->points);
+	if (morph->normals != NULL)
+		uploadAffected(morph, normals_buffer, morph->normals);
+}
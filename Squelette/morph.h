@@ -0,0 +1,65 @@
+#ifndef MORPH_H
+#define MORPH_H
+
+#include "importer.h"
+
+/* Cibles de morph du vetement (blendshapes du .dae), pour l'ajuster a la morphologie de
+l'utilisateur au-dela du facteur uniforme par os de getScale. Chaque cible ne garde que
+les sommets qu'elle deplace (MorphDelta) ; son poids est pilote par une mesure du corps,
+d'apres son nom :
+  kinect<i>_<pct>      longueur de l'os i, la cible etant faite pour un os pct % plus long qu'au repos ;
+  kinect<a>-<b>_<pct>  distance entre les origines des os a et b (epaules, hanches).
+Les mesures sont moyennees sur les MORPH_CALIBRATION_FRAMES premieres images de
+l'utilisateur puis figees : le vetement n'est deforme qu'une fois par utilisateur.
+Les positions et normales de repos deformees sont calculees en SSE sur les seuls sommets
+touches, puis envoyees par plages aux buffers du vetement, avant tout skinning (shader,
+cpuSkin.h ou cloth.h). */
+
+#define MORPH_EPSILON 1e-5f          // ecart sous lequel un sommet n'est pas touche par une cible (import)
+#define MORPH_CALIBRATION_FRAMES 50  // images moyennees par mesure (2 s a 25 images/s)
+#define MORPH_MAX_WEIGHT 1.5f        // extrapolation toleree au-dela de la cible
+#define MORPH_UPLOAD_GAP 32          // sommets non touches envoyes pour fusionner deux plages
+
+struct MorphTarget{
+	int bone_a;
+	int bone_b;        // -1 : longueur de l'os bone_a
+	float amplitude;   // ecart relatif de la mesure pour lequel le poids vaut 1
+	int delta_start;
+	int delta_ctr;
+	double sum;        // rapports mesure / repos accumules pendant l'etalonnage
+	int measured;
+};
+
+/* sommets touches en AoS : 8 floats (position, 0, normale, 0) */
+struct MorphSet{
+	int vertex_ctr;
+	int target_ctr;
+	int affected_ctr;
+	MorphTarget* targets;
+	int* affected;     // sommets touches par au moins une cible, croissants
+	int* delta_slot;   // par delta, rang de son sommet dans affected
+	float* deltas;     // 8 par delta
+	float* base;       // 8 par sommet touche
+	float* morphed;    // 8 par sommet touche
+	float* weights;    // par cible
+	float* points;     // 3 par sommet : positions de repos deformees
+	float* normals;    // 3 par sommet, NULL si le vetement n'a pas de normales
+	int frames;        // images d'etalonnage deja vues
+	void* block;
+};
+
+/* NULL si le vetement n'a aucune cible pilotable */
+MorphSet* morphCreate(const ModelData* data);
+void morphDestroy(MorphSet* morph);
+
+/* nouvel utilisateur : les mesures sont refaites, la deformation courante reste jusque-la */
+void morphRecalibrate(MorphSet* morph);
+
+/* Bones comme Session::Bones : [0..1] repos, [2..3] Kinect. Renvoie true a la fin de
+l'etalonnage : de nouveaux poids sont a appliquer */
+bool morphMeasure(MorphSet* morph, glm::vec3** Bones, int nb_bones);
+
+/* recalcule les sommets touches et les envoie ; normals_buffer est ignore sans normales */
+void morphApply(MorphSet* morph, GLuint points_buffer, GLuint normals_buffer);
+
+#endif
@@ -0,0 +1,105 @@
+#include "occlusion.h"
+#include "frameRing.h"
+#include "profiler.h"
+#include "fileMap.h"
+#include "frameArena.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static FrameRing ring;
+static RingTexture stream;
+static OcclusionCalibration calibration = {
+	{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+	OCCLUSION_FX, OCCLUSION_FY, OCCLUSION_CX, OCCLUSION_CY
+};
+
+bool occlusionCalibrate(const char* path){
+	char text[2048];
+	long lus = readFileInto(path, text, sizeof(text) - 1);
+	if (lus < 0){
+		printf("calibration du capteur %s illisible\n", path);
+		return false;
+	}
+	text[lus] = '\0';
+	float values[20];
+	const char* p = text;
+	if (parseFloats(&p, values, 20) != 20){
+		printf("calibration du capteur %s incomplete : 20 nombres attendus\n", path);
+		return false;
+	}
+	/* fichier ligne par ligne, matrice GL colonne par colonne */
+	for (int r = 0; r < 4; r++){
+		for (int c = 0; c < 4; c++)
+			calibration.sensor_from_eye[4 * c + r] = values[4 * r + c];
+	}
+	calibration.fx = values[16];
+	calibration.fy = values[17];
+	calibration.cx = values[18];
+	calibration.cy = values[19];
+	return true;
+}
+
+const OcclusionCalibration* occlusionCalibration(){
+	return &calibration;
+}
+
+/* meme calcul que behindUser (session.cpp), texel le plus proche */
+bool occlusionProject(const OcclusionCalibration* c, const float eye[3], int width, int height,
+	int* column, int* row, float* depth){
+	const float* m = c->sensor_from_eye;
+	float s[3];
+	for (int k = 0; k < 3; k++)
+		s[k] = m[k] * eye[0] + m[4 + k] * eye[1] + m[8 + k] * eye[2] + m[12 + k];
+	float d = -s[2];
+	if (d <= 0.0f)
+		return false;
+	float u = (c->cx + c->fx * s[0] / d) / width;
+	float v = (c->cy - c->fy * s[1] / d) / height;
+	if (OCCLUSION_MIRROR != 0)
+		u = 1.0f - u;
+	if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+		return false;
+	int x = (int)floorf(u * width);
+	int y = (int)floorf(v * height);
+	*column = x < width ? x : width - 1;
+	*row = y < height ? y : height - 1;
+	*depth = d;
+	return true;
+}
+
+bool occlusionOpen(const char* source){
+	if (!ringOpen(&ring, source, true)){
+		printf("occultation : desactivee\n");
+		return false;
+	}
+	ringTextureCreate(&stream, &ring);
+	return true;
+}
+
+void occlusionUniforms(GLuint program){
+	glUniform1i(glGetUniformLocation(program, "depth_map"), OCCLUSION_UNIT);
+	glUniformMatrix4fv(glGetUniformLocation(program, "sensor_from_eye"), 1, GL_FALSE, calibration.sensor_from_eye);
+	glUniform4f(glGetUniformLocation(program, "sensor_intrinsics"), calibration.fx, calibration.fy, calibration.cx, calibration.cy);
+}
+
+void occlusionClose(){
+	if (ring.header == NULL)
+		return;
+	ringClose(&ring);
+	ringTextureDestroy(&stream);
+}
+
+bool occlusionUpdate(){
+	if (ring.header == NULL)
+		return false;
+	profBeginCPU(STAGE_OCCLUSION);
+	profBeginGPU(STAGE_OCCLUSION);
+	ringTextureUpdate(&stream, &ring);
+	glActiveTexture(GL_TEXTURE0 + OCCLUSION_UNIT);
+	glBindTexture(GL_TEXTURE_2D, stream.texture);
+	glActiveTexture(GL_TEXTURE0);
+	profEndGPU(STAGE_OCCLUSION);
+	profEndCPU(STAGE_OCCLUSION);
+	return stream.shown != 0;
+}
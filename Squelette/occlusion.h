@@ -0,0 +1,62 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#include "background.h"
+
+/* Occultation du vetement par l'utilisateur (Squelette --occlusion SOURCE) : les bras croises
+devant le corps cachent le vetement. SOURCE est un anneau d'images de profondeur 16 bits en
+mm (frameRing.h) : memoire partagee du capteur, ou suite de PGM 16 bits pour les essais.
+La derniere image est envoyee au plus une fois par image affichee dans une texture R16 de
+l'unite OCCLUSION_UNIT.
+Les positions du vetement sont centrees sur le corps (repere des joints Kinect) et la camera
+du vetement (defaultView) n'est pas le capteur : une calibration de l'installation donne
+sensor_from_eye, passage de l'espace camera du vetement (view * model) a l'espace du
+capteur en metres (capteur vers -z, y vers le haut, comme une camera GL), et les
+parametres internes du capteur. Le fragment shader du vetement (behindUser) fait le meme
+calcul que occlusionProject : il lit la profondeur mesuree au texel le plus proche et se
+rejette s'il est derriere l'utilisateur. Sans calibration (Squelette --occlusion-calib),
+le capteur est suppose a la camera du vetement, avec les parametres d'une Kinect v2. */
+
+#define OCCLUSION_UNIT 1                     // unite de texture de la carte de profondeur
+#define OCCLUSION_FX 365.5f                  // parametres internes par defaut (pixels, Kinect v2)
+#define OCCLUSION_FY 365.5f
+#define OCCLUSION_CX 257.0f
+#define OCCLUSION_CY 208.0f
+#define OCCLUSION_MARGIN 0.03                // ecart (m) sous lequel le vetement reste devant
+#define OCCLUSION_MIRROR BACKGROUND_MIRROR   // meme retournement que l'image couleur
+
+/* Fichier de calibration : 20 nombres separes par des blancs, les 4 lignes de
+sensor_from_eye (rotation et translation en metres, derniere ligne 0 0 0 1) puis fx fy cx cy */
+struct OcclusionCalibration{
+	float sensor_from_eye[16]; // colonne par colonne, comme glUniformMatrix4fv
+	float fx;
+	float fy;
+	float cx;
+	float cy;
+};
+
+/* avant sessionInit ; false si le fichier est illisible ou incomplet (calibration par defaut) */
+bool occlusionCalibrate(const char* path);
+const OcclusionCalibration* occlusionCalibration();
+
+/* Texel de la carte (width x height) vu par le capteur au point 'eye' de l'espace camera du
+vetement, et sa distance au capteur ; false s'il est derriere le capteur ou hors de la carte */
+bool occlusionProject(const OcclusionCalibration* calibration, const float eye[3], int width, int height,
+	int* column, int* row, float* depth);
+
+/* contexte GL courant ; false si la source est absente ou invalide (pas d'occultation) */
+bool occlusionOpen(const char* source);
+void occlusionClose();
+/* calibration et unite de la carte pour un programme du vetement, programme courant */
+void occlusionUniforms(GLuint program);
+
+/* envoie la derniere carte si elle est nouvelle et la lie a OCCLUSION_UNIT ; false tant
+qu'aucune carte n'est disponible. Thread de rendu, avant le dessin du vetement. */
+bool occlusionUpdate();
+
+#endif
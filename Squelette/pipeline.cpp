@@ -0,0 +1,325 @@
+#include "pipeline.h"
+#include "matrixCalc.h"
+#include "session.h"
+#include "profiler.h"
+#include "frameArena.h"
+#include "allocAudit.h"
+#include "skeletonCodec.h"
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+extern int nb_bones;
+
+/* file bornee d'indices de FrameSlot ; pop renvoie -1 a l'arret */
+struct SlotQueue{
+	int items[PIPELINE_MAX_DEPTH];
+	int head;
+	int ctr;
+	std::mutex lock;
+	std::condition_variable wake;
+};
+
+static FrameSlot slots[PIPELINE_MAX_DEPTH];
+static int depth = 0;
+static SlotQueue free_queue;     // rendu -> lecture
+static SlotQueue ingest_queue;   // lecture -> calcul
+static SlotQueue solve_queue;    // calcul -> rendu
+static std::thread* ingest_thread = NULL;
+static std::thread* solve_thread = NULL;
+static std::atomic<bool> stopping(false);
+static std::atomic<int> epoch(0);
+static FrameArena ingest_arena;  // texte du fichier Kinect, rendu a chaque image
+static FILE* record = NULL;      // poses lues, ajoutees au fichier de --record
+static SkeletonCodec record_codec; // enregistrement .skc ; previous est NULL en texte
+static float* record_points = NULL;
+static unsigned char* record_frame = NULL;
+
+/* Pose de repos courante, propre au thread de calcul : scaleData la met a l'echelle
+en place a chaque image, elle evolue donc d'une image a l'autre comme avant le pipeline.
+pipelineSetRest la remplace via 'rest_pending', pris en compte a l'image suivante. */
+static glm::vec3* rest = NULL;
+static glm::vec3* rest_pending = NULL;
+static bool rest_changed = false;
+static std::mutex rest_lock;
+
+/* Matrices de reference des bones, propres au thread de calcul : celles de la derniere
+image ou chaque bone a ete signale. Comparer a la reference plutot qu'a l'image
+precedente borne l'ecart accumule par un bone qui derive lentement. */
+static glm::mat4* reference = NULL;
+static int reference_epoch = -1;
+
+/* latence lecture -> affichage, relevee par le thread de rendu */
+static int displayed_ctr = 0;
+static double latency_sum = 0.0;
+static double latency_max = 0.0;
+
+static void queuePush(SlotQueue* q, int item){
+	std::lock_guard<std::mutex> lk(q->lock);
+	q->items[(q->head + q->ctr) % PIPELINE_MAX_DEPTH] = item;
+	q->ctr++;
+	q->wake.notify_one();
+}
+
+static int queuePop(SlotQueue* q){
+	std::unique_lock<std::mutex> lk(q->lock);
+	q->wake.wait(lk, [q]{ return stopping || q->ctr > 0; });
+	if (stopping)
+		return -1;
+	int item = q->items[q->head];
+	q->head = (q->head + 1) % PIPELINE_MAX_DEPTH;
+	q->ctr--;
+	return item;
+}
+
+static void queueClear(SlotQueue* q){
+	std::lock_guard<std::mutex> lk(q->lock);
+	q->head = 0;
+	q->ctr = 0;
+}
+
+static void queueWake(SlotQueue* q){
+	std::lock_guard<std::mutex> lk(q->lock);
+	q->wake.notify_all();
+}
+
+/* texte comme le fichier Kinect, ou image codee avec son etiquette */
+static void recordPose(const FrameSlot* slot){
+	if (record_codec.previous == NULL){
+		for (int b = 0; b < nb_bones; b++){
+			fprintf(record, "%f %f %f\n", slot->Bones[b][2].x, slot->Bones[b][2].y, slot->Bones[b][2].z);
+			fprintf(record, "%f %f %f\n", slot->Bones[b][3].x, slot->Bones[b][3].y, slot->Bones[b][3].z);
+		}
+		return;
+	}
+	for (int b = 0; b < nb_bones; b++){
+		memcpy(&record_points[6 * b], &slot->Bones[b][2].x, 3 * sizeof(float));
+		memcpy(&record_points[6 * b + 3], &slot->Bones[b][3].x, 3 * sizeof(float));
+	}
+	size_t size = skeletonEncode(&record_codec, record_points, &slot->tag, record_frame);
+	fwrite(record_frame, 1, size, record);
+}
+
+/* etage 1 : positions Kinect */
+static void ingestMain(){
+	profThread("ingest");
+	allocAuditThread();
+	int frame = 0;
+	for (;;){
+		int i = queuePop(&free_queue);
+		if (i < 0)
+			return;
+		FrameSlot* slot = &slots[i];
+		slot->frame = ++frame;
+		slot->epoch = epoch;
+		slot->ingest_time = profNow();
+
+		profBeginCPU(STAGE_INGEST);
+		arenaReset(&ingest_arena);
+		readData(slot->Bones, &ingest_arena, &slot->tag);
+		updateTab(slot->Bones, slot->joint_positions);
+		profEndCPU(STAGE_INGEST);
+		if (record != NULL)
+			recordPose(slot);
+
+		queuePush(&ingest_queue, i);
+	}
+}
+
+/* bones qui ont bouge depuis leur reference ; tous apres pipelineReset */
+static void markDirty(FrameSlot* slot){
+	bool all = slot->epoch != reference_epoch;
+	reference_epoch = slot->epoch;
+	for (int b = 0; b < nb_bones; b++){
+		const float* m = glm::value_ptr(slot->bone_matrices[b]);
+		const float* ref = glm::value_ptr(reference[b]);
+		bool moved = all;
+		for (int k = 0; k < 16 && !moved; k++)
+			moved = fabsf(m[k] - ref[k]) > PIPELINE_DIRTY_EPSILON;
+		slot->bone_dirty[b] = moved ? 1 : 0;
+		if (moved)
+			reference[b] = slot->bone_matrices[b];
+	}
+}
+
+/* etage 2 : matrices de bones */
+static void solveMain(){
+	profThread("solve");
+	allocAuditThread();
+	for (;;){
+		int i = queuePop(&ingest_queue);
+		if (i < 0)
+			return;
+		FrameSlot* slot = &slots[i];
+		{
+			std::lock_guard<std::mutex> lk(rest_lock);
+			if (rest_changed){
+				memcpy(rest, rest_pending, 2 * nb_bones * sizeof(glm::vec3));
+				rest_changed = false;
+			}
+		}
+
+		profBeginCPU(STAGE_SOLVE);
+		for (int b = 0; b < nb_bones; b++){
+			slot->Bones[b][0] = rest[2 * b];
+			slot->Bones[b][1] = rest[2 * b + 1];
+		}
+		updateData(slot->Bones, slot->bone_matrices);
+		markDirty(slot);
+		bodyBuild(&slot->body, slot->Bones, nb_bones);
+		for (int b = 0; b < nb_bones; b++){
+			rest[2 * b] = slot->Bones[b][0];
+			rest[2 * b + 1] = slot->Bones[b][1];
+		}
+		profEndCPU(STAGE_SOLVE);
+
+		queuePush(&solve_queue, i);
+	}
+}
+
+void pipelineStart(int pipeline_depth, int joint_ctr){
+	if (ingest_thread != NULL)
+		return;
+	depth = pipeline_depth;
+	if (depth < 1)
+		depth = 1;
+	if (depth > PIPELINE_MAX_DEPTH)
+		depth = PIPELINE_MAX_DEPTH;
+
+	rest = (glm::vec3 *)calloc(2 * nb_bones, sizeof(glm::vec3));
+	rest_pending = (glm::vec3 *)calloc(2 * nb_bones, sizeof(glm::vec3));
+	reference = (glm::mat4 *)calloc(nb_bones, sizeof(glm::mat4));
+	reference_epoch = -1;
+	arenaInit(&ingest_arena, FRAME_ARENA_SIZE);
+	for (int i = 0; i < depth; i++){
+		FrameSlot* slot = &slots[i];
+		memset(slot, 0, sizeof(FrameSlot));
+		slot->Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
+		for (int b = 0; b < nb_bones; b++)
+			slot->Bones[b] = (glm::vec3 *)calloc(4, sizeof(glm::vec3));
+		slot->bone_matrices = (glm::mat4 *)malloc(nb_bones * sizeof(glm::mat4));
+		slot->bone_dirty = (unsigned char *)malloc(nb_bones * sizeof(unsigned char));
+		slot->joint_positions = (float *)calloc(3 * joint_ctr, sizeof(float));
+	}
+	queueClear(&free_queue);
+	queueClear(&ingest_queue);
+	queueClear(&solve_queue);
+	for (int i = 0; i < depth; i++)
+		queuePush(&free_queue, i);
+
+	displayed_ctr = 0;
+	latency_sum = 0.0;
+	latency_max = 0.0;
+	stopping = false;
+	ingest_thread = new std::thread(ingestMain);
+	solve_thread = new std::thread(solveMain);
+	printf("pipeline lecture/calcul/rendu, profondeur %i\n", depth);
+}
+
+/* nouvelle pose de repos (rechargement ou remise a zero), copiee pour le thread de calcul */
+void pipelineSetRest(glm::vec3** Bones){
+	std::lock_guard<std::mutex> lk(rest_lock);
+	for (int b = 0; b < nb_bones; b++){
+		rest_pending[2 * b] = Bones[b][0];
+		rest_pending[2 * b + 1] = Bones[b][1];
+	}
+	rest_changed = true;
+}
+
+/* Enregistre chaque pose lue, dans le format du fichier Kinect mis bout a bout, ou codee
+au pas 'precision' (m) si path finit par SKELETON_EXTENSION : rejouable par le test des
+images de reference (golden.h). Avant pipelineStart. */
+bool pipelineRecord(const char* path, float precision){
+	size_t length = strlen(path);
+	size_t ext = strlen(SKELETON_EXTENSION);
+	bool coded = length > ext && strcmp(path + length - ext, SKELETON_EXTENSION) == 0;
+	record = fopen(path, coded ? "wb" : "w");
+	if (record == NULL || !coded)
+		return record != NULL;
+	int point_ctr = 2 * nb_bones;
+	record_points = (float *)malloc(3 * point_ctr * sizeof(float));
+	record_frame = (unsigned char *)malloc(sizeof(SkeletonHeader) + SKELETON_FRAME_MAX(point_ctr));
+	skeletonCodecInit(&record_codec, point_ctr, precision, SKELETON_KEYFRAME, malloc(skeletonCodecBytes(point_ctr)));
+	size_t size = skeletonWriteHeader(&record_codec, record_frame);
+	fwrite(record_frame, 1, size, record);
+	return true;
+}
+
+/* les images deja en vol ne seront pas affichees */
+int pipelineReset(){
+	return ++epoch;
+}
+
+/* Image suivante, calculee, dans l'ordre ; attend si le calcul est en retard.
+Renvoie NULL pour une image anterieure a pipelineReset (deja rendue) ou a l'arret. */
+FrameSlot* pipelineAcquire(){
+	profBeginCPU(STAGE_WAIT);
+	int i = queuePop(&solve_queue);
+	profEndCPU(STAGE_WAIT);
+	if (i < 0)
+		return NULL;
+	if (slots[i].epoch != epoch){
+		pipelineRelease(&slots[i]);
+		return NULL;
+	}
+	return &slots[i];
+}
+
+void pipelineRelease(FrameSlot* slot){
+	queuePush(&free_queue, (int)(slot - slots));
+}
+
+/* a appeler apres l'echange des buffers */
+void pipelineDisplayed(double ingest_time){
+	double ms = (profNow() - ingest_time) * 1000.0;
+	displayed_ctr++;
+	latency_sum += ms;
+	if (ms > latency_max)
+		latency_max = ms;
+}
+
+void pipelineStop(){
+	if (ingest_thread == NULL)
+		return;
+	stopping = true;
+	queueWake(&free_queue);
+	queueWake(&ingest_queue);
+	queueWake(&solve_queue);
+	ingest_thread->join();
+	solve_thread->join();
+	delete ingest_thread;
+	delete solve_thread;
+	ingest_thread = NULL;
+	solve_thread = NULL;
+
+	if (displayed_ctr > 0)
+		printf("pipeline profondeur %i : %i images, latence lecture -> affichage moy=%.1f max=%.1f ms\n",
+			depth, displayed_ctr, latency_sum / displayed_ctr, latency_max);
+	for (int i = 0; i < depth; i++){
+		for (int b = 0; b < nb_bones; b++)
+			free(slots[i].Bones[b]);
+		free(slots[i].Bones);
+		free(slots[i].bone_matrices);
+		free(slots[i].bone_dirty);
+		free(slots[i].joint_positions);
+	}
+	free(rest);
+	free(rest_pending);
+	free(reference);
+	arenaFree(&ingest_arena);
+	if (record != NULL)
+		fclose(record);
+	record = NULL;
+	free(record_codec.previous);
+	free(record_points);
+	free(record_frame);
+	record_codec.previous = NULL;
+	record_points = NULL;
+	record_frame = NULL;
+	rest = NULL;
+	rest_pending = NULL;
+	reference = NULL;
+}
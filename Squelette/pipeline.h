@@ -0,0 +1,48 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#ifndef GLM_H
+#define GLM_H
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#endif
+
+#include "matrixCalc.h"
+#include "bodyCollision.h"
+
+/* Pipeline des images : lecture Kinect -> calcul des matrices -> rendu.
+La lecture et le calcul ont chacun leur thread ; le rendu reste sur le thread GL.
+Les etages echangent des FrameSlot par des files bornees. Avec une profondeur D,
+jusqu'a D images sont en vol : l'image N est dessinee pendant que N+1 est calculee
+et N+2 lue. D = 1 revient a la boucle sequentielle (latence minimale) : le rendu ne
+rend l'emplacement qu'apres l'echange, la lecture de N+1 commence donc une fois N
+affichee. Un D plus grand absorbe les variations de duree de chaque etage au prix de
+D-1 images de latence. */
+
+#define PIPELINE_DEPTH 2     // profondeur par defaut
+#define PIPELINE_MAX_DEPTH 8
+#define PIPELINE_DIRTY_EPSILON 1e-4f // ecart d'un coefficient de matrice au-dela duquel un bone a bouge
+
+struct FrameSlot{
+	int frame;
+	int epoch;               // sessionReset rend les images en vol obsoletes
+	double ingest_time;      // debut de la lecture, pour la latence jusqu'a l'affichage
+	PoseTag tag;             // etiquette du traqueur de test, step = -1 sinon
+	glm::vec3** Bones;       // [0..1] repos, [2..3] Kinect, comme Session::Bones
+	glm::mat4* bone_matrices;
+	unsigned char* bone_dirty; // 1 si la matrice a bouge depuis sa reference (pipeline.cpp)
+	float* joint_positions;  // 3 par joint
+	BodyProxy body;          // capsules du corps, construites avec les matrices
+};
+
+void pipelineStart(int depth, int joint_ctr);
+void pipelineSetRest(glm::vec3** Bones);
+bool pipelineRecord(const char* path, float precision);
+int pipelineReset();
+FrameSlot* pipelineAcquire();
+void pipelineRelease(FrameSlot* slot);
+void pipelineDisplayed(double ingest_time);
+void pipelineStop();
+
+#endif
@@ -0,0 +1,390 @@
+#include "poseLibrary.h"
+#include "cpuSkin.h"
+#include "skinKernels.h"
+#include "matrixCalc.h"
+#include "frameArena.h"
+#include "fileMap.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+extern int nb_bones;
+
+static char* carve(char** cursor, size_t bytes){
+	char* p = *cursor;
+	*cursor += (bytes + 15) & ~(size_t)15;
+	return p;
+}
+
+static size_t aligned(size_t bytes){
+	return (bytes + 15) & ~(size_t)15;
+}
+
+/* direction unitaire de chaque os Kinect, nulle pour un os non suivi */
+static void poseFeatures(glm::vec3** Bones, int bone_ctr, float* out){
+	for (int b = 0; b < bone_ctr; b++){
+		glm::vec3 d = Bones[b][3] - Bones[b][2];
+		float len = glm::length(d);
+		for (int k = 0; k < 3; k++)
+			out[3 * b + k] = len > 1e-6f ? d[k] / len : 0.0f;
+	}
+}
+
+static float distance2(const float* a, const float* b, int dim){
+	float sum = 0.0f;
+	for (int d = 0; d < dim; d++)
+		sum += (a[d] - b[d]) * (a[d] - b[d]);
+	return sum;
+}
+
+/* pose f de l'enregistrement, repartant du repos comme les images de reference (golden.cpp) */
+static void setPose(glm::vec3** Bones, const glm::vec3* rest, const float* pose){
+	for (int b = 0; b < nb_bones; b++){
+		Bones[b][0] = rest[2 * b];
+		Bones[b][1] = rest[2 * b + 1];
+		Bones[b][2] = glm::vec3(pose[6 * b], pose[6 * b + 1], pose[6 * b + 2]);
+		Bones[b][3] = glm::vec3(pose[6 * b + 3], pose[6 * b + 4], pose[6 * b + 5]);
+	}
+}
+
+static void posePath(char* out, const char* file_name){
+	sprintf(out, "%.500s.poses", file_name);
+}
+
+/* noeud au milieu de [lo, hi), coupe selon la dimension la plus etendue de la plage */
+static void buildTree(PoseLibrary* library, int lo, int hi){
+	if (hi - lo <= 0)
+		return;
+	const float* features = library->features;
+	int dim = library->dim;
+	int best = 0;
+	float best_spread = -1.0f;
+	for (int d = 0; d < dim; d++){
+		float lo_v = FLT_MAX;
+		float hi_v = -FLT_MAX;
+		for (int i = lo; i < hi; i++){
+			float v = features[library->order[i] * dim + d];
+			lo_v = v < lo_v ? v : lo_v;
+			hi_v = v > hi_v ? v : hi_v;
+		}
+		if (hi_v - lo_v > best_spread){
+			best_spread = hi_v - lo_v;
+			best = d;
+		}
+	}
+	int mid = (lo + hi) / 2;
+	std::nth_element(library->order + lo, library->order + mid, library->order + hi,
+		[features, dim, best](int a, int b){ return features[a * dim + best] < features[b * dim + best]; });
+	library->split[mid] = (unsigned char)best;
+	buildTree(library, lo, mid);
+	buildTree(library, mid + 1, hi);
+}
+
+/* garde les POSE_NEIGHBOURS plus proches, par distance croissante */
+static void consider(PoseLibrary* library, int pose, float d2){
+	if (library->found == POSE_NEIGHBOURS && d2 >= library->distances[POSE_NEIGHBOURS - 1])
+		return;
+	int i = library->found < POSE_NEIGHBOURS ? library->found++ : POSE_NEIGHBOURS - 1;
+	while (i > 0 && library->distances[i - 1] > d2){
+		library->distances[i] = library->distances[i - 1];
+		library->neighbours[i] = library->neighbours[i - 1];
+		i--;
+	}
+	library->distances[i] = d2;
+	library->neighbours[i] = pose;
+}
+
+static void search(PoseLibrary* library, int lo, int hi, int exclude){
+	if (lo >= hi)
+		return;
+	int mid = (lo + hi) / 2;
+	int pose = library->order[mid];
+	const float* f = &library->features[pose * library->dim];
+	if (pose != exclude)
+		consider(library, pose, distance2(library->query, f, library->dim));
+	int d = library->split[mid];
+	float diff = library->query[d] - f[d];
+	if (diff < 0.0f){
+		search(library, lo, mid, exclude);
+		if (library->found < POSE_NEIGHBOURS || diff * diff < library->distances[library->found - 1])
+			search(library, mid + 1, hi, exclude);
+	}
+	else{
+		search(library, mid + 1, hi, exclude);
+		if (library->found < POSE_NEIGHBOURS || diff * diff < library->distances[library->found - 1])
+			search(library, lo, mid, exclude);
+	}
+}
+
+PoseLibrary* poseLibraryLoad(const char* file_name, const ModelData* data){
+	char path[512];
+	posePath(path, file_name);
+	size_t size = 0;
+	void* view = mapFile(path, &size);
+	if (view == NULL)
+		return NULL;
+	const PoseHeader* h = (const PoseHeader*)view;
+	unsigned long long source_hash = 0;
+	unsigned long long rest_hash = 0;
+	hashFile(file_name, &source_hash);
+	hashFile(REST_FILE, &rest_hash);
+	bool valid = size >= sizeof(PoseHeader) && h->magic == POSE_MAGIC && h->version == POSE_VERSION
+		&& h->source_hash == source_hash && h->rest_hash == rest_hash
+		&& h->cooked_version == COOKED_VERSION && (h->auto_weights != 0) == data->auto_weights
+		&& h->vertex_ctr == data->point_ctr && h->bone_ctr == nb_bones && h->pose_ctr > 0;
+	size_t features_size = valid ? (size_t)h->pose_ctr * 3 * h->bone_ctr * sizeof(float) : 0;
+	size_t roots_size = valid ? (size_t)h->pose_ctr * 3 * sizeof(float) : 0;
+	size_t snapshots_size = valid ? (size_t)h->pose_ctr * 3 * h->vertex_ctr * sizeof(short) : 0;
+	if (!valid || sizeof(PoseHeader) + features_size + roots_size + snapshots_size > size){
+		printf("%s perime ou invalide, ignore (Squelette --pose-library pour le refaire)\n", path);
+		unmapFile(view, size);
+		return NULL;
+	}
+
+	int n = h->vertex_ctr;
+	int dim = 3 * h->bone_ctr;
+	PoseLibrary* library = (PoseLibrary*)calloc(1, sizeof(PoseLibrary));
+	library->block = calloc(1, aligned(h->pose_ctr * sizeof(int)) + aligned(h->pose_ctr)
+		+ 2 * aligned(3 * n * sizeof(float)) + aligned(dim * sizeof(float)));
+	char* cursor = (char*)library->block;
+	library->order = (int*)carve(&cursor, h->pose_ctr * sizeof(int));
+	library->split = (unsigned char*)carve(&cursor, h->pose_ctr);
+	library->accum = (float*)carve(&cursor, 3 * n * sizeof(float));
+	library->out = (float*)carve(&cursor, 3 * n * sizeof(float));
+	library->query = (float*)carve(&cursor, dim * sizeof(float));
+	library->header = h;
+	library->dim = dim;
+	library->features = (const float*)((const char*)view + sizeof(PoseHeader));
+	library->roots = (const float*)((const char*)library->features + features_size);
+	library->snapshots = (const short*)((const char*)library->roots + roots_size);
+	library->mapping = view;
+	library->mapping_size = size;
+
+	double start = profNow();
+	for (int p = 0; p < h->pose_ctr; p++)
+		library->order[p] = p;
+	buildTree(library, 0, h->pose_ctr);
+	printf("bibliotheque de poses %s : %i poses, k-d tree en %.1f ms\n", path, h->pose_ctr, (profNow() - start) * 1000.0);
+	return library;
+}
+
+void poseLibraryDestroy(PoseLibrary* library){
+	if (library == NULL)
+		return;
+	unmapFile(library->mapping, library->mapping_size);
+	free(library->block);
+	free(library);
+}
+
+void poseLibraryLookup(PoseLibrary* library, glm::vec3** Bones, int bone_ctr, int exclude){
+	poseFeatures(Bones, bone_ctr < library->header->bone_ctr ? bone_ctr : library->header->bone_ctr, library->query);
+	library->found = 0;
+	search(library, 0, library->header->pose_ctr, exclude);
+}
+
+/* somme des instantanes quantifies ponderes, dequantifiee une seule fois par sommet */
+void poseLibraryBlend(PoseLibrary* library, glm::vec3** Bones, GLuint points_buffer){
+	if (library->found == 0)
+		return;
+	const PoseHeader* h = library->header;
+	int n3 = 3 * h->vertex_ctr;
+	float weights[POSE_NEIGHBOURS];
+	float total = 0.0f;
+	for (int i = 0; i < library->found; i++){
+		weights[i] = 1.0f / (sqrtf(library->distances[i]) + POSE_SOFTEN);
+		total += weights[i];
+	}
+	memset(library->accum, 0, n3 * sizeof(float));
+	for (int i = 0; i < library->found; i++){
+		float w = weights[i] / total;
+		const short* q = &library->snapshots[(size_t)library->neighbours[i] * n3];
+		for (int j = 0; j < n3; j++)
+			library->accum[j] += w * q[j];
+	}
+	glm::vec3 root = Bones[0][2];
+	for (int j = 0; j < n3; j += 3){
+		for (int k = 0; k < 3; k++)
+			library->out[j + k] = h->origin[k] + h->step[k] * (library->accum[j + k] + 32768.0f) + root[k];
+	}
+	if (points_buffer == 0)
+		return;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, points_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)n3 * sizeof(float), library->out);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+float poseLibraryError(const PoseLibrary* library, CpuSkin* skin, const glm::mat4* bone_matrices, int nb_matrices){
+	int n = skin->vertex_ctr;
+	skinPositions(skin->rest, skin->bones, skin->weights, skin->bucket_start, 0, n, bone_matrices, nb_matrices, skin->skinned);
+	double sum = 0.0;
+	for (int v = 0; v < n; v++){
+		const float* o = &library->out[3 * v];
+		float dx = o[0] - skin->skinned[0][v];
+		float dy = o[1] - skin->skinned[1][v];
+		float dz = o[2] - skin->skinned[2][v];
+		sum += sqrtf(dx * dx + dy * dy + dz * dz);
+	}
+	return n > 0 ? (float)(sum / n) : 0.0f;
+}
+
+/* skinning CPU de la pose courante de Bones, dans skin->skinned */
+static void skinPose(CpuSkin* skin, glm::vec3** Bones, glm::mat4* bone_matrices){
+	updateData(Bones, bone_matrices);
+	skinPositions(skin->rest, skin->bones, skin->weights, skin->bucket_start, 0, skin->vertex_ctr,
+		bone_matrices, nb_bones, skin->skinned);
+}
+
+int poseLibraryBuild(const char* garment_file, const char* recording){
+	ModelData data;
+	if (!importModel(garment_file, &data))
+		return 1;
+	CpuSkin* skin = cpuSkinCreate(&data);
+	float* poses = NULL;
+	int frame_ctr = readRecording(recording, &poses);
+	FrameArena arena;
+	arenaInit(&arena, FRAME_ARENA_SIZE);
+	glm::vec3** Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
+	for (int b = 0; b < nb_bones; b++)
+		Bones[b] = (glm::vec3 *)calloc(4, sizeof(glm::vec3));
+	bool rest_ok = loadRestPose(Bones, REST_FILE, &arena);
+	if (skin == NULL || frame_ctr == 0 || !rest_ok){
+		if (skin == NULL)
+			printf("%s n'a pas de bones\n", garment_file);
+		else if (frame_ctr == 0)
+			printf("enregistrement %s vide ou illisible\n", recording);
+		else
+			printf("%s illisible\n", REST_FILE);
+		for (int b = 0; b < nb_bones; b++)
+			free(Bones[b]);
+		free(Bones);
+		free(poses);
+		arenaFree(&arena);
+		cpuSkinDestroy(skin);
+		freeModelData(&data);
+		return 1;
+	}
+	double start = profNow();
+	glm::vec3* rest = (glm::vec3 *)malloc(2 * nb_bones * sizeof(glm::vec3));
+	for (int b = 0; b < nb_bones; b++){
+		rest[2 * b] = Bones[b][0];
+		rest[2 * b + 1] = Bones[b][1];
+	}
+
+	/* premier passage : poses gardees, caracteristiques, racines et boite englobante */
+	int n = data.point_ctr;
+	int dim = 3 * nb_bones;
+	int* kept = (int*)malloc(frame_ctr * sizeof(int));
+	float* features = (float*)malloc((size_t)frame_ctr * dim * sizeof(float));
+	float* roots = (float*)malloc((size_t)frame_ctr * 3 * sizeof(float));
+	glm::mat4* bone_matrices = (glm::mat4 *)malloc(nb_bones * sizeof(glm::mat4));
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	int pose_ctr = 0;
+	for (int f = 0; f < frame_ctr; f++){
+		setPose(Bones, rest, poses + (size_t)f * 6 * nb_bones);
+		float* feature = &features[(size_t)pose_ctr * dim];
+		poseFeatures(Bones, nb_bones, feature);
+		if (pose_ctr > 0 && distance2(feature, feature - dim, dim) < POSE_SPACING * POSE_SPACING)
+			continue;
+		glm::vec3 root = Bones[0][2];
+		skinPose(skin, Bones, bone_matrices);
+		for (int k = 0; k < 3; k++){
+			roots[3 * pose_ctr + k] = root[k];
+			for (int v = 0; v < n; v++){
+				float p = skin->skinned[k][v] - root[k];
+				lo[k] = p < lo[k] ? p : lo[k];
+				hi[k] = p > hi[k] ? p : hi[k];
+			}
+		}
+		kept[pose_ctr++] = f;
+	}
+
+	PoseHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = POSE_MAGIC;
+	header.version = POSE_VERSION;
+	hashFile(garment_file, &header.source_hash);
+	hashFile(REST_FILE, &header.rest_hash);
+	header.vertex_ctr = n;
+	header.pose_ctr = pose_ctr;
+	header.bone_ctr = nb_bones;
+	header.cooked_version = COOKED_VERSION;
+	header.auto_weights = data.auto_weights ? 1 : 0;
+	for (int k = 0; k < 3; k++){
+		header.origin[k] = lo[k];
+		header.step[k] = hi[k] > lo[k] ? (hi[k] - lo[k]) / 65535.0f : 1e-9f;
+	}
+
+	/* second passage : instantanes quantifies, ecrits pose par pose */
+	char path[512];
+	posePath(path, garment_file);
+	FILE* fichier = fopen(path, "wb");
+	bool written = fichier != NULL;
+	short* snapshot = (short*)malloc(3 * n * sizeof(short));
+	if (written){
+		fwrite(&header, sizeof(header), 1, fichier);
+		fwrite(features, sizeof(float), (size_t)pose_ctr * dim, fichier);
+		fwrite(roots, sizeof(float), (size_t)pose_ctr * 3, fichier);
+		for (int p = 0; p < pose_ctr; p++){
+			setPose(Bones, rest, poses + (size_t)kept[p] * 6 * nb_bones);
+			skinPose(skin, Bones, bone_matrices);
+			for (int v = 0; v < n; v++){
+				for (int k = 0; k < 3; k++){
+					float q = floorf((skin->skinned[k][v] - roots[3 * p + k] - lo[k]) / header.step[k] + 0.5f);
+					q = q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q);
+					snapshot[3 * v + k] = (short)((int)q - 32768);
+				}
+			}
+			fwrite(snapshot, sizeof(short), 3 * n, fichier);
+		}
+		written = ferror(fichier) == 0;
+		fclose(fichier);
+	}
+	free(snapshot);
+	if (!written)
+		printf("impossible d'ecrire %s\n", path);
+	else
+		printf("%s : %i poses gardees sur %i, %.1f Mo, %.1f s\n", path, pose_ctr, frame_ctr,
+			(sizeof(header) + pose_ctr * (dim * 4.0 + 12.0 + n * 6.0)) / (1024.0 * 1024.0), profNow() - start);
+
+	/* verification : chaque pose echantillonnee est cherchee sans elle-meme dans la bibliotheque */
+	PoseLibrary* library = written && pose_ctr > 1 ? poseLibraryLoad(garment_file, &data) : NULL;
+	if (library != NULL){
+		int samples = pose_ctr < POSE_CHECK_SAMPLES ? pose_ctr : POSE_CHECK_SAMPLES;
+		double lookup_s = 0.0;
+		double error_sum = 0.0;
+		float error_max = 0.0f;
+		for (int s = 0; s < samples; s++){
+			int p = (int)((long long)s * pose_ctr / samples);
+			setPose(Bones, rest, poses + (size_t)kept[p] * 6 * nb_bones);
+			double t = profNow();
+			poseLibraryLookup(library, Bones, nb_bones, p);
+			lookup_s += profNow() - t;
+			poseLibraryBlend(library, Bones, 0);
+			updateData(Bones, bone_matrices);
+			float error = poseLibraryError(library, skin, bone_matrices, nb_bones);
+			error_sum += error;
+			error_max = error > error_max ? error : error_max;
+		}
+		printf("hors bibliotheque (%i poses) : erreur moyenne %.1f mm, pire pose %.1f mm, recherche %.1f us\n",
+			samples, error_sum / samples * 1000.0, error_max * 1000.0f, lookup_s / samples * 1e6);
+		poseLibraryDestroy(library);
+	}
+
+	free(bone_matrices);
+	free(roots);
+	free(features);
+	free(kept);
+	free(rest);
+	for (int b = 0; b < nb_bones; b++)
+		free(Bones[b]);
+	free(Bones);
+	free(poses);
+	arenaFree(&arena);
+	cpuSkinDestroy(skin);
+	freeModelData(&data);
+	return written ? 0 : 1;
+}
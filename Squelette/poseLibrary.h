@@ -0,0 +1,90 @@
+#ifndef POSELIBRARY_H
+#define POSELIBRARY_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#ifndef GLM_H
+#define GLM_H
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#endif
+
+#include "importer.h"
+
+/* Bibliotheque de poses pour les machines les plus faibles (Squelette --skin library, touche L).
+Hors ligne (Squelette --pose-library vetement.dae enregistrement), le vetement est skinne
+sur CPU pour chaque pose d'un enregistrement (Squelette --record) ; les poses trop proches
+de la precedente gardee sont sautees. Chaque pose gardee donne un instantane des positions,
+relatives au premier joint Kinect et quantifiees sur 16 bits dans la boite englobante de
+toute la bibliotheque, et un vecteur de caracteristiques : la direction unitaire de chaque
+os, soit ses deux angles. Le tout est ecrit dans <vetement>.poses, lie au hash du .dae et
+des positions de repos, a la version du fichier cuit et au mode des poids (peints ou
+automatiques, Squelette --weights). A l'execution, un k-d tree sur ces caracteristiques
+donne les POSE_NEIGHBOURS poses les plus proches de la pose Kinect affichee ; leurs
+instantanes, ponderes par l'inverse de la distance, remplacent le skinning. Les cibles de morph ne
+sont pas vues par la bibliotheque, construite sur le repos du vetement. */
+
+#define POSE_MAGIC 0x534f5047   // "GPOS"
+#define POSE_VERSION 2
+#define POSE_NEIGHBOURS 4       // instantanes melanges par image
+#define POSE_SPACING 0.05f      // distance minimale entre deux poses gardees (caracteristiques)
+#define POSE_SOFTEN 1e-3f       // ajoute aux distances avant inversion
+#define POSE_ERROR_FRAMES 60    // images entre deux mesures de l'erreur contre le skinning (0 : jamais)
+#define POSE_CHECK_SAMPLES 256  // poses de la bibliotheque verifiees hors ligne, sans elles-memes
+
+/* en-tete de <vetement>.poses, suivi des caracteristiques (3 * bone_ctr flottants par pose),
+des racines (3 flottants par pose) et des instantanes (3 entiers 16 bits par sommet et par pose) */
+struct PoseHeader{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long source_hash;
+	unsigned long long rest_hash;
+	int vertex_ctr;
+	int pose_ctr;
+	int bone_ctr;
+	unsigned int cooked_version; // COOKED_VERSION de l'import skinne
+	int auto_weights;  // poids automatiques a l'import (ModelData::auto_weights)
+	float origin[3];   // position relative = origin + step * (q + 32768)
+	float step[3];
+	int pad;
+};
+
+struct PoseLibrary{
+	const PoseHeader* header;
+	const float* features;
+	const float* roots;
+	const short* snapshots;
+	int dim;
+	int* order;          // k-d tree implicite : noeud au milieu de chaque plage de order
+	unsigned char* split; // dimension de coupe du noeud, indexee comme order
+	float* accum;        // 3 par sommet
+	float* out;          // 3 par sommet, dernier melange, contenu du buffer des positions
+	float* query;        // caracteristiques de la pose cherchee
+	int neighbours[POSE_NEIGHBOURS];
+	float distances[POSE_NEIGHBOURS];
+	int found;
+	void* mapping;
+	size_t mapping_size;
+	void* block;
+};
+
+/* outil hors ligne ; code de retour du programme */
+int poseLibraryBuild(const char* garment_file, const char* recording);
+
+/* <file_name>.poses s'il correspond au vetement importe, NULL sinon */
+PoseLibrary* poseLibraryLoad(const char* file_name, const ModelData* data);
+void poseLibraryDestroy(PoseLibrary* library);
+
+/* poses les plus proches de Bones[.][2..3] (exclude : pose ignoree, -1 : aucune) */
+void poseLibraryLookup(PoseLibrary* library, glm::vec3** Bones, int nb_bones, int exclude);
+/* melange des poses trouvees, replace sur le premier joint de Bones ; envoye a points_buffer s'il n'est pas nul */
+void poseLibraryBlend(PoseLibrary* library, glm::vec3** Bones, GLuint points_buffer);
+
+/* ecart moyen (m) entre le dernier melange et le skinning de ces matrices ; reskinne tout le vetement */
+float poseLibraryError(const PoseLibrary* library, CpuSkin* skin, const glm::mat4* bone_matrices, int nb_matrices);
+
+#endif
@@ -0,0 +1,325 @@
+#include "profiler.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define PROF_BUCKETS 24       // buckets en puissances de 2 de microsecondes
+#define PROF_GPU_RING 4       // requetes en vol par etape GPU
+#define PROF_MAX_EVENTS 65536 // evenements conserves pour la trace
+#define PROF_MAX_THREADS 16
+
+/* VS2013 ne connait pas thread_local */
+#ifdef _MSC_VER
+#define PROF_TLS __declspec(thread)
+#else
+#define PROF_TLS __thread
+#endif
+
+static const char* stage_names[NB_STAGES] = {
+	"ingest", "solve", "uniforms", "draw_garment", "draw_joints", "swap", "wait", "cloth", "skin", "background",
+	"occlusion", "pose_lookup", "pose_blend"
+};
+
+static const char* counter_names[NB_COUNTERS] = {
+	"skin_skipped", "render_scale", "pose_error"
+};
+
+struct ProfHisto{
+	unsigned int buckets[PROF_BUCKETS];
+	unsigned int count;
+	double sum_us;
+	double max_us;
+};
+
+struct ProfEvent{
+	unsigned char stage;   // ou compteur
+	unsigned char gpu;
+	unsigned char counter; // dur_us porte alors la valeur
+	unsigned char tid;
+	double ts_us;
+	double dur_us;
+};
+
+/* les histogrammes CPU sont alimentes par plusieurs threads */
+static std::mutex histo_lock;
+static ProfHisto cpu_histo[NB_STAGES];
+static ProfHisto gpu_histo[NB_STAGES];
+static double cpu_begin[NB_STAGES];
+static double counter_sum[NB_COUNTERS];
+static unsigned int counter_ctr[NB_COUNTERS];
+
+static bool gpu_enabled = false;
+static GLuint gpu_queries[NB_STAGES][PROF_GPU_RING];
+static double gpu_issue_us[NB_STAGES][PROF_GPU_RING];
+static bool gpu_pending[NB_STAGES][PROF_GPU_RING];
+static bool gpu_issued[NB_STAGES];
+static int gpu_head[NB_STAGES];
+
+static ProfEvent* events = NULL;
+static std::atomic<int> event_ctr(0);
+static std::atomic<int> event_dropped(0);
+static PROF_TLS int thread_tid = 0; // ligne de la trace : 0 pour le thread GL, 1 pour le GPU
+static std::atomic<int> thread_ctr(2);
+static const char* thread_names[PROF_MAX_THREADS] = { "CPU", "GPU" };
+static double origin_us = 0.0;
+static int frame_ctr = 0;
+
+/* horloge monotone en secondes */
+double profNow(){
+#ifdef _WIN32
+	static LARGE_INTEGER freq = { 0 };
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#endif
+}
+
+static void addSample(ProfHisto* histo, double us){
+	int b = 0;
+	if (us >= 1.0){
+		b = (int)(log(us) / log(2.0)) + 1;
+		if (b >= PROF_BUCKETS)
+			b = PROF_BUCKETS - 1;
+	}
+	histo->buckets[b]++;
+	histo->count++;
+	histo->sum_us += us;
+	if (us > histo->max_us)
+		histo->max_us = us;
+}
+
+/* borne haute du bucket contenant le centile p (approximation a un facteur 2 pres) */
+static double percentile(const ProfHisto* histo, double p){
+	unsigned int target = (unsigned int)ceil(p * histo->count);
+	unsigned int acc = 0;
+	for (int b = 0; b < PROF_BUCKETS; b++){
+		acc += histo->buckets[b];
+		if (acc >= target && acc > 0){
+			double upper = ldexp(1.0, b);
+			return upper < histo->max_us ? upper : histo->max_us;
+		}
+	}
+	return histo->max_us;
+}
+
+static void addEvent(int stage, int gpu, double ts_us, double dur_us){
+	if (events == NULL)
+		return;
+	int i = event_ctr++;
+	if (i >= PROF_MAX_EVENTS){
+		event_dropped++;
+		return;
+	}
+	ProfEvent* e = &events[i];
+	e->stage = (unsigned char)stage;
+	e->gpu = (unsigned char)gpu;
+	e->counter = 0;
+	e->tid = (unsigned char)(gpu ? 1 : thread_tid);
+	e->ts_us = ts_us - origin_us;
+	e->dur_us = dur_us;
+}
+
+/* a appeler une fois le contexte GL courant */
+void profInit(){
+	memset(cpu_histo, 0, sizeof(cpu_histo));
+	memset(gpu_histo, 0, sizeof(gpu_histo));
+	memset(counter_sum, 0, sizeof(counter_sum));
+	memset(counter_ctr, 0, sizeof(counter_ctr));
+	memset(gpu_pending, 0, sizeof(gpu_pending));
+	memset(gpu_issued, 0, sizeof(gpu_issued));
+	memset(gpu_head, 0, sizeof(gpu_head));
+	frame_ctr = 0;
+
+	if (events == NULL)
+		events = (ProfEvent*)malloc(PROF_MAX_EVENTS * sizeof(ProfEvent));
+	event_ctr = 0;
+	event_dropped = 0;
+	origin_us = profNow() * 1e6;
+
+	gpu_enabled = GLEW_ARB_timer_query ? true : false;
+	if (gpu_enabled){
+		for (int s = 0; s < NB_STAGES; s++)
+			glGenQueries(PROF_GPU_RING, gpu_queries[s]);
+	}
+	else{
+		printf("GL_ARB_timer_query absent : pas de mesure GPU\n");
+	}
+}
+
+/* donne une ligne propre au thread appelant dans la trace */
+void profThread(const char* name){
+	int tid = thread_ctr++;
+	if (tid >= PROF_MAX_THREADS)
+		return;
+	thread_names[tid] = name;
+	thread_tid = tid;
+}
+
+void profBeginCPU(int stage){
+	cpu_begin[stage] = profNow() * 1e6;
+}
+
+void profEndCPU(int stage){
+	double end = profNow() * 1e6;
+	double dur = end - cpu_begin[stage];
+	{
+		std::lock_guard<std::mutex> lk(histo_lock);
+		addSample(&cpu_histo[stage], dur);
+	}
+	addEvent(stage, 0, cpu_begin[stage], dur);
+}
+
+void profCounter(int counter, double value){
+	{
+		std::lock_guard<std::mutex> lk(histo_lock);
+		counter_sum[counter] += value;
+		counter_ctr[counter]++;
+	}
+	if (events == NULL)
+		return;
+	int i = event_ctr++;
+	if (i >= PROF_MAX_EVENTS){
+		event_dropped++;
+		return;
+	}
+	ProfEvent* e = &events[i];
+	e->stage = (unsigned char)counter;
+	e->gpu = 0;
+	e->counter = 1;
+	e->tid = (unsigned char)thread_tid;
+	e->ts_us = profNow() * 1e6 - origin_us;
+	e->dur_us = value;
+}
+
+static void collectGPU(int stage, int slot){
+	GLint available = 0;
+	glGetQueryObjectiv(gpu_queries[stage][slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+	GLuint64 ns = 0;
+	glGetQueryObjectui64v(gpu_queries[stage][slot], GL_QUERY_RESULT, &ns);
+	gpu_pending[stage][slot] = false;
+	double dur = (double)ns / 1000.0;
+	addSample(&gpu_histo[stage], dur);
+	/* GL_TIME_ELAPSED ne donne qu'une duree : l'evenement est place a l'instant de soumission */
+	addEvent(stage, 1, gpu_issue_us[stage][slot], dur);
+}
+
+void profBeginGPU(int stage){
+	gpu_issued[stage] = false;
+	if (!gpu_enabled)
+		return;
+	int slot = gpu_head[stage];
+	if (gpu_pending[stage][slot]){
+		collectGPU(stage, slot);
+		if (gpu_pending[stage][slot])
+			return; // anneau plein : on saute cette mesure plutot que d'attendre le GPU
+	}
+	gpu_issue_us[stage][slot] = profNow() * 1e6;
+	glBeginQuery(GL_TIME_ELAPSED, gpu_queries[stage][slot]);
+	gpu_issued[stage] = true;
+}
+
+void profEndGPU(int stage){
+	if (!gpu_issued[stage])
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	gpu_pending[stage][gpu_head[stage]] = true;
+	gpu_head[stage] = (gpu_head[stage] + 1) % PROF_GPU_RING;
+	gpu_issued[stage] = false;
+}
+
+/* releve les requetes GPU terminees et affiche periodiquement les histogrammes */
+void profEndFrame(){
+	if (gpu_enabled){
+		for (int s = 0; s < NB_STAGES; s++){
+			for (int k = 0; k < PROF_GPU_RING; k++){
+				if (gpu_pending[s][k])
+					collectGPU(s, k);
+			}
+		}
+	}
+	frame_ctr++;
+	if (PROF_DUMP_FRAMES > 0 && frame_ctr % PROF_DUMP_FRAMES == 0){
+		profDump(stdout);
+		std::lock_guard<std::mutex> lk(histo_lock);
+		memset(cpu_histo, 0, sizeof(cpu_histo));
+		memset(gpu_histo, 0, sizeof(gpu_histo));
+		memset(counter_sum, 0, sizeof(counter_sum));
+		memset(counter_ctr, 0, sizeof(counter_ctr));
+	}
+}
+
+static void dumpHisto(FILE* out, const char* kind, int stage, const ProfHisto* histo){
+	if (histo->count == 0)
+		return;
+	fprintf(out, "  %-4s %-13s n=%-5u moy=%8.1f p50<=%8.1f p95<=%8.1f max=%8.1f us\n",
+		kind, stage_names[stage], histo->count, histo->sum_us / histo->count,
+		percentile(histo, 0.50), percentile(histo, 0.95), histo->max_us);
+}
+
+void profDump(FILE* out){
+	std::lock_guard<std::mutex> lk(histo_lock);
+	fprintf(out, "Profil (image %i) :\n", frame_ctr);
+	for (int s = 0; s < NB_STAGES; s++){
+		dumpHisto(out, "cpu", s, &cpu_histo[s]);
+		dumpHisto(out, "gpu", s, &gpu_histo[s]);
+	}
+	for (int c = 0; c < NB_COUNTERS; c++){
+		if (counter_ctr[c] > 0)
+			fprintf(out, "  cnt  %-13s n=%-5u moy=%8.3f\n", counter_names[c], counter_ctr[c], counter_sum[c] / counter_ctr[c]);
+	}
+}
+
+/* ecrit les evenements enregistres au format Chrome trace (JSON) */
+bool profExportTrace(const char* path){
+	FILE* fichier = fopen(path, "w");
+	if (fichier == NULL){
+		printf("error writing the trace %s\n", path);
+		return false;
+	}
+	fprintf(fichier, "{\"traceEvents\":[\n");
+	int nb_threads = thread_ctr < PROF_MAX_THREADS ? (int)thread_ctr : PROF_MAX_THREADS;
+	for (int t = 0; t < nb_threads; t++)
+		fprintf(fichier, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}",
+			t > 0 ? ",\n" : "", t, thread_names[t]);
+	int nb_events = event_ctr < PROF_MAX_EVENTS ? (int)event_ctr : PROF_MAX_EVENTS;
+	for (int i = 0; i < nb_events; i++){
+		const ProfEvent* e = &events[i];
+		if (e->counter){
+			fprintf(fichier, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%.4f}}",
+				counter_names[e->stage], e->ts_us, e->dur_us);
+			continue;
+		}
+		fprintf(fichier, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%i}",
+			stage_names[e->stage], e->gpu ? "gpu" : "cpu", e->ts_us, e->dur_us, (int)e->tid);
+	}
+	fprintf(fichier, "\n]}\n");
+	fclose(fichier);
+	printf("trace ecrite dans %s (%i evenements, %i perdus)\n", path, nb_events, (int)event_dropped);
+	return true;
+}
+
+void profShutdown(){
+	if (gpu_enabled){
+		for (int s = 0; s < NB_STAGES; s++)
+			glDeleteQueries(PROF_GPU_RING, gpu_queries[s]);
+	}
+	gpu_enabled = false;
+	free(events);
+	events = NULL;
+}
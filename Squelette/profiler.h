@@ -0,0 +1,69 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#include <stdio.h>
+
+/* Instrumentation par etape de la boucle de rendu.
+Les etapes CPU sont mesurees avec une horloge monotone, les etapes GPU avec des
+anneaux de requetes GL_TIME_ELAPSED relues quelques images plus tard (pas de stall).
+Les mesures alimentent des histogrammes en memoire et une trace au format Chrome
+(chrome://tracing ou https://ui.perfetto.dev), avec une ligne par thread nomme par
+profThread : le recouvrement des etages du pipeline y est directement visible.
+Les etapes CPU peuvent etre mesurees depuis n'importe quel thread, chaque etape
+restant propre a un thread ; les etapes GPU uniquement depuis le thread GL. */
+
+enum ProfStage {
+	STAGE_INGEST,       // readData + copie des positions Kinect
+	STAGE_SOLVE,        // updateData
+	STAGE_UNIFORMS,     // envoi des matrices et du VBO des os
+	STAGE_DRAW_GARMENT, // dessin du vetement
+	STAGE_DRAW_JOINTS,  // dessin des points Kinect
+	STAGE_SWAP,         // glfwSwapBuffers
+	STAGE_WAIT,         // rendu en attente d'une image calculee
+	STAGE_CLOTH,        // pas du tissu et envoi des positions simulees
+	STAGE_SKIN,         // skinning CPU des groupes de sommets touches et envoi
+	STAGE_BACKGROUND,   // copie de l'image couleur dans le PBO et dessin du fond
+	STAGE_OCCLUSION,    // envoi de la carte de profondeur de l'occultation
+	STAGE_POSE_LOOKUP,  // recherche des poses les plus proches dans la bibliotheque
+	STAGE_POSE_BLEND,   // melange des instantanes et envoi des positions
+	NB_STAGES
+};
+
+/* valeurs relevees une fois par image, moyennees dans les histogrammes et tracees en courbe */
+enum ProfCounter {
+	COUNTER_SKIN_SKIPPED, // fraction des sommets non reskinnes par cpuSkin
+	COUNTER_RENDER_SCALE, // echelle de la resolution dynamique, par axe
+	COUNTER_POSE_ERROR,   // ecart moyen (mm) entre bibliotheque de poses et skinning
+	NB_COUNTERS
+};
+
+/* nombre d'images entre deux affichages des histogrammes (0 : jamais) */
+#define PROF_DUMP_FRAMES 300
+
+void profInit();
+double profNow();
+void profThread(const char* name);
+void profBeginCPU(int stage);
+void profEndCPU(int stage);
+void profBeginGPU(int stage);
+void profEndGPU(int stage);
+void profCounter(int counter, double value);
+void profEndFrame();
+void profDump(FILE* out);
+bool profExportTrace(const char* path);
+void profShutdown();
+
+/* mesure CPU limitee a la portee courante */
+struct ProfScope {
+	int stage;
+	ProfScope(int s) : stage(s) { profBeginCPU(stage); }
+	~ProfScope() { profEndCPU(stage); }
+};
+#define PROF_CPU(stage) ProfScope prof_scope_##stage(stage)
+
+#endif
@@ -0,0 +1,173 @@
+#include "resolution.h"
+#include "profiler.h"
+#include <stdio.h>
+
+static double budget_ns = 0.0;
+static float min_scale = RESOLUTION_MIN_SCALE;
+static float max_scale = RESOLUTION_MAX_SCALE;
+
+/* FBO a la taille maximale, zone dessinee width x height */
+static GLuint fbo = 0;
+static GLuint color_rb = 0;
+static GLuint depth_rb = 0;
+static int fbo_width = 0;
+static int fbo_height = 0;
+static int width = 0;
+static int height = 0;
+
+/* paires d'horodatages debut / fin d'image */
+static GLuint queries[RESOLUTION_QUERY_RING][2];
+static bool pending[RESOLUTION_QUERY_RING];
+static bool issued = false;
+static int head = 0;
+
+static float scale = 1.0f;
+static double smoothed_ns = 0.0;
+static int above = 0;
+static int below = 0;
+
+void resolutionConfigure(double budget, float lo, float hi){
+	budget_ns = budget * 1e6;
+	min_scale = lo > 0.1f ? lo : 0.1f;
+	max_scale = hi > min_scale ? hi : min_scale;
+}
+
+static void allocate(int window_width, int window_height){
+	fbo_width = (int)(window_width * max_scale + 0.5f);
+	fbo_height = (int)(window_height * max_scale + 0.5f);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, fbo_width, fbo_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, fbo_width, fbo_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+}
+
+void resolutionInit(int window_width, int window_height){
+	scale = max_scale < 1.0f ? max_scale : 1.0f;
+	smoothed_ns = 0.0;
+	above = 0;
+	below = 0;
+	if (budget_ns <= 0.0)
+		return;
+	if (!GLEW_ARB_timer_query){
+		printf("GL_ARB_timer_query absent : pas de resolution dynamique\n");
+		budget_ns = 0.0;
+		return;
+	}
+	glGenFramebuffers(1, &fbo);
+	glGenRenderbuffers(1, &color_rb);
+	glGenRenderbuffers(1, &depth_rb);
+	allocate(window_width, window_height);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rb);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete){
+		printf("FBO incomplet : pas de resolution dynamique\n");
+		resolutionShutdown();
+		return;
+	}
+	for (int k = 0; k < RESOLUTION_QUERY_RING; k++){
+		glGenQueries(2, queries[k]);
+		pending[k] = false;
+	}
+	head = 0;
+	printf("resolution dynamique : budget GPU %.1f ms, echelle %.2f a %.2f\n", budget_ns / 1e6, min_scale, max_scale);
+}
+
+void resolutionShutdown(){
+	if (fbo == 0)
+		return;
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &color_rb);
+	glDeleteRenderbuffers(1, &depth_rb);
+	for (int k = 0; k < RESOLUTION_QUERY_RING; k++)
+		glDeleteQueries(2, queries[k]);
+	fbo = 0;
+	budget_ns = 0.0;
+}
+
+void resolutionBegin(int window_width, int window_height, int* w, int* h){
+	if (fbo == 0){
+		*w = window_width;
+		*h = window_height;
+		return;
+	}
+	/* fenetre agrandie : seule reallocation, hors regime permanent */
+	if ((int)(window_width * max_scale + 0.5f) > fbo_width || (int)(window_height * max_scale + 0.5f) > fbo_height)
+		allocate(window_width, window_height);
+	width = (int)(window_width * scale + 0.5f);
+	height = (int)(window_height * scale + 0.5f);
+	width = width < 1 ? 1 : (width > fbo_width ? fbo_width : width);
+	height = height < 1 ? 1 : (height > fbo_height ? fbo_height : height);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	issued = false;
+	*w = width;
+	*h = height;
+}
+
+/* Horodatage de depart juste avant le premier dessin : la lecture de la pose, le tissu
+et le skinning CPU qui precedent ne comptent pas dans la duree GPU mesuree */
+void resolutionDraw(){
+	if (fbo == 0)
+		return;
+	issued = !pending[head];
+	if (issued)
+		glQueryCounter(queries[head][0], GL_TIMESTAMP);
+}
+
+/* hysteresis : un pas vers le bas ou vers le haut apres assez d'images du meme cote */
+static void adapt(double frame_ns){
+	smoothed_ns = smoothed_ns == 0.0 ? frame_ns : smoothed_ns + RESOLUTION_SMOOTHING * (frame_ns - smoothed_ns);
+	above = smoothed_ns > budget_ns * RESOLUTION_HIGH ? above + 1 : 0;
+	below = smoothed_ns < budget_ns * RESOLUTION_LOW ? below + 1 : 0;
+	float next = scale;
+	if (above >= RESOLUTION_DOWN_FRAMES)
+		next = scale - RESOLUTION_STEP < min_scale ? min_scale : scale - RESOLUTION_STEP;
+	else if (below >= RESOLUTION_UP_FRAMES)
+		next = scale + RESOLUTION_STEP > max_scale ? max_scale : scale + RESOLUTION_STEP;
+	if (next != scale){
+		scale = next;
+		above = 0;
+		below = 0;
+		/* les mesures deja en vol sont celles de l'ancienne echelle */
+		smoothed_ns = 0.0;
+	}
+}
+
+void resolutionEnd(int window_width, int window_height){
+	if (fbo == 0)
+		return;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, window_width, window_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (issued){
+		glQueryCounter(queries[head][1], GL_TIMESTAMP);
+		pending[head] = true;
+		head = (head + 1) % RESOLUTION_QUERY_RING;
+	}
+
+	/* mesures terminees, de la plus ancienne a la plus recente, sans attendre le GPU */
+	for (int i = 0; i < RESOLUTION_QUERY_RING; i++){
+		int k = (head + i) % RESOLUTION_QUERY_RING;
+		if (!pending[k])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(queries[k][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(queries[k][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries[k][1], GL_QUERY_RESULT, &end);
+		pending[k] = false;
+		adapt((double)(end - begin));
+	}
+	profCounter(COUNTER_RENDER_SCALE, scale);
+}
+
+float resolutionScale(){
+	return fbo != 0 ? scale : 1.0f;
+}
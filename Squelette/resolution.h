@@ -0,0 +1,45 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+/* Resolution dynamique (Squelette --budget MS [--scale MIN:MAX]) : l'image est dessinee dans
+un FBO a une fraction de la taille de la fenetre, puis agrandie vers la fenetre par
+glBlitFramebuffer. La duree GPU des dessins de l'image, du premier dessin a l'agrandissement
+(hors lecture de la pose et calculs CPU), mesuree par deux requetes d'horodatage lues
+quelques images plus tard, est lissee puis comparee au budget : au-dessus de
+budget * RESOLUTION_HIGH pendant RESOLUTION_DOWN_FRAMES images, l'echelle baisse d'un pas ;
+sous budget * RESOLUTION_LOW pendant RESOLUTION_UP_FRAMES images, elle remonte d'un pas.
+L'ecart entre les deux seuils et les deux durees evite les oscillations. Le FBO est alloue
+une fois a la taille maximale : changer d'echelle ne change que la zone dessinee.
+L'echelle courante est relevee a chaque image (compteur render_scale du profiler). */
+
+#define RESOLUTION_MIN_SCALE 0.5f  // bornes par defaut de l'echelle, par axe
+#define RESOLUTION_MAX_SCALE 1.0f
+#define RESOLUTION_STEP 0.05f      // pas d'echelle par axe
+#define RESOLUTION_HIGH 0.9        // fraction du budget au-dessus de laquelle on descend
+#define RESOLUTION_LOW 0.7         // fraction du budget sous laquelle on remonte
+#define RESOLUTION_DOWN_FRAMES 5
+#define RESOLUTION_UP_FRAMES 30
+#define RESOLUTION_SMOOTHING 0.2   // poids de la derniere mesure dans la moyenne glissante
+#define RESOLUTION_QUERY_RING 4    // images en vol avant de sauter une mesure
+
+/* avant sessionInit ; budget_ms <= 0 : rendu direct dans la fenetre */
+void resolutionConfigure(double budget_ms, float min_scale, float max_scale);
+
+/* contexte GL courant ; cree le FBO si la resolution dynamique est configuree */
+void resolutionInit(int window_width, int window_height);
+void resolutionShutdown();
+
+/* debut d'image : lie le FBO (ou la fenetre) et donne la taille de rendu */
+void resolutionBegin(int window_width, int window_height, int* width, int* height);
+/* premier dessin de l'image : debut de la duree GPU mesuree */
+void resolutionDraw();
+/* fin d'image : agrandit vers la fenetre, releve les mesures et adapte l'echelle */
+void resolutionEnd(int window_width, int window_height);
+float resolutionScale();
+
+#endif
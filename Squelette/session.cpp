@@ -0,0 +1,779 @@
+#include "session.h"
+#include "matrixCalc.h"
+#include "shaderCache.h"
+#include "profiler.h"
+#include "garmentLoader.h"
+#include "fileWatch.h"
+#include "texture.h"
+#include "pipeline.h"
+#include "fileMap.h"
+#include "latencyProbe.h"
+#include "cloth.h"
+#include "cpuSkin.h"
+#include "morph.h"
+#include "background.h"
+#include "occlusion.h"
+#include "resolution.h"
+#include "poseLibrary.h"
+#include <string.h>
+
+#define STR2(x) #x
+#define STR(x) STR2(x)
+
+extern int nb_bones;
+
+#define MODEL_FILE "Sweat8AutoW2.dae" // "Sweat8PaintedNormalizedTest5Retry7.dae" et 9 corrects
+
+/* vetements parcourus avec la touche N, charges en arriere-plan */
+const char* catalogue[] = {
+	MODEL_FILE,
+	"Sweat8PaintedNormalizedTest5Retry7.dae",
+	"Sweat8PaintedNormalizedTest5Retry9.dae",
+};
+#define NB_CATALOGUE 3
+
+/* Les positions des os du modele de vetement et des donnes Kinect pour representation */
+static const float bone_positions4[] = {
+	0.031702, -0.305855, 0.561678,
+	-0.053113, -0.306185, 0.490401,
+	-0.136382, -0.286400, 0.348958,
+	-0.212196, -0.227865, 0.227038,
+	0.032215, -0.317140, 0.336961,
+	0.033871, -0.300125, 0.293703,
+	0.110854, -0.314255, 0.495051,
+	0.269807, -0.312715, 0.207836,
+	0.192558, -0.337995, 0.328809,
+};
+
+/* Shaders */
+
+/* Shader pour les points de la Kinect destination */
+const GLchar* fragmentSourceB2 =
+"#version 410 core\n"
+"out vec4 frag_colour;"
+"void main() {"
+"	frag_colour = vec4(1.0, 0.0, 0.0, 1.0);"
+"}";
+
+const GLchar* vertexSourceB2 =
+"#version 410 core\n"
+"layout(location = 0) in vec3 vp;"
+"uniform mat4 proj, view, model;"
+"void main() {"
+"	gl_PointSize = 7.0;"
+"	gl_Position = proj * view * model * vec4(vp, 1.0);"
+"}";
+
+/* Shaders pour le vetement ; INFLUENCES : nombre d'influences lues par sommet, les
+variantes a 1, 2 et 3 influences dessinent les triangles ranges pour elles par l'import.
+En multi-vue (view_ctr > 1), l'instance i est vue par views[i] et resserree dans le
+panneau i de la fenetre, les plans de clipping 0 et 1 coupant ce qui deborde du panneau. */
+const GLchar* vertexSource =
+"#version 410 core\n"
+"#ifndef INFLUENCES\n"
+"#define INFLUENCES " STR(MAX_INFLUENCES) "\n"
+"#endif\n"
+"layout(location = 0) in vec3 vpos;"
+"layout(location = 1) in vec3 vnormal;"
+"layout(location = 2) in vec2 vtexcoord;"
+"layout(location = 3) in ivec4 bone_ids;"
+"layout(location = 4) in vec4 weights;"
+
+"out vec3 normal;"
+"out vec2 st;"
+"out vec3 eye;"
+"flat out int occlude;"
+
+"uniform mat4 model;"
+"uniform mat4 view;"
+"uniform mat4 proj;"
+"uniform mat4 bone_matrices[" STR(PALETTE_SIZE) "];"
+"uniform float scale;"
+"uniform int simulated;"
+"uniform int view_ctr;"
+"uniform mat4 views[" STR(MAX_VIEWS) "];"
+
+"void main(){"
+"float a = scale;"
+"mat3 window_scale = mat3("
+"vec3(a, 0.0, 0.0),"
+"vec3(0.0, a, 0.0),"
+"vec3(0.0, 0.0, a)"
+");"
+"	mat4 boneTrans;"
+"	boneTrans = bone_matrices[bone_ids[0]] * weights[0];"
+"\n#if INFLUENCES > 1\n"
+"	boneTrans += bone_matrices[bone_ids[1]] * weights[1];"
+"\n#endif\n"
+"\n#if INFLUENCES > 2\n"
+"	boneTrans += bone_matrices[bone_ids[2]] * weights[2];"
+"\n#endif\n"
+"\n#if INFLUENCES > 3\n"
+"	boneTrans += bone_matrices[bone_ids[3]] * weights[3];"
+"\n#endif\n"
+"	st = vtexcoord;"
+"	normal = vnormal;"
+"	vec4 p = vec4(vpos.x, vpos.y, vpos.z, 1.0);"
+"	if (simulated == 0)"
+"		p = boneTrans * p;"
+"	if (view_ctr <= 1){"
+"		vec4 e = view * model * p;"
+"		eye = e.xyz;"
+"		occlude = 1;"
+"		gl_Position = proj * e;"
+"		return;"
+"	}"
+/* seule la vue de face est celle du capteur de profondeur : les autres ne sont jamais occultees */
+"	vec4 e = views[gl_InstanceID] * model * p;"
+"	eye = e.xyz;"
+"	occlude = gl_InstanceID == 0 ? 1 : 0;"
+"	vec4 c = proj * e;"
+"	gl_ClipDistance[0] = c.w + c.x;"
+"	gl_ClipDistance[1] = c.w - c.x;"
+"	c.x = c.x / float(view_ctr) + c.w * (float(2 * gl_InstanceID + 1) / float(view_ctr) - 1.0);"
+"	gl_Position = c;"
+"}";
+
+const GLchar* fragmentSource =
+"#version 410 core\n"
+"in vec3 normal;"
+"in vec2 st;"
+"in vec3 eye;"
+"flat in int occlude;"
+"out vec4 outColor;"
+"uniform sampler2D garment_tex;"
+"uniform sampler2D depth_map;"
+"uniform int textured;"
+"uniform int occluded;"
+"uniform mat4 sensor_from_eye;"
+"uniform vec4 sensor_intrinsics;"
+
+/* fragment derriere la profondeur mesuree par le capteur calibre, comme occlusionProject (occlusion.h) */
+"bool behindUser(){"
+"	vec3 s = (sensor_from_eye * vec4(eye, 1.0)).xyz;"
+"	float d = -s.z;"
+"	vec2 uv = vec2(sensor_intrinsics.z + sensor_intrinsics.x * s.x / d,"
+"		sensor_intrinsics.w - sensor_intrinsics.y * s.y / d) / vec2(textureSize(depth_map, 0));"
+"	if (" STR(OCCLUSION_MIRROR) " != 0)"
+"		uv.x = 1.0 - uv.x;"
+"	if (d <= 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))"
+"		return false;"
+"	float measured = texture(depth_map, uv).r * 65.535;"
+"	return measured > 0.0 && measured < d - " STR(OCCLUSION_MARGIN) ";"
+"}"
+
+"void main(){"
+"	if (occluded != 0 && occlude != 0 && behindUser())"
+"		discard;"
+"	if (textured != 0)"
+"		outColor = texture(garment_tex, st);"
+"	else"
+"		outColor = vec4(0.5-normal-0.5, 1.0);"
+"}";
+
+/* vertexSource limite a 'influences' influences par sommet */
+static GLuint createSkinProgram(int influences){
+	const char* body = strchr(vertexSource, '\n') + 1;
+	char* src = (char*)malloc(strlen(vertexSource) + 64);
+	sprintf(src, "#version 410 core\n#define INFLUENCES %i\n%s", influences, body);
+	GLuint program = createProgram(src, fragmentSource);
+	free(src);
+	return program;
+}
+
+/* face, cote, dos puis autre cote : le monde tourne autour de l'axe vertical devant la camera */
+static void multiViews(glm::mat4* views, int view_ctr){
+	for (int i = 0; i < view_ctr; i++)
+		views[i] = defaultView() * glm::rotate(glm::mat4(1.0f), glm::radians(90.0f * i), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+bool sessionInit(Session* s, int pipeline_depth, double frame_interval, double cloth_budget, bool cpu_skin,
+	const char* background, const char* occlusion, int view_ctr, bool pose_library){
+	*s = Session();
+	s->specialized = true;
+	s->cpu_skin = cpu_skin;
+	s->pose_library = pose_library;
+	s->view_ctr = view_ctr < 1 ? 1 : (view_ctr > MAX_VIEWS ? MAX_VIEWS : view_ctr);
+	/* multi-vue : skinning fait une fois sur CPU, les instances de chaque vue ne font que projeter */
+	if (s->view_ctr > 1){
+		s->cpu_skin = true;
+		printf("%i vues, skinning CPU\n", s->view_ctr);
+	}
+	s->pipeline_depth = pipeline_depth;
+	s->frame_interval = frame_interval;
+	s->cloth_on = cloth_budget > 0.0;
+	s->cloth_budget = cloth_budget > 0.0 ? cloth_budget : CLOTH_BUDGET_MS;
+	s->shown_tag.step = -1;
+
+	/* Le tableau de bones : contiendra les positions des os */
+	s->bone_matrices = (glm::mat4 *)malloc(nb_bones * sizeof(glm::mat4));
+	s->bone_dirty = (unsigned char *)calloc(nb_bones, sizeof(unsigned char));
+	s->Bones = (glm::vec3 **)malloc(nb_bones * sizeof(glm::vec3 *));
+	int b1;
+	for (b1 = 0; b1 < nb_bones; b1++){
+		s->Bones[b1] = (glm::vec3 *)calloc(4, sizeof(glm::vec3));
+	}
+	arenaInit(&s->arena, FRAME_ARENA_SIZE);
+
+	/* positions initiales des os du modele dans un txt pour traitement */
+	FILE* fichier2 = fopen(REST_FILE, "r");
+	if (fichier2 == NULL){
+		printf("Error loading the init file\n");
+		return false;
+	}
+	fclose(fichier2);
+
+	/* variables */
+	s->screen_width = 1024;
+	s->screen_height = 768;
+	s->width = 640;
+	s->height = 480;
+
+	/* Initilisation GLFW, GLEW */
+	s->window = initGLFW(s->width, s->height, "PACT");
+	glfwMakeContextCurrent(s->window);
+	initGLEW();
+	if (background != NULL)
+		backgroundOpen(background);
+	s->occlusion_on = occlusion != NULL && occlusionOpen(occlusion);
+	resolutionInit(s->width, s->height);
+
+	/* Appel du loader : le vetement apparait des que son envoi GPU est termine */
+	s->catalogue_i = 0;
+	loaderStart(LOADER_THREADS);
+	loaderRequest(catalogue[s->catalogue_i]);
+
+	/* le vetement affiche et les positions de repos sont recharges des qu'ils changent sur le disque */
+	watchStart();
+	s->garment_watch = watchFile(catalogue[s->catalogue_i]);
+	s->rest_watch = watchFile(REST_FILE);
+
+	/* de mme pour les os Kinect */
+	s->joint_ctr = nb_bones + 1;
+	s->joint_positions = (float *)malloc(3 * s->joint_ctr * sizeof(float));
+	glGenVertexArrays(1, &s->joints_vao);
+	glBindVertexArray(s->joints_vao);
+	glGenBuffers(1, &s->joints_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, s->joints_vbo);
+	glBufferData(GL_ARRAY_BUFFER, 3 * s->joint_ctr * sizeof(float), NULL, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	glEnableVertexAttribArray(0);
+	s->joints_program = createProgram(vertexSourceB2, fragmentSourceB2);
+
+	/* Gestion des shaders du modele de vetement (binaire en cache si disponible) */
+	s->garment_program = createProgram(vertexSource, fragmentSource);
+	for (int k = 0; k < MAX_INFLUENCES; k++)
+		s->skin_programs[k] = createSkinProgram(k + 1);
+	printShaderCacheStats();
+	profInit();
+
+	/* la palette du shader est remplie partition par partition par drawGarment */
+	glUseProgram(s->garment_program);
+	s->palette_loc = glGetUniformLocation(s->garment_program, "bone_matrices[0]");
+	s->uni_model = glGetUniformLocation(s->garment_program, "model");
+	s->uni_view = glGetUniformLocation(s->garment_program, "view");
+	s->uni_proj = glGetUniformLocation(s->garment_program, "proj");
+	s->uni_scale = glGetUniformLocation(s->garment_program, "scale");
+
+	/* texture du vetement sur l'unite 0, carte de profondeur sur OCCLUSION_UNIT et calibration du capteur */
+	s->uni_textured = glGetUniformLocation(s->garment_program, "textured");
+	s->uni_simulated = glGetUniformLocation(s->garment_program, "simulated");
+	s->uni_occluded = glGetUniformLocation(s->garment_program, "occluded");
+	glUniform1i(glGetUniformLocation(s->garment_program, "garment_tex"), 0);
+	occlusionUniforms(s->garment_program);
+
+	/* memes uniforms pour les variantes par nombre d'influences, recopies a chaque image */
+	static const char* skin_names[NB_SKIN_UNIFORMS] = { "model", "view", "proj", "scale", "textured", "simulated", "occluded" };
+	for (int k = 0; k < MAX_INFLUENCES; k++){
+		GLuint program = s->skin_programs[k];
+		glUseProgram(program);
+		s->skin_palette_locs[k] = glGetUniformLocation(program, "bone_matrices[0]");
+		for (int u = 0; u < NB_SKIN_UNIFORMS; u++)
+			s->skin_uniforms[k][u] = glGetUniformLocation(program, skin_names[u]);
+		glUniform1i(glGetUniformLocation(program, "garment_tex"), 0);
+		occlusionUniforms(program);
+	}
+	glUseProgram(s->garment_program);
+
+	/* lien avec les uniform mat des 2 shaders des os */
+	s->joints_view = glGetUniformLocation(s->joints_program, "view");
+	s->joints_proj = glGetUniformLocation(s->joints_program, "proj");
+	s->joints_model = glGetUniformLocation(s->joints_program, "model");
+
+	/* Les matrices view, projection sont initialises */
+	glm::mat4 view = defaultView();
+	glm::mat4 proj = glm::perspective(45.0f, 1024.0f / 768.0f, 0.1f, 100.0f);
+	glUniformMatrix4fv(s->uni_view, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(s->uni_proj, 1, GL_FALSE, glm::value_ptr(proj));
+	for (int k = 0; k < MAX_INFLUENCES; k++){
+		glUseProgram(s->skin_programs[k]);
+		glUniformMatrix4fv(s->skin_uniforms[k][SKIN_VIEW], 1, GL_FALSE, glm::value_ptr(view));
+	}
+	glUseProgram(s->joints_program);
+	glUniformMatrix4fv(s->joints_view, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(s->joints_proj, 1, GL_FALSE, glm::value_ptr(proj));
+
+	/* vues du multi-vue, les memes pour tous les programmes du vetement */
+	glm::mat4 views[MAX_VIEWS];
+	multiViews(views, s->view_ctr);
+	for (int k = -1; k < MAX_INFLUENCES; k++){
+		GLuint program = k < 0 ? s->garment_program : s->skin_programs[k];
+		glUseProgram(program);
+		glUniform1i(glGetUniformLocation(program, "view_ctr"), s->view_ctr);
+		glUniformMatrix4fv(glGetUniformLocation(program, "views[0]"), s->view_ctr, GL_FALSE, glm::value_ptr(views[0]));
+	}
+
+	/* lecture et calcul des poses sur leurs propres threads */
+	pipelineStart(s->pipeline_depth, s->joint_ctr);
+	clothStart(CLOTH_THREADS);
+
+	s->ordre = '0';
+	sessionReset(s);
+	return true;
+}
+
+/* Remet la session dans l'etat d'un nouvel utilisateur, sans toucher a la fenetre,
+aux programmes, au vetement charge ni aux buffers GPU */
+void sessionReset(Session* s){
+	/* charge les donnes prcdentes */
+	if (!loadRestPose(s->Bones, REST_FILE, &s->arena))
+		printf("Error loading the init file\n");
+	pipelineSetRest(s->Bones);
+	pipelineReset();
+	clothReset(s->garment.cloth);
+	for (int i = 0; i < nb_bones; i++){
+		s->Bones[i][2] = s->Bones[i][0];
+		s->Bones[i][3] = s->Bones[i][1];
+		s->bone_matrices[i] = glm::mat4(1.0f);
+	}
+	cpuSkinInvalidate(s->garment.skin);
+	morphRecalibrate(s->garment.morph);
+	int nb_defaults = sizeof(bone_positions4) / sizeof(float);
+	for (int h = 0; h < 3 * s->joint_ctr; h++)
+		s->joint_positions[h] = h < nb_defaults ? bone_positions4[h] : 0.0f;
+	glBindBuffer(GL_ARRAY_BUFFER, s->joints_vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * s->joint_ctr * sizeof(float), s->joint_positions);
+
+	/* rotation et echelle du modele */
+	s->model = defaultModel();
+	s->scale = 1.0f;
+	glUseProgram(s->garment_program);
+	glUniformMatrix4fv(s->uni_model, 1, GL_FALSE, glm::value_ptr(s->model));
+	glUniform1f(s->uni_scale, s->scale);
+	glUseProgram(s->joints_program);
+	glUniformMatrix4fv(s->joints_model, 1, GL_FALSE, glm::value_ptr(s->model));
+
+	s->last_frame = glfwGetTime();
+}
+
+/* Une image : entrees, chargements en cours, dessin, donnees Kinect et echange.
+Renvoie false quand la fenetre doit se fermer. */
+bool sessionFrame(Session* s){
+	if (glfwWindowShouldClose(s->window))
+		return false;
+	GLFWwindow* window = s->window;
+	arenaReset(&s->arena);
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GL_TRUE);
+
+	/* nouvel utilisateur : seule la pose est remise a zero */
+	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS){
+		if (!s->reset_pressed){
+			double start = profNow();
+			sessionReset(s);
+			printf("session remise a zero en %.2f ms\n", (profNow() - start) * 1000.0);
+		}
+		s->reset_pressed = true;
+	}
+	else{
+		s->reset_pressed = false;
+	}
+
+	/* relu a chaque image : pas de fopen, qui alloue un tampon */
+	char ordrePrecedent;
+	do{
+		ordrePrecedent = s->ordre;
+		if (readFileInto("commandeOuverture.txt", &s->ordre, 1) < 0){
+			printf("error reading commande java\n");
+			exit(1);
+		}
+
+		if (ordrePrecedent == '1' && s->ordre == '0'){
+			glfwHideWindow(window);
+		}
+
+	} while (s->ordre == '0');
+		glfwShowWindow(window);
+
+	/* vetement suivant du catalogue, charge sans bloquer le rendu */
+	if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS){
+		if (!s->next_pressed){
+			s->catalogue_i = (s->catalogue_i + 1) % NB_CATALOGUE;
+			loaderRequest(catalogue[s->catalogue_i]);
+			watchRetarget(s->garment_watch, catalogue[s->catalogue_i]);
+		}
+		s->next_pressed = true;
+	}
+	else{
+		s->next_pressed = false;
+	}
+	/* tissu active ou coupe ; coupe, le buffer des positions retrouve sa pose de repos */
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS){
+		if (!s->cloth_pressed){
+			s->cloth_on = !s->cloth_on;
+			if (!s->cloth_on && s->garment.cloth != NULL)
+				clothRestore(s->garment.cloth, s->garment.buffers[0]);
+			cpuSkinInvalidate(s->garment.skin);
+			printf("tissu %s\n", s->cloth_on ? "active" : "coupe");
+		}
+		s->cloth_pressed = true;
+	}
+	else{
+		s->cloth_pressed = false;
+	}
+	/* skinning CPU ou GPU ; de retour sur GPU, le buffer des positions retrouve sa pose de repos */
+	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS){
+		if (!s->cpu_skin_pressed){
+			s->cpu_skin = !s->cpu_skin;
+			if (!s->cpu_skin && s->garment.skin != NULL && !(s->cloth_on && s->garment.cloth != NULL))
+				cpuSkinRestore(s->garment.skin, s->garment.buffers[0]);
+			cpuSkinInvalidate(s->garment.skin);
+			printf("skinning %s\n", s->cpu_skin ? "CPU" : "GPU");
+		}
+		s->cpu_skin_pressed = true;
+	}
+	else{
+		s->cpu_skin_pressed = false;
+	}
+	/* variantes du shader par nombre d'influences, ou shader generique a 4 influences */
+	if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS){
+		if (!s->specialized_pressed){
+			s->specialized = !s->specialized;
+			printf("skinning %s\n", s->specialized ? "specialise par nombre d'influences" : "generique");
+		}
+		s->specialized_pressed = true;
+	}
+	else{
+		s->specialized_pressed = false;
+	}
+	/* bibliotheque de poses a la place du skinning ; en la quittant, le buffer des positions
+	est rendu au skinning CPU ou retrouve sa pose de repos pour le vertex shader */
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS){
+		if (!s->pose_library_pressed){
+			s->pose_library = !s->pose_library;
+			if (!s->pose_library && s->garment.skin != NULL && !(s->cloth_on && s->garment.cloth != NULL)){
+				if (s->cpu_skin)
+					cpuSkinInvalidate(s->garment.skin);
+				else
+					cpuSkinRestore(s->garment.skin, s->garment.buffers[0]);
+			}
+			printf("bibliotheque de poses %s\n", !s->pose_library ? "desactivee" : (s->garment.poses != NULL ? "activee" : "activee, absente pour ce vetement"));
+		}
+		s->pose_library_pressed = true;
+	}
+	else{
+		s->pose_library_pressed = false;
+	}
+	/* occultation par la carte de profondeur, si Squelette --occlusion */
+	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS){
+		if (!s->occlusion_pressed){
+			s->occlusion_on = !s->occlusion_on;
+			printf("occultation %s\n", s->occlusion_on ? "activee" : "desactivee");
+		}
+		s->occlusion_pressed = true;
+	}
+	else{
+		s->occlusion_pressed = false;
+	}
+	if (watchChanged(s->garment_watch)){
+		printf("%s modifie, rechargement\n", catalogue[s->catalogue_i]);
+		loaderRequest(catalogue[s->catalogue_i]);
+	}
+	if (watchChanged(s->rest_watch)){
+		if (loadRestPose(s->Bones, REST_FILE, &s->arena)){
+			pipelineSetRest(s->Bones);
+			morphRecalibrate(s->garment.morph);
+			printf("%s modifie, positions de repos rechargees\n", REST_FILE);
+		}
+		else
+			printf("%s incomplet, positions de repos conservees\n", REST_FILE);
+	}
+	if (loaderUpdate(&s->garment, LOADER_BUDGET_MS))
+		printf("\nNombre de bones : %i\n", s->garment.bone_ctr);
+
+	/* Taille de la fenetre */
+	glfwGetWindowSize(window, &s->width, &s->height);
+	glfwSetWindowPos(window, (int)(s->screen_width - s->width) / 4.0, (int)(s->screen_height - s->height)/2.0);
+
+	/* image dessinee a l'echelle de la resolution dynamique (resolution.h) ; en multi-vue,
+	chaque panneau a la hauteur de l'image et 1 / view_ctr de sa largeur */
+	int render_width;
+	int render_height;
+	resolutionBegin(s->width, s->height, &render_width, &render_height);
+	int panel_width = render_width / s->view_ctr;
+	glm::mat4 proj = glm::perspective(45.0f, (float)panel_width / (float)render_height, 0.1f, 100.0f);
+	glUseProgram(s->garment_program);
+	glUniformMatrix4fv(s->uni_proj, 1, GL_FALSE, glm::value_ptr(proj));
+
+	/* Initialisation */
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	/* Rotation du modle */
+	float rot1 = 0.0f;
+	float rot2 = 0.0f;
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		rot1 += 0.07f;
+
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		rot1 -= 0.07f;
+
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		rot2 += 0.07f;
+
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		rot2 -= 0.07f;
+
+	glUseProgram(s->garment_program);
+	s->model = glm::rotate(s->model, glm::radians(rot2), glm::vec3(1.0f, 0.0f, 0.0f));
+	s->model = glm::rotate(s->model, glm::radians(rot1), glm::vec3(0.0f, 0.0f, 1.0f));
+	glUniformMatrix4fv(s->uni_model, 1, GL_FALSE, glm::value_ptr(s->model));
+
+	glUseProgram(s->joints_program);
+	glUniformMatrix4fv(s->joints_model, 1, GL_FALSE, glm::value_ptr(s->model));
+
+	/* image suivante du pipeline : pose lue et matrices calculees par les autres threads */
+	FrameSlot* slot = pipelineAcquire();
+	if (slot != NULL){
+		memcpy(s->bone_matrices, slot->bone_matrices, nb_bones * sizeof(glm::mat4));
+		memcpy(s->bone_dirty, slot->bone_dirty, nb_bones * sizeof(unsigned char));
+		memcpy(s->joint_positions, slot->joint_positions, 3 * s->joint_ctr * sizeof(float));
+		for (int b = 0; b < nb_bones; b++){
+			s->Bones[b][2] = slot->Bones[b][2];
+			s->Bones[b][3] = slot->Bones[b][3];
+		}
+		s->body = slot->body;
+		s->shown_ingest_time = slot->ingest_time;
+		s->shown_tag = slot->tag;
+		/* profondeur 1 : l'emplacement n'est rendu qu'apres l'echange, la lecture suivante
+		attend donc la fin de cette image comme dans la boucle sequentielle */
+		if (s->pipeline_depth > 1)
+			pipelineRelease(slot);
+	}
+	else{
+		memset(s->bone_dirty, 0, nb_bones * sizeof(unsigned char));
+	}
+
+	/* morphologie : mesuree sur les premieres images de l'utilisateur, puis appliquee une
+	fois au repos du vetement, partout ou il est lu (buffers, skinning CPU, tissu) */
+	MorphSet* morph = s->garment.morph;
+	if (slot != NULL && morph != NULL && morphMeasure(morph, s->Bones, nb_bones)){
+		double start = profNow();
+		morphApply(morph, s->garment.buffers[0], s->garment.buffers[1]);
+		cpuSkinSetRest(s->garment.skin, morph->affected, morph->affected_ctr, morph->points);
+		clothSetRest(s->garment.cloth, morph->affected, morph->affected_ctr, morph->points);
+		printf("vetement ajuste a la morphologie : %i sommets en %.2f ms\n", morph->affected_ctr, (profNow() - start) * 1000.0);
+	}
+
+	/* tissu : positions simulees a partir des matrices et du corps de l'image, a la place du skinning du shader */
+	bool simulated = s->cloth_on && s->garment.cloth != NULL;
+	if (simulated){
+		profBeginCPU(STAGE_CLOTH);
+		clothStep(s->garment.cloth, s->bone_matrices, nb_bones, &s->body, glfwGetTime() - s->last_frame, s->cloth_budget);
+		clothUpload(s->garment.cloth, s->garment.buffers[0]);
+		profEndCPU(STAGE_CLOTH);
+	}
+	/* sinon instantanes de la bibliotheque de poses les plus proches, melanges sans skinning ;
+	l'ecart au vrai skinning n'est mesure que toutes les POSE_ERROR_FRAMES images */
+	else if (s->pose_library && s->garment.poses != NULL){
+		PoseLibrary* library = s->garment.poses;
+		profBeginCPU(STAGE_POSE_LOOKUP);
+		poseLibraryLookup(library, s->Bones, nb_bones, -1);
+		profEndCPU(STAGE_POSE_LOOKUP);
+		profBeginCPU(STAGE_POSE_BLEND);
+		poseLibraryBlend(library, s->Bones, s->garment.buffers[0]);
+		profEndCPU(STAGE_POSE_BLEND);
+		if (POSE_ERROR_FRAMES > 0 && s->garment.skin != NULL && ++s->pose_error_frame >= POSE_ERROR_FRAMES){
+			s->pose_error_frame = 0;
+			profCounter(COUNTER_POSE_ERROR, 1000.0 * poseLibraryError(library, s->garment.skin, s->bone_matrices, nb_bones));
+		}
+		simulated = true;
+	}
+	/* sinon skinning CPU des seuls groupes de sommets dont un bone a bouge */
+	else if (s->cpu_skin && s->garment.skin != NULL){
+		profBeginCPU(STAGE_SKIN);
+		float skipped = cpuSkinUpdate(s->garment.skin, s->bone_matrices, s->bone_dirty, nb_bones, s->garment.buffers[0]);
+		profEndCPU(STAGE_SKIN);
+		profCounter(COUNTER_SKIN_SKIPPED, skipped);
+		simulated = true;
+	}
+
+	/* carte de profondeur la plus recente, lue par le fragment shader du vetement */
+	bool occluded = s->occlusion_on && occlusionUpdate();
+
+	profBeginCPU(STAGE_UNIFORMS);
+	glBindBuffer(GL_ARRAY_BUFFER, s->joints_vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * s->joint_ctr * sizeof(float), s->joint_positions);
+	glUseProgram(s->garment_program);
+	glUniform1f(s->uni_scale, s->scale);
+	glUniform1i(s->uni_simulated, simulated);
+	glUniform1i(s->uni_occluded, occluded);
+	for (int k = 0; s->specialized && k < MAX_INFLUENCES; k++){
+		const GLint* u = s->skin_uniforms[k];
+		glUseProgram(s->skin_programs[k]);
+		glUniformMatrix4fv(u[SKIN_MODEL], 1, GL_FALSE, glm::value_ptr(s->model));
+		glUniformMatrix4fv(u[SKIN_PROJ], 1, GL_FALSE, glm::value_ptr(proj));
+		glUniform1f(u[SKIN_SCALE], s->scale);
+		glUniform1i(u[SKIN_TEXTURED], s->garment.texture != 0);
+		glUniform1i(u[SKIN_SIMULATED], simulated);
+		glUniform1i(u[SKIN_OCCLUDED], occluded);
+	}
+	profEndCPU(STAGE_UNIFORMS);
+
+	/* l'image couleur la plus recente en fond, le plus tard possible avant le vetement ;
+	comme les os, elle ne va qu'au panneau de face */
+	glViewport(0, 0, panel_width, render_height);
+	resolutionDraw();
+	backgroundDraw();
+
+	/* on dessine le vetement */
+	profBeginCPU(STAGE_DRAW_GARMENT);
+	profBeginGPU(STAGE_DRAW_GARMENT);
+	glViewport(0, 0, render_width, render_height);
+	glEnable(GL_DEPTH_TEST);
+	if (s->view_ctr > 1){
+		glEnable(GL_CLIP_DISTANCE0);
+		glEnable(GL_CLIP_DISTANCE1);
+	}
+	glUseProgram(s->garment_program);
+	if (s->garment.vao != 0){
+		glUniform1i(s->uni_textured, s->garment.texture != 0);
+		if (s->specialized)
+			drawGarment(&s->garment, s->bone_matrices, nb_bones, s->skin_programs, s->skin_palette_locs, MAX_INFLUENCES, s->view_ctr);
+		else
+			drawGarment(&s->garment, s->bone_matrices, nb_bones, &s->garment_program, &s->palette_loc, 1, s->view_ctr);
+	}
+	glDisable(GL_CLIP_DISTANCE0);
+	glDisable(GL_CLIP_DISTANCE1);
+	profEndGPU(STAGE_DRAW_GARMENT);
+	profEndCPU(STAGE_DRAW_GARMENT);
+
+	/* sans effet hors de Squelette --latency : relit la profondeur ecrite par le vetement */
+	latencyCapture(&s->shown_tag, render_width, render_height);
+
+	/* puis les positions des os */
+	profBeginCPU(STAGE_DRAW_JOINTS);
+	profBeginGPU(STAGE_DRAW_JOINTS);
+	glViewport(0, 0, panel_width, render_height);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glUseProgram(s->joints_program);
+	glBindVertexArray(s->joints_vao);
+	glDrawArrays(GL_POINTS, 0, s->joint_ctr);
+	glDisable(GL_PROGRAM_POINT_SIZE);
+	profEndGPU(STAGE_DRAW_JOINTS);
+	profEndCPU(STAGE_DRAW_JOINTS);
+
+	/* agrandissement vers la fenetre et nouvelle echelle d'apres le temps GPU mesure */
+	resolutionEnd(s->width, s->height);
+
+	double newTime = glfwGetTime();
+	while (newTime - s->last_frame < s->frame_interval)
+		newTime = glfwGetTime();
+	s->last_frame = newTime;
+
+	profBeginCPU(STAGE_SWAP);
+	glfwSwapBuffers(window);
+	profEndCPU(STAGE_SWAP);
+	latencyPresented(profNow());
+	if (slot != NULL && s->pipeline_depth <= 1)
+		pipelineRelease(slot);
+	glfwPollEvents();
+	if (s->shown_ingest_time > 0.0){
+		pipelineDisplayed(s->shown_ingest_time);
+		s->shown_ingest_time = 0.0;
+	}
+	profEndFrame();
+	return true;
+}
+
+void sessionDestroy(Session* s){
+	/* tous les threads arretes avant le profileur : ils y ecrivent leurs evenements */
+	pipelineStop();
+	clothStop();
+	watchStop();
+	loaderStop();
+	backgroundClose();
+	occlusionClose();
+	profDump(stdout);
+	profExportTrace("trace.json");
+	profShutdown();
+	glDeleteProgram(s->garment_program);
+	for (int k = 0; k < MAX_INFLUENCES; k++)
+		glDeleteProgram(s->skin_programs[k]);
+	glDeleteProgram(s->joints_program);
+	freeGarment(&s->garment);
+	glDeleteVertexArrays(1, &s->joints_vao);
+	glDeleteBuffers(1, &s->joints_vbo);
+	textureShutdown();
+	resolutionShutdown();
+
+	glfwTerminate();
+
+	for (int h = 0; h + 2 < 3 * s->joint_ctr; h = h + 3){
+		printf("%f, %f, %f\n", s->joint_positions[h], s->joint_positions[h + 1], s->joint_positions[h + 2]);
+	}
+
+	for (int b = 0; b < nb_bones; b++)
+		free(s->Bones[b]);
+	free(s->Bones);
+	free(s->bone_matrices);
+	free(s->bone_dirty);
+	free(s->joint_positions);
+	arenaFree(&s->arena);
+	*s = Session();
+}
+
+glm::mat4 defaultView(){
+	return glm::lookAt(
+		glm::vec3(0.0f, 2.5f, 0.5f),
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+/* vetement face a la camera, avant toute rotation au clavier */
+glm::mat4 defaultModel(){
+	return glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+GLFWwindow* initGLFW(int width, int height, const char* title){
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_DECORATED, GL_FALSE); // enleve decoration fenetre
+
+	return glfwCreateWindow(width, height, title, NULL, NULL);
+}
+
+void initGLEW(){
+	glewExperimental = GL_TRUE;
+	glewInit();
+}
+
+void updateTab(glm::vec3 ** Tab, float * maj){
+	int i, k;
+	k = 0;
+	for (i = 0; i < nb_bones; i++){
+			maj[k] = Tab[i][3].x;
+			k++;
+			maj[k] = Tab[i][3].y;
+			k++;
+			maj[k] = Tab[i][3].z;
+			k++;
+	}
+	maj[k] = Tab[0][3].x;
+	maj[k + 1] = Tab[0][3].y;
+	maj[k + 2] = Tab[0][3].z;
+}
@@ -0,0 +1,115 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+#include <glfw3.h>
+
+#include "importer.h"
+#include "frameArena.h"
+#include "matrixCalc.h"
+#include "bodyCollision.h"
+
+#define FRAME_INTERVAL 0.04 // cadence par defaut : 25 images/s
+#define MAX_VIEWS 4         // panneaux du miroir multi-vue : face, cote, dos, autre cote
+
+/* uniforms des variantes du programme du vetement, dans l'ordre de Session::skin_uniforms */
+enum { SKIN_MODEL, SKIN_VIEW, SKIN_PROJ, SKIN_SCALE, SKIN_TEXTURED, SKIN_SIMULATED, SKIN_OCCLUDED, NB_SKIN_UNIFORMS };
+
+/* Une session d'essayage : fenetre, contexte, programmes et buffers GPU crees une
+seule fois par sessionInit. sessionReset (touche R) ne remet a zero que l'etat propre
+a l'utilisateur : pose Kinect, positions de repos, matrices de bones, rotation et
+echelle du modele. Aucune allocation n'est faite par sessionReset. */
+
+struct Session{
+	GLFWwindow* window;
+	int width;
+	int height;
+	int screen_width;
+	int screen_height;
+
+	/* programmes et emplacements des uniforms */
+	GLuint garment_program;
+	GLuint joints_program;
+	GLint uni_model;
+	GLint uni_view;
+	GLint uni_proj;
+	GLint uni_scale;
+	GLint uni_textured;
+	GLint uni_simulated;
+	GLint uni_occluded;
+	GLint palette_loc;
+	GLuint skin_programs[MAX_INFLUENCES];    // vertexSource a k + 1 influences (touche I)
+	GLint skin_palette_locs[MAX_INFLUENCES];
+	GLint skin_uniforms[MAX_INFLUENCES][NB_SKIN_UNIFORMS];
+	GLint joints_model;
+	GLint joints_view;
+	GLint joints_proj;
+
+	/* buffers GPU */
+	GLuint joints_vao;
+	GLuint joints_vbo;
+	int joint_ctr;      // nb_bones positions Kinect, plus la premiere repetee par updateTab
+	Garment garment;
+	int catalogue_i;
+	int garment_watch;
+	int rest_watch;
+
+	/* etat de l'utilisateur, remis a zero par sessionReset ; les matrices et les
+	positions des joints sont celles de l'image affichee, copiees depuis le pipeline */
+	glm::vec3** Bones;         // [0..1] repos de REST_FILE, [2..3] Kinect de l'image affichee
+	glm::mat4* bone_matrices;
+	unsigned char* bone_dirty; // bones qui ont bouge dans l'image, pour le skinning CPU
+	float* joint_positions; // 3 par joint
+	BodyProxy body;
+	glm::mat4 model;
+	float scale;
+
+	/* etat de la boucle ; l'arene porte les donnees temporaires de l'image du thread GL */
+	FrameArena arena;
+	int pipeline_depth;
+	double frame_interval;    // duree minimale d'une image, 0 : pas d'attente
+	double cloth_budget;      // temps de simulation du tissu par image (ms)
+	bool cloth_on;
+	bool specialized;         // triangles dessines avec la variante de leur nombre d'influences
+	bool cpu_skin;            // positions skinnees sur CPU par groupes de bones (cpuSkin.h)
+	bool occlusion_on;        // vetement cache par l'utilisateur d'apres la carte de profondeur (touche O)
+	int view_ctr;             // panneaux cote a cote dessines en une passe, 1 : vue de face seule
+	bool pose_library;        // instantanes precalcules a la place du skinning (poseLibrary.h, touche L)
+	int pose_error_frame;     // images depuis la derniere mesure d'erreur de la bibliotheque
+	double shown_ingest_time; // lecture Kinect de l'image affichee
+	PoseTag shown_tag;        // etiquette du traqueur de test de l'image affichee
+	double last_frame;
+	char ordre;
+	bool next_pressed;
+	bool reset_pressed;
+	bool cloth_pressed;
+	bool specialized_pressed;
+	bool cpu_skin_pressed;
+	bool occlusion_pressed;
+	bool pose_library_pressed;
+};
+
+/* shaders et camera du vetement, partages avec le rendu de reference (golden.cpp) */
+extern const GLchar* vertexSource;
+extern const GLchar* fragmentSource;
+glm::mat4 defaultView();
+glm::mat4 defaultModel();
+
+GLFWwindow* initGLFW(int width, int height, const char* title);
+void initGLEW();
+void updateTab(glm::vec3 ** Tab, float * maj);
+
+/* background : source de l'image couleur du fond (background.h), NULL : fond blanc
+   occlusion : source de la carte de profondeur (occlusion.h), NULL : pas d'occultation
+   view_ctr : vues du multi-vue, jusqu'a MAX_VIEWS
+   pose_library : bibliotheque de poses des vetements qui en ont une, a la place du skinning */
+bool sessionInit(Session* session, int pipeline_depth, double frame_interval, double cloth_budget, bool cpu_skin,
+	const char* background, const char* occlusion, int view_ctr, bool pose_library);
+void sessionReset(Session* session);
+bool sessionFrame(Session* session);
+void sessionDestroy(Session* session);
+
+#endif
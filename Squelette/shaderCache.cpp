@@ -0,0 +1,184 @@
+#include "shaderCache.h"
+#include <glfw3.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHADER_CACHE_MAGIC 0x43534847 // "GHSC"
+#define SHADER_CACHE_VERSION 1
+
+/* en-tete d'un fichier de cache, suivi de 'length' octets de binaire */
+struct ShaderCacheHeader{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long key;
+	GLenum format;
+	GLint length;
+	double compile_ms; // temps de compilation/link mesure lors de l'ecriture
+};
+
+/* statistiques du demarrage */
+static int cache_hits = 0;
+static int cache_misses = 0;
+static double saved_ms = 0.0;
+
+/* hash FNV-1a 64 bits */
+static unsigned long long hashString(unsigned long long h, const char* s){
+	if (s == NULL)
+		return h;
+	while (*s){
+		h ^= (unsigned char)*s++;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static unsigned long long programKey(const GLchar* vertexSrc, const GLchar* fragmentSrc){
+	unsigned long long h = 14695981039346656037ULL;
+	h = hashString(h, vertexSrc);
+	h = hashString(h, fragmentSrc);
+	h = hashString(h, (const char*)glGetString(GL_VENDOR));
+	h = hashString(h, (const char*)glGetString(GL_RENDERER));
+	h = hashString(h, (const char*)glGetString(GL_VERSION));
+	return h;
+}
+
+static bool binarySupported(){
+	if (!GLEW_ARB_get_program_binary)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+/* tente de recreer le programme depuis le cache, renvoie 0 si absent ou invalide */
+static GLuint loadCachedProgram(const char* path, unsigned long long key){
+	FILE* fichier = fopen(path, "rb");
+	if (fichier == NULL)
+		return 0;
+
+	double start = glfwGetTime();
+	ShaderCacheHeader header;
+	if (fread(&header, sizeof(header), 1, fichier) != 1
+		|| header.magic != SHADER_CACHE_MAGIC
+		|| header.version != SHADER_CACHE_VERSION
+		|| header.key != key
+		|| header.length <= 0){
+		fclose(fichier);
+		return 0;
+	}
+
+	void* binary = malloc(header.length);
+	if (fread(binary, 1, header.length, fichier) != (size_t)header.length){
+		free(binary);
+		fclose(fichier);
+		return 0;
+	}
+	fclose(fichier);
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary, header.length);
+	free(binary);
+
+	/* le driver peut refuser un binaire (mise a jour, autre GPU...) */
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE){
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	double load_ms = (glfwGetTime() - start) * 1000.0;
+	saved_ms += header.compile_ms - load_ms;
+	return program;
+}
+
+static void saveCachedProgram(const char* path, unsigned long long key, GLuint program, double compile_ms){
+	ShaderCacheHeader header;
+	header.magic = SHADER_CACHE_MAGIC;
+	header.version = SHADER_CACHE_VERSION;
+	header.key = key;
+	header.compile_ms = compile_ms;
+	header.length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+	if (header.length <= 0)
+		return;
+
+	void* binary = malloc(header.length);
+	glGetProgramBinary(program, header.length, NULL, &header.format, binary);
+
+	FILE* fichier = fopen(path, "wb");
+	if (fichier != NULL){
+		fwrite(&header, sizeof(header), 1, fichier);
+		fwrite(binary, 1, header.length, fichier);
+		fclose(fichier);
+	}
+	free(binary);
+}
+
+GLuint createShader(GLenum type, const GLchar* src){
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &src, NULL);
+	glCompileShader(shader);
+
+	return shader;
+}
+
+/* Cree et lie un programme, en passant par le cache disque quand c'est possible */
+GLuint createProgram(const GLchar* vertexSrc, const GLchar* fragmentSrc){
+	bool useCache = binarySupported();
+	unsigned long long key = 0;
+	char path[64];
+
+	if (useCache){
+		key = programKey(vertexSrc, fragmentSrc);
+		sprintf(path, "shader_%016llx.bin", key);
+		GLuint cached = loadCachedProgram(path, key);
+		if (cached != 0){
+			cache_hits++;
+			return cached;
+		}
+	}
+	cache_misses++;
+
+	/* compilation classique depuis les sources */
+	double start = glfwGetTime();
+	GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexSrc);
+	GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentSrc);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glBindFragDataLocation(program, 0, "outColor");
+	if (useCache)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+
+	/* force la fin du link pour mesurer le vrai cout */
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	double compile_ms = (glfwGetTime() - start) * 1000.0;
+
+	/* les shaders ne servent plus une fois le programme lie */
+	glDetachShader(program, vertexShader);
+	glDetachShader(program, fragmentShader);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	if (status != GL_TRUE){
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		fprintf(stderr, "ERROR linking program :\n%s\n", log);
+		return program;
+	}
+
+	if (useCache)
+		saveCachedProgram(path, key, program, compile_ms);
+	return program;
+}
+
+void printShaderCacheStats(){
+	printf("Shaders : %i depuis le cache, %i compiles", cache_hits, cache_misses);
+	if (cache_hits > 0)
+		printf(" (%.1f ms de compilation/link economisees)", saved_ms);
+	printf("\n");
+}
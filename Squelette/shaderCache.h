@@ -0,0 +1,19 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#include <stdio.h>
+
+/* Cache disque des programmes lies (glGetProgramBinary / glProgramBinary).
+La cle est un hash des sources et de la chaine du driver (vendor, renderer, version) :
+un changement de shader ou de driver invalide automatiquement l'entree. */
+
+GLuint createShader(GLenum type, const GLchar* src);
+GLuint createProgram(const GLchar* vertexSrc, const GLchar* fragmentSrc);
+void printShaderCacheStats();
+
+#endif
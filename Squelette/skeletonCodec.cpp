@@ -0,0 +1,140 @@
+#include "skeletonCodec.h"
+#include <string.h>
+#include <math.h>
+
+#define FRAME_KEY 1
+#define FRAME_TAGGED 2
+
+size_t skeletonCodecBytes(int point_ctr){
+	return 3 * (size_t)point_ctr * sizeof(int);
+}
+
+void skeletonCodecInit(SkeletonCodec* codec, int point_ctr, float step, int keyframe, void* memory){
+	codec->point_ctr = point_ctr;
+	codec->step = step > 0.0f ? step : SKELETON_PRECISION;
+	codec->inv_step = 1.0 / codec->step;
+	codec->keyframe = keyframe > 0 ? keyframe : 1;
+	codec->since_key = -1;
+	codec->previous = (int *)memory;
+}
+
+size_t skeletonWriteHeader(const SkeletonCodec* codec, unsigned char* out){
+	SkeletonHeader header;
+	header.magic = SKELETON_MAGIC;
+	header.version = SKELETON_VERSION;
+	header.point_ctr = codec->point_ctr;
+	header.step = codec->step;
+	memcpy(out, &header, sizeof(SkeletonHeader));
+	return sizeof(SkeletonHeader);
+}
+
+bool skeletonReadHeader(const unsigned char* in, size_t size, SkeletonHeader* header){
+	if (size < sizeof(SkeletonHeader))
+		return false;
+	memcpy(header, in, sizeof(SkeletonHeader));
+	return header->magic == SKELETON_MAGIC && header->version == SKELETON_VERSION
+		&& header->point_ctr > 0 && header->step > 0.0f;
+}
+
+/* entiers signes en zigzag (0, -1, 1, -2... -> 0, 1, 2, 3...), puis 7 bits par octet,
+bit de poids fort a 1 tant qu'il reste des octets */
+static unsigned char* putVarint(unsigned char* out, int value){
+	unsigned int z = ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+	while (z >= 0x80){
+		*out++ = (unsigned char)(z | 0x80);
+		z >>= 7;
+	}
+	*out++ = (unsigned char)z;
+	return out;
+}
+
+static const unsigned char* getVarint(const unsigned char* in, const unsigned char* end, int* value){
+	unsigned int z = 0;
+	for (int shift = 0; shift < 35 && in < end; shift += 7){
+		unsigned char b = *in++;
+		z |= (unsigned int)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0){
+			*value = (int)(z >> 1) ^ -(int)(z & 1);
+			return in;
+		}
+	}
+	return NULL;
+}
+
+/* en double : seul l'arrondi au pas compte dans l'erreur ; borne a 2^30 pour que
+la difference de deux valeurs tienne dans un int */
+static int quantize(float v, double inv_step){
+	if (!(v > -SKELETON_RANGE && v < SKELETON_RANGE))
+		v = v >= SKELETON_RANGE ? SKELETON_RANGE : (v <= -SKELETON_RANGE ? -SKELETON_RANGE : 0.0f);
+	double q = floor(v * inv_step + 0.5);
+	return q > 1073741823.0 ? 1073741823 : (q < -1073741823.0 ? -1073741823 : (int)q);
+}
+
+size_t skeletonEncode(SkeletonCodec* codec, const float* points, const PoseTag* tag, unsigned char* out){
+	bool key = codec->since_key < 0 || codec->since_key + 1 >= codec->keyframe;
+	bool tagged = tag != NULL && tag->step >= 0;
+	unsigned char* p = out;
+	*p++ = (unsigned char)((key ? FRAME_KEY : 0) | (tagged ? FRAME_TAGGED : 0));
+	int n = 3 * codec->point_ctr;
+	for (int i = 0; i < n; i++){
+		int q = quantize(points[i], codec->inv_step);
+		p = putVarint(p, key ? q : q - codec->previous[i]);
+		codec->previous[i] = q;
+	}
+	codec->since_key = key ? 0 : codec->since_key + 1;
+	if (tagged){
+		memcpy(p, &tag->time, sizeof(double));
+		p += sizeof(double);
+		p = putVarint(p, tag->step);
+		memcpy(p, &tag->step_time, sizeof(double));
+		p += sizeof(double);
+	}
+	return (size_t)(p - out);
+}
+
+size_t skeletonDecode(SkeletonCodec* codec, const unsigned char* in, size_t size, float* points, PoseTag* tag){
+	if (tag != NULL){
+		tag->time = 0.0;
+		tag->step = -1;
+		tag->step_time = 0.0;
+	}
+	const unsigned char* end = in + size;
+	const unsigned char* p = in;
+	if (p >= end)
+		return 0;
+	unsigned char flags = *p++;
+	bool key = (flags & FRAME_KEY) != 0;
+	if (!key && codec->since_key < 0)
+		return 0;
+	int n = 3 * codec->point_ctr;
+	for (int i = 0; i < n; i++){
+		int v;
+		p = getVarint(p, end, &v);
+		if (p == NULL){
+			codec->since_key = -1;
+			return 0;
+		}
+		codec->previous[i] = key ? v : codec->previous[i] + v;
+		points[i] = (float)((double)codec->previous[i] * codec->step);
+	}
+	codec->since_key = key ? 0 : codec->since_key + 1;
+	if (flags & FRAME_TAGGED){
+		PoseTag read;
+		if (end - p < (long)sizeof(double)){
+			codec->since_key = -1;
+			return 0;
+		}
+		memcpy(&read.time, p, sizeof(double));
+		p += sizeof(double);
+		p = getVarint(p, end, &read.step);
+		if (p == NULL || end - p < (long)sizeof(double)){
+			codec->since_key = -1;
+			return 0;
+		}
+		memcpy(&read.step_time, p, sizeof(double));
+		p += sizeof(double);
+		if (tag != NULL)
+			*tag = read;
+	}
+	return (size_t)(p - in);
+}
@@ -0,0 +1,62 @@
+#ifndef SKELETONCODEC_H
+#define SKELETONCODEC_H
+
+#include <stdlib.h>
+#include "matrixCalc.h"
+
+/* Codage binaire des positions Kinect, a la place des triplets "%f" (environ 400 octets
+par image pour 8 os). Chaque coordonnee est quantifiee au pas 'step' (en metres), puis
+codee par difference avec la valeur quantifiee de l'image precedente ; les differences,
+en zigzag, sont empaquetees en entiers de longueur variable (7 bits par octet), un
+octet suffisant aux joints immobiles. Une image cle (valeurs entieres, sans reference)
+revient toutes les 'keyframe' images pour qu'un lecteur puisse prendre le flux en cours.
+Le codeur suit les valeurs quantifiees, pas les positions : l'erreur ne s'accumule pas.
+Ecart d'une position decodee a l'originale, verifie par bench/bench.cpp :
+	|v - decode(v)| <= step / 2 + |v| * 2^-22 (arrondis flottants), pour |v| < SKELETON_RANGE
+Utilise par le fichier Kinect (une image cle par fichier, le lecteur n'en voit pas toutes
+les images) et par les enregistrements .skc de Squelette --record (flux complet). */
+
+#define SKELETON_MAGIC 0x434b5347   // "GSKC"
+#define SKELETON_VERSION 1
+#define SKELETON_PRECISION 1e-4f    // pas de quantification par defaut (m) : 0,05 mm d'erreur au plus
+#define SKELETON_KEYFRAME 30        // images entre deux images cles d'un enregistrement
+#define SKELETON_RANGE 1e4f         // positions ecretees au-dela (m), NaN lu comme 0
+#define SKELETON_EXTENSION ".skc"   // enregistrements codes, les autres restent en texte
+/* taille maximale d'une image codee : drapeaux, 5 octets par coordonnee, etiquette */
+#define SKELETON_FRAME_MAX(point_ctr) (1 + 15 * (size_t)(point_ctr) + 2 * sizeof(double) + 5)
+
+/* en-tete du flux, une fois au debut */
+struct SkeletonHeader{
+	unsigned int magic;
+	unsigned int version;
+	int point_ctr;     // 2 par os et par personne
+	float step;
+};
+
+/* etat d'un codeur ou d'un decodeur ; 'previous' est fourni par l'appelant
+(skeletonCodecBytes octets), pour decoder dans une arene d'image sans allocation */
+struct SkeletonCodec{
+	int point_ctr;
+	float step;
+	double inv_step;
+	int keyframe;      // 1 : toutes les images sont independantes
+	int since_key;     // images depuis la derniere image cle, -1 : pas de reference
+	int* previous;     // valeurs quantifiees de l'image precedente, 3 par point
+};
+
+size_t skeletonCodecBytes(int point_ctr);
+void skeletonCodecInit(SkeletonCodec* codec, int point_ctr, float step, int keyframe, void* memory);
+
+size_t skeletonWriteHeader(const SkeletonCodec* codec, unsigned char* out);
+/* false si 'in' ne commence pas par un en-tete valide ; sinon remplit 'header' */
+bool skeletonReadHeader(const unsigned char* in, size_t size, SkeletonHeader* header);
+
+/* 3 flottants par point ; tag facultatif (NULL ou step < 0 : pas d'etiquette).
+Renvoie le nombre d'octets ecrits dans out (au plus SKELETON_FRAME_MAX) */
+size_t skeletonEncode(SkeletonCodec* codec, const float* points, const PoseTag* tag, unsigned char* out);
+/* Renvoie le nombre d'octets lus, 0 si l'image est tronquee ou si c'est une difference
+sans image de reference ; apres une image tronquee, le decodeur attend l'image cle
+suivante. tag est remis a step = -1 sans etiquette */
+size_t skeletonDecode(SkeletonCodec* codec, const unsigned char* in, size_t size, float* points, PoseTag* tag);
+
+#endif
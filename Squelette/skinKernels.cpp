@@ -0,0 +1,40 @@
+#include "skinKernels.h"
+
+template <int K>
+static void skinRange(const float* const rest[3], const int* bones, const float* weights, int a, int b,
+	const glm::mat4* bone_matrices, int nb_matrices, float* const out[3]){
+	for (int p = a; p < b; p++){
+		glm::vec4 r(rest[0][p], rest[1][p], rest[2][p], 1.0f);
+		glm::vec4 s(0.0f, 0.0f, 0.0f, 0.0f);
+		/* K est une constante : la boucle est deroulee et, pour K = 0, disparait */
+		for (int k = 0; k < K; k++){
+			int bone = bones[MAX_INFLUENCES * p + k];
+			s = s + (bone < nb_matrices ? bone_matrices[bone] * r : r) * weights[MAX_INFLUENCES * p + k];
+		}
+		s = s.w != 0.0f ? s / s.w : r;
+		out[0][p] = s.x;
+		out[1][p] = s.y;
+		out[2][p] = s.z;
+	}
+}
+
+typedef void(*SkinKernel)(const float* const*, const int*, const float*, int, int, const glm::mat4*, int, float* const*);
+
+static const SkinKernel kernels[MAX_INFLUENCES + 1] = {
+	skinRange<0>, skinRange<1>, skinRange<2>, skinRange<3>, skinRange<4>,
+};
+
+void skinPositions(const float* const rest[3], const int* bones, const float* weights,
+	const int* bucket_start, int a, int b,
+	const glm::mat4* bone_matrices, int nb_matrices, float* const out[3]){
+	if (bucket_start == NULL){
+		skinRange<MAX_INFLUENCES>(rest, bones, weights, a, b, bone_matrices, nb_matrices, out);
+		return;
+	}
+	for (int k = 0; k <= MAX_INFLUENCES; k++){
+		int lo = bucket_start[k] > a ? bucket_start[k] : a;
+		int hi = bucket_start[k + 1] < b ? bucket_start[k + 1] : b;
+		if (lo < hi)
+			kernels[k](rest, bones, weights, lo, hi, bone_matrices, nb_matrices, out);
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef SKINKERNELS_H
+#define SKINKERNELS_H
+
+#ifndef GLM_H
+#define GLM_H
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#endif
+
+#include "importer.h"
+
+/* Skinning sur CPU (tissu, bench). Les influences de chaque sommet sont rangees par
+poids decroissant, celles de poids nul a la fin : un noyau specialise a la compilation
+pour K influences ne lit que les K premieres. Les sommets sont ranges par nombre
+d'influences et chaque plage est confiee a son noyau.
+Positions en SoA ; bones globaux, les bones au-dela de nb_matrices restent a l'identite.
+Le resultat est ramene a w = 1, ce qui renormalise les poids incomplets ; un sommet sans
+influence garde sa position de repos. */
+
+/* sommets [a, b) ; bucket_start[k] : premier sommet a k influences (0 a MAX_INFLUENCES),
+bucket_start[MAX_INFLUENCES + 1] : fin. NULL : noyau generique a MAX_INFLUENCES influences. */
+void skinPositions(const float* const rest[3], const int* bones, const float* weights,
+	const int* bucket_start, int a, int b,
+	const glm::mat4* bone_matrices, int nb_matrices, float* const out[3]);
+
+#endif
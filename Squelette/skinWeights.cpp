@@ -0,0 +1,318 @@
+#include "skinWeights.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#define SKIN_MAX_COT 1e3f // triangles presque plats : cotangente bornee
+
+/* Matrice symetrique creuse, diagonale a part. La ligne i a une capacite fixe de
+2 entrees par triangle voisin, dont row_len[i] sont utilisees. */
+struct SkinSystem{
+	int n;
+	const float* pos;    // 3 par particule
+	const int* tris;     // 3 par triangle, en particules
+	const int* tri_start; // triangles voisins de i : tri_of[tri_start[i]..tri_start[i + 1]]
+	const int* tri_of;
+	const glm::vec3* segments;
+	int bone_ctr;
+	int* row_len;
+	int* cols;
+	float* vals;
+	float* diag;
+	float* mh;           // M_i H_i
+	int* nearest;        // os le plus proche
+};
+
+static float segmentDistance(const float* p, glm::vec3 a, glm::vec3 b){
+	glm::vec3 ab = b - a;
+	glm::vec3 ap = glm::vec3(p[0], p[1], p[2]) - a;
+	float len2 = glm::dot(ab, ab);
+	float t = len2 > 0.0f ? glm::dot(ap, ab) / len2 : 0.0f;
+	t = std::max(0.0f, std::min(1.0f, t));
+	glm::vec3 e = ap - ab * t;
+	return sqrtf(glm::dot(e, e));
+}
+
+/* lignes [a, b) : poids cotangents, masse, chaleur de l'os le plus proche */
+static void assembleRows(SkinSystem* S, int a, int b){
+	for (int i = a; i < b; i++){
+		int start = 2 * S->tri_start[i];
+		int* cols = &S->cols[start];
+		float* vals = &S->vals[start];
+		int len = 0;
+		float mass = 0.0f;
+		const float* pi = &S->pos[3 * i];
+		for (int k = S->tri_start[i]; k < S->tri_start[i + 1]; k++){
+			const int* tv = &S->tris[3 * S->tri_of[k]];
+			int r = tv[0] == i ? 0 : (tv[1] == i ? 1 : 2);
+			int j = tv[(r + 1) % 3];
+			int l = tv[(r + 2) % 3];
+			glm::vec3 vi(pi[0], pi[1], pi[2]);
+			glm::vec3 vj(S->pos[3 * j], S->pos[3 * j + 1], S->pos[3 * j + 2]);
+			glm::vec3 vl(S->pos[3 * l], S->pos[3 * l + 1], S->pos[3 * l + 2]);
+			glm::vec3 n = glm::cross(vj - vi, vl - vi);
+			float twice_area = sqrtf(glm::dot(n, n));
+			if (twice_area < 1e-12f)
+				continue;
+			/* arete (i, j) face au sommet l, arete (i, l) face au sommet j */
+			float cot_l = glm::dot(vi - vl, vj - vl) / twice_area;
+			float cot_j = glm::dot(vi - vj, vl - vj) / twice_area;
+			cols[len] = j;
+			vals[len++] = 0.5f * std::max(0.0f, std::min(SKIN_MAX_COT, cot_l));
+			cols[len] = l;
+			vals[len++] = 0.5f * std::max(0.0f, std::min(SKIN_MAX_COT, cot_j));
+			mass += twice_area / 6.0f;
+		}
+
+		/* une arete apparait dans deux triangles : tri par colonne et fusion */
+		for (int x = 1; x < len; x++){
+			int c = cols[x];
+			float v = vals[x];
+			int y = x - 1;
+			for (; y >= 0 && cols[y] > c; y--){
+				cols[y + 1] = cols[y];
+				vals[y + 1] = vals[y];
+			}
+			cols[y + 1] = c;
+			vals[y + 1] = v;
+		}
+		int merged = 0;
+		float sum = 0.0f;
+		for (int x = 0; x < len; x++){
+			sum += vals[x];
+			if (merged > 0 && cols[merged - 1] == cols[x])
+				vals[merged - 1] -= vals[x];
+			else{
+				cols[merged] = cols[x];
+				vals[merged++] = -vals[x];
+			}
+		}
+		S->row_len[i] = merged;
+
+		float best = 1e30f;
+		int nearest = 0;
+		for (int j = 0; j < S->bone_ctr; j++){
+			float d = segmentDistance(pi, S->segments[2 * j], S->segments[2 * j + 1]);
+			if (d < best){
+				best = d;
+				nearest = j;
+			}
+		}
+		best = std::max(best, 1e-3f);
+		S->nearest[i] = nearest;
+		/* particule sans triangle : w = p directement */
+		S->mh[i] = mass > 0.0f ? mass * SKIN_HEAT / (best * best) : 1.0f;
+		S->diag[i] = sum + S->mh[i];
+	}
+}
+
+static void multiply(const SkinSystem* S, const float* x, float* y){
+	for (int i = 0; i < S->n; i++){
+		int start = 2 * S->tri_start[i];
+		double s = S->diag[i] * x[i];
+		for (int k = 0; k < S->row_len[i]; k++)
+			s += S->vals[start + k] * x[S->cols[start + k]];
+		y[i] = (float)s;
+	}
+}
+
+static double dot(const float* a, const float* b, int n){
+	double s = 0.0;
+	for (int i = 0; i < n; i++)
+		s += (double)a[i] * b[i];
+	return s;
+}
+
+/* gradient conjugue preconditionne par la diagonale, x en entree : point de depart */
+static int conjugateGradient(const SkinSystem* S, const float* b, float* x, float* work){
+	int n = S->n;
+	float* r = work;
+	float* z = work + n;
+	float* p = work + 2 * n;
+	float* q = work + 3 * n;
+	double b_norm = sqrt(dot(b, b, n));
+	if (b_norm == 0.0){
+		memset(x, 0, n * sizeof(float));
+		return 0;
+	}
+	multiply(S, x, q);
+	for (int i = 0; i < n; i++){
+		r[i] = b[i] - q[i];
+		z[i] = r[i] / S->diag[i];
+		p[i] = z[i];
+	}
+	double rz = dot(r, z, n);
+	int it = 0;
+	for (; it < SKIN_MAX_ITERATIONS; it++){
+		if (sqrt(dot(r, r, n)) <= SKIN_TOLERANCE * b_norm)
+			break;
+		multiply(S, p, q);
+		double pq = dot(p, q, n);
+		if (pq <= 0.0)
+			break;
+		float alpha = (float)(rz / pq);
+		for (int i = 0; i < n; i++){
+			x[i] += alpha * p[i];
+			r[i] -= alpha * q[i];
+			z[i] = r[i] / S->diag[i];
+		}
+		double rz_next = dot(r, z, n);
+		float beta = (float)(rz_next / rz);
+		rz = rz_next;
+		for (int i = 0; i < n; i++)
+			p[i] = z[i] + beta * p[i];
+	}
+	return it;
+}
+
+bool solveSkinWeights(const float* points, int point_ctr, const unsigned int* indices, int index_ctr,
+	const glm::vec3* segments, int bone_ctr, int* bone_ids, float* weights){
+	if (point_ctr == 0 || bone_ctr == 0)
+		return false;
+	double begin = profNow();
+
+	/* soudure par position : les coutures d'UV ne doivent pas couper la diffusion */
+	int* order = (int*)malloc(point_ctr * sizeof(int));
+	for (int v = 0; v < point_ctr; v++)
+		order[v] = v;
+	std::sort(order, order + point_ctr, [points](int i, int j){
+		const float* a = &points[3 * i];
+		const float* b = &points[3 * j];
+		if (a[0] != b[0]) return a[0] < b[0];
+		if (a[1] != b[1]) return a[1] < b[1];
+		return a[2] < b[2];
+	});
+	int* particle_of = (int*)malloc(point_ctr * sizeof(int));
+	float* pos = (float*)malloc(3 * point_ctr * sizeof(float));
+	int n = 0;
+	for (int k = 0; k < point_ctr; k++){
+		int v = order[k];
+		if (k == 0 || memcmp(&points[3 * v], &points[3 * order[k - 1]], 3 * sizeof(float)) != 0){
+			memcpy(&pos[3 * n], &points[3 * v], 3 * sizeof(float));
+			n++;
+		}
+		particle_of[v] = n - 1;
+	}
+	free(order);
+
+	/* triangles en particules et triangles voisins de chaque particule */
+	int tri_ctr = 0;
+	int* tris = (int*)malloc(index_ctr * sizeof(int));
+	for (int t = 0; t + 2 < index_ctr; t += 3){
+		int a = particle_of[indices[t]], b = particle_of[indices[t + 1]], c = particle_of[indices[t + 2]];
+		if (a == b || b == c || c == a)
+			continue;
+		tris[3 * tri_ctr] = a;
+		tris[3 * tri_ctr + 1] = b;
+		tris[3 * tri_ctr + 2] = c;
+		tri_ctr++;
+	}
+	int* tri_start = (int*)calloc(n + 1, sizeof(int));
+	int* tri_of = (int*)malloc(3 * tri_ctr * sizeof(int) + sizeof(int));
+	for (int k = 0; k < 3 * tri_ctr; k++)
+		tri_start[tris[k] + 1]++;
+	for (int i = 0; i < n; i++)
+		tri_start[i + 1] += tri_start[i];
+	int* fill = (int*)malloc(n * sizeof(int));
+	memcpy(fill, tri_start, n * sizeof(int));
+	for (int k = 0; k < 3 * tri_ctr; k++)
+		tri_of[fill[tris[k]]++] = k / 3;
+	free(fill);
+
+	SkinSystem S;
+	S.n = n;
+	S.pos = pos;
+	S.tris = tris;
+	S.tri_start = tri_start;
+	S.tri_of = tri_of;
+	S.segments = segments;
+	S.bone_ctr = bone_ctr;
+	S.row_len = (int*)malloc(n * sizeof(int));
+	S.cols = (int*)malloc(6 * tri_ctr * sizeof(int) + sizeof(int));
+	S.vals = (float*)malloc(6 * tri_ctr * sizeof(float) + sizeof(float));
+	S.diag = (float*)malloc(n * sizeof(float));
+	S.mh = (float*)malloc(n * sizeof(float));
+	S.nearest = (int*)malloc(n * sizeof(int));
+
+	int nb_threads = SKIN_THREADS;
+	std::thread threads[SKIN_THREADS];
+	int chunk = (n + nb_threads - 1) / nb_threads;
+	for (int t = 0; t < nb_threads; t++)
+		threads[t] = std::thread(assembleRows, &S, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+	for (int t = 0; t < nb_threads; t++)
+		threads[t].join();
+	double assembly_ms = (profNow() - begin) * 1000.0;
+
+	/* un systeme par os, memes matrices : les os sont repartis entre les threads */
+	float* w = (float*)malloc((size_t)bone_ctr * n * sizeof(float));
+	float* work = (float*)malloc((size_t)nb_threads * 5 * n * sizeof(float));
+	std::atomic<int> next_bone(0);
+	std::atomic<int> max_iterations(0);
+	for (int t = 0; t < nb_threads; t++){
+		threads[t] = std::thread([&, t](){
+			float* b = work + (size_t)t * 5 * n;
+			for (int j = next_bone++; j < bone_ctr; j = next_bone++){
+				float* x = w + (size_t)j * n;
+				for (int i = 0; i < n; i++){
+					b[i] = S.nearest[i] == j ? S.mh[i] : 0.0f;
+					x[i] = S.nearest[i] == j ? 1.0f : 0.0f;
+				}
+				int it = conjugateGradient(&S, b, x, b + n);
+				int seen = max_iterations.load();
+				while (it > seen && !max_iterations.compare_exchange_weak(seen, it));
+			}
+		});
+	}
+	for (int t = 0; t < nb_threads; t++)
+		threads[t].join();
+
+	/* 4 plus fortes influences par sommet, renormalisees */
+	for (int v = 0; v < point_ctr; v++){
+		int p = particle_of[v];
+		int ids[4] = { 0, 0, 0, 0 };
+		float best[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int j = 0; j < bone_ctr; j++){
+			float x = w[(size_t)j * n + p];
+			if (x <= best[3] || x < SKIN_MIN_WEIGHT)
+				continue;
+			int k = 3;
+			for (; k > 0 && best[k - 1] < x; k--){
+				best[k] = best[k - 1];
+				ids[k] = ids[k - 1];
+			}
+			best[k] = x;
+			ids[k] = j;
+		}
+		float sum = best[0] + best[1] + best[2] + best[3];
+		if (sum <= 0.0f){
+			ids[0] = S.nearest[p];
+			best[0] = sum = 1.0f;
+		}
+		for (int k = 0; k < 4; k++){
+			bone_ids[4 * v + k] = ids[k];
+			weights[4 * v + k] = best[k] / sum;
+		}
+	}
+
+	printf("poids automatiques : %i os, %i sommets (%i soudes), assemblage %.1f ms, total %.1f ms, %i iterations au plus\n",
+		bone_ctr, point_ctr, n, assembly_ms, (profNow() - begin) * 1000.0, max_iterations.load());
+	free(w);
+	free(work);
+	free(S.row_len);
+	free(S.cols);
+	free(S.vals);
+	free(S.diag);
+	free(S.mh);
+	free(S.nearest);
+	free(tri_start);
+	free(tri_of);
+	free(tris);
+	free(pos);
+	free(particle_of);
+	return true;
+}
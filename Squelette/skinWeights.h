@@ -0,0 +1,32 @@
+#ifndef SKINWEIGHTS_H
+#define SKINWEIGHTS_H
+
+#ifndef GLM_H
+#define GLM_H
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#endif
+
+/* Poids de skinning automatiques par diffusion de chaleur (Baran et Popovic, 2007).
+Pour chaque os j on resout (K + M H) w_j = M H p_j sur le maillage soude par position :
+K laplacien cotangent, M aire de Voronoi approchee (tiers des triangles voisins),
+H = SKIN_HEAT / d^2 avec d la distance a l'os le plus proche, p_j = 1 la ou cet os est
+le plus proche. Les cotangentes negatives sont ramenees a 0 : la matrice est alors une
+M-matrice symetrique definie positive et les poids restent dans [0, 1].
+Les lignes de la matrice sont assemblees en parallele, puis chaque os est resolu par
+gradient conjugue preconditionne (Jacobi) sur SKIN_THREADS threads. Chaque sommet garde
+ses 4 plus fortes influences, renormalisees. */
+
+#define SKIN_THREADS 4
+#define SKIN_HEAT 1.0f
+#define SKIN_TOLERANCE 1e-5        // residu relatif d'arret du gradient conjugue
+#define SKIN_MAX_ITERATIONS 2000
+#define SKIN_MIN_WEIGHT 0.005f     // influences plus faibles ignorees avant renormalisation
+
+/* segments : 2 extremites par os, dans l'espace du maillage. bone_ids et weights : 4 par
+sommet, bones globaux (indices dans segments). */
+bool solveSkinWeights(const float* points, int point_ctr, const unsigned int* indices, int index_ctr,
+	const glm::vec3* segments, int bone_ctr, int* bone_ids, float* weights);
+
+#endif
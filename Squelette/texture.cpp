@@ -0,0 +1,639 @@
+#include "texture.h"
+#include "fileMap.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+
+/* Format .ctex : en-tete puis niveaux de mipmap alignes sur 16 octets.
+Toute modification de la disposition doit incrementer CTEX_VERSION. */
+#define CTEX_MAGIC 0x58544847 // "GHTX"
+#define CTEX_VERSION 1
+
+#define TEX_CACHE_MAX 32
+
+struct CtexHeader{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long source_hash; // hash de l'image d'origine
+	unsigned int format;
+	int width;
+	int height;
+	int level_ctr;
+	unsigned int offsets[TEX_MAX_LEVELS];
+	unsigned int sizes[TEX_MAX_LEVELS];
+	unsigned int file_size;
+};
+
+struct CacheEntry{
+	char name[256];
+	GLuint tex;
+	size_t bytes;
+	int refs;
+	unsigned int last_use;
+};
+
+/* le cache est lu par les threads de chargement, protege par 'cache_lock' */
+static std::mutex cache_lock;
+static CacheEntry cache[TEX_CACHE_MAX];
+static int cache_ctr = 0;
+static size_t cache_bytes = 0;
+static unsigned int use_clock = 0;
+
+/* anneau de PBOs, propre au thread de rendu */
+static GLuint pbos[TEX_PBO_RING];
+static int pbo_next = 0;
+
+static bool isCompressed(GLenum format){
+	return format != GL_RGBA8;
+}
+
+/* une ligne de pixels, ou de blocs 4x4 (16 octets en BC7) si compresse */
+static void levelRows(GLenum format, int width, int height, int level, int* rows, size_t* row_bytes){
+	int w = width >> level;
+	int h = height >> level;
+	if (w < 1) w = 1;
+	if (h < 1) h = 1;
+	if (isCompressed(format)){
+		*rows = (h + 3) / 4;
+		*row_bytes = (size_t)((w + 3) / 4) * 16;
+	}
+	else{
+		*rows = h;
+		*row_bytes = (size_t)w * 4;
+	}
+}
+
+static int levelCount(int width, int height){
+	int n = 1;
+	while ((width > 1 || height > 1) && n < TEX_MAX_LEVELS){
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		n++;
+	}
+	return n;
+}
+
+static unsigned int readU16(const unsigned char* p){
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int readU32(const unsigned char* p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/* TGA non compresse ou RLE, 24 ou 32 bits ; renvoie du RGBA8, premiere ligne en bas */
+static unsigned char* decodeTGA(const unsigned char* buf, size_t size, int* width, int* height){
+	if (size < 18 || buf[1] != 0 || (buf[2] != 2 && buf[2] != 10))
+		return NULL;
+	int w = readU16(buf + 12);
+	int h = readU16(buf + 14);
+	int bpp = buf[16] / 8;
+	if (w == 0 || h == 0 || (bpp != 3 && bpp != 4))
+		return NULL;
+	bool top_down = (buf[17] & 0x20) != 0;
+	bool rle = buf[2] == 10;
+	const unsigned char* src = buf + 18 + buf[0];
+	const unsigned char* end = buf + size;
+
+	unsigned char* rgba = (unsigned char*)malloc((size_t)w * h * 4);
+	int total = w * h;
+	int i = 0;
+	while (i < total){
+		int count = total;
+		bool repeat = false;
+		if (rle){
+			if (src >= end)
+				break;
+			count = (*src & 0x7f) + 1;
+			repeat = (*src & 0x80) != 0;
+			src++;
+		}
+		for (int c = 0; c < count && i < total; c++, i++){
+			const unsigned char* px = repeat ? src : src + c * bpp;
+			if (px + bpp > end){
+				free(rgba);
+				return NULL;
+			}
+			int y = i / w;
+			int x = i % w;
+			unsigned char* dst = rgba + 4 * ((size_t)(top_down ? h - 1 - y : y) * w + x);
+			dst[0] = px[2];
+			dst[1] = px[1];
+			dst[2] = px[0];
+			dst[3] = bpp == 4 ? px[3] : 255;
+		}
+		src += repeat ? bpp : count * bpp;
+	}
+	if (i < total){
+		free(rgba);
+		return NULL;
+	}
+	*width = w;
+	*height = h;
+	return rgba;
+}
+
+/* BMP 24 ou 32 bits non compresse ; renvoie du RGBA8, premiere ligne en bas */
+static unsigned char* decodeBMP(const unsigned char* buf, size_t size, int* width, int* height){
+	if (size < 54 || buf[0] != 'B' || buf[1] != 'M')
+		return NULL;
+	unsigned int data_offset = readU32(buf + 10);
+	int w = (int)readU32(buf + 18);
+	int h = (int)readU32(buf + 22);
+	int bpp = readU16(buf + 28) / 8;
+	unsigned int compression = readU32(buf + 30);
+	bool top_down = h < 0;
+	if (top_down)
+		h = -h;
+	if (w <= 0 || h == 0 || (bpp != 3 && bpp != 4) || (compression != 0 && !(compression == 3 && bpp == 4)))
+		return NULL;
+	size_t stride = ((size_t)w * bpp + 3) & ~(size_t)3;
+	if (data_offset + stride * h > size)
+		return NULL;
+
+	unsigned char* rgba = (unsigned char*)malloc((size_t)w * h * 4);
+	for (int y = 0; y < h; y++){
+		const unsigned char* row = buf + data_offset + stride * (top_down ? h - 1 - y : y);
+		unsigned char* dst = rgba + (size_t)4 * w * y;
+		for (int x = 0; x < w; x++){
+			const unsigned char* px = row + x * bpp;
+			dst[4 * x] = px[2];
+			dst[4 * x + 1] = px[1];
+			dst[4 * x + 2] = px[0];
+			dst[4 * x + 3] = compression == 3 ? px[3] : 255; // l'alpha d'un BI_RGB n'est pas fiable
+		}
+	}
+	*width = w;
+	*height = h;
+	return rgba;
+}
+
+static unsigned char* decodeImage(const char* file_name, int* width, int* height){
+	size_t size = 0;
+	void* view = mapFile(file_name, &size);
+	if (view == NULL){
+		printf("error reading the texture %s\n", file_name);
+		return NULL;
+	}
+	unsigned char* rgba = decodeBMP((const unsigned char*)view, size, width, height);
+	if (rgba == NULL)
+		rgba = decodeTGA((const unsigned char*)view, size, width, height);
+	unmapFile(view, size);
+	if (rgba == NULL)
+		printf("format de texture non supporte (TGA ou BMP attendu) : %s\n", file_name);
+	return rgba;
+}
+
+/* image TGA ou BMP en RGBA8, ligne du bas en premier comme glReadPixels ; a liberer par free */
+unsigned char* readImage(const char* file_name, int* width, int* height){
+	return decodeImage(file_name, width, height);
+}
+
+/* range les niveaux de tex dans un seul bloc, alignes comme dans le .ctex */
+static void allocLevels(TextureData* tex, const size_t* sizes){
+	size_t offsets[TEX_MAX_LEVELS];
+	size_t total = 0;
+	for (int l = 0; l < tex->level_ctr; l++){
+		offsets[l] = total;
+		total = (total + sizes[l] + 15) & ~(size_t)15;
+	}
+	tex->block = malloc(total);
+	tex->total_size = 0;
+	for (int l = 0; l < tex->level_ctr; l++){
+		tex->levels[l] = (const unsigned char*)tex->block + offsets[l];
+		tex->level_sizes[l] = sizes[l];
+		tex->total_size += sizes[l];
+	}
+}
+
+/* chaine de mipmaps complete par moyenne 2x2, en RGBA8 */
+static void buildMips(TextureData* tex, const unsigned char* rgba, int width, int height){
+	tex->format = GL_RGBA8;
+	tex->width = width;
+	tex->height = height;
+	tex->level_ctr = levelCount(width, height);
+	size_t sizes[TEX_MAX_LEVELS];
+	for (int l = 0; l < tex->level_ctr; l++){
+		int rows;
+		size_t row_bytes;
+		levelRows(tex->format, width, height, l, &rows, &row_bytes);
+		sizes[l] = rows * row_bytes;
+	}
+	allocLevels(tex, sizes);
+	memcpy((void*)tex->levels[0], rgba, sizes[0]);
+
+	int w = width;
+	int h = height;
+	for (int l = 1; l < tex->level_ctr; l++){
+		const unsigned char* src = tex->levels[l - 1];
+		unsigned char* dst = (unsigned char*)tex->levels[l];
+		int nw = w > 1 ? w / 2 : 1;
+		int nh = h > 1 ? h / 2 : 1;
+		for (int y = 0; y < nh; y++){
+			int y0 = 2 * y < h ? 2 * y : h - 1;
+			int y1 = 2 * y + 1 < h ? 2 * y + 1 : h - 1;
+			for (int x = 0; x < nw; x++){
+				int x0 = 2 * x < w ? 2 * x : w - 1;
+				int x1 = 2 * x + 1 < w ? 2 * x + 1 : w - 1;
+				for (int c = 0; c < 4; c++){
+					int sum = src[4 * (y0 * w + x0) + c] + src[4 * (y0 * w + x1) + c]
+						+ src[4 * (y1 * w + x0) + c] + src[4 * (y1 * w + x1) + c];
+					dst[4 * (y * nw + x) + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		w = nw;
+		h = nh;
+	}
+}
+
+static bool loadCtex(const char* path, unsigned long long source_hash, TextureData* tex){
+	size_t size = 0;
+	void* view = mapFile(path, &size);
+	if (view == NULL)
+		return false;
+
+	const CtexHeader* header = (const CtexHeader*)view;
+	bool valid = size >= sizeof(CtexHeader)
+		&& header->magic == CTEX_MAGIC
+		&& header->version == CTEX_VERSION
+		&& header->source_hash == source_hash
+		&& header->file_size == size
+		&& (header->format == GL_RGBA8 || header->format == GL_COMPRESSED_RGBA_BPTC_UNORM)
+		&& header->level_ctr > 0 && header->level_ctr <= TEX_MAX_LEVELS;
+	for (int l = 0; valid && l < header->level_ctr; l++){
+		int rows;
+		size_t row_bytes;
+		levelRows(header->format, header->width, header->height, l, &rows, &row_bytes);
+		valid = header->sizes[l] == rows * row_bytes && header->offsets[l] + (size_t)header->sizes[l] <= size;
+	}
+	if (!valid){
+		unmapFile(view, size);
+		return false;
+	}
+
+	tex->format = header->format;
+	tex->width = header->width;
+	tex->height = header->height;
+	tex->level_ctr = header->level_ctr;
+	tex->total_size = 0;
+	for (int l = 0; l < tex->level_ctr; l++){
+		tex->levels[l] = (const unsigned char*)view + header->offsets[l];
+		tex->level_sizes[l] = header->sizes[l];
+		tex->total_size += header->sizes[l];
+	}
+	tex->mapping = view;
+	tex->mapping_size = size;
+	return true;
+}
+
+static bool writeCtex(const char* path, unsigned long long source_hash, const TextureData* tex){
+	CtexHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CTEX_MAGIC;
+	header.version = CTEX_VERSION;
+	header.source_hash = source_hash;
+	header.format = tex->format;
+	header.width = tex->width;
+	header.height = tex->height;
+	header.level_ctr = tex->level_ctr;
+	size_t offset = sizeof(header);
+	for (int l = 0; l < tex->level_ctr; l++){
+		offset = (offset + 15) & ~(size_t)15;
+		header.offsets[l] = (unsigned int)offset;
+		header.sizes[l] = (unsigned int)tex->level_sizes[l];
+		offset += tex->level_sizes[l];
+	}
+	header.file_size = (unsigned int)offset;
+
+	/* ecrit a cote puis renomme, comme les fichiers cuits des modeles */
+	char tmp_path[520];
+	sprintf(tmp_path, "%.500s.tmp", path);
+	FILE* fichier = fopen(tmp_path, "wb");
+	if (fichier == NULL){
+		printf("error writing the texture %s\n", path);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, fichier);
+	static const char padding[16] = { 0 };
+	offset = sizeof(header);
+	for (int l = 0; l < tex->level_ctr; l++){
+		fwrite(padding, 1, header.offsets[l] - offset, fichier);
+		fwrite(tex->levels[l], 1, tex->level_sizes[l], fichier);
+		offset = header.offsets[l] + header.sizes[l];
+	}
+	fclose(fichier);
+	remove(path);
+	return rename(tmp_path, path) == 0;
+}
+
+/* Lit une texture depuis <file_name>.ctex si le hash de l'image correspond, sinon
+decode l'image et calcule les mipmaps en RGBA8 (le .ctex ecrit evite de recommencer ;
+cookTexture le remplace par sa version BC7). Aucun appel GL : thread de chargement. */
+bool readTexture(const char* file_name, TextureData* tex){
+	memset(tex, 0, sizeof(TextureData));
+	strncpy(tex->name, file_name, sizeof(tex->name) - 1);
+
+	unsigned long long source_hash = 0;
+	if (!hashFile(file_name, &source_hash)){
+		printf("error reading the texture %s\n", file_name);
+		return false;
+	}
+	char ctex[512];
+	sprintf(ctex, "%.500s.ctex", file_name);
+	if (loadCtex(ctex, source_hash, tex))
+		return true;
+
+	int width, height;
+	unsigned char* rgba = decodeImage(file_name, &width, &height);
+	if (rgba == NULL)
+		return false;
+	buildMips(tex, rgba, width, height);
+	free(rgba);
+	writeCtex(ctex, source_hash, tex);
+	return true;
+}
+
+void freeTextureData(TextureData* tex){
+	free(tex->block);
+	unmapFile(tex->mapping, tex->mapping_size);
+	memset(tex, 0, sizeof(TextureData));
+}
+
+/* Conversion hors ligne : les mipmaps RGBA8 sont compresses en BC7 par le pilote puis
+relus avec glGetCompressedTexImage. L'encodeur du pilote est lent mais ce n'est fait
+qu'une fois par image ; sans BPTC, le .ctex reste en RGBA8. */
+bool cookTexture(const char* file_name){
+	unsigned long long source_hash = 0;
+	if (!hashFile(file_name, &source_hash))
+		return false;
+	int width, height;
+	unsigned char* rgba = decodeImage(file_name, &width, &height);
+	if (rgba == NULL)
+		return false;
+	double start = profNow();
+
+	TextureData plain;
+	memset(&plain, 0, sizeof(plain));
+	strncpy(plain.name, file_name, sizeof(plain.name) - 1);
+	buildMips(&plain, rgba, width, height);
+	free(rgba);
+
+	TextureData* result = &plain;
+	TextureData packed;
+	memset(&packed, 0, sizeof(packed));
+	if (GLEW_ARB_texture_compression_bptc){
+		GLuint tex;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		int w = width;
+		int h = height;
+		for (int l = 0; l < plain.level_ctr; l++){
+			glTexImage2D(GL_TEXTURE_2D, l, GL_COMPRESSED_RGBA_BPTC_UNORM, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, plain.levels[l]);
+			w = w > 1 ? w / 2 : 1;
+			h = h > 1 ? h / 2 : 1;
+		}
+
+		packed = plain;
+		packed.block = NULL;
+		packed.mapping = NULL;
+		packed.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		size_t sizes[TEX_MAX_LEVELS];
+		bool ok = true;
+		for (int l = 0; l < plain.level_ctr && ok; l++){
+			GLint compressed = GL_FALSE, format = 0, size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_COMPRESSED, &compressed);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_INTERNAL_FORMAT, &format);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			int rows;
+			size_t row_bytes;
+			levelRows(packed.format, width, height, l, &rows, &row_bytes);
+			sizes[l] = size;
+			ok = compressed && format == GL_COMPRESSED_RGBA_BPTC_UNORM && (size_t)size == rows * row_bytes;
+		}
+		if (ok){
+			allocLevels(&packed, sizes);
+			for (int l = 0; l < packed.level_ctr; l++)
+				glGetCompressedTexImage(GL_TEXTURE_2D, l, (void*)packed.levels[l]);
+			result = &packed;
+		}
+		else{
+			printf("le pilote n'a pas compresse %s en BC7, RGBA8 conserve\n", file_name);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glDeleteTextures(1, &tex);
+	}
+
+	char ctex[512];
+	sprintf(ctex, "%.500s.ctex", file_name);
+	bool written = writeCtex(ctex, source_hash, result);
+	if (written)
+		printf("%s : %ix%i, %i niveaux, %s, %.1f Ko (%.0f ms)\n", ctex, width, height, result->level_ctr,
+			result->format == GL_RGBA8 ? "RGBA8" : "BC7", result->total_size / 1024.0, (profNow() - start) * 1000.0);
+	freeTextureData(&packed);
+	freeTextureData(&plain);
+	return written;
+}
+
+/* Cree la texture et alloue tous ses niveaux ; l'envoi prend possession des donnees */
+void textureUploadBegin(TextureUpload* up, const TextureData* data){
+	up->data = *data;
+	up->level = 0;
+	up->row = 0;
+	up->active = true;
+
+	glGenTextures(1, &up->tex);
+	glBindTexture(GL_TEXTURE_2D, up->tex);
+	int w = data->width;
+	int h = data->height;
+	for (int l = 0; l < data->level_ctr; l++){
+		if (isCompressed(data->format))
+			glCompressedTexImage2D(GL_TEXTURE_2D, l, data->format, w, h, 0, (GLsizei)data->level_sizes[l], NULL);
+		else
+			glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, data->level_ctr - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	if (pbos[0] == 0)
+		glGenBuffers(TEX_PBO_RING, pbos);
+}
+
+/* Envoie des tranches de TEX_PBO_SIZE jusqu'a 'deadline' (en secondes de profNow),
+au moins une par appel. Chaque tranche passe par le PBO suivant de l'anneau, rendu
+orphelin avant d'etre projete, pour ne jamais attendre la fin d'une copie precedente.
+Renvoie true quand tous les niveaux sont envoyes. */
+bool textureUploadStep(TextureUpload* up, double deadline){
+	const TextureData* data = &up->data;
+	glBindTexture(GL_TEXTURE_2D, up->tex);
+	while (up->level < data->level_ctr){
+		int l = up->level;
+		int rows;
+		size_t row_bytes;
+		levelRows(data->format, data->width, data->height, l, &rows, &row_bytes);
+		int n = (int)(TEX_PBO_SIZE / row_bytes);
+		if (n < 1)
+			n = 1;
+		if (n > rows - up->row)
+			n = rows - up->row;
+		size_t bytes = n * row_bytes;
+		const unsigned char* src = data->levels[l] + up->row * row_bytes;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[pbo_next]);
+		pbo_next = (pbo_next + 1) % TEX_PBO_RING;
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		const void* pixels = NULL; // offset 0 dans le PBO
+		if (dst != NULL){
+			memcpy(dst, src, bytes);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			pixels = src;
+		}
+
+		int w = data->width >> l;
+		int h = data->height >> l;
+		if (w < 1) w = 1;
+		if (h < 1) h = 1;
+		if (isCompressed(data->format)){
+			int y = up->row * 4;
+			int sub_h = n * 4 < h - y ? n * 4 : h - y;
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, l, 0, y, w, sub_h, data->format, (GLsizei)bytes, pixels);
+		}
+		else{
+			glTexSubImage2D(GL_TEXTURE_2D, l, 0, up->row, w, n, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+
+		up->row += n;
+		if (up->row == rows){
+			up->level++;
+			up->row = 0;
+		}
+		if (profNow() >= deadline)
+			break;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return up->level == data->level_ctr;
+}
+
+/* retire les textures inutilisees les plus anciennes tant que le budget est depasse */
+static void evictTextures(size_t budget, int max_entries){
+	while (cache_bytes > budget || cache_ctr > max_entries){
+		int oldest = -1;
+		for (int i = 0; i < cache_ctr; i++){
+			if (cache[i].refs == 0 && (oldest < 0 || cache[i].last_use < cache[oldest].last_use))
+				oldest = i;
+		}
+		if (oldest < 0)
+			return;
+		glDeleteTextures(1, &cache[oldest].tex);
+		cache_bytes -= cache[oldest].bytes;
+		cache[oldest] = cache[--cache_ctr];
+	}
+}
+
+/* Range la texture envoyee dans le cache, avec une reference pour l'appelant. Si toutes
+les places sont prises par des textures utilisees, elle reste hors du cache, a l'appelant :
+textureRelease la detruit. */
+GLuint textureUploadFinish(TextureUpload* up){
+	std::lock_guard<std::mutex> lk(cache_lock);
+	GLuint tex = up->tex;
+	for (int i = 0; i < cache_ctr; i++){
+		/* deja chargee par une autre demande entre-temps */
+		if (strcmp(cache[i].name, up->data.name) == 0){
+			glDeleteTextures(1, &tex);
+			tex = cache[i].tex;
+			cache[i].refs++;
+			up->tex = 0;
+		}
+	}
+	if (up->tex != 0){
+		evictTextures(cache_bytes, TEX_CACHE_MAX - 1);
+		if (cache_ctr < TEX_CACHE_MAX){
+			CacheEntry* e = &cache[cache_ctr++];
+			strcpy(e->name, up->data.name);
+			e->tex = tex;
+			e->bytes = up->data.total_size;
+			e->refs = 1;
+			e->last_use = ++use_clock;
+			cache_bytes += e->bytes;
+			evictTextures(TEX_BUDGET, TEX_CACHE_MAX);
+		}
+	}
+	freeTextureData(&up->data);
+	up->tex = 0;
+	up->active = false;
+	return tex;
+}
+
+void textureUploadAbort(TextureUpload* up){
+	if (!up->active)
+		return;
+	glDeleteTextures(1, &up->tex);
+	freeTextureData(&up->data);
+	up->tex = 0;
+	up->active = false;
+}
+
+bool textureResident(const char* name){
+	std::lock_guard<std::mutex> lk(cache_lock);
+	for (int i = 0; i < cache_ctr; i++){
+		if (strcmp(cache[i].name, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+/* texture deja en cache, 0 sinon */
+GLuint textureAcquire(const char* name){
+	std::lock_guard<std::mutex> lk(cache_lock);
+	for (int i = 0; i < cache_ctr; i++){
+		if (strcmp(cache[i].name, name) == 0){
+			cache[i].refs++;
+			cache[i].last_use = ++use_clock;
+			return cache[i].tex;
+		}
+	}
+	return 0;
+}
+
+/* la texture reste en cache (pour revenir au vetement sans la recharger)
+tant que le budget n'oblige pas a la retirer ; hors du cache, elle est detruite */
+void textureRelease(GLuint tex){
+	if (tex == 0)
+		return;
+	std::lock_guard<std::mutex> lk(cache_lock);
+	bool cached = false;
+	for (int i = 0; i < cache_ctr; i++){
+		if (cache[i].tex == tex){
+			cached = true;
+			if (cache[i].refs > 0)
+				cache[i].refs--;
+			cache[i].last_use = ++use_clock;
+		}
+	}
+	if (!cached)
+		glDeleteTextures(1, &tex);
+	evictTextures(TEX_BUDGET, TEX_CACHE_MAX);
+}
+
+void textureShutdown(){
+	std::lock_guard<std::mutex> lk(cache_lock);
+	for (int i = 0; i < cache_ctr; i++)
+		glDeleteTextures(1, &cache[i].tex);
+	cache_ctr = 0;
+	cache_bytes = 0;
+	if (pbos[0] != 0)
+		glDeleteBuffers(TEX_PBO_RING, pbos);
+	memset(pbos, 0, sizeof(pbos));
+}
@@ -0,0 +1,61 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#ifndef GLEW_H
+#define GLEW_H
+#include <glew.h>
+#endif
+
+#include <stdlib.h>
+
+/* Textures des vetements.
+Les images (TGA ou BMP) sont converties hors ligne en <image>.ctex : chaine de mipmaps
+complete, compressee en BC7 quand le pilote sait l'encoder, en RGBA8 sinon. La lecture
+se fait dans les threads de chargement ; l'envoi GPU passe par un anneau de PBOs, par
+tranches bornees en temps, et les textures restent en cache dans la limite de TEX_BUDGET. */
+
+#define TEX_MAX_LEVELS 16
+#define TEX_BUDGET (128 * 1024 * 1024) // octets de textures gardes sur le GPU
+#define TEX_PBO_RING 3
+#define TEX_PBO_SIZE (256 * 1024)      // octets par tranche d'envoi
+
+struct TextureData{
+	char name[256];     // chemin de l'image source, cle du cache
+	GLenum format;      // GL_COMPRESSED_RGBA_BPTC_UNORM ou GL_RGBA8
+	int width;
+	int height;
+	int level_ctr;
+	const unsigned char* levels[TEX_MAX_LEVELS];
+	size_t level_sizes[TEX_MAX_LEVELS];
+	size_t total_size;
+
+	void* block;        // image decodee et mipmaps calcules a la lecture
+	void* mapping;      // vue du fichier .ctex
+	size_t mapping_size;
+};
+
+/* envoi d'une texture en cours, propre au thread de rendu */
+struct TextureUpload{
+	TextureData data;
+	GLuint tex;
+	int level;
+	int row;            // en lignes de pixels, ou de blocs 4x4 si compresse
+	bool active;
+};
+
+unsigned char* readImage(const char* file_name, int* width, int* height);
+bool readTexture(const char* file_name, TextureData* tex);
+void freeTextureData(TextureData* tex);
+bool cookTexture(const char* file_name); // contexte GL courant requis
+
+void textureUploadBegin(TextureUpload* up, const TextureData* data);
+bool textureUploadStep(TextureUpload* up, double deadline);
+GLuint textureUploadFinish(TextureUpload* up);
+void textureUploadAbort(TextureUpload* up);
+
+bool textureResident(const char* name); // utilisable depuis les threads de chargement
+GLuint textureAcquire(const char* name);
+void textureRelease(GLuint tex);
+void textureShutdown();
+
+#endif